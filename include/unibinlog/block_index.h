@@ -0,0 +1,169 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_BLOCK_INDEX_H
+#define UNIBINLOG_BLOCK_INDEX_H
+
+#include <stdio.h>
+
+#include <unibinlog/basic_types.h>
+#include <unibinlog/chksum.h>
+#include <unibinlog/error.h>
+#include <unibinlog/platform.h>
+#include <unibinlog/types.h>
+
+UB_BEGIN_DECLS
+
+/**
+ * \def UB_BLOCK_INDEX_NO_TIMESTAMP
+ *
+ * Value of \ref ub_block_index_t.timestamp_column when the log has no
+ * timestamp column.
+ */
+#define UB_BLOCK_INDEX_NO_TIMESTAMP 255
+
+/**
+ * \def UB_BLOCK_INDEX_ENTRY_LENGTH
+ *
+ * The length of a single serialized entry in an index block
+ * (\c UB_BLOCK_INDEX).
+ */
+#define UB_BLOCK_INDEX_ENTRY_LENGTH 34
+
+/**
+ * \def UB_BLOCK_INDEX_TRAILER_LENGTH
+ *
+ * The length of the payload of an index trailer block
+ * (\c UB_BLOCK_INDEX_TRAILER).
+ */
+#define UB_BLOCK_INDEX_TRAILER_LENGTH 17
+
+/**
+ * Structure describing a single log entry block in a \ref ub_block_index_t.
+ */
+typedef struct {
+    uint64_t offset;               /**< File offset of the first byte of the block */
+    uint64_t first_row;            /**< Row number of the first row of the block */
+    size_t num_rows;               /**< The number of rows in the block */
+    int64_t first_timestamp;       /**< Timestamp of the first row of the block */
+    int64_t last_timestamp;        /**< Timestamp of the last row of the block */
+} ub_block_index_entry_t;
+
+/**
+ * Structure that stores the \em block \em index of a log file, i.e. the
+ * location, the row numbers and the time range of each log entry block.
+ *
+ * The index is stored at the end of the file in one or more index blocks
+ * (\c UB_BLOCK_INDEX), holding \ref UB_BLOCK_INDEX_ENTRY_LENGTH bytes per
+ * log entry block, followed by a trailer block (\c UB_BLOCK_INDEX_TRAILER)
+ * that points to the first index block. The trailer has a fixed length, so
+ * readers can find it by seeking to the end of the file. All numbers are
+ * stored in network byte order.
+ *
+ * Timestamps are taken from the timestamp column of the log (if any; see
+ * \c timestamp_column) with \ref ub_byteorder_decode_int64(). Seeking by
+ * time assumes that the timestamps never decrease.
+ */
+typedef struct {
+    ub_block_index_entry_t* entries;  /**< The entries of the index, one per block */
+    size_t num_entries;               /**< The number of entries */
+    size_t capacity;                  /**< The number of entries allocated */
+    size_t timestamp_column;          /**< Index of the timestamp column or \ref UB_BLOCK_INDEX_NO_TIMESTAMP */
+} ub_block_index_t;
+
+/**
+ * Initializes an empty block index without a timestamp column.
+ *
+ * \param  index  the index to initialize
+ * \return \c UB_SUCCESS
+ */
+ub_error_t ub_block_index_init(ub_block_index_t* index);
+
+/**
+ * Destroys a block index.
+ *
+ * \param  index  the index to destroy
+ */
+void ub_block_index_destroy(ub_block_index_t* index);
+
+/**
+ * Removes all the entries from a block index.
+ *
+ * \param  index  the index to clear
+ */
+void ub_block_index_clear(ub_block_index_t* index);
+
+/**
+ * Appends an entry to the end of a block index.
+ *
+ * \param  index  the index
+ * \param  entry  the entry to append; it is copied
+ * \return \c UB_SUCCESS or \c UB_ENOMEM
+ */
+ub_error_t ub_block_index_append(ub_block_index_t* index,
+        const ub_block_index_entry_t* entry);
+
+/**
+ * Returns the total number of rows in the blocks of an index.
+ *
+ * \param  index  the index
+ * \return the number of rows
+ */
+uint64_t ub_block_index_get_num_rows(const ub_block_index_t* index);
+
+/**
+ * Finds the entry of the block that contains the row with the given number
+ * using binary search.
+ *
+ * \param  index  the index
+ * \param  row    the row number to look for
+ * \param  entry  the index of the entry will be returned here
+ * \return \c UB_SUCCESS or \c UB_EOF if the row is past the last block
+ */
+ub_error_t ub_block_index_find_row(const ub_block_index_t* index,
+        uint64_t row, size_t* entry);
+
+/**
+ * Finds the entry of the first block that contains rows with timestamps
+ * greater than or equal to the given timestamp using binary search.
+ *
+ * \param  index      the index
+ * \param  timestamp  the timestamp to look for
+ * \param  entry      the index of the entry will be returned here
+ * \return \c UB_SUCCESS, \c UB_EOF if all the rows are older than the given
+ *         timestamp or \c UB_EUNSUPPORTED if the log has no timestamp column
+ */
+ub_error_t ub_block_index_find_timestamp(const ub_block_index_t* index,
+        int64_t timestamp, size_t* entry);
+
+/**
+ * Writes a block index into the given file as index blocks followed by an
+ * index trailer block. The index blocks start at the current position of
+ * the file, which therefore must support \c ftell().
+ *
+ * \param  index        the index to write
+ * \param  f            the file to write into
+ * \param  chksum_type  the checksum type used by the blocks of the file
+ * \return \c UB_SUCCESS, \c UB_EUNSUPPORTED if the position of the file
+ *         cannot be determined or an error code from the write operations
+ */
+ub_error_t ub_block_index_write(const ub_block_index_t* index, FILE* f,
+        ub_chksum_type_t chksum_type);
+
+/**
+ * Reads a block index from the end of the given file, replacing the entries
+ * of the index. The position of the file is unspecified afterwards.
+ *
+ * \param  index        the index to read into
+ * \param  f            the file to read from; it must support seeking
+ * \param  chksum_type  the checksum type used by the blocks of the file
+ * \return \c UB_SUCCESS, \c UB_EOF if the file does not end with an index
+ *         trailer block, \c UB_EUNSUPPORTED if the file does not support
+ *         seeking, \c UB_EPARSE if the index is corrupted or an error code
+ *         from the read operations
+ */
+ub_error_t ub_block_index_read(ub_block_index_t* index, FILE* f,
+        ub_chksum_type_t chksum_type);
+
+UB_END_DECLS
+
+#endif
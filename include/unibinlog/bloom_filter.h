@@ -0,0 +1,116 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_BLOOM_FILTER_H
+#define UNIBINLOG_BLOOM_FILTER_H
+
+#include <unibinlog/basic_types.h>
+#include <unibinlog/buffer.h>
+#include <unibinlog/byteorder.h>
+#include <unibinlog/error.h>
+#include <unibinlog/log_column.h>
+#include <unibinlog/platform.h>
+#include <unibinlog/types.h>
+
+UB_BEGIN_DECLS
+
+/**
+ * \def UB_BLOOM_FILTER_BITS_PER_ROW
+ *
+ * The number of bits allocated per row in the Bloom filters written by
+ * \ref ub_bloom_filter_encode(). Together with
+ * \ref UB_BLOOM_FILTER_NUM_HASHES, this yields a false positive rate of
+ * about 1% when all the values in the block are distinct.
+ */
+#define UB_BLOOM_FILTER_BITS_PER_ROW 10
+
+/**
+ * \def UB_BLOOM_FILTER_NUM_HASHES
+ *
+ * The number of hash functions used by the Bloom filters written by
+ * \ref ub_bloom_filter_encode().
+ */
+#define UB_BLOOM_FILTER_NUM_HASHES 7
+
+/**
+ * A value to look for in the Bloom filters of a log, see
+ * \ref ub_bloom_key_init().
+ */
+typedef struct {
+    size_t column;                 /**< Index of the column */
+    uint64_t hash;                 /**< Hash of the value */
+} ub_bloom_key_t;
+
+/**
+ * Initializes a key to look for in the Bloom filters of a column.
+ *
+ * Values are hashed in a canonical form that does not depend on the byte
+ * order of the log: strings without their terminating null byte, blobs
+ * without their length prefix and everything else in network byte order.
+ * Floating-point values are compared by their bit patterns.
+ *
+ * \param  key     the key to initialize
+ * \param  column  the index of the column
+ * \param  type    the data type of the column
+ * \param  value   pointer to the value. Strings and blobs are given by their
+ *                 contents; values of other types are given as the native C
+ *                 type of the column (see \ref ub_typeinfo_t.c_name).
+ * \param  length  the length of the string or blob; ignored for other types
+ * \return \c UB_SUCCESS or \c UB_EUNSUPPORTED if the type is unknown
+ */
+ub_error_t ub_bloom_key_init(ub_bloom_key_t* key, size_t column,
+        ub_datatype_t type, const void* value, size_t length);
+
+/**
+ * Computes the Bloom filters of the given columns of the given rows and
+ * serializes them into the payload of a Bloom filter block
+ * (\c UB_BLOCK_BLOOM_FILTER).
+ *
+ * The payload consists of the number of rows of the block (2 bytes) and the
+ * number of filters (1 byte), followed by each filter: the column index
+ * (1 byte), the number of hash functions (1 byte), the length of the bit
+ * array in bytes (2 bytes) and the bit array itself. All numbers are stored
+ * in network byte order. Each filter has
+ * \ref UB_BLOOM_FILTER_BITS_PER_ROW bits per row unless that would make the
+ * block too long.
+ *
+ * \param  payload         the buffer to write the payload into; it is
+ *                         resized
+ * \param  columns         the columns of the log
+ * \param  num_columns     the number of columns
+ * \param  aligned         whether the rows use the aligned row layout
+ * \param  order           the byte order of the values in the rows
+ * \param  rows            the rows, one after the other
+ * \param  length          the total length of the rows
+ * \param  filter_columns  the indices of the columns to build filters for
+ * \param  num_filters     the number of filters; at most 255
+ * \return \c UB_SUCCESS, \c UB_ENOMEM or \c UB_EINVAL if the rows do not
+ *         match the columns or a column index is out of range
+ */
+ub_error_t ub_bloom_filter_encode(ub_buffer_t* payload,
+        const ub_log_column_t* columns, size_t num_columns, ub_bool_t aligned,
+        ub_byte_order_t order, const uint8_t* rows, size_t length,
+        const size_t* filter_columns, size_t num_filters);
+
+/**
+ * Decides whether the block described by the given Bloom filter block may
+ * contain rows that match the given keys. Keys of the same column are
+ * alternatives; keys of different columns must all match. Keys of columns
+ * without a filter are assumed to match.
+ *
+ * \param  data      the payload of the Bloom filter block
+ * \param  size      the size of the payload
+ * \param  keys      the keys to look for
+ * \param  num_keys  the number of keys
+ * \param  num_rows  the number of rows of the block will be returned here
+ *                   if it is not null
+ * \param  result    whether the block may contain matching rows will be
+ *                   returned here
+ * \return \c UB_SUCCESS or \c UB_EPARSE if the payload is malformed
+ */
+ub_error_t ub_bloom_filter_may_contain(const uint8_t* data, size_t size,
+        const ub_bloom_key_t* keys, size_t num_keys, size_t* num_rows,
+        ub_bool_t* result);
+
+UB_END_DECLS
+
+#endif
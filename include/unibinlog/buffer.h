@@ -6,11 +6,15 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <time.h>
+#include <sys/time.h>
 #include <unistd.h>
 
 #include <unibinlog/basic_types.h>
 #include <unibinlog/chksum.h>
 #include <unibinlog/error.h>
+#include <unibinlog/platform.h>
+
+UB_BEGIN_DECLS
 
 /**
  * Structure for a heap-allocated buffer that keeps track of its size.
@@ -562,4 +566,6 @@ ub_error_t ub_buffer_writer_write_timestamp(ub_buffer_writer_t* writer, time_t v
  */
 ub_error_t ub_buffer_writer_write_timeval(ub_buffer_writer_t* writer, struct timeval time);
 
+UB_END_DECLS
+
 #endif
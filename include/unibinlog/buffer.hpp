@@ -0,0 +1,309 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_BUFFER_HPP
+#define UNIBINLOG_BUFFER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <utility>
+
+#include <unibinlog/buffer.h>
+#include <unibinlog/error.hpp>
+#include <unibinlog/lowlevel.h>
+#include <unibinlog/span.hpp>
+#include <unibinlog/types.hpp>
+
+namespace unibinlog {
+
+namespace detail {
+
+/**
+ * Deleter for heap-allocated \ref ub_buffer_t structures that destroys the
+ * buffer before freeing the structure itself.
+ */
+struct buffer_deleter {
+    void operator()(ub_buffer_t* buf) const noexcept {
+        ub_buffer_destroy(buf);
+        delete buf;
+    }
+};
+
+}
+
+/**
+ * Move-only C++ wrapper around \ref ub_buffer_t.
+ *
+ * The underlying \ref ub_buffer_t lives on the heap so its address does not
+ * change when the wrapper is moved; \ref buffer_writer objects and C
+ * functions holding a pointer to it remain valid. Moving a buffer transfers
+ * the ownership of its memory area without copying it. Copies have to be
+ * requested explicitly with \ref copy().
+ *
+ * This header requires C++17.
+ */
+class buffer {
+public:
+    /**
+     * Creates an empty buffer.
+     */
+    buffer() : buffer(std::size_t(0)) {}
+
+    /**
+     * Creates a zero-filled buffer of the given size.
+     */
+    explicit buffer(std::size_t size) : buf_(new ub_buffer_t) {
+        ub_error_t retval = ub_buffer_init(buf_.get(), size);
+        if (retval != UB_SUCCESS) {
+            delete buf_.release();
+            throw error(retval);
+        }
+    }
+
+    buffer(buffer&&) noexcept = default;
+    buffer& operator=(buffer&&) noexcept = default;
+
+    /**
+     * Takes ownership of a buffer initialized by the C API. The C structure
+     * is reset to an empty view so it must not be used afterwards.
+     */
+    static buffer adopt(ub_buffer_t& buf) {
+        buffer result(nullptr);
+        result.buf_.reset(new ub_buffer_t(buf));
+        buf = ub_buffer_view(0, 0);
+        return result;
+    }
+
+    /**
+     * Creates a buffer that refers to a memory area that it does not own.
+     * The memory area must outlive the buffer, and the buffer cannot be
+     * resized.
+     */
+    static buffer view(void* data, std::size_t size) {
+        buffer result(nullptr);
+        result.buf_.reset(new ub_buffer_t(ub_buffer_view(data, size)));
+        return result;
+    }
+
+    /**
+     * Creates a deep copy of the buffer.
+     */
+    buffer copy() const {
+        if (!buf_) {
+            return buffer();
+        }
+        buffer result(nullptr);
+        result.buf_.reset(new ub_buffer_t);
+        ub_error_t retval = ub_buffer_copy(result.buf_.get(), buf_.get());
+        if (retval != UB_SUCCESS) {
+            delete result.buf_.release();
+            throw error(retval);
+        }
+        return result;
+    }
+
+    /**
+     * Releases the ownership of the memory area of the buffer and returns it
+     * as a C structure. The caller becomes responsible for destroying it with
+     * \ref ub_buffer_destroy(). The wrapper becomes empty.
+     */
+    ub_buffer_t release() noexcept {
+        if (!buf_) {
+            return ub_buffer_view(0, 0);
+        }
+        ub_buffer_t result = *buf_;
+        delete buf_.release();
+        return result;
+    }
+
+    /**
+     * Returns the contents of the buffer as a read-only view.
+     */
+    const_byte_span bytes() const noexcept {
+        if (!buf_) {
+            return const_byte_span();
+        }
+        return const_byte_span(reinterpret_cast<const std::byte*>(buf_->bytes),
+                ub_buffer_size(buf_.get()));
+    }
+
+    /**
+     * Returns the contents of the buffer as a read-write view.
+     */
+    byte_span mutable_bytes() noexcept {
+        if (!buf_) {
+            return byte_span();
+        }
+        return byte_span(reinterpret_cast<std::byte*>(buf_->bytes),
+                ub_buffer_size(buf_.get()));
+    }
+
+    /**
+     * Returns the number of bytes that the buffer can hold without
+     * reallocating its memory area.
+     */
+    std::size_t capacity() const noexcept {
+        return buf_ ? ub_buffer_capacity(buf_.get()) : 0;
+    }
+
+    /**
+     * Returns whether the buffer owns its memory area.
+     */
+    bool is_owner() const noexcept {
+        return buf_ && buf_->owner;
+    }
+
+    /**
+     * Returns a pointer to the underlying C structure. The pointer remains
+     * valid until the wrapper is destroyed or released, even if the wrapper
+     * is moved.
+     */
+    ub_buffer_t* native() noexcept { return buf_.get(); }
+    const ub_buffer_t* native() const noexcept { return buf_.get(); }
+
+    /**
+     * Ensures that the buffer can hold the given number of bytes without
+     * reallocating its memory area.
+     *
+     * \throws error  with \c UB_EINVAL if the buffer was moved from or
+     *                released, or it is a view
+     */
+    void reserve(std::size_t capacity) {
+        if (!is_owner()) {
+            throw error(UB_EINVAL);
+        }
+        check(ub_buffer_reserve(buf_.get(), capacity));
+    }
+
+    /**
+     * Resizes the buffer; new bytes are filled with zeros.
+     *
+     * \throws error  with \c UB_EINVAL if the buffer was moved from or
+     *                released, or it is a view
+     */
+    void resize(std::size_t size) {
+        if (!is_owner()) {
+            throw error(UB_EINVAL);
+        }
+        check(ub_buffer_resize(buf_.get(), size));
+    }
+
+    /**
+     * Returns the number of bytes stored in the buffer.
+     */
+    std::size_t size() const noexcept {
+        return buf_ ? ub_buffer_size(buf_.get()) : 0;
+    }
+
+private:
+    explicit buffer(std::nullptr_t) noexcept {}
+
+    std::unique_ptr<ub_buffer_t, detail::buffer_deleter> buf_;
+};
+
+/**
+ * Move-only C++ wrapper around \ref ub_buffer_writer_t.
+ *
+ * The writer refers to a \ref buffer that must outlive it; the buffer itself
+ * may be moved while the writer is in use.
+ */
+class buffer_writer {
+public:
+    /**
+     * Creates a writer that writes into the given buffer.
+     *
+     * \param  buf    the buffer to write into
+     * \param  index  the index where the writer will start writing
+     * \param  grow   whether the buffer has to be grown when needed
+     */
+    explicit buffer_writer(buffer& buf, std::size_t index = 0, bool grow = true) {
+        check(ub_buffer_writer_init(&writer_, buf.native(), index, grow));
+    }
+
+    buffer_writer(buffer_writer&& other) noexcept : writer_(other.writer_) {
+        other.writer_.loc.buffer = nullptr;
+    }
+
+    buffer_writer& operator=(buffer_writer&& other) noexcept {
+        if (this != &other) {
+            ub_buffer_writer_destroy(&writer_);
+            writer_ = other.writer_;
+            other.writer_.loc.buffer = nullptr;
+        }
+        return *this;
+    }
+
+    ~buffer_writer() {
+        ub_buffer_writer_destroy(&writer_);
+    }
+
+    /**
+     * Returns a pointer to the underlying C structure.
+     */
+    ub_buffer_writer_t* native() noexcept { return &writer_; }
+
+    /**
+     * Moves the write position; see \ref ub_buffer_writer_seek().
+     */
+    void seek(long offset, int whence = SEEK_SET) {
+        check(ub_buffer_writer_seek(&writer_, offset, whence));
+    }
+
+    /**
+     * Returns the current write position.
+     */
+    std::size_t tell() const noexcept {
+        return ub_buffer_writer_tell(&writer_);
+    }
+
+    /**
+     * Writes a single value in network byte order. The type of the value
+     * must have a \ref datatype_traits specialization.
+     */
+    template <typename T>
+    void write(const T& value) {
+        std::uint8_t bytes[datatype_traits<T>::length];
+        datatype_traits<T>::store(bytes, value);
+        write_bytes(const_byte_span(reinterpret_cast<const std::byte*>(bytes),
+                    sizeof(bytes)));
+    }
+
+    /**
+     * Writes raw bytes.
+     */
+    void write_bytes(const_byte_span bytes) {
+        if (writer_.grow) {
+            check(ub_buffer_update_and_grow_from_array(&writer_.loc,
+                        bytes.data(), bytes.size()));
+        } else if (writer_.loc.index + bytes.size() > ub_buffer_size(writer_.loc.buffer)) {
+            throw error(UB_EINVAL);
+        } else {
+            ub_buffer_update_from_array(&writer_.loc, bytes.data(), bytes.size());
+        }
+    }
+
+    /**
+     * Writes a null-terminated string, including its trailing zero byte.
+     */
+    void write_string(const char* str) {
+        check(ub_buffer_writer_write_string(&writer_, str));
+    }
+
+private:
+    ub_buffer_writer_t writer_;
+};
+
+/**
+ * Writes a \c unibin block with the payload taken from the given buffer.
+ * See \ref ub_write_block().
+ */
+inline void write_block(FILE* f, ub_block_type_t block_type,
+        const buffer& payload, ub_chksum_type_t chksum_type) {
+    const_byte_span bytes = payload.bytes();
+    check(ub_write_block(f, block_type, bytes.data(), bytes.size(), chksum_type));
+}
+
+}
+
+#endif
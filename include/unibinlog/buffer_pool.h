@@ -0,0 +1,132 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_BUFFER_POOL_H
+#define UNIBINLOG_BUFFER_POOL_H
+
+#include <stddef.h>
+
+#include <unibinlog/buffer.h>
+#include <unibinlog/error.h>
+#include <unibinlog/platform.h>
+
+UB_BEGIN_DECLS
+
+/**
+ * \def UB_BUFFER_POOL_CACHE_LENGTH
+ *
+ * The largest number of idle buffers that a thread keeps for itself in
+ * each buffer pool.
+ */
+#define UB_BUFFER_POOL_CACHE_LENGTH 4
+
+/**
+ * \def UB_BUFFER_POOL_BUFFER_SIZE
+ *
+ * The initial capacity of the buffers of the shared buffer pool of the
+ * library and of the buffers acquired without a pool.
+ */
+#define UB_BUFFER_POOL_BUFFER_SIZE 4096
+
+/**
+ * \def UB_BUFFER_POOL_SHARED_LIMIT
+ *
+ * The largest total capacity of the idle buffers of the shared buffer pool
+ * of the library (see \ref ub_buffer_pool_get_shared()).
+ */
+#define UB_BUFFER_POOL_SHARED_LIMIT (8 * 1024 * 1024)
+
+/**
+ * Structure that stores the state information of a \em buffer \em pool,
+ * i.e. a set of idle buffers that are handed out instead of allocating
+ * new ones and taken back when they are no longer needed, so code that
+ * needs a temporary buffer for each block does not allocate any memory in
+ * steady state.
+ *
+ * Buffers keep the capacity that they grew to while they were in use, so
+ * the pool converges to buffers that are large enough for their users.
+ * Each thread keeps up to \ref UB_BUFFER_POOL_CACHE_LENGTH idle buffers
+ * in its own cache, which it reaches without locking; the rest are shared
+ * between the threads under a lock. The first 64 threads that use a pool
+ * get a cache; the others use the shared buffers only, and so does every
+ * thread when the library is built without threads. The cache of a thread is given back to
+ * the shared buffers when the thread exits. The total capacity of the idle
+ * buffers is bounded by \c max_idle_bytes; buffers given back beyond that
+ * are freed.
+ *
+ * The library uses a shared pool of its own (see
+ * \ref ub_buffer_pool_get_shared()) for the buffers in which blocks are
+ * assembled and encoded.
+ */
+typedef struct {
+    size_t buffer_size;            /**< The initial capacity of new buffers */
+    size_t max_idle_bytes;         /**< The largest total capacity of the idle buffers */
+    size_t idle_bytes;             /**< The total capacity of the idle buffers; updated atomically */
+    void* state;                   /**< The shared buffers, the lock and the caches; opaque */
+} ub_buffer_pool_t;
+
+/**
+ * Initializes a buffer pool.
+ *
+ * \param  pool            the buffer pool to initialize
+ * \param  buffer_size     the initial capacity of new buffers; at least one
+ *                         byte
+ * \param  max_idle_bytes  the largest total capacity of the idle buffers
+ * \return \c UB_SUCCESS, \c UB_EINVAL if the buffer size is zero or
+ *         \c UB_ENOMEM
+ */
+ub_error_t ub_buffer_pool_init(ub_buffer_pool_t* pool, size_t buffer_size,
+        size_t max_idle_bytes);
+
+/**
+ * Destroys a buffer pool and frees its idle buffers, including the ones in
+ * the caches of the threads. No thread may use the pool any more; buffers
+ * that are still in use must be destroyed with \ref ub_buffer_destroy().
+ *
+ * \param  pool  the buffer pool to destroy
+ */
+void ub_buffer_pool_destroy(ub_buffer_pool_t* pool);
+
+/**
+ * Takes an empty buffer from the pool, allocating a new one if the pool
+ * has no idle buffers. The capacity of the buffer is at least the buffer
+ * size of the pool.
+ *
+ * \param  pool  the buffer pool; if null, a new buffer is allocated
+ * \param  buf   the buffer will be returned here
+ * \return \c UB_SUCCESS or \c UB_ENOMEM
+ */
+ub_error_t ub_buffer_pool_acquire(ub_buffer_pool_t* pool, ub_buffer_t* buf);
+
+/**
+ * Gives a buffer taken with \ref ub_buffer_pool_acquire() back to the pool,
+ * or destroys it if the pool is full. The buffer may be given back from a
+ * different thread than the one that took it.
+ *
+ * \param  pool  the buffer pool; if null, the buffer is destroyed
+ * \param  buf   the buffer; it must not be used afterwards
+ */
+void ub_buffer_pool_release(ub_buffer_pool_t* pool, ub_buffer_t* buf);
+
+/**
+ * Frees all the idle buffers of the pool, including the ones in the caches
+ * of the threads. No other thread may use the pool at the same time.
+ *
+ * \param  pool  the buffer pool
+ */
+void ub_buffer_pool_trim(ub_buffer_pool_t* pool);
+
+/**
+ * Returns the shared buffer pool of the library, setting it up on the
+ * first call. Its idle buffers hold at most
+ * \ref UB_BUFFER_POOL_SHARED_LIMIT bytes. The pool is trimmed when the
+ * memory allocator of the library is changed (see
+ * \ref ub_memory_set_allocator()).
+ *
+ * \return the shared pool, or null if it could not be set up, in which case
+ *         \ref ub_buffer_pool_acquire() allocates new buffers
+ */
+ub_buffer_pool_t* ub_buffer_pool_get_shared(void);
+
+UB_END_DECLS
+
+#endif
@@ -0,0 +1,155 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_BYTEORDER_H
+#define UNIBINLOG_BYTEORDER_H
+
+#include <stdlib.h>
+
+#include <unibinlog/basic_types.h>
+#include <unibinlog/error.h>
+#include <unibinlog/platform.h>
+#include <unibinlog/types.h>
+
+UB_BEGIN_DECLS
+
+/**
+ * Enum constants for the byte orders of the values in log entry blocks.
+ *
+ * \c unibin files use network byte order (big endian) by default; files
+ * whose header has the \ref UB_HEADER_FLAG_LITTLE_ENDIAN flag set store the
+ * values of their log entries in little-endian byte order instead.
+ */
+typedef enum {
+    UB_BIG_ENDIAN = 0,             /**< Network byte order */
+    UB_LITTLE_ENDIAN               /**< Little-endian byte order */
+} ub_byte_order_t;
+
+/**
+ * Returns the byte order of integers on the host.
+ */
+ub_byte_order_t ub_byteorder_native(void);
+
+/**
+ * Enum constants for the implementations of the batch byte swapping kernels
+ * that convert arrays of values between network and host byte order.
+ */
+typedef enum {
+    UB_BYTEORDER_KERNEL_AUTO = 0,  /**< The fastest kernel supported by the CPU */
+    UB_BYTEORDER_KERNEL_SCALAR,    /**< Portable kernel, one value at a time */
+    UB_BYTEORDER_KERNEL_SSSE3,     /**< x86 kernel using SSSE3 byte shuffles */
+    UB_BYTEORDER_KERNEL_AVX2,      /**< x86 kernel using AVX2 byte shuffles */
+    UB_MAX_BYTEORDER_KERNEL        /**< Not a real kernel; useful for enumerating all kernels */
+} ub_byteorder_kernel_t;
+
+/**
+ * Returns the kernel used by the batch byte swapping functions. The kernel
+ * is selected when it is first needed, based on the features of the CPU.
+ *
+ * \return the kernel in use; never \c UB_BYTEORDER_KERNEL_AUTO
+ */
+ub_byteorder_kernel_t ub_byteorder_get_kernel(void);
+
+/**
+ * Overrides the kernel used by the batch byte swapping functions. This is
+ * mostly useful for testing and benchmarking. If other threads are
+ * converting values meanwhile, each call picks up one of the kernels.
+ *
+ * \param  kernel  the kernel to use; \c UB_BYTEORDER_KERNEL_AUTO restores
+ *                 the automatic selection
+ * \return \c UB_SUCCESS or \c UB_EUNSUPPORTED if the kernel was not compiled
+ *         in or is not supported by the CPU
+ */
+ub_error_t ub_byteorder_set_kernel(ub_byteorder_kernel_t kernel);
+
+/**
+ * Reverses the byte order of each 16-bit value in an array.
+ *
+ * \param  dest   the array to write the swapped values into. It may be the
+ *                same as \p src but must not overlap with it otherwise.
+ * \param  src    the array of values to swap; it does not have to be aligned
+ * \param  count  the number of values
+ */
+void ub_byteorder_swap16(void* dest, const void* src, size_t count);
+
+/**
+ * Reverses the byte order of each 32-bit value in an array.
+ * See \ref ub_byteorder_swap16() for the details.
+ */
+void ub_byteorder_swap32(void* dest, const void* src, size_t count);
+
+/**
+ * Reverses the byte order of each 64-bit value in an array.
+ * See \ref ub_byteorder_swap16() for the details.
+ */
+void ub_byteorder_swap64(void* dest, const void* src, size_t count);
+
+/**
+ * Tells whether values of the given data type can be converted from and into
+ * the given byte order by \ref ub_byteorder_decode_column() and
+ * \ref ub_byteorder_encode_column() on this host.
+ *
+ * \param  type   the data type of the values
+ * \param  order  the byte order of the converted values
+ * \return whether the conversion is supported
+ */
+ub_bool_t ub_byteorder_supports_type(ub_datatype_t type,
+        ub_byte_order_t order);
+
+/**
+ * Converts a contiguous run of values of a fixed-width \c unibin data type
+ * from the given byte order into an array of the corresponding native C type
+ * (see \ref ub_typeinfo_t.c_name). When the byte order matches the host,
+ * this is a plain copy.
+ *
+ * \param  type   the data type of the values
+ * \param  order  the byte order of the values in \p src
+ * \param  dest   the array to write the native values into. It may be the
+ *                same as \p src but must not overlap with it otherwise.
+ * \param  src    the values to convert, packed without padding
+ * \param  count  the number of values
+ * \return \c UB_SUCCESS or \c UB_EUNSUPPORTED if the type is variable-length,
+ *         has no native array representation (\c UB_DATATYPE_TIMEVAL) or
+ *         cannot be converted from the given byte order on this host
+ */
+ub_error_t ub_byteorder_decode_column(ub_datatype_t type,
+        ub_byte_order_t order, void* dest, const void* src, size_t count);
+
+/**
+ * Converts an array of native values of a fixed-width \c unibin data type
+ * into a contiguous run of values in the given byte order. This is the
+ * inverse of \ref ub_byteorder_decode_column().
+ *
+ * \param  type   the data type of the values
+ * \param  order  the byte order to convert the values into
+ * \param  dest   the memory area to write the converted values into; it may
+ *                be the same as \p src but must not overlap with it
+ *                otherwise
+ * \param  src    the native values
+ * \param  count  the number of values
+ * \return \c UB_SUCCESS or \c UB_EUNSUPPORTED if the type is variable-length,
+ *         has no native array representation (\c UB_DATATYPE_TIMEVAL) or
+ *         cannot be converted into the given byte order on this host
+ */
+ub_error_t ub_byteorder_encode_column(ub_datatype_t type,
+        ub_byte_order_t order, void* dest, const void* src, size_t count);
+
+/**
+ * Decodes a single value of an integer or timestamp \c unibin data type
+ * from the given byte order into a signed 64-bit integer.
+ *
+ * \c UB_DATATYPE_TIMEVAL values are converted into microseconds; unsigned
+ * 64-bit values above \c INT64_MAX wrap around.
+ *
+ * \param  type   the data type of the value
+ * \param  order  the byte order of the value
+ * \param  src    the encoded value
+ * \param  value  the decoded value will be returned here
+ * \return \c UB_SUCCESS or \c UB_EUNSUPPORTED if the type is not an integer
+ *         or timestamp type
+ */
+ub_error_t ub_byteorder_decode_int64(ub_datatype_t type,
+        ub_byte_order_t order, const void* src, int64_t* value);
+
+UB_END_DECLS
+
+#endif
@@ -6,6 +6,9 @@
 #include <stdlib.h>
 
 #include <unibinlog/error.h>
+#include <unibinlog/platform.h>
+
+UB_BEGIN_DECLS
 
 /**
  * Enum constants for the different checksum types supported by this library.
@@ -40,5 +43,7 @@ size_t ub_chksum_size(ub_chksum_type_t type);
 ub_error_t ub_get_chksum_of_array(const void* array, size_t size,
         void* chksum, ub_chksum_type_t chksum_type);
 
+UB_END_DECLS
+
 #endif
 
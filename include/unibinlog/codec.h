@@ -0,0 +1,144 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_CODEC_H
+#define UNIBINLOG_CODEC_H
+
+#include <unibinlog/basic_types.h>
+#include <unibinlog/buffer.h>
+#include <unibinlog/error.h>
+#include <unibinlog/log_column.h>
+#include <unibinlog/platform.h>
+#include <unibinlog/types.h>
+
+UB_BEGIN_DECLS
+
+/**
+ * Enum constants for the different column encodings that may be used in
+ * encoded log entry blocks (\c UB_BLOCK_ENCODED_LOG_ENTRY).
+ *
+ * Codecs operate on a single column of a block, i.e. on a contiguous run of
+ * fixed-width values of the same data type, each value being stored in
+ * network byte order.
+ */
+typedef enum {
+    UB_CODEC_RAW = 0,          /**< Values stored as they are */
+    UB_CODEC_DELTA,            /**< First value, then zigzag varint differences */
+    UB_CODEC_RLE,              /**< Pairs of varint run lengths and values */
+    UB_MAX_CODEC,              /**< Not a real codec; useful for enumerating all codecs */
+    UB_CODEC_AUTO = 255        /**< Not a real codec; pick the smallest codec per column and block */
+} ub_codec_t;
+
+/**
+ * Returns whether the given codec can encode values of the given data type.
+ *
+ * Only fixed-width data types can be encoded by any codec. \c UB_CODEC_DELTA
+ * is restricted further to integer types.
+ *
+ * \param  codec  the codec
+ * \param  type   the data type
+ * \return whether the codec supports the data type
+ */
+ub_bool_t ub_codec_supports(ub_codec_t codec, ub_datatype_t type);
+
+/**
+ * Encodes a column of fixed-width values with the given codec.
+ *
+ * \param  codec       the codec to use; must not be \c UB_CODEC_AUTO
+ * \param  type        the data type of the values
+ * \param  values      pointer to the values, packed without padding
+ * \param  num_values  the number of values
+ * \param  writer      the buffer writer to write the encoded column into
+ * \return \c UB_SUCCESS or an error code; \c UB_EUNSUPPORTED if the codec
+ *         cannot encode the given data type
+ */
+ub_error_t ub_codec_encode(ub_codec_t codec, ub_datatype_t type,
+        const void* values, size_t num_values, ub_buffer_writer_t* writer);
+
+/**
+ * Decodes a column of fixed-width values that was encoded with
+ * \ref ub_codec_encode.
+ *
+ * \param  codec       the codec that was used to encode the column
+ * \param  type        the data type of the values
+ * \param  data        pointer to the encoded column
+ * \param  size        the number of bytes available at \p data
+ * \param  num_values  the number of values to decode
+ * \param  values      pointer to a memory area that will hold the decoded
+ *                     values; it must be large enough to hold \p num_values
+ *                     values of the given data type
+ * \return \c UB_SUCCESS or an error code; \c UB_EPARSE if the encoded column
+ *         is malformed or shorter than expected
+ */
+ub_error_t ub_codec_decode(ub_codec_t codec, ub_datatype_t type,
+        const void* data, size_t size, size_t num_values, void* values);
+
+/**
+ * Selects the codec that encodes the given column into the smallest number
+ * of bytes.
+ *
+ * Only the first \p sample_size values of the column are used for the
+ * selection; this bounds the CPU time spent on trial encodings. Ties are
+ * resolved in favour of the codec that is cheaper to decode, i.e. the one
+ * with the lower codec ID.
+ *
+ * \param  type         the data type of the values
+ * \param  values       pointer to the values, packed without padding
+ * \param  num_values   the number of values
+ * \param  sample_size  the maximum number of values to try the codecs on;
+ *                      zero means to use all the values
+ * \return the selected codec; \c UB_CODEC_RAW if the data type is not
+ *         supported by any codec
+ */
+ub_codec_t ub_codec_select(ub_datatype_t type, const void* values,
+        size_t num_values, size_t sample_size);
+
+/**
+ * Encodes row-major log entries into the payload of an encoded log entry
+ * block (\c UB_BLOCK_ENCODED_LOG_ENTRY).
+ *
+ * The payload consists of the number of rows (two bytes, network byte
+ * order), followed by each column in turn. Each column starts with the ID of
+ * the codec used for the column (one byte) and the length of the encoded
+ * column (two bytes, network byte order), followed by the encoded column
+ * itself. A column is never stored in a form larger than its raw form.
+ *
+ * \param  columns      pointer to an array containing the columns of the
+ *                      log; all of them must have fixed-width data types
+ * \param  num_columns  the number of columns
+ * \param  rows         pointer to the rows, each row being the concatenation
+ *                      of the values in the row
+ * \param  num_rows     the number of rows
+ * \param  codec        the codec to use for all the columns, or
+ *                      \c UB_CODEC_AUTO to select a codec per column
+ * \param  sample_size  the sample size to pass on to \ref ub_codec_select
+ *                      when \p codec is \c UB_CODEC_AUTO
+ * \param  payload      the buffer to write the payload into. It will be
+ *                      resized to the exact size of the payload.
+ * \return \c UB_SUCCESS or an error code
+ */
+ub_error_t ub_codec_encode_log_entries(const ub_log_column_t* columns,
+        size_t num_columns, const void* rows, size_t num_rows,
+        ub_codec_t codec, size_t sample_size, ub_buffer_t* payload);
+
+/**
+ * Decodes the payload of an encoded log entry block
+ * (\c UB_BLOCK_ENCODED_LOG_ENTRY) into row-major log entries, i.e. into the
+ * same form as the payload of a \c UB_BLOCK_LOG_ENTRY block.
+ *
+ * \param  columns      pointer to an array containing the columns of the log
+ * \param  num_columns  the number of columns
+ * \param  payload      pointer to the payload of the block
+ * \param  size         the size of the payload
+ * \param  rows         the buffer to write the decoded rows into. It will be
+ *                      resized to the exact size of the decoded rows.
+ * \param  num_rows     the number of decoded rows will be returned here
+ *                      if it is not null
+ * \return \c UB_SUCCESS or an error code
+ */
+ub_error_t ub_codec_decode_log_entries(const ub_log_column_t* columns,
+        size_t num_columns, const void* payload, size_t size,
+        ub_buffer_t* rows, size_t* num_rows);
+
+UB_END_DECLS
+
+#endif
@@ -0,0 +1,285 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_DATASET_H
+#define UNIBINLOG_DATASET_H
+
+#include <stdio.h>
+
+#include <unibinlog/basic_types.h>
+#include <unibinlog/chksum.h>
+#include <unibinlog/error.h>
+#include <unibinlog/log_column.h>
+#include <unibinlog/log_writer.h>
+#include <unibinlog/platform.h>
+#include <unibinlog/scanner.h>
+
+UB_BEGIN_DECLS
+
+/**
+ * \def UB_DATASET_MANIFEST_HEADER_LENGTH
+ *
+ * The length of the payload of a manifest header block
+ * (\c UB_BLOCK_MANIFEST_HEADER).
+ */
+#define UB_DATASET_MANIFEST_HEADER_LENGTH 17
+
+/**
+ * \def UB_DATASET_CHUNK_LENGTH
+ *
+ * The length of a single serialized chunk in a manifest block
+ * (\c UB_BLOCK_MANIFEST).
+ */
+#define UB_DATASET_CHUNK_LENGTH 40
+
+/**
+ * Structure describing a single chunk file of a \ref ub_dataset_t.
+ */
+typedef struct {
+    uint64_t sequence;             /**< Sequence number of the chunk file */
+    int64_t first_timestamp;       /**< Timestamp of the first row of the chunk */
+    int64_t last_timestamp;        /**< Timestamp of the last row of the chunk */
+    uint64_t num_rows;             /**< The number of rows in the chunk */
+    uint64_t schema_id;            /**< Fingerprint of the columns of the chunk; see \ref ub_dataset_get_schema_id() */
+} ub_dataset_chunk_t;
+
+/**
+ * Structure that stores the \em manifest of a \em dataset, i.e. a
+ * directory of \c unibin logs (\em chunks) partitioned by time.
+ *
+ * Each chunk holds the rows whose timestamps fall into the same
+ * \em partition, a time interval of \c partition_length starting at a
+ * multiple of it, and is named after its sequence number, e.g.
+ * \c chunk-000042.ubl. The manifest lists the chunks in time order with
+ * their time range, row count and schema, so queries can skip the chunks
+ * outside their time range without opening them (see
+ * \ref ub_dataset_select()) and scan the remaining ones in parallel (see
+ * \ref ub_dataset_scan()). Dropping old data deletes whole chunk files
+ * (see \ref ub_dataset_remove_before()).
+ *
+ * The manifest is stored in the \c MANIFEST file of the directory, which
+ * has the same file header as a log. It contains a manifest header block
+ * (\c UB_BLOCK_MANIFEST_HEADER) with the index of the timestamp column
+ * (1 byte), the length of a partition and the number of chunks (8 bytes
+ * each), followed by manifest blocks (\c UB_BLOCK_MANIFEST) holding
+ * \ref UB_DATASET_CHUNK_LENGTH bytes per chunk: the fields of
+ * \ref ub_dataset_chunk_t in order, 8 bytes each. All numbers are stored
+ * in network byte order. The manifest is replaced atomically by renaming
+ * a new file over it, so readers always see a complete manifest that only
+ * lists complete chunks.
+ */
+typedef struct {
+    char* path;                    /**< The path of the directory; owned by the dataset */
+    ub_chksum_type_t chksum_type;  /**< The checksum type of the blocks of the manifest */
+    size_t timestamp_column;       /**< Index of the timestamp column of the chunks */
+    uint64_t partition_length;     /**< The length of the time interval covered by a chunk */
+    ub_dataset_chunk_t* chunks;    /**< The chunks of the dataset, in time order */
+    size_t num_chunks;             /**< The number of chunks */
+    size_t capacity;               /**< The number of chunks allocated */
+    size_t num_threads;            /**< The number of worker threads used by queries */
+} ub_dataset_t;
+
+/**
+ * Structure that stores the state information of a \em dataset
+ * \em writer, i.e. a log writer that writes the rows of a
+ * \ref ub_dataset_t into a new chunk file whenever the timestamp of a row
+ * falls into a new partition.
+ *
+ * The timestamps of the rows must never decrease. Rows are given in the
+ * default layout of a log writer (big endian, packed). Each chunk has a
+ * block index on the timestamp column, so readers can also seek by time
+ * within a chunk. The chunk that is being written is added to the manifest
+ * when it is finished, i.e. when the next partition starts or the writer is
+ * closed.
+ */
+typedef struct {
+    ub_dataset_t dataset;          /**< The manifest of the dataset */
+    ub_log_column_t* columns;      /**< The columns of the log; not owned by the writer */
+    size_t num_columns;            /**< The number of columns of the log */
+    ub_chksum_type_t chksum_type;  /**< The checksum type of the blocks in the chunks */
+    size_t timestamp_offset;       /**< Offset of the timestamp column in a row; \c SIZE_MAX if rows have variable length */
+    uint64_t next_sequence;        /**< The sequence number of the next chunk file */
+    FILE* file;                    /**< The current chunk file; null if no chunk is being written */
+    ub_log_writer_t writer;        /**< The log writer of the current chunk */
+    ub_dataset_chunk_t chunk;      /**< The current chunk */
+    int64_t partition;             /**< The partition of the current chunk */
+} ub_dataset_writer_t;
+
+/**
+ * Returns the fingerprint of the given columns, which changes whenever the
+ * name or the data type of a column changes.
+ *
+ * \param  columns      pointer to an array containing columns
+ * \param  num_columns  the number of columns
+ * \return the fingerprint of the columns
+ */
+uint64_t ub_dataset_get_schema_id(const ub_log_column_t* columns,
+        size_t num_columns);
+
+/**
+ * Opens a dataset by reading its manifest.
+ *
+ * \param  dataset  the dataset to initialize
+ * \param  path     the path of the directory; it is copied
+ * \return \c UB_SUCCESS, \c UB_EOPEN if the manifest cannot be opened,
+ *         \c UB_EPARSE if it is corrupted, \c UB_ENOMEM or an error code
+ *         from the read operations
+ */
+ub_error_t ub_dataset_open(ub_dataset_t* dataset, const char* path);
+
+/**
+ * Destroys a dataset. The files of the dataset are left alone.
+ *
+ * \param  dataset  the dataset to destroy
+ */
+void ub_dataset_destroy(ub_dataset_t* dataset);
+
+/**
+ * Sets the number of worker threads used by \ref ub_dataset_scan(). The
+ * default is one, which scans all the chunks on the calling thread.
+ *
+ * \param  dataset      the dataset
+ * \param  num_threads  the number of worker threads; at least one
+ * \return \c UB_SUCCESS or \c UB_EINVAL if the number of threads is zero
+ */
+ub_error_t ub_dataset_set_num_threads(ub_dataset_t* dataset,
+        size_t num_threads);
+
+/**
+ * Returns the path of the chunk file with the given sequence number.
+ *
+ * \param  dataset   the dataset
+ * \param  sequence  the sequence number of the chunk
+ * \return the path, which must be freed by the caller with
+ *         \ref ub_memory_free(), or null if there is not enough memory
+ */
+char* ub_dataset_get_chunk_path(const ub_dataset_t* dataset,
+        uint64_t sequence);
+
+/**
+ * Finds the chunks that may contain rows with timestamps in the given
+ * closed interval using the manifest, without opening any chunk files.
+ * Since the chunks are in time order, these are consecutive.
+ *
+ * \param  dataset  the dataset
+ * \param  begin    the first timestamp of the interval
+ * \param  end      the last timestamp of the interval
+ * \param  first    the index of the first matching chunk will be returned
+ *                  here
+ * \param  count    the number of matching chunks will be returned here;
+ *                  may be zero
+ * \return \c UB_SUCCESS
+ */
+ub_error_t ub_dataset_select(const ub_dataset_t* dataset, int64_t begin,
+        int64_t end, size_t* first, size_t* count);
+
+/**
+ * Scans the log entry blocks of the given chunks in parallel.
+ *
+ * Each chunk has its own state in the \p states array. The blocks of each
+ * chunk are passed to \p block_func in file order, on one of the worker
+ * threads; different chunks may be scanned at the same time. The \c range
+ * of a block is the index of its chunk within the scanned ones. When all
+ * the chunks are done, their states are merged into the state of the first
+ * one with \p reduce_func, in time order, on the calling thread. Without a
+ * reduce function, the per-chunk states are left to the caller.
+ *
+ * Blocks are passed on regardless of their timestamps, so queries over a
+ * time interval still have to filter the rows of the first and the last
+ * chunk returned by \ref ub_dataset_select().
+ *
+ * \param  dataset      the dataset
+ * \param  first        the index of the first chunk to scan
+ * \param  count        the number of chunks to scan
+ * \param  block_func   the function to call for each log entry block
+ * \param  states       the states of the chunks, one after the other
+ * \param  state_size   the size of the state of a single chunk
+ * \param  reduce_func  the function that merges the states of the chunks;
+ *                      may be null
+ * \return \c UB_SUCCESS, \c UB_EINVAL if the chunks are out of range,
+ *         \c UB_EOPEN or \c UB_EREAD if a chunk file cannot be read, an
+ *         error code from \ref ub_scanner_run() or the first error code
+ *         returned by \p block_func or \p reduce_func
+ */
+ub_error_t ub_dataset_scan(const ub_dataset_t* dataset, size_t first,
+        size_t count, ub_scan_block_func_t* block_func, void* states,
+        size_t state_size, ub_scan_reduce_func_t* reduce_func);
+
+/**
+ * Removes the chunks whose rows are all older than the given timestamp:
+ * the manifest is rewritten without them first, then their files are
+ * deleted.
+ *
+ * \param  dataset    the dataset
+ * \param  timestamp  the oldest timestamp to keep
+ * \return \c UB_SUCCESS or an error code from writing the manifest
+ */
+ub_error_t ub_dataset_remove_before(ub_dataset_t* dataset,
+        int64_t timestamp);
+
+/**
+ * Initializes a dataset writer. If the directory has a manifest already,
+ * the new chunks are added after the existing ones; otherwise the manifest
+ * is created with the first chunk. No file is opened until the first row
+ * is written.
+ *
+ * \param  writer            the dataset writer to initialize
+ * \param  path              the path of the directory, which must exist;
+ *                           it is copied
+ * \param  columns           pointer to an array containing the columns of
+ *                           the log. The array is not copied; it must not
+ *                           be modified or destroyed until the writer is
+ *                           destroyed.
+ * \param  num_columns       the number of columns
+ * \param  chksum_type       the checksum type to use for each block in the
+ *                           chunks and the manifest
+ * \param  timestamp_column  the index of the column that holds the
+ *                           timestamps (see
+ *                           \ref ub_log_writer_set_timestamp_column())
+ * \param  partition_length  the length of the time interval covered by a
+ *                           chunk; at least one
+ * \return \c UB_SUCCESS, \c UB_EINVAL if the partition length is zero or
+ *         the timestamp column or the partition length differs from the
+ *         existing manifest, \c UB_EUNSUPPORTED if the timestamp column
+ *         does not have a suitable type, \c UB_ENOMEM or an error code from
+ *         \ref ub_dataset_open()
+ */
+ub_error_t ub_dataset_writer_init(ub_dataset_writer_t* writer,
+        const char* path, ub_log_column_t* columns, size_t num_columns,
+        ub_chksum_type_t chksum_type, size_t timestamp_column,
+        uint64_t partition_length);
+
+/**
+ * Destroys a dataset writer. Rows that have not been written yet are
+ * discarded and the current chunk is not added to the manifest; call
+ * \ref ub_dataset_writer_close() first if you need them.
+ *
+ * \param  writer  the dataset writer to destroy
+ */
+void ub_dataset_writer_destroy(ub_dataset_writer_t* writer);
+
+/**
+ * Adds a row to the dataset, finishing the current chunk first if the
+ * timestamp of the row falls into a new partition. See
+ * \ref ub_log_writer_write_row().
+ *
+ * \param  writer  the dataset writer
+ * \param  row     pointer to the row
+ * \param  length  the length of the row
+ * \return \c UB_SUCCESS, \c UB_EINVAL if the timestamp of the row is older
+ *         than that of the previous row or cannot be decoded, or an error
+ *         code
+ */
+ub_error_t ub_dataset_writer_write_row(ub_dataset_writer_t* writer,
+        const void* row, size_t length);
+
+/**
+ * Finishes the current chunk, if any, and adds it to the manifest.
+ *
+ * \param  writer  the dataset writer
+ * \return \c UB_SUCCESS or the first error that occurred
+ */
+ub_error_t ub_dataset_writer_close(ub_dataset_writer_t* writer);
+
+UB_END_DECLS
+
+#endif
@@ -3,6 +3,10 @@
 #ifndef UNIBINLOG_DEBUG_H
 #define UNIBINLOG_DEBUG_H
 
+#include <unibinlog/platform.h>
+
+UB_BEGIN_DECLS
+
 extern unsigned short int __ub_debug_mode;
 
 #define UB_IN_DEBUG_MODE (!!__ub_debug_mode)
@@ -24,5 +28,7 @@ void ub_set_debug_mode(unsigned short int on);
  */
 void UB_WARNING(const char* component, const char* format, ...);
 
+UB_END_DECLS
+
 #endif
 
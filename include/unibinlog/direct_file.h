@@ -0,0 +1,117 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_DIRECT_FILE_H
+#define UNIBINLOG_DIRECT_FILE_H
+
+#include <stdio.h>
+
+#include <unibinlog/basic_types.h>
+#include <unibinlog/error.h>
+#include <unibinlog/log_writer.h>
+#include <unibinlog/platform.h>
+
+UB_BEGIN_DECLS
+
+/**
+ * Structure that stores the state information of a \em direct \em file,
+ * i.e. a write-only stream over a file descriptor that writes with
+ * \c O_DIRECT, bypassing the page cache, so that logs which are written
+ * once and rarely read do not evict the data of other processes from
+ * memory. Pass \c file to \ref ub_log_writer_init() to use it as the sink
+ * of a log writer.
+ *
+ * Direct I/O requires the file offsets, the lengths and the memory
+ * addresses of the writes to be multiples of the logical block size of
+ * the device, which is queried from the kernel (see \c alignment). The
+ * stream collects the bytes written into it in a buffer with that
+ * alignment and writes each full buffer at once. When the stream is
+ * synced, closed or moved with \c fseek(), the last, partial block is
+ * padded with zeros, written and cut off again with \c ftruncate(); the
+ * next write rewrites that block, so the contents of the file are the
+ * same byte for byte as if it had been written with plain stdio. If the
+ * file system does not support direct I/O, the same aligned writes go
+ * through the page cache instead.
+ *
+ * The stream supports \c ftell(). Flushing the stream does not write the
+ * partial buffer, so \ref ub_log_writer_sync() and the durability policies
+ * of the log writer only reach the disk if the writer is attached to the
+ * file with \ref ub_direct_file_attach(); \ref ub_direct_file_sync()
+ * syncs it directly. Write errors are reported by the next write into the stream
+ * that fills the buffer, by \ref ub_direct_file_sync() or by
+ * \ref ub_direct_file_close().
+ */
+typedef struct {
+    FILE* file;                    /**< The stream to write into; null once the file is closed */
+    int fd;                        /**< The file descriptor written into; owned by the file */
+    size_t alignment;              /**< The alignment of the offsets, lengths and buffers of the writes */
+    size_t buffer_size;            /**< The length of the buffer; a multiple of \c alignment */
+    ub_bool_t direct;              /**< Whether the writes bypass the page cache */
+    ub_error_t error;              /**< The first write error, if any */
+    void* state;                   /**< The buffer and the write position; opaque */
+} ub_direct_file_t;
+
+/**
+ * Initializes a direct file that writes into the given file descriptor,
+ * starting at its current offset.
+ *
+ * \param  file         the direct file to initialize
+ * \param  fd           the file descriptor; it is closed with the file. It
+ *                      must be open for reading as well, so the blocks
+ *                      that are only partly overwritten can be read back,
+ *                      and it must not be in append mode.
+ * \param  buffer_size  the length of the buffer; at least one byte. It is
+ *                      rounded up to a multiple of the alignment.
+ * \param  direct       whether to bypass the page cache if the file system
+ *                      supports it; writes go through the page cache
+ *                      otherwise
+ * \return \c UB_SUCCESS, \c UB_EINVAL if the buffer is empty or the file
+ *         descriptor is in append mode, \c UB_EUNSUPPORTED if the platform
+ *         cannot wrap custom streams into a \c FILE* or \c UB_ENOMEM
+ */
+ub_error_t ub_direct_file_init(ub_direct_file_t* file, int fd,
+        size_t buffer_size, ub_bool_t direct);
+
+/**
+ * Destroys a direct file, closing it first if needed. Errors from closing
+ * the file are lost; call \ref ub_direct_file_close() first if you need
+ * them.
+ *
+ * \param  file  the direct file to destroy
+ */
+void ub_direct_file_destroy(ub_direct_file_t* file);
+
+/**
+ * Writes all the bytes written into the stream so far into the file and
+ * flushes the data of the file to the disk.
+ *
+ * \param  file  the direct file
+ * \return \c UB_SUCCESS or \c UB_EWRITE
+ */
+ub_error_t ub_direct_file_sync(ub_direct_file_t* file);
+
+/**
+ * Makes the given log writer, which writes into the stream of the file,
+ * sync the file with \ref ub_direct_file_sync() (see
+ * \ref ub_log_writer_set_sync_func()), so \ref ub_log_writer_sync() and
+ * the durability policies of the writer reach the disk. The policy
+ * \c UB_DURABILITY_INTERVAL is not supported.
+ *
+ * \param  file    the direct file
+ * \param  writer  the log writer
+ * \return \c UB_SUCCESS or an error code from
+ *         \ref ub_log_writer_set_sync_func()
+ */
+ub_error_t ub_direct_file_attach(ub_direct_file_t* file, ub_log_writer_t* writer);
+
+/**
+ * Writes all the bytes written into the stream so far into the file and
+ * closes the stream and the file descriptor.
+ *
+ * \param  file  the direct file
+ * \return \c UB_SUCCESS or \c UB_EWRITE if a write failed
+ */
+ub_error_t ub_direct_file_close(ub_direct_file_t* file);
+
+UB_END_DECLS
+
+#endif
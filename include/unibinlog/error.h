@@ -3,6 +3,10 @@
 #ifndef UNIBINLOG_ERROR_H
 #define UNIBINLOG_ERROR_H
 
+#include <unibinlog/platform.h>
+
+UB_BEGIN_DECLS
+
 /**
  * Error codes used throughout the library.
  */
@@ -18,7 +22,8 @@ typedef enum {
     UB_FAILURE,                        /**< Generic failure code */
     UB_EUNSUPPORTED,                   /**< Unsupported operation */
     UB_EUNIMPLEMENTED,                 /**< Unimplemented operation */
-    UB_ETOOLONG                        /**< Payload too long */
+    UB_ETOOLONG,                       /**< Payload too long */
+    UB_EOF                             /**< End of file reached */
 } ub_error_t;
 
 #ifdef UB_LOG_ERRORS
@@ -47,5 +52,7 @@ typedef enum {
  */
 const char* ub_error_to_string(int code);
 
+UB_END_DECLS
+
 #endif
 
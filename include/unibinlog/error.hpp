@@ -0,0 +1,44 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_ERROR_HPP
+#define UNIBINLOG_ERROR_HPP
+
+#include <stdexcept>
+
+#include <unibinlog/error.h>
+
+namespace unibinlog {
+
+/**
+ * Exception thrown by the C++ layer of the library when one of the
+ * underlying C functions returns an error code.
+ */
+class error : public std::runtime_error {
+public:
+    /**
+     * Constructs an exception from an error code.
+     */
+    explicit error(ub_error_t code)
+        : std::runtime_error(ub_error_to_string(code)), code_(code) {}
+
+    /**
+     * Returns the error code that the exception was constructed from.
+     */
+    ub_error_t code() const noexcept { return code_; }
+
+private:
+    ub_error_t code_;
+};
+
+/**
+ * Throws an \ref error if the given error code is not \c UB_SUCCESS.
+ */
+inline void check(ub_error_t code) {
+    if (code != UB_SUCCESS) {
+        throw error(code);
+    }
+}
+
+}
+
+#endif
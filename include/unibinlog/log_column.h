@@ -5,8 +5,20 @@
 
 #include <unibinlog/buffer.h>
 #include <unibinlog/error.h>
+#include <unibinlog/platform.h>
 #include <unibinlog/types.h>
 
+UB_BEGIN_DECLS
+
+/**
+ * \def UB_ROW_ALIGNMENT
+ *
+ * The largest alignment required by a column in the aligned row layout. The
+ * payloads of the log entry blocks of aligned logs start at file offsets
+ * that are multiples of this value.
+ */
+#define UB_ROW_ALIGNMENT 8
+
 /**
  * Typedef that represents a log column in \c unibin files.
  */
@@ -93,6 +105,24 @@ ub_error_t ub_log_column_set_type(ub_log_column_t* column, ub_datatype_t type);
 ub_error_t ub_log_column_write(const ub_log_column_t* column,
 		ub_buffer_location_t* loc);
 
+/**
+ * Parses a log column description in \c unibin format from the given memory
+ * area. This is the inverse of \ref ub_log_column_write().
+ *
+ * \param  column    the column to initialize with the parsed description.
+ *                    It must be destroyed with \ref ub_log_column_destroy()
+ *                    if the function succeeds.
+ * \param  data      pointer to the serialized column description
+ * \param  size      the number of bytes available at \p data
+ * \param  consumed  the number of bytes parsed will be returned here if it
+ *                    is not null
+ * \return \c UB_SUCCESS, \c UB_EPARSE if the description is truncated or
+ *         its type is unknown or invalid, or \c UB_EUNIMPLEMENTED if the
+ *         column uses a transformation that is not implemented yet
+ */
+ub_error_t ub_log_column_read(ub_log_column_t* column, const void* data,
+        size_t size, size_t* consumed);
+
 /**
  * Returns the total length of the data types in multiple log columns.
  *
@@ -104,5 +134,29 @@ ub_error_t ub_log_column_write(const ub_log_column_t* column,
 size_t ub_log_columns_get_total_length(const ub_log_column_t* columns,
         size_t num_columns);
 
+/**
+ * Calculates the layout of the rows of a log with the given columns, i.e. the
+ * offset of each column within a row and the length of a row.
+ *
+ * In the packed layout, the values of the columns follow each other without
+ * padding. In the aligned layout, the offset of each column is rounded up to
+ * the alignment of its data type (see \ref ub_datatype_get_alignment()) and
+ * the length of the row is rounded up to the largest alignment, so every
+ * value of a row that starts at an address aligned to
+ * \ref UB_ROW_ALIGNMENT is naturally aligned. Padding bytes are zero.
+ *
+ * \param  columns      pointer to an array containing columns
+ * \param  num_columns  the number of columns
+ * \param  aligned      whether to calculate the aligned layout
+ * \param  offsets      array of \p num_columns elements where the offsets of
+ *                      the columns will be returned if it is not null
+ * \return the length of a row or zero if at least one column has a variable
+ *         length, in which case the contents of \p offsets are unspecified
+ */
+size_t ub_log_columns_get_layout(const ub_log_column_t* columns,
+        size_t num_columns, ub_bool_t aligned, size_t* offsets);
+
+UB_END_DECLS
+
 #endif
 
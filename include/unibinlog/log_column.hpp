@@ -0,0 +1,119 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_LOG_COLUMN_HPP
+#define UNIBINLOG_LOG_COLUMN_HPP
+
+#include <cstddef>
+
+#include <unibinlog/error.hpp>
+#include <unibinlog/log_column.h>
+
+namespace unibinlog {
+
+/**
+ * Move-only C++ wrapper around \ref ub_log_column_t.
+ *
+ * Moving a column transfers the ownership of its name without copying it.
+ *
+ * This header requires C++17.
+ */
+class log_column {
+public:
+    /**
+     * Creates a column with the given name and type.
+     *
+     * \param  name  the name of the column; null if there is no name yet
+     * \param  type  the type of the column
+     */
+    explicit log_column(const char* name = nullptr,
+            ub_datatype_t type = UB_DATATYPE_UNKNOWN) {
+        ub_error_t retval = ub_log_column_init(&column_, name, type);
+        if (retval != UB_SUCCESS) {
+            ub_log_column_destroy(&column_);
+            throw error(retval);
+        }
+    }
+
+    log_column(log_column&& other) noexcept : column_(other.column_) {
+        other.column_.name = nullptr;
+        other.column_.xform_params = nullptr;
+    }
+
+    log_column& operator=(log_column&& other) noexcept {
+        if (this != &other) {
+            ub_log_column_destroy(&column_);
+            column_ = other.column_;
+            other.column_.name = nullptr;
+            other.column_.xform_params = nullptr;
+        }
+        return *this;
+    }
+
+    ~log_column() {
+        ub_log_column_destroy(&column_);
+    }
+
+    /**
+     * Returns the length of the data type stored in this column, or zero if
+     * the column has a variable length.
+     */
+    std::size_t length() const noexcept {
+        return ub_log_column_get_length(&column_);
+    }
+
+    /**
+     * Returns the name of the column; null if the column has no name.
+     */
+    const char* name() const noexcept {
+        return ub_log_column_get_name(&column_);
+    }
+
+    /**
+     * Returns a pointer to the underlying C structure.
+     */
+    ub_log_column_t* native() noexcept { return &column_; }
+    const ub_log_column_t* native() const noexcept { return &column_; }
+
+    /**
+     * Releases the ownership of the column and returns it as a C structure.
+     * The caller becomes responsible for destroying it with
+     * \ref ub_log_column_destroy(). The wrapper is left without a name.
+     */
+    ub_log_column_t release() noexcept {
+        ub_log_column_t result = column_;
+        column_.name = nullptr;
+        column_.xform_params = nullptr;
+        return result;
+    }
+
+    /**
+     * Sets the name of the column.
+     */
+    void set_name(const char* name) {
+        check(ub_log_column_set_name(&column_, name));
+    }
+
+    /**
+     * Sets the type of the column.
+     */
+    void set_type(ub_datatype_t type) {
+        check(ub_log_column_set_type(&column_, type));
+    }
+
+    /**
+     * Returns the type of the column.
+     */
+    ub_datatype_t type() const noexcept {
+        return ub_log_column_get_type(&column_);
+    }
+
+private:
+    ub_log_column_t column_;
+};
+
+static_assert(sizeof(log_column) == sizeof(ub_log_column_t),
+        "log_column must be layout-compatible with ub_log_column_t");
+
+}
+
+#endif
@@ -0,0 +1,392 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_LOG_READER_H
+#define UNIBINLOG_LOG_READER_H
+
+#include <stdio.h>
+
+#include <unibinlog/basic_types.h>
+#include <unibinlog/block_index.h>
+#include <unibinlog/bloom_filter.h>
+#include <unibinlog/buffer.h>
+#include <unibinlog/byteorder.h>
+#include <unibinlog/chksum.h>
+#include <unibinlog/error.h>
+#include <unibinlog/log_column.h>
+#include <unibinlog/platform.h>
+#include <unibinlog/scanner.h>
+#include <unibinlog/types.h>
+#include <unibinlog/zone_map.h>
+
+UB_BEGIN_DECLS
+
+/**
+ * \def UB_LOG_READER_FETCH_DEPTH
+ *
+ * The largest number of reads that \ref ub_log_reader_fetch_blocks() keeps
+ * in flight.
+ */
+#define UB_LOG_READER_FETCH_DEPTH 64
+
+/**
+ * \def UB_LOG_READER_FETCH_LENGTH
+ *
+ * The number of bytes that \ref ub_log_reader_fetch_blocks() reads first
+ * from each block.
+ */
+#define UB_LOG_READER_FETCH_LENGTH 4096
+
+/**
+ * \def UB_LOG_READER_READAHEAD_LENGTH
+ *
+ * The number of bytes that a log reader with a sequential access pattern
+ * asks the kernel to read ahead of the current block.
+ */
+#define UB_LOG_READER_READAHEAD_LENGTH (1024 * 1024)
+
+/**
+ * Access patterns of a log reader, passed to the kernel as page cache
+ * hints with \c posix_fadvise(); see
+ * \ref ub_log_reader_set_access_pattern().
+ */
+typedef enum {
+    UB_ACCESS_NORMAL = 0,          /**< No hints; the default */
+    UB_ACCESS_SEQUENTIAL,          /**< Blocks are read in file order; the file is read ahead of the reader */
+    UB_ACCESS_RANDOM,              /**< Blocks are read at offsets found by index lookups; the kernel does not read ahead */
+    UB_ACCESS_ONCE                 /**< Like \c UB_ACCESS_SEQUENTIAL, but the pages behind the reader are dropped from the page cache */
+} ub_access_pattern_t;
+
+/**
+ * Structure that stores the state information of a \em log reader, i.e. an
+ * object that reads a \c unibin log file one log entry block at a time and
+ * provides the rows of the current block in row-major form.
+ *
+ * Blocks other than log header and log entry blocks are skipped. Encoded log
+ * entry blocks are decoded transparently; the rows of plain log entry blocks
+ * are provided directly from the payload of the block without copying.
+ *
+ * In logs that use the aligned row layout (see \c aligned), the rows of
+ * plain log entry blocks start at file offsets that are multiples of
+ * \ref UB_ROW_ALIGNMENT and the values of the columns are naturally
+ * aligned within them, so readers that map the file into memory can access
+ * the values in place.
+ *
+ * The \c rows, \c rows_length and \c num_rows fields describe the current
+ * block and are valid until the next call to \ref ub_log_reader_next_block();
+ * they must be treated as read-only.
+ */
+typedef struct {
+    FILE* file;                    /**< The file that the reader reads from */
+    uint8_t version;               /**< The version number found in the file header */
+    ub_chksum_type_t chksum_type;  /**< The checksum type of the blocks in the file */
+    ub_byte_order_t byte_order;    /**< The byte order of the values in the log entry blocks */
+    ub_bool_t aligned;             /**< Whether the rows use the aligned layout */
+    ub_log_column_t* columns;      /**< The columns of the log; owned by the reader */
+    size_t num_columns;            /**< The number of columns of the log */
+    size_t* offsets;               /**< The offsets of the columns within a row; null if the rows have variable length */
+    size_t row_length;             /**< Length of a row, including padding; zero if the rows have variable length */
+    ub_buffer_t block;             /**< The payload of the last block read */
+    ub_buffer_t decoded;           /**< The decoded rows of the last encoded block */
+    const uint8_t* rows;           /**< The rows of the current block, one after the other */
+    size_t rows_length;            /**< The total length of the rows of the current block */
+    size_t num_rows;               /**< The number of rows in the current block */
+    uint64_t first_row;            /**< The row number of the first row of the current block */
+    uint64_t block_offset;         /**< File offset of the current block; meaningless if the file does not support \c ftell() */
+    uint64_t header_offset;        /**< File offset of the log header block that defines the columns */
+    ub_block_index_t index;        /**< The block index of the file; empty unless loaded */
+    ub_filter_t* filters;          /**< The filters used to skip blocks; owned by the reader */
+    size_t num_filters;            /**< The number of filters */
+    ub_zone_map_t zone_map;        /**< The zone map of the last zone map block read */
+    ub_bloom_key_t* keys;          /**< The keys looked up in Bloom filters; owned by the reader */
+    size_t num_keys;               /**< The number of keys */
+    ub_access_pattern_t access_pattern; /**< The access pattern of the reader */
+    uint64_t advised_offset;       /**< File offset after the last byte that was asked to be read ahead */
+    uint64_t dropped_offset;       /**< File offset of the first byte that was not dropped from the page cache */
+} ub_log_reader_t;
+
+/**
+ * Initializes a log reader and reads the file header and the log header
+ * block from the given file.
+ *
+ * \param  reader  the log reader to initialize
+ * \param  f       the file to read from. It is not owned by the reader; it
+ *                 must be kept open until the reader is destroyed.
+ * \return \c UB_SUCCESS, \c UB_EPARSE if the file is not a \c unibin log
+ *         file, \c UB_EUNSUPPORTED if the file header has flags that the
+ *         reader does not know about or an error code from the underlying
+ *         read operations
+ */
+ub_error_t ub_log_reader_init(ub_log_reader_t* reader, FILE* f);
+
+/**
+ * Destroys a log reader. The file is not closed.
+ *
+ * \param  reader  the log reader to destroy
+ */
+void ub_log_reader_destroy(ub_log_reader_t* reader);
+
+/**
+ * Returns a pointer to the row with the given index in the current block of
+ * a log whose rows have a fixed length.
+ *
+ * \param  reader  the log reader
+ * \param  index   the index of the row; it must be less than \c num_rows
+ * \return pointer to the first byte of the row, or null if the rows of the
+ *         log have variable length
+ */
+const uint8_t* ub_log_reader_get_row(const ub_log_reader_t* reader,
+        size_t index);
+
+/**
+ * Decodes a single column of the current block of a log whose rows have a
+ * fixed length into an array of native values, using the batch byte order
+ * conversion of \ref ub_byteorder_decode_column().
+ *
+ * \param  reader  the log reader
+ * \param  column  the index of the column to decode
+ * \param  dest    the array to write the values into; it must have room for
+ *                 \c num_rows values of the native type of the column
+ * \return \c UB_SUCCESS, \c UB_EINVAL if the column index is out of range
+ *         or \c UB_EUNSUPPORTED if the rows of the log have variable length,
+ *         the column has no native array representation or it cannot be
+ *         converted from the byte order of the log on this host
+ */
+ub_error_t ub_log_reader_read_column(const ub_log_reader_t* reader,
+        size_t column, void* dest);
+
+/**
+ * Loads the block index from the end of the file (see
+ * \ref ub_block_index_t) into the \c index field of the reader, so it can
+ * seek with \ref ub_log_reader_seek_row() and
+ * \ref ub_log_reader_seek_timestamp(). The position of the reader is not
+ * changed.
+ *
+ * \param  reader  the log reader
+ * \return \c UB_SUCCESS, \c UB_EOF if the file has no block index,
+ *         \c UB_EUNSUPPORTED if the file does not support seeking or an
+ *         error code from \ref ub_block_index_read()
+ */
+ub_error_t ub_log_reader_load_index(ub_log_reader_t* reader);
+
+/**
+ * Moves the reader to the log entry block that contains the row with the
+ * given number, using the block index loaded by
+ * \ref ub_log_reader_load_index().
+ *
+ * \param  reader  the log reader
+ * \param  row     the number of the row to seek to
+ * \param  index   the index of the row within the new current block will be
+ *                 returned here if it is not null
+ * \return \c UB_SUCCESS, \c UB_EOF if the row is past the end of the log,
+ *         \c UB_EINVAL if no block index was loaded or an error code from
+ *         \ref ub_log_reader_next_block()
+ */
+ub_error_t ub_log_reader_seek_row(ub_log_reader_t* reader, uint64_t row,
+        size_t* index);
+
+/**
+ * Moves the reader to the first row whose timestamp is greater than or equal
+ * to the given timestamp, using the block index loaded by
+ * \ref ub_log_reader_load_index().
+ *
+ * \param  reader     the log reader
+ * \param  timestamp  the timestamp to seek to, in the units of the timestamp
+ *                    column (see \ref ub_byteorder_decode_int64())
+ * \param  index      the index of the row within the new current block will
+ *                    be returned here if it is not null
+ * \return \c UB_SUCCESS, \c UB_EOF if all the rows are older than the
+ *         given timestamp, \c UB_EINVAL if no block index was loaded,
+ *         \c UB_EUNSUPPORTED if the log has no timestamp column or an error
+ *         code from \ref ub_log_reader_next_block()
+ */
+ub_error_t ub_log_reader_seek_timestamp(ub_log_reader_t* reader,
+        int64_t timestamp, size_t* index);
+
+/**
+ * Moves the reader to the log entry block at the given file offset, e.g. an
+ * offset from the \c block_offset field of the reader or from an index,
+ * and reads it.
+ *
+ * \param  reader     the log reader
+ * \param  offset     the file offset of the log entry block
+ * \param  first_row  the row number of the first row of the block
+ * \return \c UB_SUCCESS, \c UB_EREAD if the file does not support seeking
+ *         or an error code from \ref ub_log_reader_next_block()
+ */
+ub_error_t ub_log_reader_seek_block(ub_log_reader_t* reader, uint64_t offset,
+        uint64_t first_row);
+
+/**
+ * Moves the reader to the first sync block (see
+ * \ref ub_log_writer_set_sync_interval()) at or after the given file
+ * offset and reads the log entry block that follows it. The offset does
+ * not have to be a block boundary. The row numbers are taken from the sync
+ * block, and if the sync block refers to a different log header block than
+ * the current one, the columns are reloaded from that log header block.
+ *
+ * \param  reader  the log reader
+ * \param  offset  the file offset to start looking from
+ * \return \c UB_SUCCESS, \c UB_EOF if there are no sync blocks after the
+ *         given offset, \c UB_EREAD if the file does not support seeking,
+ *         \c UB_EPARSE if the sync block does not refer to a log header
+ *         block or an error code from \ref ub_log_reader_next_block()
+ */
+ub_error_t ub_log_reader_seek_sync(ub_log_reader_t* reader, uint64_t offset);
+
+/**
+ * Reads the log entry blocks at the given file offsets, e.g. the offsets
+ * found by index lookups, and passes them to \p block_func in the order in
+ * which their reads complete.
+ *
+ * The reads are submitted together as one io_uring batch, keeping up to
+ * \ref UB_LOG_READER_FETCH_DEPTH of them in flight, so the storage device
+ * can serve them in parallel instead of one after the other. Each read
+ * starts with the first \ref UB_LOG_READER_FETCH_LENGTH bytes of the
+ * block, and the rest of a longer block is read when its header arrives.
+ * If the kernel does not support io_uring (or the library was built
+ * without it), the blocks are read one by one with \c pread().
+ *
+ * The blocks are decoded with the columns of the current log header block
+ * of the reader. The \c range field of each block is the index of its
+ * offset in \p offsets. The position and the current block of the reader
+ * are not changed.
+ *
+ * \param  reader      the log reader
+ * \param  offsets     the file offsets of the log entry blocks
+ * \param  count       the number of offsets
+ * \param  block_func  the function to call for each block
+ * \param  user_data   pointer passed to \p block_func as its state
+ * \return \c UB_SUCCESS, \c UB_EUNSUPPORTED if the file of the reader has
+ *         no file descriptor, \c UB_EREAD if a read fails, \c UB_EPARSE
+ *         if an offset does not point to a valid log entry block,
+ *         \c UB_ENOMEM or the first error code returned by \p block_func,
+ *         which stops the delivery of the remaining blocks
+ */
+ub_error_t ub_log_reader_fetch_blocks(ub_log_reader_t* reader,
+        const uint64_t* offsets, size_t count,
+        ub_scan_block_func_t* block_func, void* user_data);
+
+/**
+ * Sets the access pattern of the reader and tells it to the kernel, so the
+ * page cache can serve the reader better and disturb the other processes
+ * less.
+ *
+ * With \c UB_ACCESS_SEQUENTIAL, the kernel reads ahead more aggressively,
+ * and \ref ub_log_reader_next_block() also asks it to read the next
+ * \ref UB_LOG_READER_READAHEAD_LENGTH bytes of the file in the
+ * background, so the reader rarely waits for the disk. With
+ * \c UB_ACCESS_ONCE, meant for one-pass jobs such as exports, the pages
+ * that the reader has left behind are dropped from the page cache as well,
+ * so a scan of a large archive does not evict the working set of other
+ * processes. Pages that are still cached for other readers are dropped as
+ * well, so use it only for files that nobody else reads. With
+ * \c UB_ACCESS_RANDOM, the kernel does not read ahead; use
+ * \ref ub_log_reader_prefetch_rows() to prefetch the blocks that an index
+ * lookup selected instead.
+ *
+ * The hints never change the results of the reader.
+ *
+ * \param  reader   the log reader
+ * \param  pattern  the access pattern
+ * \return \c UB_SUCCESS, \c UB_EINVAL if the access pattern is unknown or
+ *         \c UB_EUNSUPPORTED if the file of the reader has no file
+ *         descriptor, does not take hints (e.g. a pipe) or the platform has
+ *         no \c posix_fadvise()
+ */
+ub_error_t ub_log_reader_set_access_pattern(ub_log_reader_t* reader,
+        ub_access_pattern_t pattern);
+
+/**
+ * Asks the kernel to read the blocks that hold the given rows into the page
+ * cache in the background, using the block index loaded by
+ * \ref ub_log_reader_load_index(). Seeking to the rows afterwards, or
+ * fetching their blocks, then finds them in memory.
+ *
+ * \param  reader     the log reader
+ * \param  first_row  the row number of the first row
+ * \param  num_rows   the number of rows
+ * \return \c UB_SUCCESS, \c UB_EOF if the first row is past the last
+ *         block, \c UB_EINVAL if no block index was loaded or
+ *         \c UB_EUNSUPPORTED if the file of the reader has no file
+ *         descriptor or the platform has no \c posix_fadvise()
+ */
+ub_error_t ub_log_reader_prefetch_rows(ub_log_reader_t* reader,
+        uint64_t first_row, uint64_t num_rows);
+
+/**
+ * Adds a filter that compares a numeric column with a constant. Log entry
+ * blocks whose zone map (see \ref ub_zone_map_t) shows that none of their
+ * rows can satisfy all the filters of the reader are skipped by
+ * \ref ub_log_reader_next_block() without reading their payload.
+ *
+ * Filters only skip whole blocks; the rows of the blocks that are not
+ * skipped must still be checked one by one. Blocks without a zone map are
+ * never skipped.
+ *
+ * \param  reader  the log reader
+ * \param  column  the index of the column
+ * \param  op      the comparison operator
+ * \param  value   pointer to the constant, stored as the native C type of
+ *                 the column (see \ref ub_typeinfo_t.c_name)
+ * \return \c UB_SUCCESS, \c UB_EINVAL if the column index or the operator
+ *         is invalid, \c UB_EUNSUPPORTED if zone maps do not support the
+ *         data type of the column (see \ref ub_zone_map_supports_type())
+ *         or \c UB_ENOMEM
+ */
+ub_error_t ub_log_reader_add_filter(ub_log_reader_t* reader, size_t column,
+        ub_filter_op_t op, const void* value);
+
+/**
+ * Removes all the filters of a log reader.
+ *
+ * \param  reader  the log reader
+ */
+void ub_log_reader_clear_filters(ub_log_reader_t* reader);
+
+/**
+ * Adds a value to look for in a column. Log entry blocks whose Bloom filter
+ * for the column (see \ref ub_log_writer_add_bloom_filter()) shows that
+ * the block does not contain any of the values added for the column are
+ * skipped by \ref ub_log_reader_next_block() without reading their
+ * payload. Values added for the same column are alternatives; values of
+ * different columns must all be present in a block.
+ *
+ * Bloom filters have false positives, so the rows of the blocks that are
+ * not skipped must still be checked one by one. Blocks without a Bloom
+ * filter for the column are never skipped.
+ *
+ * \param  reader  the log reader
+ * \param  column  the index of the column
+ * \param  value   pointer to the value; see \ref ub_bloom_key_init()
+ * \param  length  the length of the value if the column holds strings or
+ *                 blobs; ignored otherwise
+ * \return \c UB_SUCCESS, \c UB_EINVAL if the column index is out of range,
+ *         \c UB_EUNSUPPORTED if the column has an unknown type or
+ *         \c UB_ENOMEM
+ */
+ub_error_t ub_log_reader_add_key(ub_log_reader_t* reader, size_t column,
+        const void* value, size_t length);
+
+/**
+ * Removes all the keys added with \ref ub_log_reader_add_key().
+ *
+ * \param  reader  the log reader
+ */
+void ub_log_reader_clear_keys(ub_log_reader_t* reader);
+
+/**
+ * Advances the reader to the next log entry block of the file. Log header
+ * blocks encountered along the way replace the columns of the reader, and
+ * blocks that cannot match the filters or the keys of the reader are skipped
+ * (see \ref ub_log_reader_add_filter() and \ref ub_log_reader_add_key()).
+ *
+ * \param  reader  the log reader
+ * \return \c UB_SUCCESS, \c UB_EOF if there are no more log entry blocks,
+ *         \c UB_EPARSE if a block is corrupted or an error code from the
+ *         underlying read operations
+ */
+ub_error_t ub_log_reader_next_block(ub_log_reader_t* reader);
+
+UB_END_DECLS
+
+#endif
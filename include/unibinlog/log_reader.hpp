@@ -0,0 +1,415 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_LOG_READER_HPP
+#define UNIBINLOG_LOG_READER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+#include <unibinlog/error.hpp>
+#include <unibinlog/log_reader.h>
+#include <unibinlog/span.hpp>
+#include <unibinlog/types.hpp>
+
+namespace unibinlog {
+
+namespace detail {
+
+/**
+ * Deleter for heap-allocated \ref ub_log_reader_t structures that destroys
+ * the reader before freeing the structure itself.
+ */
+struct log_reader_deleter {
+    void operator()(ub_log_reader_t* reader) const noexcept {
+        ub_log_reader_destroy(reader);
+        delete reader;
+    }
+};
+
+}
+
+/**
+ * Lightweight view of a single row in the current block of a
+ * \ref log_reader, with the column types given by a \ref schema.
+ *
+ * The view refers to the encoded row data in the block, which is in the byte
+ * order of the log; it does not decode anything by itself. Columns are decoded only when they are
+ * accessed with \ref get(), so a query that touches only a few columns of
+ * a wide row pays only for those. Structured bindings are supported as well;
+ * they decode every column that they bind.
+ *
+ * The view is valid until the reader advances to the next block.
+ */
+template <typename Schema>
+class row_view {
+public:
+    explicit row_view(const std::uint8_t* data,
+            ub_byte_order_t order = UB_BIG_ENDIAN) noexcept
+        : data_(data), order_(order) {}
+
+    /**
+     * Decodes the column with the given index.
+     */
+    template <std::size_t I>
+    typename Schema::template column_type<I> get() const noexcept {
+        typedef datatype_traits<typename Schema::template column_type<I>> traits;
+        const std::uint8_t* src = data_ + Schema::offsets[I];
+
+        if (order_ == UB_LITTLE_ENDIAN) {
+            return traits::template load<UB_LITTLE_ENDIAN>(src);
+        } else {
+            return traits::template load<UB_BIG_ENDIAN>(src);
+        }
+    }
+
+    /**
+     * Returns the raw row data.
+     */
+    const std::uint8_t* data() const noexcept { return data_; }
+
+    /**
+     * Returns the byte order of the raw row data.
+     */
+    ub_byte_order_t byte_order() const noexcept { return order_; }
+
+private:
+    const std::uint8_t* data_;
+    ub_byte_order_t order_;
+};
+
+/**
+ * Input range over the rows of a \ref log_reader, created by
+ * \ref log_reader::rows(). Iterating over the range advances the reader
+ * block by block until the end of the file.
+ */
+template <typename Schema>
+class row_range {
+public:
+    class iterator {
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef row_view<Schema> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const row_view<Schema>* pointer;
+        typedef row_view<Schema> reference;
+
+        iterator() noexcept : reader_(nullptr), index_(0) {}
+
+        iterator(ub_log_reader_t* reader, std::size_t index)
+            : reader_(reader), index_(index) {
+            if (index_ >= reader_->num_rows) {
+                next_block();
+            } else {
+                check_schema();
+            }
+        }
+
+        row_view<Schema> operator*() const noexcept {
+            return row_view<Schema>(reader_->rows + index_ * Schema::row_length,
+                    reader_->byte_order);
+        }
+
+        iterator& operator++() {
+            if (++index_ >= reader_->num_rows) {
+                next_block();
+            }
+            return *this;
+        }
+
+        bool operator==(const iterator& other) const noexcept {
+            return reader_ == other.reader_ &&
+                (reader_ == nullptr || index_ == other.index_);
+        }
+
+        bool operator!=(const iterator& other) const noexcept {
+            return !(*this == other);
+        }
+
+    private:
+        void check_schema() const {
+            if (!Schema::matches(reader_->columns, reader_->num_columns) ||
+                    Schema::aligned != static_cast<bool>(reader_->aligned)) {
+                throw error(UB_EINVAL);
+            }
+        }
+
+        void next_block() {
+            ub_error_t retval;
+
+            index_ = 0;
+            do {
+                retval = ub_log_reader_next_block(reader_);
+            } while (retval == UB_SUCCESS && reader_->num_rows == 0);
+
+            if (retval == UB_EOF) {
+                reader_ = nullptr;
+            } else {
+                check(retval);
+                check_schema();
+            }
+        }
+
+        ub_log_reader_t* reader_;
+        std::size_t index_;
+    };
+
+    row_range(ub_log_reader_t* reader, std::size_t start) noexcept
+        : reader_(reader), start_(start) {}
+
+    /**
+     * Returns an iterator pointing to the starting row of the current block
+     * of the reader, or to the first row of the next non-empty block if the
+     * current block has no more rows.
+     */
+    iterator begin() const { return iterator(reader_, start_); }
+
+    /**
+     * Returns an iterator marking the end of the file.
+     */
+    iterator end() const noexcept { return iterator(); }
+
+private:
+    ub_log_reader_t* reader_;
+    std::size_t start_;
+};
+
+/**
+ * Move-only C++ wrapper around \ref ub_log_reader_t.
+ *
+ * Rows can be read in a typed manner with \ref rows():
+ *
+ * \code
+ * typedef unibinlog::schema<std::uint16_t, double> my_schema;
+ *
+ * unibinlog::log_reader reader(f);
+ * for (auto row : reader.rows<my_schema>()) {
+ *     use(row.get<1>());
+ * }
+ * \endcode
+ *
+ * This header requires C++17.
+ */
+class log_reader {
+public:
+    /**
+     * Creates a log reader that reads from the given file, and reads the
+     * file header and the log header block.
+     *
+     * \param  f  the file to read from. It is not owned by the reader; it
+     *            must be kept open until the reader is destroyed.
+     */
+    explicit log_reader(FILE* f) : reader_(new ub_log_reader_t) {
+        ub_error_t retval = ub_log_reader_init(reader_.get(), f);
+        if (retval != UB_SUCCESS) {
+            delete reader_.release();
+            throw error(retval);
+        }
+    }
+
+    log_reader(log_reader&&) noexcept = default;
+    log_reader& operator=(log_reader&&) noexcept = default;
+
+    /**
+     * Returns the columns of the log.
+     */
+    span<const ub_log_column_t> columns() const noexcept {
+        return span<const ub_log_column_t>(reader_->columns,
+                reader_->num_columns);
+    }
+
+    /**
+     * Returns the underlying C log reader.
+     */
+    ub_log_reader_t* native() noexcept { return reader_.get(); }
+    const ub_log_reader_t* native() const noexcept { return reader_.get(); }
+
+    /**
+     * Advances the reader to the next log entry block.
+     *
+     * \return \c true if a block was read, \c false at the end of the file
+     */
+    bool next_block() {
+        ub_error_t retval = ub_log_reader_next_block(reader_.get());
+        if (retval == UB_EOF) {
+            return false;
+        }
+        check(retval);
+        return true;
+    }
+
+    /**
+     * Loads the block index of the file. See \ref ub_log_reader_load_index().
+     *
+     * \return \c true if the index was loaded, \c false if the file has no
+     *         block index
+     */
+    bool load_index() {
+        ub_error_t retval = ub_log_reader_load_index(reader_.get());
+        if (retval == UB_EOF) {
+            return false;
+        }
+        check(retval);
+        return true;
+    }
+
+    /**
+     * Moves the reader to the block containing the row with the given
+     * number. See \ref ub_log_reader_seek_row().
+     *
+     * \return the index of the row within the current block, to be passed
+     *         to \ref rows()
+     */
+    std::size_t seek_row(std::uint64_t row) {
+        std::size_t index;
+        check(ub_log_reader_seek_row(reader_.get(), row, &index));
+        return index;
+    }
+
+    /**
+     * Moves the reader to the first row whose timestamp is not older than
+     * the given timestamp. See \ref ub_log_reader_seek_timestamp().
+     *
+     * \return the index of the row within the current block, to be passed
+     *         to \ref rows()
+     */
+    std::size_t seek_timestamp(std::int64_t timestamp) {
+        std::size_t index;
+        check(ub_log_reader_seek_timestamp(reader_.get(), timestamp, &index));
+        return index;
+    }
+
+    /**
+     * Moves the reader to the first sync block at or after the given file
+     * offset and reads the block after it. See
+     * \ref ub_log_reader_seek_sync().
+     *
+     * \return \c true if a sync block was found, \c false if there are no
+     *         sync blocks after the offset
+     */
+    bool seek_sync(std::uint64_t offset) {
+        ub_error_t retval = ub_log_reader_seek_sync(reader_.get(), offset);
+        if (retval == UB_EOF) {
+            return false;
+        }
+        check(retval);
+        return true;
+    }
+
+    /**
+     * Adds a filter that compares a numeric column with a constant, so that
+     * blocks that cannot contain matching rows are skipped. See
+     * \ref ub_log_reader_add_filter().
+     *
+     * \param  column  the index of the column
+     * \param  op      the comparison operator
+     * \param  value   the constant; \ref error is thrown with \c UB_EINVAL
+     *                 if its type does not match the type of the column
+     *                 (see \ref datatype_traits), e.g. for an \c int literal
+     *                 and a \c UB_DATATYPE_U64 column
+     */
+    template <typename T>
+    void add_filter(std::size_t column, ub_filter_op_t op, T value) {
+        check_column_type<T>(column);
+        check(ub_log_reader_add_filter(reader_.get(), column, op, &value));
+    }
+
+    /**
+     * Removes all the filters of the reader.
+     */
+    void clear_filters() noexcept {
+        ub_log_reader_clear_filters(reader_.get());
+    }
+
+    /**
+     * Adds a value to look for in a numeric column, so that blocks whose
+     * Bloom filter does not contain it are skipped. See
+     * \ref ub_log_reader_add_key().
+     *
+     * \param  column  the index of the column
+     * \param  value   the value; \ref error is thrown with \c UB_EINVAL if
+     *                 its type does not match the type of the column (see
+     *                 \ref datatype_traits)
+     */
+    template <typename T,
+             typename = std::enable_if_t<std::is_arithmetic<T>::value>>
+    void add_key(std::size_t column, T value) {
+        check_column_type<T>(column);
+        check(ub_log_reader_add_key(reader_.get(), column, &value, sizeof(T)));
+    }
+
+    /**
+     * Adds a value to look for in a string or blob column, so that blocks
+     * whose Bloom filter does not contain it are skipped. See
+     * \ref ub_log_reader_add_key().
+     */
+    void add_key(std::size_t column, std::string_view value) {
+        check(ub_log_reader_add_key(reader_.get(), column, value.data(),
+                    value.size()));
+    }
+
+    /**
+     * Removes all the keys of the reader.
+     */
+    void clear_keys() noexcept {
+        ub_log_reader_clear_keys(reader_.get());
+    }
+
+    /**
+     * Returns a range over the remaining rows of the log, typed according to
+     * the given \ref schema or \ref aligned_schema. The column types and
+     * the row layout of the log must match the schema exactly; \ref error
+     * is thrown with \c UB_EINVAL otherwise.
+     *
+     * \param  start  the index of the first row of the range within the
+     *                current block, e.g. as returned by \ref seek_row()
+     */
+    template <typename Schema>
+    row_range<Schema> rows(std::size_t start = 0) {
+        if (!Schema::matches(reader_->columns, reader_->num_columns) ||
+                Schema::aligned != static_cast<bool>(reader_->aligned)) {
+            throw error(UB_EINVAL);
+        }
+        return row_range<Schema>(reader_.get(), start);
+    }
+
+private:
+    /**
+     * Throws \ref error with \c UB_EINVAL unless values of the given type can
+     * be passed to the C API as values of the given column, which reads as
+     * many bytes as the column type is long.
+     */
+    template <typename T>
+    void check_column_type(std::size_t column) const {
+        static_assert(sizeof(T) == datatype_traits<T>::length,
+                "the type must have the same layout as the column type");
+        if (column < reader_->num_columns &&
+                reader_->columns[column].type != datatype_traits<T>::type) {
+            throw error(UB_EINVAL);
+        }
+    }
+
+    std::unique_ptr<ub_log_reader_t, detail::log_reader_deleter> reader_;
+};
+
+}
+
+namespace std {
+
+template <typename Schema>
+struct tuple_size<unibinlog::row_view<Schema>>
+    : std::integral_constant<std::size_t, Schema::num_columns> {};
+
+template <std::size_t I, typename Schema>
+struct tuple_element<I, unibinlog::row_view<Schema>> {
+    typedef typename Schema::template column_type<I> type;
+};
+
+}
+
+#endif
@@ -0,0 +1,472 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_LOG_WRITER_H
+#define UNIBINLOG_LOG_WRITER_H
+
+#include <stdio.h>
+
+#include <unibinlog/basic_types.h>
+#include <unibinlog/block_index.h>
+#include <unibinlog/bloom_filter.h>
+#include <unibinlog/buffer.h>
+#include <unibinlog/byteorder.h>
+#include <unibinlog/chksum.h>
+#include <unibinlog/codec.h>
+#include <unibinlog/error.h>
+#include <unibinlog/log_column.h>
+#include <unibinlog/platform.h>
+#include <unibinlog/zone_map.h>
+
+UB_BEGIN_DECLS
+
+/**
+ * \def UB_LOG_WRITER_DEFAULT_BLOCK_LENGTH
+ *
+ * The default maximum length of the payload of the log entry blocks written
+ * by a \ref ub_log_writer_t.
+ */
+#define UB_LOG_WRITER_DEFAULT_BLOCK_LENGTH 8192
+
+/**
+ * Enum constants for the durability policies of a \ref ub_log_writer_t,
+ * i.e. the points where the writer waits until the blocks written so far
+ * are stored on the disk (see \ref ub_sync_file()).
+ *
+ * A single sync makes all the blocks written before it durable, so the
+ * policies that sync less often amortize the latency of the disk over many
+ * blocks.
+ */
+typedef enum {
+    UB_DURABILITY_NONE = 0,        /**< Leave it to the operating system */
+    UB_DURABILITY_BLOCK,           /**< Sync after each log entry block */
+    UB_DURABILITY_BLOCK_COUNT,     /**< Sync after every N log entry blocks */
+    UB_DURABILITY_INTERVAL         /**< Sync in the background at most N milliseconds after a log entry block was written */
+} ub_durability_t;
+
+/**
+ * Type of a function that makes the blocks written by a log writer so far
+ * durable, for streams that \ref ub_sync_file() cannot sync (see
+ * \ref ub_log_writer_set_sync_func()).
+ *
+ * \param  user_data  the user data given with the function
+ * \return \c UB_SUCCESS or an error code that is returned from the call
+ *         that synced the writer
+ */
+typedef ub_error_t ub_log_writer_sync_func_t(void* user_data);
+
+/**
+ * Structure that stores the state information of a \em log writer, i.e. an
+ * object that collects log entries (rows) and writes them into a \c unibin
+ * file in batches, one log entry block at a time.
+ *
+ * The file header and the log header block are written lazily, when the
+ * first block is written or when the writer is closed.
+ */
+typedef struct {
+    FILE* file;                    /**< The file that the writer writes into */
+    ub_log_column_t* columns;      /**< The columns of the log; not owned by the writer */
+    size_t num_columns;            /**< The number of columns of the log */
+    size_t row_length;             /**< Length of a row; zero if the rows have variable length */
+    uint8_t version;               /**< The version number to write into the file header */
+    ub_chksum_type_t chksum_type;  /**< The checksum type of the blocks in the file */
+    ub_bool_t header_written;      /**< Whether the file header was written already */
+    ub_buffer_t block;             /**< The rows not written yet, one after the other */
+    size_t num_rows;               /**< The number of rows not written yet */
+    size_t max_block_length;       /**< The maximum payload length of a log entry block */
+    ub_codec_t codec;              /**< The codec to use for the columns */
+    size_t codec_sample_size;      /**< The number of rows to sample when selecting codecs */
+    ub_buffer_t payload;           /**< Scratch buffer for encoded payloads */
+    ub_byte_order_t byte_order;    /**< The byte order of the values in the log entry blocks */
+    ub_bool_t aligned;             /**< Whether the rows use the aligned layout */
+    ub_bool_t indexed;             /**< Whether to write a block index when the writer is closed */
+    ub_block_index_t index;        /**< The block index of the blocks written so far */
+    uint64_t num_rows_written;     /**< The number of rows written into the file so far */
+    size_t last_row_offset;        /**< Offset of the last row not written yet in \c block */
+    size_t timestamp_offset;       /**< Offset of the timestamp column in a row; \c SIZE_MAX if rows have variable length */
+    ub_bool_t zone_maps;           /**< Whether to write a zone map block before each log entry block */
+    ub_zone_map_t zone_map;        /**< Scratch space for the zone map of the current block */
+    size_t* bloom_columns;         /**< The columns to write Bloom filters for; owned by the writer */
+    size_t num_bloom_columns;      /**< The number of columns to write Bloom filters for */
+    uint64_t sync_interval;        /**< The number of bytes between sync blocks; zero if sync blocks are disabled */
+    uint64_t next_sync;            /**< File offset after which the next sync block is due */
+    uint64_t header_offset;        /**< File offset of the log header block */
+    ub_bool_t appending;           /**< Whether the writer appends to a file that has its headers already */
+    ub_bool_t rows_unknown;        /**< Whether the number of rows already in the file is unknown when appending */
+    ub_durability_t durability;    /**< The durability policy of the writer */
+    uint64_t durability_param;     /**< The number of blocks or milliseconds between syncs, depending on the policy */
+    uint64_t unsynced_blocks;      /**< The number of log entry blocks written since the last sync */
+    uint64_t last_sync;            /**< Time of the last sync on a monotonic clock, in milliseconds */
+    void* sync_thread;             /**< The thread that syncs the file for \c UB_DURABILITY_INTERVAL, shared with the other writers of the same file descriptor; opaque */
+    ub_log_writer_sync_func_t* sync_func; /**< Function that syncs the file instead of \ref ub_sync_file(); may be null */
+    void* sync_data;               /**< User data passed to \c sync_func */
+} ub_log_writer_t;
+
+/**
+ * Initializes a log writer.
+ *
+ * \param  writer       the log writer to initialize
+ * \param  f            the file to write into. It is not owned by the writer;
+ *                      it must be kept open until the writer is closed.
+ * \param  columns      pointer to an array containing the columns of the log.
+ *                      The array is not copied; it must not be modified or
+ *                      destroyed until the writer is destroyed.
+ * \param  num_columns  the number of columns
+ * \param  chksum_type  the checksum type to use for each block in the file
+ * \return \c UB_SUCCESS or an error code
+ */
+ub_error_t ub_log_writer_init(ub_log_writer_t* writer, FILE* f,
+        ub_log_column_t* columns, size_t num_columns,
+        ub_chksum_type_t chksum_type);
+
+/**
+ * Initializes a log writer that appends to an existing log, e.g. after the
+ * process that wrote it was restarted following a crash or a power loss.
+ *
+ * The checksum type, the byte order and the row layout are taken from the
+ * file header. The last intact block of the file is found from the block
+ * index of the file if it has one (see \ref ub_log_writer_set_index()), in
+ * which case the new blocks are added to the index. Otherwise at most the
+ * last 256 KiB of the file are read: the blocks are walked from the last
+ * sync block in there (see \ref ub_log_writer_set_sync_interval()), or
+ * else from the first offset where a block with a valid checksum starts
+ * and the chain of blocks runs to the end of the file. Either way, only
+ * the end of the file is read. The blocks after the last intact block,
+ * i.e. a torn write or the block index, are cut off. A torn write is a
+ * single block that runs past the end of the file, or zeros; a damaged
+ * block followed by anything else is not cut off, and the file is
+ * rejected instead.
+ *
+ * The row numbers continue where the intact blocks end. If neither a block
+ * index nor a sync block tells the number of rows already in the file,
+ * \c num_rows_written counts from zero, \c rows_unknown is set and sync
+ * blocks cannot be enabled. Blocks found by trying each offset are only
+ * reliable with a checksum type other than \c UB_CHKSUM_NONE.
+ *
+ * \param  writer       the log writer to initialize
+ * \param  f            the file to append to, opened for reading and
+ *                      writing. It must support seeking and, if the file
+ *                      has to be cut, \c ftruncate(). It is not owned by the
+ *                      writer; it must be kept open until the writer is
+ *                      closed.
+ * \param  columns      pointer to an array containing the columns of the log;
+ *                      they must match the columns in the log header block
+ *                      of the file. The array is not copied; it must not be
+ *                      modified or destroyed until the writer is destroyed.
+ * \param  num_columns  the number of columns
+ * \return \c UB_SUCCESS, \c UB_EPARSE if the file is not a \c unibin log
+ *         or has a damaged block that is not at its end,
+ *         \c UB_EINVAL if the columns do not match the ones in the file,
+ *         \c UB_EUNSUPPORTED if the file header has flags that the writer
+ *         does not know about or the file cannot be cut, or an error code
+ *         from the underlying read operations
+ */
+ub_error_t ub_log_writer_init_append(ub_log_writer_t* writer, FILE* f,
+        ub_log_column_t* columns, size_t num_columns);
+
+/**
+ * Destroys a log writer. Rows that have not been written yet are discarded;
+ * call \ref ub_log_writer_close() first if you need them.
+ *
+ * \param  writer  the log writer to destroy
+ */
+void ub_log_writer_destroy(ub_log_writer_t* writer);
+
+/**
+ * Writes all the rows that have not been written yet into the file, followed
+ * by the file header and the log header block if they have not been written
+ * yet either, and the block index if the writer maintains one (see
+ * \ref ub_log_writer_set_index()). The file itself is not closed; no rows
+ * may be added after the block index was written.
+ *
+ * \param  writer  the log writer
+ * \return \c UB_SUCCESS or an error code
+ */
+ub_error_t ub_log_writer_close(ub_log_writer_t* writer);
+
+/**
+ * Writes all the rows that have not been written yet into a new log entry
+ * block. Does nothing if there are no such rows.
+ *
+ * \param  writer  the log writer
+ * \return \c UB_SUCCESS or an error code
+ */
+ub_error_t ub_log_writer_flush(ub_log_writer_t* writer);
+
+/**
+ * Writes all the rows that have not been written yet into a new log entry
+ * block and waits until all the blocks written so far are stored on the
+ * disk, regardless of the durability policy of the writer.
+ *
+ * \param  writer  the log writer
+ * \return \c UB_SUCCESS or an error code
+ */
+ub_error_t ub_log_writer_sync(ub_log_writer_t* writer);
+
+/**
+ * Sets the durability policy of the writer, i.e. how often the blocks
+ * written so far are stored on the disk. With \c UB_DURABILITY_BLOCK and
+ * \c UB_DURABILITY_BLOCK_COUNT, the writer syncs after writing a log entry
+ * block. With \c UB_DURABILITY_INTERVAL, the blocks are handed to the
+ * kernel as they are written, and a background thread syncs them at most
+ * N milliseconds later, even if no more blocks are written; the writers of
+ * the same file descriptor share the thread and its syncs, and the errors
+ * of the syncs are reported by the next flush, write or close. Writers
+ * that have a policy other than \c UB_DURABILITY_NONE also sync when they
+ * are closed. The default is \c UB_DURABILITY_NONE.
+ *
+ * \param  writer  the log writer
+ * \param  policy  the durability policy
+ * \param  param   the number of blocks between syncs for
+ *                 \c UB_DURABILITY_BLOCK_COUNT or the number of milliseconds
+ *                 between syncs for \c UB_DURABILITY_INTERVAL; ignored for
+ *                 the other policies
+ * \return \c UB_SUCCESS, \c UB_EINVAL if the policy is invalid or the
+ *         parameter is zero when a parameter is required,
+ *         \c UB_EUNSUPPORTED if the policy is \c UB_DURABILITY_INTERVAL and
+ *         the file has no file descriptor or a sync function is set, or an
+ *         error code if the background thread cannot be started
+ */
+ub_error_t ub_log_writer_set_durability(ub_log_writer_t* writer,
+        ub_durability_t policy, uint64_t param);
+
+/**
+ * Sets a function that syncs the file of the writer instead of
+ * \ref ub_sync_file(), for streams that are not backed by a file
+ * descriptor or that buffer the data themselves, e.g. the streams of
+ * \ref ub_uring_file_t and \ref ub_direct_file_t (see
+ * \ref ub_uring_file_attach() and \ref ub_direct_file_attach()). The
+ * function is called on the thread that uses the writer.
+ *
+ * \param  writer     the log writer
+ * \param  func       the function; null to use \ref ub_sync_file()
+ * \param  user_data  user data passed to the function
+ * \return \c UB_SUCCESS or \c UB_EUNSUPPORTED if the durability policy of
+ *         the writer is \c UB_DURABILITY_INTERVAL, which syncs the file
+ *         descriptor in the background
+ */
+ub_error_t ub_log_writer_set_sync_func(ub_log_writer_t* writer,
+        ub_log_writer_sync_func_t* func, void* user_data);
+
+/**
+ * Sets the maximum payload length of the log entry blocks written by the
+ * writer. This may only be called when there are no rows waiting to be
+ * written.
+ *
+ * \param  writer  the log writer
+ * \param  length  the new maximum payload length; at most 65535
+ * \return \c UB_SUCCESS or \c UB_EINVAL if the length is invalid or there
+ *         are rows waiting to be written
+ */
+ub_error_t ub_log_writer_set_block_length(ub_log_writer_t* writer,
+        size_t length);
+
+/**
+ * Sets the codec used to encode the columns of the log entry blocks written
+ * by the writer.
+ *
+ * With \c UB_CODEC_RAW (the default), rows are written as they are into
+ * \c UB_BLOCK_LOG_ENTRY blocks. Any other codec makes the writer write
+ * \c UB_BLOCK_ENCODED_LOG_ENTRY blocks instead, where each column is encoded
+ * with the given codec, or with \c UB_CODEC_RAW if the codec does not
+ * support the data type of the column or would make it larger.
+ *
+ * With \c UB_CODEC_AUTO, the writer selects the smallest codec for each
+ * column in each block separately, by trying all the codecs on the first
+ * \p sample_size rows of the block. The selected codecs are recorded in the
+ * block itself.
+ *
+ * Codecs other than \c UB_CODEC_RAW are supported only if all the columns
+ * of the log have fixed-width data types, the log uses network byte order
+ * and the packed row layout. This may only be called when there are no rows waiting to be
+ * written.
+ *
+ * \param  writer       the log writer
+ * \param  codec        the codec to use
+ * \param  sample_size  the number of rows to sample when \p codec is
+ *                      \c UB_CODEC_AUTO; zero means to use all the rows
+ *                      of the block. Ignored for other codecs.
+ * \return \c UB_SUCCESS, \c UB_EINVAL if the codec is invalid or there are
+ *         rows waiting to be written, \c UB_EUNSUPPORTED if the log has
+ *         variable-length columns, uses little-endian byte order or the
+ *         aligned row layout
+ */
+ub_error_t ub_log_writer_set_codec(ub_log_writer_t* writer, ub_codec_t codec,
+        size_t sample_size);
+
+/**
+ * Sets the byte order of the values in the log entry blocks written by the
+ * writer. The default is network byte order; \c UB_LITTLE_ENDIAN sets the
+ * \ref UB_HEADER_FLAG_LITTLE_ENDIAN flag in the file header so readers on
+ * little-endian hosts can use the values without byte swapping. The framing
+ * of the file (block lengths, the log header block and the length prefixes
+ * of blobs) stays in network byte order.
+ *
+ * Little-endian logs support \c UB_CODEC_RAW only. This may only be called
+ * before the file header is written.
+ *
+ * \param  writer  the log writer
+ * \param  order   the byte order to use
+ * \return \c UB_SUCCESS, \c UB_EINVAL if the byte order is invalid or the
+ *         file header or rows have been written already, \c UB_EUNSUPPORTED
+ *         if the writer uses a codec other than \c UB_CODEC_RAW
+ */
+ub_error_t ub_log_writer_set_byte_order(ub_log_writer_t* writer,
+        ub_byte_order_t order);
+
+/**
+ * Sets whether the rows written by the writer use the aligned row layout
+ * (see \ref ub_log_columns_get_layout()) instead of the packed one.
+ *
+ * In aligned logs, the \ref UB_HEADER_FLAG_ALIGNED flag is set in the file
+ * header, and each log entry block is preceded by a padding block when
+ * needed so its payload starts at a file offset that is a multiple of
+ * \ref UB_ROW_ALIGNMENT. Readers that map the file into memory can then
+ * access the values of the columns in place with aligned loads. This
+ * requires a file that supports \c ftell().
+ *
+ * The aligned layout is supported only if all the columns of the log have
+ * fixed-width data types and the writer uses \c UB_CODEC_RAW. This may only
+ * be called before the file header is written.
+ *
+ * \param  writer   the log writer
+ * \param  aligned  whether to use the aligned row layout
+ * \return \c UB_SUCCESS, \c UB_EINVAL if the file header or rows have been
+ *         written already, \c UB_EUNSUPPORTED if the columns or the codec
+ *         of the writer do not meet the requirements above
+ */
+ub_error_t ub_log_writer_set_aligned(ub_log_writer_t* writer,
+        ub_bool_t aligned);
+
+/**
+ * Sets whether the writer maintains a block index (see
+ * \ref ub_block_index_t) and writes it at the end of the file when it is
+ * closed, allowing readers to seek to any row or time without scanning the
+ * file. This requires a file that supports \c ftell(). This may only be
+ * called before the file header is written.
+ *
+ * \param  writer   the log writer
+ * \param  indexed  whether to maintain a block index
+ * \return \c UB_SUCCESS or \c UB_EINVAL if the file header has been written
+ *         already
+ */
+ub_error_t ub_log_writer_set_index(ub_log_writer_t* writer, ub_bool_t indexed);
+
+/**
+ * Sets the column that holds the timestamps of the rows. The block index
+ * records the timestamps of the first and the last row of each block, which
+ * must never decrease. This may only be called before the file header is
+ * written.
+ *
+ * \param  writer  the log writer
+ * \param  column  the index of the column, or
+ *                 \ref UB_BLOCK_INDEX_NO_TIMESTAMP to unset it. The column
+ *                 must have an integer or timestamp data type (see
+ *                 \ref ub_byteorder_decode_int64()).
+ * \return \c UB_SUCCESS, \c UB_EINVAL if the column index is out of range
+ *         or the file header has been written already, or
+ *         \c UB_EUNSUPPORTED if the column does not have a suitable type
+ */
+ub_error_t ub_log_writer_set_timestamp_column(ub_log_writer_t* writer,
+        size_t column);
+
+/**
+ * Sets whether the writer writes a zone map block (see \ref ub_zone_map_t)
+ * before each log entry block, recording the smallest and largest value of
+ * each numeric column in the block. Readers use them to skip blocks that
+ * cannot match their filters (see \ref ub_log_reader_add_filter()). This
+ * may only be called before the file header is written.
+ *
+ * \param  writer     the log writer
+ * \param  zone_maps  whether to write zone map blocks
+ * \return \c UB_SUCCESS or \c UB_EINVAL if the file header has been written
+ *         already
+ */
+ub_error_t ub_log_writer_set_zone_maps(ub_log_writer_t* writer,
+        ub_bool_t zone_maps);
+
+/**
+ * Makes the writer write a Bloom filter of the given column for each log
+ * entry block, in a Bloom filter block right before the log entry block.
+ * Readers use them to skip blocks that cannot contain the values they look
+ * for (see \ref ub_log_reader_add_key()). This is most useful for columns
+ * with many distinct values, like identifiers, where the zone maps of
+ * \ref ub_log_writer_set_zone_maps() do not help. This may only be called
+ * before the file header is written.
+ *
+ * \param  writer  the log writer
+ * \param  column  the index of the column
+ * \return \c UB_SUCCESS, \c UB_EINVAL if the column index is out of range
+ *         or the file header has been written already, or \c UB_ENOMEM
+ */
+ub_error_t ub_log_writer_add_bloom_filter(ub_log_writer_t* writer,
+        size_t column);
+
+/**
+ * Makes the writer write a sync block (see \ref ub_write_sync_block())
+ * before the first log entry block that starts at least \p interval bytes
+ * after the previous sync block. Sync blocks hold a long magic pattern,
+ * the file offset of the log header block and the number of the next row,
+ * so readers that start at an arbitrary offset can find the next block
+ * boundary and the row number without trying each offset (see
+ * \ref ub_log_reader_seek_sync()). This requires a file that supports
+ * \c ftell(). This may only be called before the file header is written.
+ *
+ * \param  writer    the log writer
+ * \param  interval  the minimum number of bytes between sync blocks, or
+ *                   zero to disable sync blocks
+ * \return \c UB_SUCCESS, \c UB_EINVAL if the file header has been written
+ *         already or \c UB_EUNSUPPORTED if the writer appends to a log whose
+ *         number of rows is unknown (see \ref ub_log_writer_init_append())
+ */
+ub_error_t ub_log_writer_set_sync_interval(ub_log_writer_t* writer,
+        uint64_t interval);
+
+/**
+ * Adds a row to the log. The row is written into the file when the current
+ * log entry block fills up, or when the writer is flushed or closed.
+ *
+ * \param  writer  the log writer
+ * \param  row     pointer to the row, i.e. the concatenation of the values
+ *                 of the columns, as written by a \ref ub_buffer_writer_t.
+ *                 The values must be in the byte order of the writer (see
+ *                 \ref ub_log_writer_set_byte_order()) and laid out
+ *                 according to the row layout of the writer, including
+ *                 padding (see \ref ub_log_writer_set_aligned()).
+ * \param  length  the length of the row in bytes
+ * \return \c UB_SUCCESS, \c UB_EINVAL if the length of the row does not
+ *         match the columns of the log, \c UB_ETOOLONG if the row does not
+ *         fit into a single block, or another error code
+ */
+ub_error_t ub_log_writer_write_row(ub_log_writer_t* writer, const void* row,
+        size_t length);
+
+/**
+ * Adds multiple rows to the log, given as one array of native values per
+ * column.
+ *
+ * Each array is converted into the byte order of the writer in batches with
+ * \ref ub_byteorder_encode_column() and transposed into the rows of the
+ * current log entry block; full blocks are written into the file along the
+ * way. The result is the same as adding the rows one by one with
+ * \ref ub_log_writer_write_row().
+ *
+ * This is supported only if all the columns of the log have fixed-width data
+ * types that have a native array representation, i.e. anything except
+ * strings, blobs and \c UB_DATATYPE_TIMEVAL.
+ *
+ * \param  writer    the log writer
+ * \param  values    array holding a pointer to the values of each column.
+ *                   The values of each column must be stored as an array of
+ *                   the native C type of the column (see
+ *                   \ref ub_typeinfo_t.c_name) with \p num_rows elements.
+ * \param  num_rows  the number of rows to add
+ * \return \c UB_SUCCESS, \c UB_EUNSUPPORTED if the columns of the log do
+ *         not meet the requirements above, \c UB_ETOOLONG if a single row
+ *         does not fit into a block, or another error code
+ */
+ub_error_t ub_log_writer_write_columns(ub_log_writer_t* writer,
+        const void* const* values, size_t num_rows);
+
+UB_END_DECLS
+
+#endif
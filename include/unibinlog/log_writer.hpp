@@ -0,0 +1,320 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_LOG_WRITER_HPP
+#define UNIBINLOG_LOG_WRITER_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <utility>
+
+#include <unibinlog/error.hpp>
+#include <unibinlog/log_writer.h>
+#include <unibinlog/types.hpp>
+
+namespace unibinlog {
+
+/**
+ * Typed C++ wrapper around \ref ub_log_writer_t with a schema that is fixed
+ * at compile time.
+ *
+ * The column types of the log are given as template arguments; each of them
+ * must have a \ref datatype_traits specialization. The column list, the
+ * length of a row and the offset of each column within a row are all
+ * derived at compile time, so writing a row boils down to a fixed sequence
+ * of byte-swapping stores into a stack-allocated row, without any runtime
+ * dispatch on data types.
+ *
+ * This header requires C++17.
+ */
+template <typename... Ts>
+class log_writer {
+public:
+    /** The compile-time description of the rows of the log */
+    typedef schema<Ts...> schema_type;
+
+    /**
+     * The compile-time description of the rows of the log when it uses the
+     * aligned layout
+     */
+    typedef aligned_schema<Ts...> aligned_schema_type;
+
+    /** The number of columns in the log */
+    static constexpr std::size_t num_columns = schema_type::num_columns;
+
+    /** The length of a single row in bytes */
+    static constexpr std::size_t row_length = schema_type::row_length;
+
+    /** The data types of the columns */
+    static constexpr const std::array<ub_datatype_t, num_columns>& types =
+        schema_type::types;
+
+    /** The offsets of the columns within a row */
+    static constexpr const std::array<std::size_t, num_columns>& offsets =
+        schema_type::offsets;
+
+    /**
+     * Creates a log writer that writes into the given file.
+     *
+     * \param  f            the file to write into. It is not owned by the
+     *                      writer; it must be kept open until the writer is
+     *                      closed.
+     * \param  names        the names of the columns
+     * \param  chksum_type  the checksum type to use for each block in the file
+     */
+    log_writer(FILE* f, const std::array<const char*, num_columns>& names,
+            ub_chksum_type_t chksum_type = UB_CHKSUM_FLETCHER_16)
+        : state_(new state(f, names, chksum_type)) {}
+
+    log_writer(log_writer&&) noexcept = default;
+
+    log_writer& operator=(log_writer&& other) noexcept {
+        if (this != &other) {
+            close_quietly();
+            state_ = std::move(other.state_);
+        }
+        return *this;
+    }
+
+    /**
+     * Destroys the writer. Rows that have not been written yet are written
+     * into the file unless the writer was closed already; errors are ignored.
+     * Call \ref close() explicitly if you need to know about them.
+     */
+    ~log_writer() {
+        close_quietly();
+    }
+
+    /**
+     * Writes all the rows that have not been written yet into the file.
+     * The file itself is not closed.
+     */
+    void close() {
+        check(ub_log_writer_close(&state_->writer));
+        state_->closed = true;
+    }
+
+    /**
+     * Writes all the rows that have not been written yet into a new log
+     * entry block.
+     */
+    void flush() {
+        check(ub_log_writer_flush(&state_->writer));
+    }
+
+    /**
+     * Writes all the rows that have not been written yet and waits until
+     * they are stored on the disk. See \ref ub_log_writer_sync().
+     */
+    void sync() {
+        check(ub_log_writer_sync(&state_->writer));
+    }
+
+    /**
+     * Sets the durability policy of the writer.
+     * See \ref ub_log_writer_set_durability().
+     */
+    void set_durability(ub_durability_t policy, std::uint64_t param = 0) {
+        check(ub_log_writer_set_durability(&state_->writer, policy, param));
+    }
+
+    /**
+     * Returns the underlying C log writer.
+     */
+    ub_log_writer_t* native() noexcept {
+        return &state_->writer;
+    }
+
+    /**
+     * Sets the maximum payload length of the log entry blocks written by the
+     * writer. See \ref ub_log_writer_set_block_length().
+     */
+    void set_block_length(std::size_t length) {
+        check(ub_log_writer_set_block_length(&state_->writer, length));
+    }
+
+    /**
+     * Sets the codec used to encode the columns of the log entry blocks
+     * written by the writer. See \ref ub_log_writer_set_codec().
+     */
+    void set_codec(ub_codec_t codec, std::size_t sample_size = 0) {
+        check(ub_log_writer_set_codec(&state_->writer, codec, sample_size));
+    }
+
+    /**
+     * Sets the byte order of the values in the log entry blocks written by
+     * the writer. See \ref ub_log_writer_set_byte_order().
+     */
+    void set_byte_order(ub_byte_order_t order) {
+        check(ub_log_writer_set_byte_order(&state_->writer, order));
+    }
+
+    /**
+     * Sets whether the rows written by the writer use the aligned layout.
+     * See \ref ub_log_writer_set_aligned().
+     */
+    void set_aligned(bool aligned) {
+        check(ub_log_writer_set_aligned(&state_->writer, aligned));
+    }
+
+    /**
+     * Sets whether the writer writes a block index at the end of the file.
+     * See \ref ub_log_writer_set_index().
+     */
+    void set_index(bool indexed) {
+        check(ub_log_writer_set_index(&state_->writer, indexed));
+    }
+
+    /**
+     * Sets the column that holds the timestamps of the rows.
+     * See \ref ub_log_writer_set_timestamp_column().
+     */
+    void set_timestamp_column(std::size_t column) {
+        check(ub_log_writer_set_timestamp_column(&state_->writer, column));
+    }
+
+    /**
+     * Sets whether the writer writes a zone map before each log entry
+     * block. See \ref ub_log_writer_set_zone_maps().
+     */
+    void set_zone_maps(bool zone_maps) {
+        check(ub_log_writer_set_zone_maps(&state_->writer, zone_maps));
+    }
+
+    /**
+     * Makes the writer write a Bloom filter of the given column for each
+     * log entry block. See \ref ub_log_writer_add_bloom_filter().
+     */
+    void add_bloom_filter(std::size_t column) {
+        check(ub_log_writer_add_bloom_filter(&state_->writer, column));
+    }
+
+    /**
+     * Sets the minimum number of bytes between sync blocks, or zero to
+     * disable them. See \ref ub_log_writer_set_sync_interval().
+     */
+    void set_sync_interval(std::uint64_t interval) {
+        check(ub_log_writer_set_sync_interval(&state_->writer, interval));
+    }
+
+    /**
+     * Adds a row to the log.
+     *
+     * \param  values  the values of the columns in the row
+     */
+    void write(const Ts&... values) {
+        if (state_->writer.aligned) {
+            write_as<aligned_schema_type>(values...);
+        } else {
+            write_as<schema_type>(values...);
+        }
+    }
+
+    /**
+     * Adds multiple rows to the log, given as one array per column. See
+     * \ref ub_log_writer_write_columns().
+     *
+     * \param  num_rows  the number of rows to add
+     * \param  columns   pointers to arrays of \p num_rows values, one for
+     *                   each column
+     */
+    void write_columns(std::size_t num_rows, const Ts*... columns) {
+        static_assert(((sizeof(Ts) == datatype_traits<Ts>::length) && ...),
+                "the in-memory representation of each column type must "
+                "match its representation in the log");
+
+        const void* values[] = { columns... };
+        check(ub_log_writer_write_columns(&state_->writer, values, num_rows));
+    }
+
+    /**
+     * Encodes a row into the given memory area in the format expected by
+     * \ref ub_log_writer_write_row().
+     *
+     * The values are encoded in network byte order and the packed row
+     * layout unless another byte order or an \ref aligned_schema_type is
+     * given as a template argument. Padding bytes are left untouched.
+     *
+     * \param  row     pointer to a memory area of at least
+     *                 \c Schema::row_length bytes
+     * \param  values  the values of the columns in the row
+     */
+    template <ub_byte_order_t Order = UB_BIG_ENDIAN,
+              typename Schema = schema_type>
+    static void encode(std::uint8_t* row, const Ts&... values) noexcept {
+        encode_impl<Order, Schema>(row, std::index_sequence_for<Ts...>(),
+                values...);
+    }
+
+private:
+    void close_quietly() noexcept {
+        if (state_ && !state_->closed) {
+            ub_log_writer_close(&state_->writer);
+            state_->closed = true;
+        }
+    }
+
+    template <typename Schema>
+    void write_as(const Ts&... values) {
+        std::array<std::uint8_t, Schema::row_length> row {};
+        if (state_->writer.byte_order == UB_LITTLE_ENDIAN) {
+            encode<UB_LITTLE_ENDIAN, Schema>(row.data(), values...);
+        } else {
+            encode<UB_BIG_ENDIAN, Schema>(row.data(), values...);
+        }
+        check(ub_log_writer_write_row(&state_->writer, row.data(),
+                    Schema::row_length));
+    }
+
+    template <ub_byte_order_t Order, typename Schema, std::size_t... Is>
+    static void encode_impl(std::uint8_t* row, std::index_sequence<Is...>,
+            const Ts&... values) noexcept {
+        (datatype_traits<Ts>::template store<Order>(row + Schema::offsets[Is],
+                values), ...);
+    }
+
+    /**
+     * The state of the writer. It is kept on the heap because the C writer
+     * refers to the column array, which therefore must not move when the
+     * C++ writer is moved.
+     */
+    struct state {
+        std::array<ub_log_column_t, num_columns> columns;
+        ub_log_writer_t writer;
+        bool closed = false;
+
+        state(FILE* f, const std::array<const char*, num_columns>& names,
+                ub_chksum_type_t chksum_type) {
+            std::size_t i;
+            ub_error_t retval = UB_SUCCESS;
+
+            for (i = 0; i < num_columns && retval == UB_SUCCESS; i++) {
+                retval = ub_log_column_init(&columns[i], names[i], types[i]);
+            }
+            if (retval == UB_SUCCESS) {
+                retval = ub_log_writer_init(&writer, f, columns.data(),
+                        num_columns, chksum_type);
+            }
+            if (retval != UB_SUCCESS) {
+                ub_log_column_destroy_array(columns.data(), i);
+                throw error(retval);
+            }
+        }
+
+        ~state() {
+            ub_log_writer_destroy(&writer);
+            ub_log_column_destroy_array(columns.data(), num_columns);
+        }
+
+        state(const state&) = delete;
+        state& operator=(const state&) = delete;
+    };
+
+    std::unique_ptr<state> state_;
+};
+
+}
+
+#endif
@@ -10,8 +10,68 @@
 #include <unibinlog/chksum.h>
 #include <unibinlog/error.h>
 #include <unibinlog/log_column.h>
+#include <unibinlog/platform.h>
 #include <unibinlog/types.h>
 
+UB_BEGIN_DECLS
+
+/**
+ * \def UB_HEADER_FLAG_LITTLE_ENDIAN
+ *
+ * Flag in the file header declaring that the values in the log entry blocks
+ * of the file are stored in little-endian byte order instead of network byte
+ * order. Block headers, checksums, log header blocks and the length prefixes
+ * of blobs are not affected.
+ *
+ * Header flags are stored in the upper four bits of the checksum type byte
+ * of the file header, so readers that do not know about them reject such
+ * files as having an unknown checksum type instead of misinterpreting them.
+ */
+#define UB_HEADER_FLAG_LITTLE_ENDIAN 0x80
+
+/**
+ * \def UB_HEADER_FLAG_ALIGNED
+ *
+ * Flag in the file header declaring that the rows of the log entry blocks of
+ * the file use the aligned layout (see \ref ub_log_columns_get_layout()) and
+ * that the payload of each log entry block starts at a file offset that is a
+ * multiple of \ref UB_ROW_ALIGNMENT, which is achieved by writing padding
+ * blocks in front of them when needed.
+ */
+#define UB_HEADER_FLAG_ALIGNED 0x40
+
+/**
+ * \def UB_SYNC_MAGIC
+ *
+ * The magic pattern at the start of the payload of sync blocks
+ * (\c UB_BLOCK_SYNC); \ref UB_SYNC_MAGIC_LENGTH bytes long.
+ */
+#define UB_SYNC_MAGIC "UBSYNC\xE2\x9C\x93\x1F\xA7\x3D\xC8\x6B\x04\xB1"
+
+/**
+ * \def UB_SYNC_MAGIC_LENGTH
+ *
+ * The length of \ref UB_SYNC_MAGIC.
+ */
+#define UB_SYNC_MAGIC_LENGTH 16
+
+/**
+ * \def UB_SYNC_BLOCK_LENGTH
+ *
+ * The length of the payload of a sync block (\c UB_BLOCK_SYNC): the magic
+ * pattern, followed by the schema identifier and the row number of the
+ * next row, both on 8 bytes in network byte order.
+ */
+#define UB_SYNC_BLOCK_LENGTH (UB_SYNC_MAGIC_LENGTH + 16)
+
+/**
+ * \def UB_HEADER_FLAGS_MASK
+ *
+ * Mask of the bits in the checksum type byte of the file header that are
+ * used for header flags.
+ */
+#define UB_HEADER_FLAGS_MASK 0xF0
+
 /**
  * Writes a byte array into the given file.
  *
@@ -32,6 +92,20 @@ ub_error_t ub_write_byte_array(FILE* f, const void* array, size_t length);
  */
 ub_error_t ub_write_header(FILE* f, uint8_t version, ub_chksum_type_t chksum_type);
 
+/**
+ * Writes the header of an \c unibin log file with the given header flags
+ * into the given file.
+ *
+ * \param  f            the file to write into
+ * \param  version      the version number to write into the header
+ * \param  chksum_type  the checksum type that the file will use for each block
+ * \param  flags        the header flags, e.g. \ref UB_HEADER_FLAG_LITTLE_ENDIAN
+ * \return \c UB_SUCCESS, \c UB_EINVAL if \p flags has bits set outside
+ *         \ref UB_HEADER_FLAGS_MASK, or \c UB_EWRITE
+ */
+ub_error_t ub_write_header_with_flags(FILE* f, uint8_t version,
+        ub_chksum_type_t chksum_type, uint8_t flags);
+
 /**
  * Writes a \c unibin block with the given payload into the given file.
  *
@@ -73,6 +147,25 @@ ub_error_t ub_write_block_from_buffer(FILE* f, ub_block_type_t block_type,
 ub_error_t ub_write_comment_block(FILE* f, const char* comment,
         ub_chksum_type_t chksum_type);
 
+/**
+ * Writes a padding block into the given file if needed, such that the payload
+ * of the next block written after it starts at a file offset that is a
+ * multiple of the given alignment. Nothing is written if the payload of the
+ * next block would be aligned already.
+ *
+ * \param  f            the file to write into; it must support \c ftell()
+ * \param  alignment    the required alignment of the payload of the next
+ *                      block; at most 256
+ * \param  chksum_type  the checksum type at the end of the block (if any).
+ *                      This must match the checksum type specified in the
+ *                      header of the \c unibin file
+ * \return \c UB_SUCCESS, \c UB_EINVAL if the alignment is invalid,
+ *         \c UB_EUNSUPPORTED if the position of the file cannot be
+ *         determined or an error code from the write operation
+ */
+ub_error_t ub_write_padding_block(FILE* f, size_t alignment,
+        ub_chksum_type_t chksum_type);
+
 /**
  * Writes a log header block containing the given columns into the given
  * file.
@@ -88,5 +181,165 @@ ub_error_t ub_write_comment_block(FILE* f, const char* comment,
 ub_error_t ub_write_log_header_block(FILE* f, ub_log_column_t* columns,
         size_t num_columns, ub_chksum_type_t chksum_type);
 
+/**
+ * Writes a sync block into the given file. Sync blocks let readers that
+ * start at an arbitrary file offset find the next block boundary and the
+ * current row number quickly; see \ref ub_find_sync_block().
+ *
+ * \param  f            the file to write into
+ * \param  schema_id    the identifier of the columns of the log. Log writers
+ *                      use the file offset of the log header block that
+ *                      defines the columns.
+ * \param  row          the row number of the first row after the block
+ * \param  chksum_type  the checksum type at the end of the block (if any).
+ *                      This must match the checksum type specified in the
+ *                      header of the \c unibin file
+ * \return \c UB_SUCCESS or an error code from the write operation
+ */
+ub_error_t ub_write_sync_block(FILE* f, uint64_t schema_id, uint64_t row,
+        ub_chksum_type_t chksum_type);
+
+/**
+ * Writes the buffered data of the given file to the disk and waits until
+ * it is stored durably, using \c fdatasync() or \c fsync(). Streams that
+ * are not backed by a file descriptor (e.g. memory streams and custom
+ * streams) are only flushed, and cannot be synced.
+ *
+ * \param  f  the file to sync
+ * \return \c UB_SUCCESS, \c UB_EWRITE if the data could not be written or
+ *         \c UB_EUNSUPPORTED if the stream has no file descriptor or the
+ *         platform cannot sync files
+ */
+ub_error_t ub_sync_file(FILE* f);
+
+/**
+ * Reads the header of an \c unibin log file from the given file.
+ *
+ * \param  f            the file to read from
+ * \param  version      the version number found in the header will be
+ *                      returned here if it is not null
+ * \param  chksum_type  the checksum type used by the blocks of the file will
+ *                      be returned here if it is not null
+ * \return \c UB_SUCCESS, \c UB_EPARSE if the file is not a \c unibin file,
+ *         \c UB_EOF or \c UB_EREAD if the header could not be read
+ *
+ * Header flags are stripped from the checksum type; use
+ * \ref ub_read_header_with_flags() if you need them.
+ */
+ub_error_t ub_read_header(FILE* f, uint8_t* version, ub_chksum_type_t* chksum_type);
+
+/**
+ * Reads the header of an \c unibin log file, including the header flags,
+ * from the given file.
+ *
+ * \param  f            the file to read from
+ * \param  version      the version number found in the header will be
+ *                      returned here if it is not null
+ * \param  chksum_type  the checksum type used by the blocks of the file will
+ *                      be returned here if it is not null
+ * \param  flags        the header flags will be returned here if it is not
+ *                      null
+ * \return \c UB_SUCCESS, \c UB_EPARSE if the file is not a \c unibin file,
+ *         \c UB_EOF or \c UB_EREAD if the header could not be read
+ */
+ub_error_t ub_read_header_with_flags(FILE* f, uint8_t* version,
+        ub_chksum_type_t* chksum_type, uint8_t* flags);
+
+/**
+ * Parses the header of an \c unibin log file, including the header flags,
+ * from the given memory area, e.g. a memory-mapped file.
+ *
+ * \param  data         the memory area to parse
+ * \param  size         the size of the memory area
+ * \param  version      the version number found in the header will be
+ *                      returned here if it is not null
+ * \param  chksum_type  the checksum type used by the blocks of the file will
+ *                      be returned here if it is not null
+ * \param  flags        the header flags will be returned here if it is not
+ *                      null
+ * \return \c UB_SUCCESS, \c UB_EOF if the memory area is empty or
+ *         \c UB_EPARSE if it does not start with an \c unibin header
+ */
+ub_error_t ub_parse_header(const void* data, size_t size, uint8_t* version,
+        ub_chksum_type_t* chksum_type, uint8_t* flags);
+
+/**
+ * Parses the \c unibin block at the start of the given memory area and
+ * validates its checksum without copying the payload.
+ *
+ * \param  data         the memory area to parse
+ * \param  size         the size of the memory area
+ * \param  block_type   the type of the block will be returned here
+ * \param  payload      pointer to the payload of the block will be returned
+ *                      here
+ * \param  length       the length of the payload will be returned here
+ * \param  chksum_type  the checksum type at the end of the block (if any).
+ *                      This must match the checksum type specified in the
+ *                      header of the \c unibin file
+ * \return \c UB_SUCCESS, \c UB_EOF if the memory area is empty or
+ *         \c UB_EPARSE if the block is truncated or its checksum does not
+ *         match. The whole block, including its header and checksum, is
+ *         <code>3 + length + ub_chksum_size(chksum_type)</code> bytes long.
+ */
+ub_error_t ub_parse_block(const void* data, size_t size,
+        ub_block_type_t* block_type, const uint8_t** payload, size_t* length,
+        ub_chksum_type_t chksum_type);
+
+/**
+ * Finds the first sync block (\c UB_BLOCK_SYNC) in the given memory area
+ * by looking for its block header and magic pattern, and validates its
+ * checksum.
+ *
+ * \param  data         the memory area to search
+ * \param  size         the size of the memory area
+ * \param  chksum_type  the checksum type of the blocks
+ * \param  offset       the offset of the sync block within the memory area
+ *                      will be returned here
+ * \param  schema_id    the schema identifier stored in the block will be
+ *                      returned here if it is not null
+ * \param  row          the row number stored in the block will be returned
+ *                      here if it is not null
+ * \return \c UB_SUCCESS or \c UB_EOF if the memory area contains no
+ *         complete sync block
+ */
+ub_error_t ub_find_sync_block(const void* data, size_t size,
+        ub_chksum_type_t chksum_type, size_t* offset, uint64_t* schema_id,
+        uint64_t* row);
+
+/**
+ * Reads the next \c unibin block from the given file.
+ *
+ * \param  f            the file to read from
+ * \param  block_type   the type of the block will be returned here
+ * \param  payload      the buffer that will hold the payload of the block.
+ *                      It will be resized to the exact size of the payload.
+ * \param  chksum_type  the checksum type at the end of the block (if any).
+ *                      This must match the checksum type specified in the
+ *                      header of the \c unibin file
+ * \return \c UB_SUCCESS, \c UB_EOF if there are no more blocks in the file,
+ *         \c UB_EREAD if the block is truncated or \c UB_EPARSE if its
+ *         checksum does not match
+ */
+ub_error_t ub_read_block(FILE* f, ub_block_type_t* block_type,
+        ub_buffer_t* payload, ub_chksum_type_t chksum_type);
+
+/**
+ * Skips the next \c unibin block in the given file without reading its
+ * payload into memory. The checksum of the block is not validated and a
+ * truncated block is not detected if the file supports seeking.
+ *
+ * \param  f            the file to read from
+ * \param  block_type   the type of the skipped block will be returned here
+ * \param  chksum_type  the checksum type at the end of the block (if any).
+ *                      This must match the checksum type specified in the
+ *                      header of the \c unibin file
+ * \return \c UB_SUCCESS, \c UB_EOF if there are no more blocks in the file
+ *         or \c UB_EREAD if the block is truncated
+ */
+ub_error_t ub_skip_block(FILE* f, ub_block_type_t* block_type,
+        ub_chksum_type_t chksum_type);
+
+UB_END_DECLS
+
 #endif
 
@@ -6,15 +6,118 @@
 #include <memory.h>
 #include <stdlib.h>
 
+#include <unibinlog/error.h>
+#include <unibinlog/platform.h>
+
+UB_BEGIN_DECLS
+
+/**
+ * Structure that describes a memory allocator, i.e. a set of functions
+ * that the library uses for all its heap memory: buffers, columns and
+ * their names, indexes and scratch memory. Each function receives the
+ * \c context pointer as its last argument.
+ *
+ * The functions must behave like their C library counterparts; in
+ * particular, \c realloc must accept a null pointer and \c free must
+ * accept a null pointer. \c calloc may be null, in which case \c malloc is
+ * used and the memory is zeroed by the library.
+ */
+typedef struct {
+    void* (*malloc)(size_t size, void* context);                 /**< Allocates memory */
+    void* (*calloc)(size_t count, size_t size, void* context);   /**< Allocates zeroed memory; may be null */
+    void* (*realloc)(void* ptr, size_t size, void* context);     /**< Resizes memory */
+    void (*free)(void* ptr, void* context);                      /**< Frees memory */
+    void* context;                 /**< Pointer passed to the functions, e.g. an arena or a counter */
+} ub_allocator_t;
+
+/**
+ * Sets the memory allocator of the library. The allocator is copied.
+ *
+ * The allocator is global and it is not synchronized, so it must be set
+ * before the library is used, typically at the start of the program, and
+ * memory allocated by one allocator must not outlive it: objects created
+ * before the allocator is changed must be destroyed before. The idle
+ * buffers of the shared buffer pool are freed before the allocator is
+ * replaced.
+ *
+ * \param  allocator  the allocator, or null to use the C library again
+ * \return \c UB_SUCCESS or \c UB_EINVAL if \c malloc, \c realloc or
+ *         \c free is missing
+ */
+ub_error_t ub_memory_set_allocator(const ub_allocator_t* allocator);
+
+/**
+ * Returns the memory allocator of the library.
+ *
+ * \return the allocator; the C library unless another one was set
+ */
+const ub_allocator_t* ub_memory_get_allocator(void);
+
+/**
+ * Allocates zeroed memory for an array with the allocator of the library.
+ *
+ * \param  count  the number of elements
+ * \param  size   the size of an element
+ * \return the memory or null if there is not enough memory
+ */
+void* ub_memory_calloc(size_t count, size_t size);
+
+/**
+ * Resizes memory allocated by the allocator of the library.
+ *
+ * \param  ptr   the memory; may be null
+ * \param  size  the new size
+ * \return the memory or null if there is not enough memory, in which case
+ *         \p ptr is left alone
+ */
+void* ub_memory_realloc(void* ptr, size_t size);
+
+/**
+ * Frees memory allocated by the allocator of the library.
+ *
+ * \param  ptr  the memory; may be null
+ */
+void ub_memory_free(void* ptr);
+
+/**
+ * Copies a string into memory allocated by the allocator of the library.
+ *
+ * \param  str  the string
+ * \return the copy or null if there is not enough memory
+ */
+char* ub_memory_strdup(const char* str);
+
+/**
+ * Allocates memory whose address is a multiple of the given alignment,
+ * e.g. for direct I/O, with the allocator of the library. The memory is
+ * not zeroed.
+ *
+ * \param  alignment  the alignment; a power of two
+ * \param  size       the size of the memory
+ * \return the memory, which must be freed with
+ *         \ref ub_memory_aligned_free(), or null if there is not enough
+ *         memory
+ */
+void* ub_memory_aligned_alloc(size_t alignment, size_t size);
+
+/**
+ * Frees memory allocated by \ref ub_memory_aligned_alloc().
+ *
+ * \param  ptr  the memory; may be null
+ */
+void ub_memory_aligned_free(void* ptr);
+
+UB_END_DECLS
+
 /**
  * Friendlier form of calloc.
  */
-#define ub_calloc(type, count) ((type*)calloc(count, sizeof(type)))
+#define ub_calloc(type, count) ((type*)ub_memory_calloc(count, sizeof(type)))
 
 /**
  * Macro that frees a pointer and resets it to null.
  */
-#define ub_free(ptr) { free(ptr); ptr = 0; }
+#define ub_free(ptr) { ub_memory_free(ptr); ptr = 0; }
 
 /**
  * Macro that frees a pointer unless it is to null.
@@ -24,7 +127,6 @@
 /**
  * Friendlier form of realloc.
  */
-#define ub_realloc(ptr, type, count) ((type*)realloc(ptr, sizeof(type) * count))
+#define ub_realloc(ptr, type, count) ((type*)ub_memory_realloc(ptr, sizeof(type) * count))
 
 #endif
-
@@ -3,5 +3,25 @@
 #ifndef UNIBINLOG_PLATFORM_H
 #define UNIBINLOG_PLATFORM_H
 
+/**
+ * \def UB_BEGIN_DECLS
+ *
+ * Opens a block of declarations that must have C linkage when the header is
+ * included from C++ code.
+ */
+
+/**
+ * \def UB_END_DECLS
+ *
+ * Closes a block of declarations opened by \ref UB_BEGIN_DECLS.
+ */
+
+#ifdef __cplusplus
+#  define UB_BEGIN_DECLS extern "C" {
+#  define UB_END_DECLS }
+#else
+#  define UB_BEGIN_DECLS
+#  define UB_END_DECLS
 #endif
 
+#endif
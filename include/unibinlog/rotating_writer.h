@@ -0,0 +1,177 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_ROTATING_WRITER_H
+#define UNIBINLOG_ROTATING_WRITER_H
+
+#include <stdio.h>
+
+#include <unibinlog/basic_types.h>
+#include <unibinlog/chksum.h>
+#include <unibinlog/error.h>
+#include <unibinlog/log_column.h>
+#include <unibinlog/log_writer.h>
+#include <unibinlog/platform.h>
+
+UB_BEGIN_DECLS
+
+/**
+ * Function called by a \ref ub_rotating_writer_t for the log writer of each
+ * new file, before any rows are written into it, to configure it (e.g.
+ * with \ref ub_log_writer_set_codec() or \ref ub_log_writer_set_index()).
+ *
+ * \param  writer     the log writer of the new file
+ * \param  user_data  the pointer given to
+ *                    \ref ub_rotating_writer_set_setup_func()
+ * \return \c UB_SUCCESS or an error code that is returned from the call
+ *         that opened the file
+ */
+typedef ub_error_t ub_rotating_writer_setup_func_t(ub_log_writer_t* writer,
+        void* user_data);
+
+/**
+ * Structure that stores the state information of a \em rotating writer,
+ * i.e. a log writer that writes into a series of files and moves on to
+ * the next file when the current one grows too large or too old.
+ *
+ * The files are named after a prefix, a sequence number of six or more
+ * digits and a suffix, e.g. \c log-000042.ubl. Each file is a complete
+ * \c unibin log with its own file header and log header block, and the row
+ * numbers start from zero in each file.
+ *
+ * Files are only switched at block boundaries, so a file may exceed the
+ * size limit by up to one block. While a file is being written, the next
+ * file is created and its disk space is reserved on a background thread
+ * (if the library was built with thread support), and the previous file is
+ * closed there, so switching to the next file only costs the hot path the
+ * closing of the log writer. The next file, which is empty, is removed
+ * when the rotating writer is closed.
+ *
+ * Existing files are never overwritten: if the path of a file exists
+ * already, starting the file fails with \c UB_EWRITE.
+ */
+typedef struct {
+    char* prefix;                  /**< The path of the files up to the sequence number; owned by the writer */
+    char* suffix;                  /**< The path of the files after the sequence number; owned by the writer */
+    ub_log_column_t* columns;      /**< The columns of the log; not owned by the writer */
+    size_t num_columns;            /**< The number of columns of the log */
+    ub_chksum_type_t chksum_type;  /**< The checksum type of the blocks in the files */
+    uint64_t max_bytes;            /**< The size after which the next file is started; zero if unlimited */
+    uint64_t max_age;              /**< The time in milliseconds after which the next file is started; zero if unlimited */
+    ub_rotating_writer_setup_func_t* setup_func; /**< Function that configures the log writer of each file; may be null */
+    void* user_data;               /**< User data passed to \c setup_func */
+    uint64_t index;                /**< The sequence number of the current file */
+    char* path;                    /**< The path of the current file; null if no file has been opened yet */
+    FILE* file;                    /**< The current file; null if no file has been opened yet */
+    ub_log_writer_t writer;        /**< The log writer of the current file */
+    uint64_t opened_at;            /**< Time when the current file was started on a monotonic clock, in milliseconds */
+    uint64_t rows_checked;         /**< The number of rows written into the current file when the limits were last checked */
+    void* next;                    /**< The preparation of the next file; opaque */
+} ub_rotating_writer_t;
+
+/**
+ * Initializes a rotating writer. No file is opened until the first row is
+ * written.
+ *
+ * \param  writer       the rotating writer to initialize
+ * \param  prefix       the path of the files up to the sequence number; it
+ *                      is copied
+ * \param  suffix       the path of the files after the sequence number; it
+ *                      is copied
+ * \param  first_index  the sequence number of the first file
+ * \param  columns      pointer to an array containing the columns of the log.
+ *                      The array is not copied; it must not be modified or
+ *                      destroyed until the writer is destroyed.
+ * \param  num_columns  the number of columns
+ * \param  chksum_type  the checksum type to use for each block in the files
+ * \return \c UB_SUCCESS or \c UB_ENOMEM
+ */
+ub_error_t ub_rotating_writer_init(ub_rotating_writer_t* writer,
+        const char* prefix, const char* suffix, uint64_t first_index,
+        ub_log_column_t* columns, size_t num_columns,
+        ub_chksum_type_t chksum_type);
+
+/**
+ * Destroys a rotating writer. Rows that have not been written yet are
+ * discarded; call \ref ub_rotating_writer_close() first if you need them.
+ *
+ * \param  writer  the rotating writer to destroy
+ */
+void ub_rotating_writer_destroy(ub_rotating_writer_t* writer);
+
+/**
+ * Sets the limits after which the writer moves on to the next file. The
+ * limits are checked whenever a log entry block is written.
+ *
+ * \param  writer     the rotating writer
+ * \param  max_bytes  the size of a file after which the next file is
+ *                    started, or zero for no size limit. The disk space of
+ *                    the next file is reserved up to this size in advance.
+ * \param  max_age    the number of milliseconds after which the next file
+ *                    is started, or zero for no time limit
+ * \return \c UB_SUCCESS
+ */
+ub_error_t ub_rotating_writer_set_limits(ub_rotating_writer_t* writer,
+        uint64_t max_bytes, uint64_t max_age);
+
+/**
+ * Sets the function that configures the log writer of each file. This
+ * should be called before the first row is written.
+ *
+ * \param  writer      the rotating writer
+ * \param  setup_func  the function to call, or null
+ * \param  user_data   pointer passed to the function
+ * \return \c UB_SUCCESS
+ */
+ub_error_t ub_rotating_writer_set_setup_func(ub_rotating_writer_t* writer,
+        ub_rotating_writer_setup_func_t* setup_func, void* user_data);
+
+/**
+ * Adds a row to the log, opening the first file if needed and moving on to
+ * the next file if the current one reached one of the limits. See
+ * \ref ub_log_writer_write_row().
+ *
+ * \param  writer  the rotating writer
+ * \param  row     pointer to the row
+ * \param  length  the length of the row
+ * \return \c UB_SUCCESS or an error code
+ */
+ub_error_t ub_rotating_writer_write_row(ub_rotating_writer_t* writer,
+        const void* row, size_t length);
+
+/**
+ * Writes all the rows that have not been written yet into a new log entry
+ * block of the current file, moving on to the next file afterwards if the
+ * current one reached one of the limits.
+ *
+ * \param  writer  the rotating writer
+ * \return \c UB_SUCCESS or an error code
+ */
+ub_error_t ub_rotating_writer_flush(ub_rotating_writer_t* writer);
+
+/**
+ * Closes the current file and moves on to the next one regardless of the
+ * limits. Does nothing if no file has been opened yet. The files are closed
+ * in the background, so an error while closing a file is reported by the
+ * rotation or the \ref ub_rotating_writer_close() call after the one that
+ * closed it.
+ *
+ * \param  writer  the rotating writer
+ * \return \c UB_SUCCESS or the first error that occurred; the writer moves
+ *         on to the next file even if closing the current one failed, and
+ *         no file is open afterwards if the next file could not be created
+ *         (e.g. because it exists already)
+ */
+ub_error_t ub_rotating_writer_rotate(ub_rotating_writer_t* writer);
+
+/**
+ * Writes all the rows that have not been written yet, closes the current
+ * file and removes the next file that was prepared in advance.
+ *
+ * \param  writer  the rotating writer
+ * \return \c UB_SUCCESS or the first error that occurred
+ */
+ub_error_t ub_rotating_writer_close(ub_rotating_writer_t* writer);
+
+UB_END_DECLS
+
+#endif
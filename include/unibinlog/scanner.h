@@ -0,0 +1,181 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_SCANNER_H
+#define UNIBINLOG_SCANNER_H
+
+#include <unibinlog/basic_types.h>
+#include <unibinlog/buffer.h>
+#include <unibinlog/byteorder.h>
+#include <unibinlog/chksum.h>
+#include <unibinlog/error.h>
+#include <unibinlog/log_column.h>
+#include <unibinlog/platform.h>
+#include <unibinlog/types.h>
+
+UB_BEGIN_DECLS
+
+/**
+ * A single log entry block, as passed to a \ref ub_scan_block_func_t.
+ * All the pointers are valid only during the call.
+ */
+typedef struct {
+    size_t range;                  /**< Index of the byte range that the block belongs to */
+    uint64_t offset;               /**< File offset of the block */
+    const ub_log_column_t* columns; /**< The columns of the log */
+    size_t num_columns;            /**< The number of columns of the log */
+    const size_t* offsets;         /**< The offsets of the columns within a row; null if the rows have variable length */
+    size_t row_length;             /**< Length of a row, including padding; zero if the rows have variable length */
+    ub_byte_order_t byte_order;    /**< The byte order of the values in the rows */
+    const uint8_t* rows;           /**< The rows of the block, one after the other */
+    size_t rows_length;            /**< The total length of the rows */
+    size_t num_rows;               /**< The number of rows in the block */
+} ub_scan_block_t;
+
+/**
+ * Function called by \ref ub_scanner_run() for each log entry block of a
+ * byte range, in file order, with the state of the range.
+ *
+ * \param  block  the block
+ * \param  state  the state of the range of the block
+ * \return \c UB_SUCCESS to continue; any other value stops the scan of the
+ *         range and is returned from \ref ub_scanner_run()
+ */
+typedef ub_error_t ub_scan_block_func_t(const ub_scan_block_t* block,
+        void* state);
+
+/**
+ * Function called by \ref ub_scanner_run() to merge the state of a range
+ * into the state of the first range, after all the ranges were scanned.
+ * The ranges are merged in file order, so the function only needs to be
+ * associative.
+ *
+ * \param  state  the state of the first range, holding the results of all
+ *                the ranges before \p other
+ * \param  other  the state of the next range
+ * \return \c UB_SUCCESS or an error code that is returned from
+ *         \ref ub_scanner_run()
+ */
+typedef ub_error_t ub_scan_reduce_func_t(void* state, const void* other);
+
+/**
+ * Structure that stores the state information of a \em parallel
+ * \em scanner, i.e. an object that decodes the log entry blocks of a
+ * \c unibin log held in memory (typically a memory-mapped file) on
+ * multiple threads.
+ *
+ * The log is split into byte ranges of roughly equal length, and each
+ * range is scanned independently. Since the blocks of a range may start
+ * anywhere, the scanner first resynchronizes each range on the first sync
+ * block in it (see \ref ub_log_writer_set_sync_interval()), or on the
+ * first block boundary at or after its start if it has no sync block (see
+ * \ref ub_scanner_find_block()). A range then owns the blocks from there
+ * up to the block where the next range was resynchronized, and the scanner
+ * walks their block headers. Boundaries found by resynchronization that
+ * disagree with the end of the preceding range are false positives, and
+ * are replaced by the boundary where the preceding range ended, so every
+ * block is decoded exactly once. Then the ranges are decoded in parallel.
+ *
+ * The columns of the log are taken from its first log header block. Log
+ * header blocks later in the log must have the same columns.
+ *
+ * \ref ub_scanner_run() tells the kernel with \c madvise() that the memory
+ * area of the log is read sequentially, so memory-mapped logs are read
+ * ahead aggressively.
+ */
+typedef struct {
+    const uint8_t* data;           /**< The log, including the file header */
+    size_t size;                   /**< The length of the log */
+    ub_chksum_type_t chksum_type;  /**< The checksum type of the blocks in the log */
+    ub_byte_order_t byte_order;    /**< The byte order of the values in the log entry blocks */
+    ub_bool_t aligned;             /**< Whether the rows use the aligned layout */
+    ub_log_column_t* columns;      /**< The columns of the log; owned by the scanner */
+    size_t num_columns;            /**< The number of columns of the log */
+    size_t* offsets;               /**< The offsets of the columns within a row; null if the rows have variable length */
+    size_t row_length;             /**< Length of a row, including padding; zero if the rows have variable length */
+    ub_buffer_t header;            /**< The payload of the first log header block */
+    size_t start;                  /**< Offset of the first block after the first log header block */
+    size_t num_threads;            /**< The number of worker threads to use */
+} ub_scanner_t;
+
+/**
+ * Initializes a parallel scanner and parses the file header and the first
+ * log header block of the given log.
+ *
+ * \param  scanner  the scanner to initialize
+ * \param  data     the log. It is not owned by the scanner; it must be kept
+ *                  valid until the scanner is destroyed.
+ * \param  size     the length of the log
+ * \return \c UB_SUCCESS, \c UB_EPARSE if the memory area does not hold a
+ *         \c unibin log, \c UB_EUNSUPPORTED if the file header has flags
+ *         that the scanner does not know about or \c UB_ENOMEM
+ */
+ub_error_t ub_scanner_init(ub_scanner_t* scanner, const void* data,
+        size_t size);
+
+/**
+ * Destroys a parallel scanner.
+ *
+ * \param  scanner  the scanner to destroy
+ */
+void ub_scanner_destroy(ub_scanner_t* scanner);
+
+/**
+ * Sets the number of worker threads of the scanner. The default is one,
+ * which scans all the ranges on the calling thread. Ranges are also
+ * scanned on the calling thread if the library was built without thread
+ * support or a worker thread cannot be started.
+ *
+ * \param  scanner      the scanner
+ * \param  num_threads  the number of worker threads; at least one
+ * \return \c UB_SUCCESS or \c UB_EINVAL if the number of threads is zero
+ */
+ub_error_t ub_scanner_set_num_threads(ub_scanner_t* scanner,
+        size_t num_threads);
+
+/**
+ * Finds the first block boundary at or after the given offset by trying
+ * each offset in turn. An offset is accepted if a block with a known type
+ * and a valid checksum starts there, and the block is followed either by
+ * the end of the log or by another such block. Logs without checksums
+ * produce more false positives.
+ *
+ * \param  scanner  the scanner
+ * \param  offset   the offset to start from
+ * \param  result   the offset of the block boundary will be returned here
+ * \return \c UB_SUCCESS or \c UB_EOF if there are no block boundaries after
+ *         the given offset
+ */
+ub_error_t ub_scanner_find_block(const ub_scanner_t* scanner, size_t offset,
+        size_t* result);
+
+/**
+ * Scans the log entry blocks of the log in parallel.
+ *
+ * The log is split into \p num_ranges byte ranges, each with its own state
+ * in the \p states array. The blocks of each range are passed to
+ * \p block_func in file order, on one of the worker threads; different
+ * ranges may be scanned at the same time. When all the ranges are done,
+ * the states of the ranges are merged into the state of the first range
+ * with \p reduce_func, in file order, on the calling thread. Without a
+ * reduce function, the per-range states are left to the caller.
+ *
+ * \param  scanner      the scanner
+ * \param  num_ranges   the number of byte ranges; at least one. Use more
+ *                      ranges than threads to balance the load.
+ * \param  block_func   the function to call for each log entry block
+ * \param  states       the states of the ranges, one after the other
+ * \param  state_size   the size of the state of a single range
+ * \param  reduce_func  the function that merges the states of the ranges;
+ *                      may be null
+ * \return \c UB_SUCCESS, \c UB_EINVAL if the number of ranges is zero,
+ *         \c UB_EPARSE if a block is corrupted, \c UB_EUNSUPPORTED if the
+ *         columns of the log change, \c UB_ENOMEM or the first error code
+ *         returned by \p block_func or \p reduce_func
+ */
+ub_error_t ub_scanner_run(ub_scanner_t* scanner, size_t num_ranges,
+        ub_scan_block_func_t* block_func, void* states, size_t state_size,
+        ub_scan_reduce_func_t* reduce_func);
+
+UB_END_DECLS
+
+#endif
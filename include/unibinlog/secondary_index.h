@@ -0,0 +1,161 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_SECONDARY_INDEX_H
+#define UNIBINLOG_SECONDARY_INDEX_H
+
+#include <stdio.h>
+
+#include <unibinlog/basic_types.h>
+#include <unibinlog/buffer.h>
+#include <unibinlog/chksum.h>
+#include <unibinlog/error.h>
+#include <unibinlog/log_reader.h>
+#include <unibinlog/platform.h>
+#include <unibinlog/types.h>
+
+UB_BEGIN_DECLS
+
+/**
+ * A single entry of a \ref ub_secondary_index_t, pointing to a row of the
+ * log that has the given key in the indexed column.
+ */
+typedef struct {
+    const uint8_t* key;            /**< The key, in sortable form; points into \c keys of the index */
+    size_t key_offset;             /**< The offset of the key in \c keys of the index */
+    size_t key_length;             /**< The length of the key */
+    uint64_t offset;               /**< File offset of the log entry block holding the row */
+    uint64_t row;                  /**< Row number of the row in the log */
+    size_t index;                  /**< Index of the row within its block */
+} ub_secondary_index_entry_t;
+
+/**
+ * Structure that stores a \em secondary \em index of a column of a log,
+ * i.e. the locations of all the rows of the log, sorted by the value of the
+ * column. Secondary indices are built by scanning an existing log with
+ * \ref ub_secondary_index_build() and are stored in a separate \em sidecar
+ * file, so they can be added to logs without rewriting them.
+ *
+ * Keys are stored in a form that sorts correctly when compared byte by
+ * byte: numbers in network byte order, with the sign bit flipped for signed
+ * integers and all the bits flipped for negative floating-point numbers,
+ * strings without their terminating null byte and blobs without their
+ * length prefix.
+ *
+ * The sidecar file has the same file header as a log. It contains a
+ * secondary index header block (\c UB_BLOCK_SECONDARY_INDEX_HEADER) with
+ * the index and the data type of the column (1 byte each), the length of
+ * the log when the index was built and the number of entries (8 bytes
+ * each) and the name of the column, followed by secondary index blocks
+ * (\c UB_BLOCK_SECONDARY_INDEX) holding the entries in sorted order: the
+ * length of the key (2 bytes), the key, the block offset and the row number
+ * (8 bytes each) and the index of the row within its block (2 bytes). All
+ * numbers are stored in network byte order.
+ */
+typedef struct {
+    size_t column;                       /**< Index of the indexed column */
+    ub_datatype_t type;                  /**< Data type of the indexed column */
+    char* column_name;                   /**< Name of the indexed column; owned by the index */
+    uint64_t log_length;                 /**< Length of the log when the index was built, to detect stale indices */
+    ub_secondary_index_entry_t* entries; /**< The entries of the index, sorted by key and row number */
+    size_t num_entries;                  /**< The number of entries */
+    size_t capacity;                     /**< The number of entries allocated */
+    ub_buffer_t keys;                    /**< The keys of the entries, one after the other */
+} ub_secondary_index_t;
+
+/**
+ * Initializes an empty secondary index.
+ *
+ * \param  index  the index to initialize
+ * \return \c UB_SUCCESS or \c UB_ENOMEM
+ */
+ub_error_t ub_secondary_index_init(ub_secondary_index_t* index);
+
+/**
+ * Destroys a secondary index.
+ *
+ * \param  index  the index to destroy
+ */
+void ub_secondary_index_destroy(ub_secondary_index_t* index);
+
+/**
+ * Builds a secondary index of the given column by scanning all the rows of
+ * a log, replacing the entries of the index. The reader must be positioned
+ * at the beginning of the log, i.e. right after \ref ub_log_reader_init();
+ * it is at the end of the log afterwards. The file of the reader must
+ * support \c ftell().
+ *
+ * \param  index   the index to build
+ * \param  reader  the reader of the log
+ * \param  column  the index of the column to index
+ * \return \c UB_SUCCESS, \c UB_EINVAL if the column index is out of range,
+ *         \c UB_EUNSUPPORTED if the file does not support \c ftell() or the
+ *         type of the column changes in a later log header block, or an
+ *         error code from the reader
+ */
+ub_error_t ub_secondary_index_build(ub_secondary_index_t* index,
+        ub_log_reader_t* reader, size_t column);
+
+/**
+ * Writes a secondary index into a sidecar file.
+ *
+ * \param  index        the index to write
+ * \param  f            the file to write into
+ * \param  chksum_type  the checksum type to use for the blocks of the file
+ * \return \c UB_SUCCESS or an error code from the write operations
+ */
+ub_error_t ub_secondary_index_write(const ub_secondary_index_t* index,
+        FILE* f, ub_chksum_type_t chksum_type);
+
+/**
+ * Reads a secondary index from a sidecar file, replacing the entries of the
+ * index.
+ *
+ * \param  index  the index to read into
+ * \param  f      the file to read from
+ * \return \c UB_SUCCESS, \c UB_EPARSE if the file is not a valid sidecar
+ *         file or an error code from the read operations
+ */
+ub_error_t ub_secondary_index_read(ub_secondary_index_t* index, FILE* f);
+
+/**
+ * Finds the entries whose keys fall into the given closed range using
+ * binary search. Pass the same value as both bounds for an equality lookup.
+ *
+ * Bounds are given like the keys of \ref ub_bloom_key_init(): strings and
+ * blobs by their contents, values of other types as the native C type of
+ * the indexed column.
+ *
+ * \param  index         the index
+ * \param  lower         pointer to the lower bound; null if there is none
+ * \param  lower_length  the length of the lower bound if the column holds
+ *                       strings or blobs; ignored otherwise
+ * \param  upper         pointer to the upper bound; null if there is none
+ * \param  upper_length  the length of the upper bound if the column holds
+ *                       strings or blobs; ignored otherwise
+ * \param  begin         the index of the first matching entry will be
+ *                       returned here
+ * \param  end           the index after the last matching entry will be
+ *                       returned here
+ * \return \c UB_SUCCESS or \c UB_EUNSUPPORTED if the index has an unknown
+ *         data type
+ */
+ub_error_t ub_secondary_index_find(const ub_secondary_index_t* index,
+        const void* lower, size_t lower_length, const void* upper,
+        size_t upper_length, size_t* begin, size_t* end);
+
+/**
+ * Moves a reader to the row of an entry of a secondary index of its log.
+ * The current block of the reader is kept if it holds the row already.
+ *
+ * \param  reader  the log reader
+ * \param  entry   the entry of the index
+ * \return \c UB_SUCCESS, \c UB_EPARSE if the entry does not point to a
+ *         row of the log or an error code from
+ *         \ref ub_log_reader_seek_block()
+ */
+ub_error_t ub_log_reader_seek_entry(ub_log_reader_t* reader,
+        const ub_secondary_index_entry_t* entry);
+
+UB_END_DECLS
+
+#endif
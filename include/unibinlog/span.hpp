@@ -0,0 +1,73 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_SPAN_HPP
+#define UNIBINLOG_SPAN_HPP
+
+#include <cstddef>
+
+#if defined(__has_include)
+#  if __has_include(<span>)
+#    include <span>
+#  endif
+#endif
+
+namespace unibinlog {
+
+#if defined(__cpp_lib_span)
+
+template <typename T>
+using span = std::span<T>;
+
+#else
+
+/**
+ * Minimal replacement for \c std::span for compilers that do not provide it
+ * (i.e. before C++20). It supports only the operations needed by the C++
+ * layer of the library.
+ */
+template <typename T>
+class span {
+public:
+    typedef T element_type;
+    typedef std::size_t size_type;
+    typedef T* iterator;
+
+    constexpr span() noexcept : data_(nullptr), size_(0) {}
+    constexpr span(T* data, std::size_t size) noexcept : data_(data), size_(size) {}
+
+    template <typename U>
+    constexpr span(const span<U>& other) noexcept
+        : data_(other.data()), size_(other.size()) {}
+
+    constexpr T* data() const noexcept { return data_; }
+    constexpr std::size_t size() const noexcept { return size_; }
+    constexpr std::size_t size_bytes() const noexcept { return size_ * sizeof(T); }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+    constexpr T* begin() const noexcept { return data_; }
+    constexpr T* end() const noexcept { return data_ + size_; }
+    constexpr T& operator[](std::size_t index) const noexcept { return data_[index]; }
+
+    constexpr span subspan(std::size_t offset) const noexcept {
+        return span(data_ + offset, size_ - offset);
+    }
+
+    constexpr span subspan(std::size_t offset, std::size_t count) const noexcept {
+        return span(data_ + offset, count);
+    }
+
+private:
+    T* data_;
+    std::size_t size_;
+};
+
+#endif
+
+/** Read-only view of a memory area */
+typedef span<const std::byte> const_byte_span;
+
+/** Read-write view of a memory area */
+typedef span<std::byte> byte_span;
+
+}
+
+#endif
@@ -0,0 +1,117 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_STRUCT_DECODER_H
+#define UNIBINLOG_STRUCT_DECODER_H
+
+#include <stddef.h>
+
+#include <unibinlog/basic_types.h>
+#include <unibinlog/byteorder.h>
+#include <unibinlog/error.h>
+#include <unibinlog/log_column.h>
+#include <unibinlog/platform.h>
+#include <unibinlog/types.h>
+
+UB_BEGIN_DECLS
+
+/**
+ * Describes where and how the value of a log column is stored in a
+ * caller-defined C struct.
+ *
+ * The native type of the field is given with a \ref ub_datatype_t constant;
+ * the corresponding C types are the following:
+ *
+ * - \c UB_DATATYPE_BOOLEAN: \ref ub_bool_t
+ * - \c UB_DATATYPE_U8 ... \c UB_DATATYPE_S64: the corresponding
+ *   \c uint8_t ... \c int64_t type
+ * - \c UB_DATATYPE_FLOAT, \c UB_DATATYPE_DOUBLE: \c float, \c double
+ * - \c UB_DATATYPE_CHAR: \c char
+ * - \c UB_DATATYPE_UNIX_TIMESTAMP: \c uint64_t
+ * - \c UB_DATATYPE_TIMEVAL: <tt>struct timeval</tt>
+ * - \c UB_DATATYPE_STRING: <tt>const char*</tt>, pointing into the decoded
+ *   data, which therefore must outlive the struct
+ *
+ * \c UB_DATATYPE_UNKNOWN means that the column is not stored at all.
+ */
+typedef struct {
+    size_t offset;                 /**< Offset of the field within the struct */
+    ub_datatype_t type;            /**< Native type of the field */
+} ub_struct_field_t;
+
+/**
+ * \def UB_STRUCT_FIELD
+ *
+ * Initializer for a \ref ub_struct_field_t that refers to the given member
+ * of the given struct type.
+ */
+#define UB_STRUCT_FIELD(struct_type, member, native_type) \
+    { offsetof(struct_type, member), native_type }
+
+/**
+ * \def UB_STRUCT_FIELD_SKIP
+ *
+ * Initializer for a \ref ub_struct_field_t for columns that are not needed.
+ */
+#define UB_STRUCT_FIELD_SKIP { 0, UB_DATATYPE_UNKNOWN }
+
+/**
+ * Checks whether the values of the given columns can be decoded into fields
+ * of the given native types.
+ *
+ * Besides identical types, integer (including Boolean, character and
+ * timestamp) columns may be decoded into fields of any other integer or
+ * floating-point type, and floating-point columns may be decoded into fields
+ * of any floating-point type; values are converted as by a C cast, except
+ * that Boolean fields receive 1 for every non-zero value. Blob columns can
+ * only be skipped.
+ *
+ * \param  columns      pointer to an array containing the columns of the log
+ * \param  num_columns  the number of columns
+ * \param  fields       pointer to an array containing one field for each
+ *                      column
+ * \return \c UB_SUCCESS, \c UB_EINVAL if a column cannot be decoded into its
+ *         field or \c UB_EUNSUPPORTED if a column has an unknown type
+ */
+ub_error_t ub_struct_decoder_validate(const ub_log_column_t* columns,
+        size_t num_columns, const ub_struct_field_t* fields);
+
+/**
+ * Decodes the payload of a log entry block (\c UB_BLOCK_LOG_ENTRY), i.e.
+ * rows stored one after the other, directly into an array of caller-defined
+ * structs in a single pass.
+ *
+ * The rows of a \ref ub_log_reader_t can be decoded by passing the \c rows,
+ * \c rows_length, \c byte_order and \c aligned fields of the reader as
+ * \p rows, \p size, \p order and \p aligned.
+ *
+ * \param  columns      pointer to an array containing the columns of the log
+ * \param  num_columns  the number of columns
+ * \param  fields       pointer to an array containing one field for each
+ *                      column; see \ref ub_struct_decoder_validate() for the
+ *                      conversions that are allowed
+ * \param  rows         pointer to the rows to decode
+ * \param  size         the total length of the rows
+ * \param  order        the byte order of the values in the rows
+ * \param  aligned      whether the rows use the aligned layout (see
+ *                      \ref ub_log_columns_get_layout())
+ * \param  structs      pointer to the array of structs to decode into
+ * \param  struct_size  the size of a single struct, i.e. the stride of the
+ *                      array
+ * \param  max_structs  the number of structs in the array
+ * \param  num_structs  the number of structs filled will be returned here if
+ *                      it is not null
+ * \return \c UB_SUCCESS, \c UB_ETOOLONG if the array is too short to hold all
+ *         the rows or there are more than 255 columns, \c UB_EPARSE if the
+ *         rows are truncated, \c UB_EUNSUPPORTED if the rows are aligned
+ *         but have variable length, or any error returned by
+ *         \ref ub_struct_decoder_validate()
+ */
+ub_error_t ub_struct_decode_log_entries(const ub_log_column_t* columns,
+        size_t num_columns, const ub_struct_field_t* fields,
+        const void* rows, size_t size, ub_byte_order_t order,
+        ub_bool_t aligned, void* structs, size_t struct_size,
+        size_t max_structs, size_t* num_structs);
+
+UB_END_DECLS
+
+#endif
@@ -5,6 +5,9 @@
 
 #include <stdlib.h>
 #include <unibinlog/basic_types.h>
+#include <unibinlog/platform.h>
+
+UB_BEGIN_DECLS
 
 /**
  * Enum constants for the different block types in \c unibin files.
@@ -15,6 +18,17 @@ typedef enum {
 	UB_BLOCK_LOG_HEADER,          /**< Log header block */
 	UB_BLOCK_LOG_ENTRY,           /**< Log entry block */
 	UB_BLOCK_EVENT,               /**< Event block */
+	UB_BLOCK_ENCODED_LOG_ENTRY,   /**< Log entry block with per-column codecs */
+	UB_BLOCK_PADDING,             /**< Padding block; its payload is ignored */
+	UB_BLOCK_INDEX,               /**< Block index entries */
+	UB_BLOCK_INDEX_TRAILER,       /**< Fixed-length pointer to the block index at the end of the file */
+	UB_BLOCK_ZONE_MAP,            /**< Per-column statistics of the next log entry block */
+	UB_BLOCK_BLOOM_FILTER,        /**< Bloom filters of some columns of the next log entry block */
+	UB_BLOCK_SECONDARY_INDEX_HEADER, /**< Header of a secondary index sidecar file */
+	UB_BLOCK_SECONDARY_INDEX,     /**< Secondary index entries in a sidecar file */
+	UB_BLOCK_SYNC,                /**< Sync marker with the schema and the row number, for resynchronization */
+	UB_BLOCK_MANIFEST_HEADER,     /**< Header of the manifest of a dataset */
+	UB_BLOCK_MANIFEST,            /**< Chunk descriptions in the manifest of a dataset */
 } ub_block_type_t;
 
 /**
@@ -73,5 +87,33 @@ typedef struct {
  */
 ub_typeinfo_t ub_datatype_get_info(ub_datatype_t type);
 
+/**
+ * Returns the length of a single serialized value of the given \c unibin
+ * data type. For fixed-length types this is the length of the type; for
+ * variable-length types the length is determined from the serialized value
+ * itself.
+ *
+ * \param  type  the data type
+ * \param  data  pointer to the serialized value
+ * \param  size  the number of bytes available at \p data
+ * \return the length of the value in bytes, or zero if the type is unknown
+ *         or the value does not fit into \p size bytes
+ */
+size_t ub_datatype_get_value_length(ub_datatype_t type, const void* data,
+        size_t size);
+
+/**
+ * Returns the natural alignment of the native C type corresponding to the
+ * given \c unibin data type, i.e. the alignment that a value of the type
+ * needs in an aligned row layout.
+ *
+ * \param  type  the data type
+ * \return the alignment of the type in bytes, or zero if the type is unknown
+ *         or has a variable length
+ */
+size_t ub_datatype_get_alignment(ub_datatype_t type);
+
+UB_END_DECLS
+
 #endif
 
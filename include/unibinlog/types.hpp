@@ -0,0 +1,356 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_TYPES_HPP
+#define UNIBINLOG_TYPES_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <sys/time.h>
+
+#include <unibinlog/byteorder.h>
+#include <unibinlog/log_column.h>
+#include <unibinlog/types.h>
+
+namespace unibinlog {
+
+/**
+ * C++ type for \c UB_DATATYPE_UNIX_TIMESTAMP columns. It is a separate type
+ * so that timestamps can be told apart from plain 64-bit integers at compile
+ * time.
+ */
+struct unix_timestamp {
+    std::uint64_t value;       /**< The timestamp itself */
+};
+
+namespace detail {
+
+/**
+ * Converts an unsigned integer between host and network byte order.
+ */
+template <typename U>
+inline U swap_be(U value) noexcept {
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if constexpr (sizeof(U) == 2) {
+        return __builtin_bswap16(value);
+    } else if constexpr (sizeof(U) == 4) {
+        return __builtin_bswap32(value);
+    } else if constexpr (sizeof(U) == 8) {
+        return __builtin_bswap64(value);
+    }
+    return value;
+#elif defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return value;
+#else
+    std::uint8_t bytes[sizeof(U)];
+    for (std::size_t i = sizeof(U); i-- > 0; ) {
+        bytes[i] = static_cast<std::uint8_t>(value & 0xFF);
+        value = static_cast<U>(value >> 8);
+    }
+    std::memcpy(&value, bytes, sizeof(U));
+    return value;
+#endif
+}
+
+/**
+ * Converts an unsigned integer between host and little-endian byte order.
+ */
+template <typename U>
+inline U swap_le(U value) noexcept {
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    return value;
+#elif defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    if constexpr (sizeof(U) == 2) {
+        return __builtin_bswap16(value);
+    } else if constexpr (sizeof(U) == 4) {
+        return __builtin_bswap32(value);
+    } else if constexpr (sizeof(U) == 8) {
+        return __builtin_bswap64(value);
+    }
+    return value;
+#else
+    std::uint8_t bytes[sizeof(U)];
+    for (std::size_t i = 0; i < sizeof(U); i++) {
+        bytes[i] = static_cast<std::uint8_t>(value & 0xFF);
+        value = static_cast<U>(value >> 8);
+    }
+    std::memcpy(&value, bytes, sizeof(U));
+    return value;
+#endif
+}
+
+/**
+ * Converts an unsigned integer between host byte order and the given byte
+ * order.
+ */
+template <ub_byte_order_t Order, typename U>
+inline U swap(U value) noexcept {
+    if constexpr (Order == UB_LITTLE_ENDIAN) {
+        return swap_le<U>(value);
+    } else {
+        return swap_be<U>(value);
+    }
+}
+
+/**
+ * Stores an unsigned integer in the given byte order.
+ */
+template <ub_byte_order_t Order, typename U>
+inline void store(std::uint8_t* dest, U value) noexcept {
+    value = swap<Order, U>(value);
+    std::memcpy(dest, &value, sizeof(U));
+}
+
+/**
+ * Loads an unsigned integer stored in the given byte order.
+ */
+template <ub_byte_order_t Order, typename U>
+inline U load(const std::uint8_t* src) noexcept {
+    U value;
+    std::memcpy(&value, src, sizeof(U));
+    return swap<Order, U>(value);
+}
+
+/**
+ * Implementation of \ref datatype_traits for integer types.
+ */
+template <typename T, typename U, ub_datatype_t Type>
+struct integer_traits {
+    static constexpr ub_datatype_t type = Type;
+    static constexpr std::size_t length = sizeof(T);
+
+    template <ub_byte_order_t Order = UB_BIG_ENDIAN>
+    static void store(std::uint8_t* dest, T value) noexcept {
+        detail::store<Order, U>(dest, static_cast<U>(value));
+    }
+
+    template <ub_byte_order_t Order = UB_BIG_ENDIAN>
+    static T load(const std::uint8_t* src) noexcept {
+        return static_cast<T>(detail::load<Order, U>(src));
+    }
+};
+
+/**
+ * Implementation of \ref datatype_traits for IEEE-754 floating point types.
+ */
+template <typename T, typename U, ub_datatype_t Type>
+struct float_traits {
+    static_assert(sizeof(T) == sizeof(U), "unexpected floating point format");
+
+    static constexpr ub_datatype_t type = Type;
+    static constexpr std::size_t length = sizeof(T);
+
+    template <ub_byte_order_t Order = UB_BIG_ENDIAN>
+    static void store(std::uint8_t* dest, T value) noexcept {
+        U bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        detail::store<Order, U>(dest, bits);
+    }
+
+    template <ub_byte_order_t Order = UB_BIG_ENDIAN>
+    static T load(const std::uint8_t* src) noexcept {
+        U bits = detail::load<Order, U>(src);
+        T value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
+
+}
+
+/**
+ * Compile-time mapping from C++ types to \c unibin data types.
+ *
+ * Each specialization provides the data type code (\c type), the length of
+ * the encoded value in bytes (\c length) and two functions that encode
+ * (\c store) and decode (\c load) a single value; both take the byte order of the encoded value
+ * as an optional template argument that defaults to network byte order.
+ * Types without a specialization cannot be used as column types.
+ */
+template <typename T>
+struct datatype_traits;
+
+template <> struct datatype_traits<bool> {
+    static constexpr ub_datatype_t type = UB_DATATYPE_BOOLEAN;
+    static constexpr std::size_t length = 1;
+
+    template <ub_byte_order_t Order = UB_BIG_ENDIAN>
+    static void store(std::uint8_t* dest, bool value) noexcept {
+        *dest = value ? 1 : 0;
+    }
+
+    template <ub_byte_order_t Order = UB_BIG_ENDIAN>
+    static bool load(const std::uint8_t* src) noexcept {
+        return *src != 0;
+    }
+};
+
+template <> struct datatype_traits<char>
+    : detail::integer_traits<char, std::uint8_t, UB_DATATYPE_CHAR> {};
+template <> struct datatype_traits<std::uint8_t>
+    : detail::integer_traits<std::uint8_t, std::uint8_t, UB_DATATYPE_U8> {};
+template <> struct datatype_traits<std::int8_t>
+    : detail::integer_traits<std::int8_t, std::uint8_t, UB_DATATYPE_S8> {};
+template <> struct datatype_traits<std::uint16_t>
+    : detail::integer_traits<std::uint16_t, std::uint16_t, UB_DATATYPE_U16> {};
+template <> struct datatype_traits<std::int16_t>
+    : detail::integer_traits<std::int16_t, std::uint16_t, UB_DATATYPE_S16> {};
+template <> struct datatype_traits<std::uint32_t>
+    : detail::integer_traits<std::uint32_t, std::uint32_t, UB_DATATYPE_U32> {};
+template <> struct datatype_traits<std::int32_t>
+    : detail::integer_traits<std::int32_t, std::uint32_t, UB_DATATYPE_S32> {};
+template <> struct datatype_traits<std::uint64_t>
+    : detail::integer_traits<std::uint64_t, std::uint64_t, UB_DATATYPE_U64> {};
+template <> struct datatype_traits<std::int64_t>
+    : detail::integer_traits<std::int64_t, std::uint64_t, UB_DATATYPE_S64> {};
+template <> struct datatype_traits<float>
+    : detail::float_traits<float, std::uint32_t, UB_DATATYPE_FLOAT> {};
+template <> struct datatype_traits<double>
+    : detail::float_traits<double, std::uint64_t, UB_DATATYPE_DOUBLE> {};
+
+template <> struct datatype_traits<unix_timestamp> {
+    static constexpr ub_datatype_t type = UB_DATATYPE_UNIX_TIMESTAMP;
+    static constexpr std::size_t length = 8;
+
+    template <ub_byte_order_t Order = UB_BIG_ENDIAN>
+    static void store(std::uint8_t* dest, unix_timestamp value) noexcept {
+        detail::store<Order, std::uint64_t>(dest, value.value);
+    }
+
+    template <ub_byte_order_t Order = UB_BIG_ENDIAN>
+    static unix_timestamp load(const std::uint8_t* src) noexcept {
+        return unix_timestamp { detail::load<Order, std::uint64_t>(src) };
+    }
+};
+
+template <> struct datatype_traits<struct timeval> {
+    static constexpr ub_datatype_t type = UB_DATATYPE_TIMEVAL;
+    static constexpr std::size_t length = 8;
+
+    template <ub_byte_order_t Order = UB_BIG_ENDIAN>
+    static void store(std::uint8_t* dest, const struct timeval& value) noexcept {
+        detail::store<Order, std::uint32_t>(dest, static_cast<std::uint32_t>(value.tv_sec));
+        detail::store<Order, std::uint32_t>(dest + 4, static_cast<std::uint32_t>(value.tv_usec));
+    }
+
+    template <ub_byte_order_t Order = UB_BIG_ENDIAN>
+    static struct timeval load(const std::uint8_t* src) noexcept {
+        struct timeval value;
+        value.tv_sec = detail::load<Order, std::uint32_t>(src);
+        value.tv_usec = detail::load<Order, std::uint32_t>(src + 4);
+        return value;
+    }
+};
+
+namespace detail {
+
+/**
+ * Compile-time counterpart of \ref ub_datatype_get_alignment() for
+ * fixed-width data types.
+ */
+constexpr std::size_t alignment_of(ub_datatype_t type, std::size_t length) {
+    return type == UB_DATATYPE_TIMEVAL ? 4 : length;
+}
+
+/**
+ * Common implementation of \ref schema and \ref aligned_schema.
+ */
+template <bool Aligned, typename... Ts>
+struct basic_schema {
+    static_assert(sizeof...(Ts) > 0, "a log needs at least one column");
+    static_assert(sizeof...(Ts) <= 255, "a log may have at most 255 columns");
+
+    /** The C++ types of the columns, as a tuple */
+    typedef std::tuple<Ts...> tuple_type;
+
+    /** The C++ type of the column with the given index */
+    template <std::size_t I>
+    using column_type = std::tuple_element_t<I, tuple_type>;
+
+    /** Whether the rows use the aligned layout */
+    static constexpr bool aligned = Aligned;
+
+    /** The number of columns in the log */
+    static constexpr std::size_t num_columns = sizeof...(Ts);
+
+    /** The data types of the columns */
+    static constexpr std::array<ub_datatype_t, num_columns> types = {
+        datatype_traits<Ts>::type...
+    };
+
+    /**
+     * The alignment of the columns; all ones unless the rows use the aligned
+     * layout
+     */
+    static constexpr std::array<std::size_t, num_columns> alignments = {
+        (Aligned ? alignment_of(datatype_traits<Ts>::type,
+                                datatype_traits<Ts>::length) : 1)...
+    };
+
+    /** The offsets of the columns within a row */
+    static constexpr std::array<std::size_t, num_columns> offsets =
+        [] {
+            constexpr std::size_t lengths[] = { datatype_traits<Ts>::length... };
+            std::array<std::size_t, num_columns> result {};
+            std::size_t offset = 0;
+            for (std::size_t i = 0; i < num_columns; i++) {
+                offset = (offset + alignments[i] - 1) / alignments[i] * alignments[i];
+                result[i] = offset;
+                offset += lengths[i];
+            }
+            return result;
+        }();
+
+    /** The length of a single row in bytes, including padding */
+    static constexpr std::size_t row_length =
+        [] {
+            std::size_t max_alignment = 1;
+            for (std::size_t alignment : alignments) {
+                if (alignment > max_alignment) {
+                    max_alignment = alignment;
+                }
+            }
+            constexpr std::size_t lengths[] = { datatype_traits<Ts>::length... };
+            std::size_t length = offsets[num_columns - 1] + lengths[num_columns - 1];
+            return (length + max_alignment - 1) / max_alignment * max_alignment;
+        }();
+
+    /**
+     * Returns whether the types of the given log columns match the schema.
+     */
+    static bool matches(const ub_log_column_t* columns,
+            std::size_t count) noexcept {
+        if (count != num_columns) {
+            return false;
+        }
+        for (std::size_t i = 0; i < num_columns; i++) {
+            if (columns[i].type != types[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+}
+
+/**
+ * Compile-time description of the packed row layout of a log whose column
+ * types are given as template arguments; each of them must have a
+ * \ref datatype_traits specialization.
+ */
+template <typename... Ts>
+struct schema : detail::basic_schema<false, Ts...> {};
+
+/**
+ * Compile-time description of the aligned row layout of a log whose column
+ * types are given as template arguments; see \ref ub_log_columns_get_layout().
+ */
+template <typename... Ts>
+struct aligned_schema : detail::basic_schema<true, Ts...> {};
+
+}
+
+#endif
@@ -4,15 +4,30 @@
 #define UNIBINLOG_H
 
 #include <unibinlog/basic_types.h>
+#include <unibinlog/block_index.h>
+#include <unibinlog/bloom_filter.h>
 #include <unibinlog/buffer.h>
+#include <unibinlog/buffer_pool.h>
+#include <unibinlog/byteorder.h>
 #include <unibinlog/chksum.h>
+#include <unibinlog/codec.h>
+#include <unibinlog/dataset.h>
 #include <unibinlog/debug.h>
+#include <unibinlog/direct_file.h>
 #include <unibinlog/error.h>
 #include <unibinlog/log_column.h>
+#include <unibinlog/log_reader.h>
+#include <unibinlog/log_writer.h>
 #include <unibinlog/lowlevel.h>
 #include <unibinlog/memory.h>
 #include <unibinlog/platform.h>
+#include <unibinlog/rotating_writer.h>
+#include <unibinlog/scanner.h>
+#include <unibinlog/secondary_index.h>
+#include <unibinlog/struct_decoder.h>
 #include <unibinlog/types.h>
+#include <unibinlog/uring_file.h>
+#include <unibinlog/zone_map.h>
 
 #endif
 
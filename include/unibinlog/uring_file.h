@@ -0,0 +1,117 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_URING_FILE_H
+#define UNIBINLOG_URING_FILE_H
+
+#include <stdio.h>
+
+#include <unibinlog/basic_types.h>
+#include <unibinlog/error.h>
+#include <unibinlog/log_writer.h>
+#include <unibinlog/platform.h>
+
+UB_BEGIN_DECLS
+
+/**
+ * Structure that stores the state information of an \em io_uring \em file,
+ * i.e. a write-only stream over a file descriptor that collects the bytes
+ * written into it in a small set of buffers and writes each full buffer
+ * with an asynchronous io_uring operation. Pass \c file to
+ * \ref ub_log_writer_init() to use it as the sink of a log writer.
+ *
+ * The buffers are registered with the kernel if the locked memory limit
+ * allows it, so the writes do not have to map them each time. Up to
+ * \c num_buffers - 1 writes are in flight while the next buffer is being
+ * filled; a buffer is reused as soon as its write completes, and the
+ * stream only waits for the kernel when all the buffers are in flight.
+ * If the kernel does not support io_uring (or the library was built
+ * without it), the full buffers are written with \c pwrite() instead.
+ *
+ * The stream supports \c ftell(); seeking waits for the writes in flight
+ * first. Flushing the stream does not wait for the writes, so
+ * \ref ub_log_writer_sync() and the durability policies of the log writer
+ * only reach the disk if the writer is attached to the file with
+ * \ref ub_uring_file_attach(); \ref ub_uring_file_sync() syncs it
+ * directly. Write
+ * errors are reported by the next write into the stream that has to wait
+ * for a buffer, by \ref ub_uring_file_sync() or by
+ * \ref ub_uring_file_close(). If the completions of the writes cannot be
+ * waited for, the stream fails all further writes, and the buffers in
+ * flight are only freed by \ref ub_uring_file_destroy() after the ring is
+ * torn down.
+ */
+typedef struct {
+    FILE* file;                    /**< The stream to write into; null once the file is closed */
+    int fd;                        /**< The file descriptor written into; owned by the file */
+    size_t buffer_size;            /**< The length of a buffer */
+    size_t num_buffers;            /**< The number of buffers */
+    ub_bool_t async;               /**< Whether the writes go through io_uring */
+    ub_bool_t fixed;               /**< Whether the buffers are registered with the kernel */
+    ub_error_t error;              /**< The first write error, if any */
+    void* state;                   /**< The buffers and the ring; opaque */
+} ub_uring_file_t;
+
+/**
+ * Initializes an io_uring file that writes into the given file descriptor,
+ * starting at its current offset.
+ *
+ * \param  file         the io_uring file to initialize
+ * \param  fd           the file descriptor; it is closed with the file
+ * \param  buffer_size  the length of a buffer; at least one byte. Each
+ *                      write operation writes a full buffer, except for the
+ *                      last one before a flush.
+ * \param  num_buffers  the number of buffers; at least two
+ * \param  async        whether to use io_uring if the kernel supports it;
+ *                      writes use \c pwrite() otherwise
+ * \return \c UB_SUCCESS, \c UB_EINVAL if the buffers are too small or too
+ *         few, \c UB_EUNSUPPORTED if the platform cannot wrap custom
+ *         streams into a \c FILE* or \c UB_ENOMEM
+ */
+ub_error_t ub_uring_file_init(ub_uring_file_t* file, int fd,
+        size_t buffer_size, size_t num_buffers, ub_bool_t async);
+
+/**
+ * Destroys an io_uring file, closing it first if needed. Errors from
+ * closing the file are lost; call \ref ub_uring_file_close() first if you
+ * need them.
+ *
+ * \param  file  the io_uring file to destroy
+ */
+void ub_uring_file_destroy(ub_uring_file_t* file);
+
+/**
+ * Writes all the bytes written into the stream so far into the file, waits
+ * for the writes to complete and flushes the data of the file to the disk.
+ *
+ * \param  file  the io_uring file
+ * \return \c UB_SUCCESS or \c UB_EWRITE
+ */
+ub_error_t ub_uring_file_sync(ub_uring_file_t* file);
+
+/**
+ * Makes the given log writer, which writes into the stream of the file,
+ * sync the file with \ref ub_uring_file_sync() (see
+ * \ref ub_log_writer_set_sync_func()), so \ref ub_log_writer_sync() and
+ * the durability policies of the writer reach the disk. The policy
+ * \c UB_DURABILITY_INTERVAL is not supported.
+ *
+ * \param  file    the io_uring file
+ * \param  writer  the log writer
+ * \return \c UB_SUCCESS or an error code from
+ *         \ref ub_log_writer_set_sync_func()
+ */
+ub_error_t ub_uring_file_attach(ub_uring_file_t* file, ub_log_writer_t* writer);
+
+/**
+ * Writes all the bytes written into the stream so far into the file, waits
+ * for the writes to complete and closes the stream and the file
+ * descriptor.
+ *
+ * \param  file  the io_uring file
+ * \return \c UB_SUCCESS or \c UB_EWRITE if a write failed
+ */
+ub_error_t ub_uring_file_close(ub_uring_file_t* file);
+
+UB_END_DECLS
+
+#endif
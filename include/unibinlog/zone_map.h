@@ -0,0 +1,190 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_ZONE_MAP_H
+#define UNIBINLOG_ZONE_MAP_H
+
+#include <unibinlog/basic_types.h>
+#include <unibinlog/buffer.h>
+#include <unibinlog/byteorder.h>
+#include <unibinlog/error.h>
+#include <unibinlog/log_column.h>
+#include <unibinlog/platform.h>
+#include <unibinlog/types.h>
+
+UB_BEGIN_DECLS
+
+/**
+ * \def UB_ZONE_MAP_ENTRY_LENGTH
+ *
+ * The length of a single serialized entry in a zone map block
+ * (\c UB_BLOCK_ZONE_MAP).
+ */
+#define UB_ZONE_MAP_ENTRY_LENGTH 19
+
+/**
+ * A numeric value in a zone map or a filter. Which member is used depends on
+ * the data type of the column: \c s for signed integers, \c f for
+ * floating-point numbers and \c u for everything else.
+ */
+typedef union {
+    uint64_t u;                    /**< Value of an unsigned column */
+    int64_t s;                     /**< Value of a signed column */
+    double f;                      /**< Value of a floating-point column */
+} ub_zone_value_t;
+
+/**
+ * Comparison operators of filters evaluated on zone maps.
+ */
+typedef enum {
+    UB_FILTER_EQ = 0,              /**< Equal to the constant */
+    UB_FILTER_NE,                  /**< Not equal to the constant */
+    UB_FILTER_LT,                  /**< Less than the constant */
+    UB_FILTER_LE,                  /**< Less than or equal to the constant */
+    UB_FILTER_GT,                  /**< Greater than the constant */
+    UB_FILTER_GE,                  /**< Greater than or equal to the constant */
+    UB_MAX_FILTER_OP               /**< Not a real operator; useful for enumerating all operators */
+} ub_filter_op_t;
+
+/**
+ * Statistics of a single column in a \ref ub_zone_map_t.
+ *
+ * \c min and \c max are zero if all the values of the column are NaN.
+ */
+typedef struct {
+    size_t column;                 /**< Index of the column */
+    ub_zone_value_t min;           /**< The smallest value of the column in the block */
+    ub_zone_value_t max;           /**< The largest value of the column in the block */
+    size_t num_nans;               /**< The number of NaN values; zero for integer columns */
+} ub_zone_map_entry_t;
+
+/**
+ * Structure that stores the \em zone \em map of a log entry block, i.e. the
+ * smallest and largest value and the number of NaN values of each numeric
+ * column of the block. Readers can skip whole blocks whose zone map shows
+ * that none of their rows can match a filter.
+ *
+ * Zone maps are stored in zone map blocks (\c UB_BLOCK_ZONE_MAP) right
+ * before the log entry block that they describe. The payload consists of
+ * the number of rows of the block (2 bytes) and the number of entries
+ * (1 byte), followed by \ref UB_ZONE_MAP_ENTRY_LENGTH bytes per entry: the
+ * column index (1 byte), the minimum and the maximum (8 bytes each, see
+ * \ref ub_zone_value_t) and the number of NaN values (2 bytes). All numbers
+ * are stored in network byte order.
+ */
+typedef struct {
+    ub_zone_map_entry_t* entries;  /**< The entries of the zone map, in increasing column order */
+    size_t num_entries;            /**< The number of entries */
+    size_t capacity;               /**< The number of entries allocated */
+    size_t num_rows;               /**< The number of rows of the block */
+} ub_zone_map_t;
+
+/**
+ * A filter that compares a numeric column with a constant, used to decide
+ * whether a block may contain matching rows.
+ */
+typedef struct {
+    size_t column;                 /**< Index of the column */
+    ub_datatype_t type;            /**< Data type of the column */
+    ub_filter_op_t op;             /**< The comparison operator */
+    ub_zone_value_t value;         /**< The constant to compare with */
+} ub_filter_t;
+
+/**
+ * Returns whether zone maps track the values of columns with the given data
+ * type. These are the types that have a native array representation (see
+ * \ref ub_byteorder_decode_column()).
+ *
+ * \param  type  the data type
+ * \return whether the type is supported
+ */
+ub_bool_t ub_zone_map_supports_type(ub_datatype_t type);
+
+/**
+ * Initializes an empty zone map.
+ *
+ * \param  map  the zone map to initialize
+ * \return \c UB_SUCCESS
+ */
+ub_error_t ub_zone_map_init(ub_zone_map_t* map);
+
+/**
+ * Destroys a zone map.
+ *
+ * \param  map  the zone map to destroy
+ */
+void ub_zone_map_destroy(ub_zone_map_t* map);
+
+/**
+ * Computes the zone map of the given rows, replacing the entries of the map.
+ *
+ * \param  map          the zone map
+ * \param  columns      the columns of the log
+ * \param  num_columns  the number of columns
+ * \param  aligned      whether the rows use the aligned row layout
+ * \param  order        the byte order of the values in the rows
+ * \param  rows         the rows, one after the other
+ * \param  length       the total length of the rows
+ * \return \c UB_SUCCESS, \c UB_ENOMEM or \c UB_EINVAL if the rows do not
+ *         match the columns
+ */
+ub_error_t ub_zone_map_compute(ub_zone_map_t* map,
+        const ub_log_column_t* columns, size_t num_columns, ub_bool_t aligned,
+        ub_byte_order_t order, const uint8_t* rows, size_t length);
+
+/**
+ * Serializes a zone map into the payload of a zone map block.
+ *
+ * \param  map      the zone map
+ * \param  payload  the buffer to write the payload into; it is resized
+ * \return \c UB_SUCCESS or \c UB_ENOMEM
+ */
+ub_error_t ub_zone_map_encode(const ub_zone_map_t* map, ub_buffer_t* payload);
+
+/**
+ * Parses the payload of a zone map block, replacing the entries of the map.
+ *
+ * \param  map   the zone map
+ * \param  data  the payload of the block
+ * \param  size  the size of the payload
+ * \return \c UB_SUCCESS, \c UB_ENOMEM or \c UB_EPARSE if the payload is
+ *         malformed
+ */
+ub_error_t ub_zone_map_decode(ub_zone_map_t* map, const uint8_t* data,
+        size_t size);
+
+/**
+ * Initializes a filter that compares a column with a constant.
+ *
+ * \param  filter  the filter to initialize
+ * \param  column  the index of the column
+ * \param  type    the data type of the column
+ * \param  op      the comparison operator
+ * \param  value   pointer to the constant, stored as the native C type of
+ *                 the column (see \ref ub_typeinfo_t.c_name)
+ * \return \c UB_SUCCESS, \c UB_EINVAL if the operator is invalid or
+ *         \c UB_EUNSUPPORTED if zone maps do not support the data type
+ */
+ub_error_t ub_filter_init(ub_filter_t* filter, size_t column,
+        ub_datatype_t type, ub_filter_op_t op, const void* value);
+
+/**
+ * Decides whether a block with the given zone map may contain rows that
+ * match all the given filters. Filters on columns that the zone map has no
+ * entry for, or whose data type does not match the given columns, are
+ * assumed to match.
+ *
+ * \param  map          the zone map of the block
+ * \param  columns      the columns of the log
+ * \param  num_columns  the number of columns
+ * \param  filters      the filters
+ * \param  num_filters  the number of filters
+ * \return \c false if no row of the block can match all the filters,
+ *         \c true otherwise
+ */
+ub_bool_t ub_zone_map_may_match(const ub_zone_map_t* map,
+        const ub_log_column_t* columns, size_t num_columns,
+        const ub_filter_t* filters, size_t num_filters);
+
+UB_END_DECLS
+
+#endif
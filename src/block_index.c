@@ -0,0 +1,257 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#include <string.h>
+
+#include <unibinlog/block_index.h>
+#include <unibinlog/buffer.h>
+#include <unibinlog/lowlevel.h>
+#include <unibinlog/memory.h>
+
+/**
+ * The maximum number of entries in a single index block.
+ */
+#define UB_I_ENTRIES_PER_BLOCK (65535 / UB_BLOCK_INDEX_ENTRY_LENGTH)
+
+/**
+ * Loads an unsigned integer of the given width (in bytes) stored in network
+ * byte order.
+ */
+static uint64_t ub_i_load_be(const uint8_t* bytes, size_t width) {
+    uint64_t result = 0;
+    while (width > 0) {
+        result = (result << 8) | *bytes;
+        bytes++; width--;
+    }
+    return result;
+}
+
+/**
+ * Stores an unsigned integer on the given number of bytes in network byte
+ * order.
+ */
+static void ub_i_store_be(uint8_t* bytes, size_t width, uint64_t value) {
+    while (width > 0) {
+        width--;
+        bytes[width] = value & 0xFF;
+        value >>= 8;
+    }
+}
+
+static void ub_i_encode_entry(uint8_t* bytes,
+        const ub_block_index_entry_t* entry) {
+    ub_i_store_be(bytes, 8, entry->offset);
+    ub_i_store_be(bytes + 8, 8, entry->first_row);
+    ub_i_store_be(bytes + 16, 2, entry->num_rows);
+    ub_i_store_be(bytes + 18, 8, (uint64_t)entry->first_timestamp);
+    ub_i_store_be(bytes + 26, 8, (uint64_t)entry->last_timestamp);
+}
+
+static void ub_i_decode_entry(ub_block_index_entry_t* entry,
+        const uint8_t* bytes) {
+    entry->offset = ub_i_load_be(bytes, 8);
+    entry->first_row = ub_i_load_be(bytes + 8, 8);
+    entry->num_rows = ub_i_load_be(bytes + 16, 2);
+    entry->first_timestamp = (int64_t)ub_i_load_be(bytes + 18, 8);
+    entry->last_timestamp = (int64_t)ub_i_load_be(bytes + 26, 8);
+}
+
+ub_error_t ub_block_index_init(ub_block_index_t* index) {
+    index->entries = 0;
+    index->num_entries = 0;
+    index->capacity = 0;
+    index->timestamp_column = UB_BLOCK_INDEX_NO_TIMESTAMP;
+    return UB_SUCCESS;
+}
+
+void ub_block_index_destroy(ub_block_index_t* index) {
+    ub_free_unless_null(index->entries);
+    index->num_entries = 0;
+    index->capacity = 0;
+}
+
+void ub_block_index_clear(ub_block_index_t* index) {
+    index->num_entries = 0;
+}
+
+ub_error_t ub_block_index_append(ub_block_index_t* index,
+        const ub_block_index_entry_t* entry) {
+    ub_block_index_entry_t* entries;
+    size_t capacity;
+
+    if (index->num_entries == index->capacity) {
+        capacity = index->capacity > 0 ? index->capacity * 2 : 64;
+        entries = ub_realloc(index->entries, ub_block_index_entry_t, capacity);
+        if (entries == 0)
+            return UB_ENOMEM;
+        index->entries = entries;
+        index->capacity = capacity;
+    }
+
+    index->entries[index->num_entries++] = *entry;
+    return UB_SUCCESS;
+}
+
+uint64_t ub_block_index_get_num_rows(const ub_block_index_t* index) {
+    const ub_block_index_entry_t* last;
+
+    if (index->num_entries == 0)
+        return 0;
+
+    last = &index->entries[index->num_entries - 1];
+    return last->first_row + last->num_rows;
+}
+
+ub_error_t ub_block_index_find_row(const ub_block_index_t* index,
+        uint64_t row, size_t* entry) {
+    size_t lo = 0, hi = index->num_entries, mid;
+
+    if (row >= ub_block_index_get_num_rows(index))
+        return UB_EOF;
+
+    /* find the last block whose first row is not after the given row */
+    while (hi - lo > 1) {
+        mid = lo + (hi - lo) / 2;
+        if (index->entries[mid].first_row <= row)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    *entry = lo;
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_block_index_find_timestamp(const ub_block_index_t* index,
+        int64_t timestamp, size_t* entry) {
+    size_t lo = 0, hi = index->num_entries, mid;
+
+    if (index->timestamp_column == UB_BLOCK_INDEX_NO_TIMESTAMP)
+        return UB_EUNSUPPORTED;
+
+    /* find the first block whose last timestamp is not older than the
+     * given timestamp */
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (index->entries[mid].last_timestamp < timestamp)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == index->num_entries)
+        return UB_EOF;
+
+    *entry = lo;
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_block_index_write(const ub_block_index_t* index, FILE* f,
+        ub_chksum_type_t chksum_type) {
+    uint8_t trailer[UB_BLOCK_INDEX_TRAILER_LENGTH];
+    ub_buffer_t payload;
+    size_t i, j, count;
+    ub_error_t retval = UB_SUCCESS;
+    long pos;
+
+    pos = ftell(f);
+    if (pos < 0)
+        return UB_EUNSUPPORTED;
+
+    UB_CHECK(ub_buffer_init(&payload, 0));
+
+    for (i = 0; i < index->num_entries && retval == UB_SUCCESS; i += count) {
+        count = index->num_entries - i;
+        if (count > UB_I_ENTRIES_PER_BLOCK)
+            count = UB_I_ENTRIES_PER_BLOCK;
+
+        retval = ub_buffer_resize(&payload, count * UB_BLOCK_INDEX_ENTRY_LENGTH);
+        if (retval != UB_SUCCESS)
+            break;
+
+        for (j = 0; j < count; j++) {
+            ub_i_encode_entry(UB_BUFFER(payload) + j * UB_BLOCK_INDEX_ENTRY_LENGTH,
+                    &index->entries[i + j]);
+        }
+
+        retval = ub_write_block_from_buffer(f, UB_BLOCK_INDEX, &payload,
+                chksum_type);
+    }
+
+    ub_buffer_destroy(&payload);
+    UB_CHECK(retval);
+
+    ub_i_store_be(trailer, 8, pos);
+    ub_i_store_be(trailer + 8, 8, index->num_entries);
+    trailer[16] = index->timestamp_column;
+
+    return ub_write_block(f, UB_BLOCK_INDEX_TRAILER, trailer, sizeof(trailer),
+            chksum_type);
+}
+
+ub_error_t ub_block_index_read(ub_block_index_t* index, FILE* f,
+        ub_chksum_type_t chksum_type) {
+    long trailer_length = 3 + UB_BLOCK_INDEX_TRAILER_LENGTH +
+        ub_chksum_size(chksum_type);
+    uint8_t header[3];
+    ub_block_type_t block_type;
+    ub_buffer_t payload;
+    uint64_t offset, num_entries;
+    ub_block_index_entry_t entry;
+    const uint8_t* data;
+    size_t i, count;
+    ub_error_t retval = UB_SUCCESS;
+
+    if (fseek(f, -trailer_length, SEEK_END))
+        return ferror(f) ? UB_EUNSUPPORTED : UB_EOF;
+
+    /* check the block header first so we do not try to parse arbitrary
+     * data as a block */
+    if (fread(header, 1, sizeof(header), f) != sizeof(header))
+        return UB_EOF;
+    if (header[0] != UB_BLOCK_INDEX_TRAILER || header[1] != 0 ||
+            header[2] != UB_BLOCK_INDEX_TRAILER_LENGTH)
+        return UB_EOF;
+    if (fseek(f, -(long)sizeof(header), SEEK_CUR))
+        return UB_EUNSUPPORTED;
+
+    UB_CHECK(ub_buffer_init(&payload, 0));
+
+    retval = ub_read_block(f, &block_type, &payload, chksum_type);
+    if (retval == UB_SUCCESS) {
+        data = UB_BUFFER(payload);
+        offset = ub_i_load_be(data, 8);
+        num_entries = ub_i_load_be(data + 8, 8);
+        index->timestamp_column = data[16];
+
+        ub_block_index_clear(index);
+        if (fseek(f, offset, SEEK_SET))
+            retval = UB_EPARSE;
+    }
+
+    while (retval == UB_SUCCESS && index->num_entries < num_entries) {
+        retval = ub_read_block(f, &block_type, &payload, chksum_type);
+        if (retval == UB_EOF || (retval == UB_SUCCESS &&
+                    (block_type != UB_BLOCK_INDEX ||
+                     ub_buffer_size(&payload) % UB_BLOCK_INDEX_ENTRY_LENGTH != 0)))
+            retval = UB_EPARSE;
+        if (retval != UB_SUCCESS)
+            break;
+
+        data = UB_BUFFER(payload);
+        count = ub_buffer_size(&payload) / UB_BLOCK_INDEX_ENTRY_LENGTH;
+        for (i = 0; i < count && retval == UB_SUCCESS; i++) {
+            ub_i_decode_entry(&entry, data + i * UB_BLOCK_INDEX_ENTRY_LENGTH);
+            retval = ub_block_index_append(index, &entry);
+        }
+    }
+
+    if (retval == UB_SUCCESS && index->num_entries != num_entries)
+        retval = UB_EPARSE;
+
+    ub_buffer_destroy(&payload);
+
+    if (retval != UB_SUCCESS)
+        ub_block_index_clear(index);
+
+    return retval;
+}
@@ -0,0 +1,241 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#include <string.h>
+
+#include <unibinlog/bloom_filter.h>
+
+/**
+ * Returns a 64-bit hash of the given bytes: FNV-1a, followed by the
+ * finalizer of MurmurHash3 to spread the bits of short keys.
+ */
+static uint64_t ub_i_hash(const uint8_t* data, size_t length) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+
+    while (length > 0) {
+        hash = (hash ^ *data) * 0x100000001B3ULL;
+        data++; length--;
+    }
+
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+/**
+ * Hashes a single serialized value of the given type, stored in the given
+ * byte order, in its canonical form (see \ref ub_bloom_key_init()).
+ */
+static uint64_t ub_i_hash_value(ub_datatype_t type, const uint8_t* value,
+        size_t length, ub_byte_order_t order) {
+    uint8_t canonical[8];
+    size_t i, j, unit;
+
+    switch (type) {
+        case UB_DATATYPE_STRING:
+            return ub_i_hash(value, length - 1);
+
+        case UB_DATATYPE_SHORT_BLOB:
+            return ub_i_hash(value + 1, length - 1);
+
+        case UB_DATATYPE_BLOB:
+            return ub_i_hash(value + 2, length - 2);
+
+        default:
+            break;
+    }
+
+    if (order == UB_BIG_ENDIAN || length > sizeof(canonical))
+        return ub_i_hash(value, length);
+
+    /* a timeval is stored as two 32-bit integers */
+    unit = type == UB_DATATYPE_TIMEVAL ? 4 : length;
+    for (i = 0; i < length; i += unit)
+        for (j = 0; j < unit; j++)
+            canonical[i + j] = value[i + unit - 1 - j];
+
+    return ub_i_hash(canonical, length);
+}
+
+/**
+ * Returns the index of the bit of the given hash function in a Bloom filter
+ * with the given number of bits, using double hashing.
+ */
+static size_t ub_i_bit_index(uint64_t hash, size_t index, size_t num_bits) {
+    uint32_t h1 = (uint32_t)hash, h2 = (uint32_t)(hash >> 32) | 1;
+    return (size_t)((h1 + (uint64_t)index * h2) % num_bits);
+}
+
+ub_error_t ub_bloom_key_init(ub_bloom_key_t* key, size_t column,
+        ub_datatype_t type, const void* value, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)value;
+
+    if (type == UB_DATATYPE_UNKNOWN || type >= UB_MAX_DATATYPE)
+        return UB_EUNSUPPORTED;
+
+    key->column = column;
+
+    switch (type) {
+        case UB_DATATYPE_STRING:
+        case UB_DATATYPE_SHORT_BLOB:
+        case UB_DATATYPE_BLOB:
+            key->hash = ub_i_hash(bytes, length);
+            break;
+
+        default:
+            key->hash = ub_i_hash_value(type, bytes,
+                    ub_datatype_get_info(type).length, ub_byteorder_native());
+    }
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_bloom_filter_encode(ub_buffer_t* payload,
+        const ub_log_column_t* columns, size_t num_columns, ub_bool_t aligned,
+        ub_byte_order_t order, const uint8_t* rows, size_t length,
+        const size_t* filter_columns, size_t num_filters) {
+    size_t offsets[255], value_offsets[255], value_lengths[255];
+    const uint8_t* end = rows + length;
+    const uint8_t* row;
+    size_t i, j, k, row_length, offset, next, bit;
+    size_t num_rows, num_bytes, num_bits;
+    uint8_t* data;
+    uint64_t hash;
+
+    if (num_columns > 255 || num_filters > 255 ||
+            (num_columns == 0 && length > 0))
+        return UB_EINVAL;
+
+    for (i = 0; i < num_filters; i++) {
+        if (filter_columns[i] >= num_columns)
+            return UB_EINVAL;
+    }
+
+    row_length = ub_log_columns_get_layout(columns, num_columns, aligned,
+            offsets);
+
+    /* count the rows first so we know how large the filters should be */
+    for (row = rows, num_rows = 0; row < end; num_rows++) {
+        if (row_length > 0) {
+            if ((size_t)(end - row) < row_length)
+                return UB_EINVAL;
+            row += row_length;
+            continue;
+        }
+
+        for (i = 0; i < num_columns; i++, row += offset) {
+            offset = ub_datatype_get_value_length(columns[i].type, row,
+                    end - row);
+            if (offset == 0)
+                return UB_EINVAL;
+        }
+    }
+
+    if (num_rows > 65535)
+        return UB_EINVAL;
+
+    num_bytes = (num_rows * UB_BLOOM_FILTER_BITS_PER_ROW + 7) / 8;
+    if (num_bytes == 0)
+        num_bytes = 1;
+    if (num_filters > 0 && num_bytes > (65535 - 3) / num_filters - 4)
+        num_bytes = (65535 - 3) / num_filters - 4;
+    num_bits = num_bytes * 8;
+
+    UB_CHECK(ub_buffer_resize(payload, 3 + num_filters * (4 + num_bytes)));
+    data = UB_BUFFER(*payload);
+    memset(data, 0, ub_buffer_size(payload));
+
+    data[0] = num_rows >> 8;
+    data[1] = num_rows & 0xFF;
+    data[2] = num_filters;
+    for (i = 0; i < num_filters; i++) {
+        data[3 + i * (4 + num_bytes)] = filter_columns[i];
+        data[4 + i * (4 + num_bytes)] = UB_BLOOM_FILTER_NUM_HASHES;
+        data[5 + i * (4 + num_bytes)] = num_bytes >> 8;
+        data[6 + i * (4 + num_bytes)] = num_bytes & 0xFF;
+    }
+
+    for (row = rows; row < end; row += next) {
+        /* locate the values of the row */
+        for (i = 0, offset = 0; i < num_columns; i++) {
+            value_offsets[i] = row_length > 0 ? offsets[i] : offset;
+            value_lengths[i] = ub_datatype_get_value_length(columns[i].type,
+                    row + value_offsets[i], end - row - value_offsets[i]);
+            offset = value_offsets[i] + value_lengths[i];
+        }
+        next = row_length > 0 ? row_length : offset;
+
+        for (i = 0; i < num_filters; i++) {
+            j = filter_columns[i];
+            hash = ub_i_hash_value(columns[j].type, row + value_offsets[j],
+                    value_lengths[j], order);
+            data = UB_BUFFER(*payload) + 7 + i * (4 + num_bytes);
+            for (k = 0; k < UB_BLOOM_FILTER_NUM_HASHES; k++) {
+                bit = ub_i_bit_index(hash, k, num_bits);
+                data[bit / 8] |= 1 << (bit % 8);
+            }
+        }
+    }
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_bloom_filter_may_contain(const uint8_t* data, size_t size,
+        const ub_bloom_key_t* keys, size_t num_keys, size_t* num_rows,
+        ub_bool_t* result) {
+    const uint8_t* end = data + size;
+    size_t i, j, k, column, num_hashes, num_bits, bit, num_filters;
+    ub_bool_t found;
+
+    if (size < 3)
+        return UB_EPARSE;
+
+    if (num_rows)
+        *num_rows = (data[0] << 8) | data[1];
+    num_filters = data[2];
+    data += 3;
+
+    *result = 1;
+
+    for (i = 0; i < num_filters; i++) {
+        if (end - data < 4)
+            return UB_EPARSE;
+
+        column = data[0];
+        num_hashes = data[1];
+        num_bits = ((data[2] << 8) | data[3]) * 8;
+        data += 4;
+        if ((size_t)(end - data) < num_bits / 8)
+            return UB_EPARSE;
+
+        if (*result && num_bits > 0) {
+            /* the block can be skipped if none of the keys of the column
+             * are in the filter */
+            found = 1;
+            for (j = 0; j < num_keys; j++) {
+                if (keys[j].column != column)
+                    continue;
+
+                for (k = 0; k < num_hashes; k++) {
+                    bit = ub_i_bit_index(keys[j].hash, k, num_bits);
+                    if (!(data[bit / 8] & (1 << (bit % 8))))
+                        break;
+                }
+
+                found = k == num_hashes;
+                if (found)
+                    break;
+            }
+
+            if (!found)
+                *result = 0;
+        }
+
+        data += num_bits / 8;
+    }
+
+    return data == end ? UB_SUCCESS : UB_EPARSE;
+}
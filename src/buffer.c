@@ -161,7 +161,7 @@ ub_error_t ub_buffer_reserve(ub_buffer_t* buf, size_t capacity) {
         return UB_SUCCESS;
 
     current_size = ub_buffer_size(buf);
-    new_bytes = realloc(buf->bytes, capacity);
+    new_bytes = ub_realloc(buf->bytes, uint8_t, capacity);
     if (new_bytes == 0) {
         buf->end = buf->alloc_end = 0;
         return UB_ENOMEM;
@@ -226,7 +226,7 @@ ub_error_t ub_buffer_truncate(ub_buffer_t* buf) {
     capacity = ub_buffer_capacity(buf);
 
     if (size < capacity) {
-        new_bytes = realloc(buf->bytes, size);
+        new_bytes = ub_realloc(buf->bytes, uint8_t, size);
         if (new_bytes == 0) {
             buf->end = buf->alloc_end = 0;
             return UB_ENOMEM;
@@ -298,16 +298,15 @@ ub_error_t ub_buffer_validate_checksum(const ub_buffer_t* buf,
         ub_chksum_type_t chksum_type) {
     size_t chksum_size = ub_chksum_size(chksum_type);
     size_t buf_size;
-    uint8_t* chksum;
+    uint8_t chksum[2];
     
     if (chksum_size == 0)
         return UB_SUCCESS;
 
     buf_size = ub_buffer_size(buf);
-    if (buf_size < chksum_size)
+    if (buf_size < chksum_size || chksum_size > sizeof(chksum))
         return UB_FAILURE;
 
-    chksum = ub_calloc(uint8_t, chksum_size);
     UB_CHECK(ub_buffer_get_checksum(buf, chksum, chksum_type, chksum_size));
     return memcmp(chksum, &buf->bytes[buf_size-chksum_size], chksum_size) ?
         UB_FAILURE : UB_SUCCESS;
@@ -0,0 +1,422 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#include <unibinlog/buffer_pool.h>
+#include <unibinlog/memory.h>
+
+#include "config.h"
+#include "utils.h"
+
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
+
+/**
+ * The largest number of threads that have a cache of their own in a buffer
+ * pool; further threads use the shared buffers only.
+ */
+#define UB_I_MAX_CACHES 64
+
+struct ub_i_buffer_pool_state_s;
+
+/**
+ * The idle buffers that a thread keeps for itself. Caches live in the
+ * state of the pool, so they stay valid when the pool is trimmed, and the
+ * threads reach them through a thread-specific key.
+ */
+typedef struct {
+    struct ub_i_buffer_pool_state_s* state;  /**< The state of the pool */
+    ub_buffer_t buffers[UB_BUFFER_POOL_CACHE_LENGTH];  /**< The idle buffers */
+    size_t num_buffers;            /**< The number of idle buffers */
+    ub_bool_t in_use;              /**< Whether a thread owns the cache */
+} ub_i_buffer_pool_cache_t;
+
+/**
+ * The state of a buffer pool.
+ */
+typedef struct ub_i_buffer_pool_state_s {
+    ub_buffer_pool_t* pool;        /**< The pool that owns the state */
+    ub_buffer_t* buffers;          /**< The shared idle buffers */
+    size_t num_buffers;            /**< The number of shared idle buffers */
+    size_t capacity;               /**< The length of \c buffers */
+#ifdef HAVE_PTHREAD
+    pthread_mutex_t lock;          /**< Guards the shared buffers and the caches */
+    pthread_key_t key;             /**< The cache of the current thread */
+    ub_i_buffer_pool_cache_t caches[UB_I_MAX_CACHES];  /**< The caches of the threads */
+#endif
+} ub_i_buffer_pool_state_t;
+
+#ifdef HAVE_PTHREAD
+/**
+ * Value of the thread-specific key of the threads that found no free
+ * cache, so they do not look for one again.
+ */
+static char ub_i_no_cache;
+#endif
+
+/**
+ * The shared pool of the library and its state, which is not allocated so
+ * it does not depend on the allocator that was set when the pool was set up.
+ */
+static ub_buffer_pool_t ub_i_shared_pool;
+static ub_i_buffer_pool_state_t ub_i_shared_state;
+static ub_buffer_pool_t* ub_i_shared = 0;
+
+#ifdef HAVE_PTHREAD
+static pthread_once_t ub_i_shared_once = PTHREAD_ONCE_INIT;
+#else
+static ub_bool_t ub_i_shared_once = 0;
+#endif
+
+static void ub_i_buffer_pool_lock(ub_i_buffer_pool_state_t* state) {
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&state->lock);
+#else
+    (void)state;
+#endif
+}
+
+static void ub_i_buffer_pool_unlock(ub_i_buffer_pool_state_t* state) {
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&state->lock);
+#else
+    (void)state;
+#endif
+}
+
+/**
+ * Adds the capacity of a buffer to the idle bytes of the pool unless that
+ * would exceed the limit of the pool.
+ *
+ * \return whether the buffer fits into the pool
+ */
+static ub_bool_t ub_i_buffer_pool_charge(ub_buffer_pool_t* pool, size_t size) {
+#ifdef HAVE_PTHREAD
+    if (__atomic_add_fetch(&pool->idle_bytes, size, __ATOMIC_RELAXED) <=
+            pool->max_idle_bytes)
+        return 1;
+    __atomic_sub_fetch(&pool->idle_bytes, size, __ATOMIC_RELAXED);
+    return 0;
+#else
+    if (pool->idle_bytes + size > pool->max_idle_bytes)
+        return 0;
+    pool->idle_bytes += size;
+    return 1;
+#endif
+}
+
+/**
+ * Removes the capacity of a buffer from the idle bytes of the pool.
+ */
+static void ub_i_buffer_pool_discharge(ub_buffer_pool_t* pool, size_t size) {
+#ifdef HAVE_PTHREAD
+    __atomic_sub_fetch(&pool->idle_bytes, size, __ATOMIC_RELAXED);
+#else
+    pool->idle_bytes -= size;
+#endif
+}
+
+/**
+ * Adds a buffer to the shared buffers of the pool. The lock of the pool
+ * must be held.
+ *
+ * \return \c UB_SUCCESS or \c UB_ENOMEM
+ */
+static ub_error_t ub_i_buffer_pool_push(ub_i_buffer_pool_state_t* state,
+        const ub_buffer_t* buf) {
+    ub_buffer_t* buffers;
+    size_t capacity;
+
+    if (state->num_buffers == state->capacity) {
+        capacity = state->capacity ? state->capacity * 2 : 8;
+        buffers = ub_realloc(state->buffers, ub_buffer_t, capacity);
+        if (buffers == 0)
+            return UB_ENOMEM;
+        state->buffers = buffers;
+        state->capacity = capacity;
+    }
+
+    state->buffers[state->num_buffers++] = *buf;
+    return UB_SUCCESS;
+}
+
+#ifdef HAVE_PTHREAD
+
+/**
+ * Gives the cache of an exiting thread back to the pool; its buffers
+ * become shared.
+ */
+static void ub_i_buffer_pool_release_cache(void* value) {
+    ub_i_buffer_pool_cache_t* cache = (ub_i_buffer_pool_cache_t*)value;
+    ub_i_buffer_pool_state_t* state;
+    ub_buffer_t* buf;
+
+    if (value == &ub_i_no_cache)
+        return;
+
+    state = cache->state;
+    ub_i_buffer_pool_lock(state);
+    while (cache->num_buffers > 0) {
+        buf = &cache->buffers[--cache->num_buffers];
+        if (ub_i_buffer_pool_push(state, buf)) {
+            ub_i_buffer_pool_discharge(state->pool, ub_buffer_capacity(buf));
+            ub_buffer_destroy(buf);
+        }
+    }
+    cache->in_use = 0;
+    ub_i_buffer_pool_unlock(state);
+}
+
+#endif
+
+/**
+ * Returns the cache of the current thread, claiming a free one on the
+ * first call of the thread.
+ *
+ * \return the cache or null if the thread has none
+ */
+static ub_i_buffer_pool_cache_t* ub_i_buffer_pool_get_cache(
+        ub_i_buffer_pool_state_t* state) {
+#ifdef HAVE_PTHREAD
+    ub_i_buffer_pool_cache_t* cache = 0;
+    void* value;
+    size_t i;
+
+    value = pthread_getspecific(state->key);
+    if (value == &ub_i_no_cache)
+        return 0;
+    if (value != 0)
+        return (ub_i_buffer_pool_cache_t*)value;
+
+    ub_i_buffer_pool_lock(state);
+    for (i = 0; i < UB_I_MAX_CACHES; i++) {
+        if (!state->caches[i].in_use) {
+            cache = &state->caches[i];
+            cache->in_use = 1;
+            break;
+        }
+    }
+    ub_i_buffer_pool_unlock(state);
+
+    if (pthread_setspecific(state->key, cache ? (void*)cache : &ub_i_no_cache)) {
+        if (cache != 0)
+            cache->in_use = 0;
+        return 0;
+    }
+
+    return cache;
+#else
+    (void)state;
+    return 0;
+#endif
+}
+
+/**
+ * Sets up a buffer pool with the given state, which must be zeroed.
+ */
+static ub_error_t ub_i_buffer_pool_setup(ub_buffer_pool_t* pool,
+        ub_i_buffer_pool_state_t* state, size_t buffer_size,
+        size_t max_idle_bytes) {
+#ifdef HAVE_PTHREAD
+    size_t i;
+
+    if (pthread_mutex_init(&state->lock, 0))
+        return UB_ENOMEM;
+    if (pthread_key_create(&state->key, ub_i_buffer_pool_release_cache)) {
+        pthread_mutex_destroy(&state->lock);
+        return UB_ENOMEM;
+    }
+    for (i = 0; i < UB_I_MAX_CACHES; i++)
+        state->caches[i].state = state;
+#endif
+
+    state->pool = pool;
+    pool->buffer_size = buffer_size;
+    pool->max_idle_bytes = max_idle_bytes;
+    pool->idle_bytes = 0;
+    pool->state = state;
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_buffer_pool_init(ub_buffer_pool_t* pool, size_t buffer_size,
+        size_t max_idle_bytes) {
+    ub_i_buffer_pool_state_t* state;
+    ub_error_t retval;
+
+    if (buffer_size == 0)
+        return UB_EINVAL;
+
+    state = ub_calloc(ub_i_buffer_pool_state_t, 1);
+    if (state == 0)
+        return UB_ENOMEM;
+
+    retval = ub_i_buffer_pool_setup(pool, state, buffer_size, max_idle_bytes);
+    if (retval != UB_SUCCESS)
+        ub_free(state);
+
+    return retval;
+}
+
+void ub_buffer_pool_destroy(ub_buffer_pool_t* pool) {
+    ub_i_buffer_pool_state_t* state = (ub_i_buffer_pool_state_t*)pool->state;
+
+    if (state == 0)
+        return;
+
+    ub_buffer_pool_trim(pool);
+
+#ifdef HAVE_PTHREAD
+    pthread_key_delete(state->key);
+    pthread_mutex_destroy(&state->lock);
+#endif
+
+    ub_free(state);
+    pool->state = 0;
+}
+
+ub_error_t ub_buffer_pool_acquire(ub_buffer_pool_t* pool, ub_buffer_t* buf) {
+    ub_i_buffer_pool_state_t* state;
+    ub_i_buffer_pool_cache_t* cache;
+    ub_bool_t found = 0;
+
+    if (pool == 0) {
+        UB_CHECK(ub_buffer_init(buf, UB_BUFFER_POOL_BUFFER_SIZE));
+        buf->end = buf->bytes;
+        return UB_SUCCESS;
+    }
+
+    state = (ub_i_buffer_pool_state_t*)pool->state;
+
+    /* try the cache of the thread first, then the shared buffers */
+    cache = ub_i_buffer_pool_get_cache(state);
+    if (cache != 0 && cache->num_buffers > 0) {
+        *buf = cache->buffers[--cache->num_buffers];
+        found = 1;
+    } else {
+        ub_i_buffer_pool_lock(state);
+        if (state->num_buffers > 0) {
+            *buf = state->buffers[--state->num_buffers];
+            found = 1;
+        }
+        ub_i_buffer_pool_unlock(state);
+    }
+
+    if (!found) {
+        UB_CHECK(ub_buffer_init(buf, pool->buffer_size));
+        buf->end = buf->bytes;
+        return UB_SUCCESS;
+    }
+
+    ub_i_buffer_pool_discharge(pool, ub_buffer_capacity(buf));
+    buf->end = buf->bytes;
+
+    /* buffers given back from elsewhere may be smaller than the others */
+    if (ub_buffer_reserve(buf, pool->buffer_size)) {
+        ub_buffer_destroy(buf);
+        return UB_ENOMEM;
+    }
+
+    return UB_SUCCESS;
+}
+
+void ub_buffer_pool_release(ub_buffer_pool_t* pool, ub_buffer_t* buf) {
+    ub_i_buffer_pool_state_t* state;
+    ub_i_buffer_pool_cache_t* cache;
+    size_t size;
+    ub_error_t retval;
+
+    if (pool == 0 || !buf->owner || buf->bytes == 0) {
+        ub_buffer_destroy(buf);
+        return;
+    }
+
+    size = ub_buffer_capacity(buf);
+    if (!ub_i_buffer_pool_charge(pool, size)) {
+        ub_buffer_destroy(buf);
+        return;
+    }
+
+    state = (ub_i_buffer_pool_state_t*)pool->state;
+
+    cache = ub_i_buffer_pool_get_cache(state);
+    if (cache != 0 && cache->num_buffers < UB_BUFFER_POOL_CACHE_LENGTH) {
+        cache->buffers[cache->num_buffers++] = *buf;
+        return;
+    }
+
+    ub_i_buffer_pool_lock(state);
+    retval = ub_i_buffer_pool_push(state, buf);
+    ub_i_buffer_pool_unlock(state);
+
+    if (retval != UB_SUCCESS) {
+        ub_i_buffer_pool_discharge(pool, size);
+        ub_buffer_destroy(buf);
+    }
+}
+
+void ub_buffer_pool_trim(ub_buffer_pool_t* pool) {
+    ub_i_buffer_pool_state_t* state = (ub_i_buffer_pool_state_t*)pool->state;
+#ifdef HAVE_PTHREAD
+    ub_i_buffer_pool_cache_t* cache;
+    size_t i;
+#endif
+
+    ub_i_buffer_pool_lock(state);
+
+#ifdef HAVE_PTHREAD
+    for (i = 0; i < UB_I_MAX_CACHES; i++) {
+        cache = &state->caches[i];
+        while (cache->num_buffers > 0) {
+            ub_buffer_destroy(&cache->buffers[--cache->num_buffers]);
+        }
+    }
+#endif
+
+    while (state->num_buffers > 0) {
+        ub_buffer_destroy(&state->buffers[--state->num_buffers]);
+    }
+    ub_free_unless_null(state->buffers);
+    state->capacity = 0;
+    pool->idle_bytes = 0;
+
+    ub_i_buffer_pool_unlock(state);
+}
+
+/**
+ * Sets up the shared pool of the library.
+ */
+static void ub_i_buffer_pool_setup_shared(void) {
+    if (ub_i_buffer_pool_setup(&ub_i_shared_pool, &ub_i_shared_state,
+                UB_BUFFER_POOL_BUFFER_SIZE, UB_BUFFER_POOL_SHARED_LIMIT))
+        return;
+
+#ifdef HAVE_PTHREAD
+    __atomic_store_n(&ub_i_shared, &ub_i_shared_pool, __ATOMIC_RELEASE);
+#else
+    ub_i_shared = &ub_i_shared_pool;
+#endif
+}
+
+ub_buffer_pool_t* ub_buffer_pool_get_shared(void) {
+#ifdef HAVE_PTHREAD
+    pthread_once(&ub_i_shared_once, ub_i_buffer_pool_setup_shared);
+    return __atomic_load_n(&ub_i_shared, __ATOMIC_ACQUIRE);
+#else
+    if (!ub_i_shared_once) {
+        ub_i_shared_once = 1;
+        ub_i_buffer_pool_setup_shared();
+    }
+    return ub_i_shared;
+#endif
+}
+
+void ub_buffer_pool_trim_shared(void) {
+#ifdef HAVE_PTHREAD
+    ub_buffer_pool_t* pool = __atomic_load_n(&ub_i_shared, __ATOMIC_ACQUIRE);
+#else
+    ub_buffer_pool_t* pool = ub_i_shared;
+#endif
+
+    if (pool != 0)
+        ub_buffer_pool_trim(pool);
+}
@@ -0,0 +1,448 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#include <string.h>
+
+#include <unibinlog/byteorder.h>
+#include "config.h"
+#include "utils.h"
+
+#ifdef HAVE_X86_SIMD_DISPATCH
+#  include <immintrin.h>
+#endif
+
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
+
+/* Floating-point values can be swapped like integers of the same width if
+ * the bytes of floats are laid out the same way as the bytes of integers */
+#if defined(HAVE_IEEE754_FLOATS) && \
+    ((defined(WORDS_BIGENDIAN) && defined(HAVE_FLOAT_BYTES_BIGENDIAN) && \
+      defined(HAVE_FLOAT_WORDS_BIGENDIAN)) || \
+     (!defined(WORDS_BIGENDIAN) && !defined(HAVE_FLOAT_BYTES_BIGENDIAN) && \
+      !defined(HAVE_FLOAT_WORDS_BIGENDIAN)))
+#  define UB_I_FLOATS_LIKE_INTEGERS
+#endif
+
+#if defined(__GNUC__)
+#  define UB_I_BSWAP16(x) __builtin_bswap16(x)
+#  define UB_I_BSWAP32(x) __builtin_bswap32(x)
+#  define UB_I_BSWAP64(x) __builtin_bswap64(x)
+#else
+#  define UB_I_BSWAP16(x) ((uint16_t)(((x) >> 8) | ((x) << 8)))
+#  define UB_I_BSWAP32(x) \
+    ((((x) & 0xFF000000u) >> 24) | (((x) & 0x00FF0000u) >> 8) | \
+     (((x) & 0x0000FF00u) << 8) | (((x) & 0x000000FFu) << 24))
+#  define UB_I_BSWAP64(x) \
+    (((uint64_t)UB_I_BSWAP32((uint32_t)(x)) << 32) | \
+     UB_I_BSWAP32((uint32_t)((x) >> 32)))
+#endif
+
+typedef void ub_i_swap_func_t(void* dest, const void* src, size_t count);
+
+/**
+ * Batch byte swapping functions of a kernel for each value width.
+ */
+typedef struct {
+    ub_i_swap_func_t* swap16;
+    ub_i_swap_func_t* swap32;
+    ub_i_swap_func_t* swap64;
+} ub_i_kernel_t;
+
+/* Portable kernel ***********************************************************/
+
+static void ub_i_swap16_scalar(void* dest, const void* src, size_t count) {
+    const uint8_t* s = (const uint8_t*)src;
+    uint8_t* d = (uint8_t*)dest;
+    uint16_t value;
+
+    for (; count > 0; count--, s += 2, d += 2) {
+        memcpy(&value, s, 2);
+        value = UB_I_BSWAP16(value);
+        memcpy(d, &value, 2);
+    }
+}
+
+static void ub_i_swap32_scalar(void* dest, const void* src, size_t count) {
+    const uint8_t* s = (const uint8_t*)src;
+    uint8_t* d = (uint8_t*)dest;
+    uint32_t value;
+
+    for (; count > 0; count--, s += 4, d += 4) {
+        memcpy(&value, s, 4);
+        value = UB_I_BSWAP32(value);
+        memcpy(d, &value, 4);
+    }
+}
+
+static void ub_i_swap64_scalar(void* dest, const void* src, size_t count) {
+    const uint8_t* s = (const uint8_t*)src;
+    uint8_t* d = (uint8_t*)dest;
+    uint64_t value;
+
+    for (; count > 0; count--, s += 8, d += 8) {
+        memcpy(&value, s, 8);
+        value = UB_I_BSWAP64(value);
+        memcpy(d, &value, 8);
+    }
+}
+
+/* x86 kernels ***************************************************************/
+
+#ifdef HAVE_X86_SIMD_DISPATCH
+
+/**
+ * Swaps the bytes of values of the given width in 16-byte chunks, as long as
+ * there are full chunks left. Returns the number of bytes processed.
+ */
+__attribute__((target("ssse3")))
+static size_t ub_i_swap_chunks_ssse3(uint8_t* d, const uint8_t* s,
+        size_t length, size_t width) {
+    __m128i mask, value;
+    size_t i;
+
+    if (width == 2) {
+        mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    } else if (width == 4) {
+        mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    } else {
+        mask = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    }
+
+    for (i = 0; i + 16 <= length; i += 16) {
+        value = _mm_loadu_si128((const __m128i*)(s + i));
+        _mm_storeu_si128((__m128i*)(d + i), _mm_shuffle_epi8(value, mask));
+    }
+
+    return i;
+}
+
+/**
+ * Swaps the bytes of values of the given width in 32-byte chunks, as long as
+ * there are full chunks left. Returns the number of bytes processed.
+ */
+__attribute__((target("avx2")))
+static size_t ub_i_swap_chunks_avx2(uint8_t* d, const uint8_t* s,
+        size_t length, size_t width) {
+    __m256i mask, value;
+    size_t i;
+
+    /* the shuffle works within 128-bit lanes so the mask repeats */
+    if (width == 2) {
+        mask = _mm256_setr_epi8(
+                1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    } else if (width == 4) {
+        mask = _mm256_setr_epi8(
+                3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    } else {
+        mask = _mm256_setr_epi8(
+                7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    }
+
+    for (i = 0; i + 32 <= length; i += 32) {
+        value = _mm256_loadu_si256((const __m256i*)(s + i));
+        _mm256_storeu_si256((__m256i*)(d + i), _mm256_shuffle_epi8(value, mask));
+    }
+
+    return i;
+}
+
+#define UB_I_DEFINE_SIMD_SWAP(isa, bits, width)                               \
+    static void ub_i_swap##bits##_##isa(void* dest, const void* src,         \
+            size_t count) {                                                  \
+        size_t done = ub_i_swap_chunks_##isa((uint8_t*)dest,                 \
+                (const uint8_t*)src, count * width, width);                  \
+        ub_i_swap##bits##_scalar((uint8_t*)dest + done,                      \
+                (const uint8_t*)src + done, count - done / width);           \
+    }
+
+UB_I_DEFINE_SIMD_SWAP(ssse3, 16, 2)
+UB_I_DEFINE_SIMD_SWAP(ssse3, 32, 4)
+UB_I_DEFINE_SIMD_SWAP(ssse3, 64, 8)
+UB_I_DEFINE_SIMD_SWAP(avx2, 16, 2)
+UB_I_DEFINE_SIMD_SWAP(avx2, 32, 4)
+UB_I_DEFINE_SIMD_SWAP(avx2, 64, 8)
+
+#undef UB_I_DEFINE_SIMD_SWAP
+
+#endif
+
+ub_byte_order_t ub_byteorder_native(void) {
+#ifdef WORDS_BIGENDIAN
+    return UB_BIG_ENDIAN;
+#else
+    return UB_LITTLE_ENDIAN;
+#endif
+}
+
+/* Kernel selection **********************************************************/
+
+static const ub_i_kernel_t ub_i_kernels[UB_MAX_BYTEORDER_KERNEL] = {
+    /* UB_BYTEORDER_KERNEL_AUTO */
+    { 0, 0, 0 },
+    /* UB_BYTEORDER_KERNEL_SCALAR */
+    { ub_i_swap16_scalar, ub_i_swap32_scalar, ub_i_swap64_scalar },
+#ifdef HAVE_X86_SIMD_DISPATCH
+    /* UB_BYTEORDER_KERNEL_SSSE3 */
+    { ub_i_swap16_ssse3, ub_i_swap32_ssse3, ub_i_swap64_ssse3 },
+    /* UB_BYTEORDER_KERNEL_AVX2 */
+    { ub_i_swap16_avx2, ub_i_swap32_avx2, ub_i_swap64_avx2 }
+#else
+    { 0, 0, 0 },
+    { 0, 0, 0 }
+#endif
+};
+
+/** The kernel selected with \ref ub_byteorder_set_kernel() */
+static ub_byteorder_kernel_t ub_i_kernel = UB_BYTEORDER_KERNEL_AUTO;
+
+/** The best kernel supported by the CPU; detected once */
+static ub_byteorder_kernel_t ub_i_best_kernel = UB_BYTEORDER_KERNEL_AUTO;
+
+#ifdef HAVE_PTHREAD
+static pthread_once_t ub_i_best_kernel_once = PTHREAD_ONCE_INIT;
+#else
+static ub_bool_t ub_i_best_kernel_once = 0;
+#endif
+
+/**
+ * Tells whether the CPU supports the given kernel. The features of the CPU
+ * must have been detected by \ref ub_i_get_best_kernel() first.
+ */
+static ub_bool_t ub_i_kernel_is_supported(ub_byteorder_kernel_t kernel) {
+    switch (kernel) {
+        case UB_BYTEORDER_KERNEL_SCALAR:
+            return 1;
+
+#ifdef HAVE_X86_SIMD_DISPATCH
+        case UB_BYTEORDER_KERNEL_SSSE3:
+            return __builtin_cpu_supports("ssse3") != 0;
+
+        case UB_BYTEORDER_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2") != 0;
+#endif
+
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Detects the features of the CPU and selects the best kernel.
+ */
+static void ub_i_detect_best_kernel(void) {
+    ub_byteorder_kernel_t kernel = UB_MAX_BYTEORDER_KERNEL - 1;
+
+#ifdef HAVE_X86_SIMD_DISPATCH
+    __builtin_cpu_init();
+#endif
+    while (!ub_i_kernel_is_supported(kernel))
+        kernel--;
+    ub_i_best_kernel = kernel;
+}
+
+/**
+ * Returns the best kernel supported by the CPU, detecting it on the first
+ * call.
+ */
+static ub_byteorder_kernel_t ub_i_get_best_kernel(void) {
+#ifdef HAVE_PTHREAD
+    pthread_once(&ub_i_best_kernel_once, ub_i_detect_best_kernel);
+#else
+    if (!ub_i_best_kernel_once) {
+        ub_i_best_kernel_once = 1;
+        ub_i_detect_best_kernel();
+    }
+#endif
+    return ub_i_best_kernel;
+}
+
+ub_byteorder_kernel_t ub_byteorder_get_kernel(void) {
+#ifdef HAVE_PTHREAD
+    ub_byteorder_kernel_t kernel = __atomic_load_n(&ub_i_kernel,
+            __ATOMIC_RELAXED);
+#else
+    ub_byteorder_kernel_t kernel = ub_i_kernel;
+#endif
+
+    return kernel != UB_BYTEORDER_KERNEL_AUTO ? kernel :
+        ub_i_get_best_kernel();
+}
+
+ub_error_t ub_byteorder_set_kernel(ub_byteorder_kernel_t kernel) {
+    ub_i_get_best_kernel();
+
+    if (kernel != UB_BYTEORDER_KERNEL_AUTO &&
+            (kernel >= UB_MAX_BYTEORDER_KERNEL ||
+             !ub_i_kernel_is_supported(kernel)))
+        return UB_EUNSUPPORTED;
+
+#ifdef HAVE_PTHREAD
+    __atomic_store_n(&ub_i_kernel, kernel, __ATOMIC_RELAXED);
+#else
+    ub_i_kernel = kernel;
+#endif
+    return UB_SUCCESS;
+}
+
+void ub_byteorder_swap16(void* dest, const void* src, size_t count) {
+    ub_i_kernels[ub_byteorder_get_kernel()].swap16(dest, src, count);
+}
+
+void ub_byteorder_swap32(void* dest, const void* src, size_t count) {
+    ub_i_kernels[ub_byteorder_get_kernel()].swap32(dest, src, count);
+}
+
+void ub_byteorder_swap64(void* dest, const void* src, size_t count) {
+    ub_i_kernels[ub_byteorder_get_kernel()].swap64(dest, src, count);
+}
+
+/* Column conversion *********************************************************/
+
+#if defined(HAVE_IEEE754_FLOATS) && !defined(UB_I_FLOATS_LIKE_INTEGERS)
+static void ub_i_convert_floats(void* dest, const void* src, size_t count) {
+    const uint8_t* s = (const uint8_t*)src;
+    uint8_t* d = (uint8_t*)dest;
+    float value;
+
+    for (; count > 0; count--, s += sizeof(value), d += sizeof(value)) {
+        memcpy(&value, s, sizeof(value));
+        value = htonf(value);
+        memcpy(d, &value, sizeof(value));
+    }
+}
+
+static void ub_i_convert_doubles(void* dest, const void* src, size_t count) {
+    const uint8_t* s = (const uint8_t*)src;
+    uint8_t* d = (uint8_t*)dest;
+    double value;
+
+    for (; count > 0; count--, s += sizeof(value), d += sizeof(value)) {
+        memcpy(&value, s, sizeof(value));
+        value = htonlf(value);
+        memcpy(d, &value, sizeof(value));
+    }
+}
+#endif
+
+ub_bool_t ub_byteorder_supports_type(ub_datatype_t type,
+        ub_byte_order_t order) {
+    switch (type) {
+        case UB_DATATYPE_BOOLEAN:
+        case UB_DATATYPE_U8:
+        case UB_DATATYPE_S8:
+        case UB_DATATYPE_CHAR:
+        case UB_DATATYPE_U16:
+        case UB_DATATYPE_S16:
+        case UB_DATATYPE_U32:
+        case UB_DATATYPE_S32:
+        case UB_DATATYPE_U64:
+        case UB_DATATYPE_S64:
+        case UB_DATATYPE_UNIX_TIMESTAMP:
+            return 1;
+
+        case UB_DATATYPE_FLOAT:
+        case UB_DATATYPE_DOUBLE:
+#if defined(UB_I_FLOATS_LIKE_INTEGERS)
+            return 1;
+#elif defined(HAVE_IEEE754_FLOATS)
+            return order == UB_BIG_ENDIAN;
+#else
+            return 0;
+#endif
+
+        default:
+            return 0;
+    }
+}
+
+ub_error_t ub_byteorder_decode_column(ub_datatype_t type,
+        ub_byte_order_t order, void* dest, const void* src, size_t count) {
+    size_t width;
+
+    if (!ub_byteorder_supports_type(type, order))
+        return UB_EUNSUPPORTED;
+
+#if defined(HAVE_IEEE754_FLOATS) && !defined(UB_I_FLOATS_LIKE_INTEGERS)
+    if (type == UB_DATATYPE_FLOAT) {
+        ub_i_convert_floats(dest, src, count);
+        return UB_SUCCESS;
+    }
+    if (type == UB_DATATYPE_DOUBLE) {
+        ub_i_convert_doubles(dest, src, count);
+        return UB_SUCCESS;
+    }
+#endif
+
+    width = ub_datatype_get_info(type).length;
+    if (width == 1 || order == ub_byteorder_native()) {
+        if (dest != src)
+            memcpy(dest, src, count * width);
+    } else if (width == 2) {
+        ub_byteorder_swap16(dest, src, count);
+    } else if (width == 4) {
+        ub_byteorder_swap32(dest, src, count);
+    } else {
+        ub_byteorder_swap64(dest, src, count);
+    }
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_byteorder_encode_column(ub_datatype_t type,
+        ub_byte_order_t order, void* dest, const void* src, size_t count) {
+    /* swapping bytes is its own inverse */
+    return ub_byteorder_decode_column(type, order, dest, src, count);
+}
+
+ub_error_t ub_byteorder_decode_int64(ub_datatype_t type,
+        ub_byte_order_t order, const void* src, int64_t* value) {
+    union {
+        uint8_t u8;
+        int8_t s8;
+        uint16_t u16;
+        int16_t s16;
+        uint32_t u32[2];
+        int32_t s32;
+        uint64_t u64;
+        int64_t s64;
+    } v;
+
+    switch (type) {
+        case UB_DATATYPE_BOOLEAN:
+        case UB_DATATYPE_U8:
+            *value = *(const uint8_t*)src;
+            return UB_SUCCESS;
+
+        case UB_DATATYPE_S8:
+            *value = *(const int8_t*)src;
+            return UB_SUCCESS;
+
+        case UB_DATATYPE_TIMEVAL:
+            UB_CHECK(ub_byteorder_decode_column(UB_DATATYPE_U32, order,
+                        v.u32, src, 2));
+            *value = (int64_t)v.u32[0] * 1000000 + v.u32[1];
+            return UB_SUCCESS;
+
+        default:
+            break;
+    }
+
+    UB_CHECK(ub_byteorder_decode_column(type, order, &v, src, 1));
+
+    switch (type) {
+        case UB_DATATYPE_U16: *value = v.u16; break;
+        case UB_DATATYPE_S16: *value = v.s16; break;
+        case UB_DATATYPE_U32: *value = v.u32[0]; break;
+        case UB_DATATYPE_S32: *value = v.s32; break;
+        case UB_DATATYPE_U64:
+        case UB_DATATYPE_UNIX_TIMESTAMP: *value = (int64_t)v.u64; break;
+        case UB_DATATYPE_S64: *value = v.s64; break;
+        default: return UB_EUNSUPPORTED;
+    }
+
+    return UB_SUCCESS;
+}
@@ -0,0 +1,468 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#include <assert.h>
+#include <string.h>
+
+#include <unibinlog/buffer_pool.h>
+#include <unibinlog/codec.h>
+#include <unibinlog/memory.h>
+
+/**
+ * Loads an unsigned integer of the given width (in bytes) stored in network
+ * byte order.
+ */
+static uint64_t ub_i_load_be(const uint8_t* bytes, size_t width) {
+    uint64_t result = 0;
+    while (width > 0) {
+        result = (result << 8) | *bytes;
+        bytes++; width--;
+    }
+    return result;
+}
+
+/**
+ * Stores an unsigned integer on the given number of bytes in network byte
+ * order.
+ */
+static void ub_i_store_be(uint8_t* bytes, size_t width, uint64_t value) {
+    while (width > 0) {
+        width--;
+        bytes[width] = value & 0xFF;
+        value >>= 8;
+    }
+}
+
+/**
+ * Returns the difference of two integers of the given width, sign-extended
+ * to 64 bits and mapped to an unsigned integer with zigzag encoding so that
+ * small differences of either sign are mapped to small numbers.
+ */
+static uint64_t ub_i_zigzag_diff(uint64_t value, uint64_t prev, size_t width) {
+    unsigned int shift = 64 - 8 * width;
+    int64_t diff = (int64_t)((value - prev) << shift) >> shift;
+    return ((uint64_t)diff << 1) ^ (uint64_t)(diff >> 63);
+}
+
+/**
+ * Returns the number of bytes needed to store the given value as a varint.
+ */
+static size_t ub_i_varint_size(uint64_t value) {
+    size_t result = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        result++;
+    }
+    return result;
+}
+
+static ub_error_t ub_i_write_varint(ub_buffer_writer_t* writer, uint64_t value) {
+    while (value >= 0x80) {
+        UB_CHECK(ub_buffer_writer_write_u8(writer, (value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    return ub_buffer_writer_write_u8(writer, value);
+}
+
+static ub_error_t ub_i_write_bytes(ub_buffer_writer_t* writer,
+        const uint8_t* bytes, size_t num_bytes) {
+    while (num_bytes > 0) {
+        UB_CHECK(ub_buffer_writer_write_u8(writer, *bytes));
+        bytes++; num_bytes--;
+    }
+    return UB_SUCCESS;
+}
+
+static ub_error_t ub_i_read_varint(const uint8_t** ptr, const uint8_t* end,
+        uint64_t* value) {
+    const uint8_t* p = *ptr;
+    unsigned int shift = 0;
+
+    *value = 0;
+    while (p < end && shift < 64) {
+        *value |= ((uint64_t)(*p & 0x7F)) << shift;
+        if ((*p++ & 0x80) == 0) {
+            *ptr = p;
+            return UB_SUCCESS;
+        }
+        shift += 7;
+    }
+
+    return UB_EPARSE;
+}
+
+/**
+ * Returns the number of bytes that the given codec would need to encode the
+ * given column, assuming that the codec supports the data type.
+ */
+static size_t ub_i_codec_encoded_size(ub_codec_t codec, size_t width,
+        const uint8_t* values, size_t num_values) {
+    const uint8_t* end = values + width * num_values;
+    const uint8_t* run_start;
+    uint64_t value, prev;
+    size_t result;
+
+    if (num_values == 0)
+        return 0;
+
+    switch (codec) {
+        case UB_CODEC_DELTA:
+            result = width;
+            prev = ub_i_load_be(values, width);
+            for (values += width; values < end; values += width) {
+                value = ub_i_load_be(values, width);
+                result += ub_i_varint_size(ub_i_zigzag_diff(value, prev, width));
+                prev = value;
+            }
+            return result;
+
+        case UB_CODEC_RLE:
+            result = 0;
+            while (values < end) {
+                run_start = values;
+                for (values += width; values < end; values += width) {
+                    if (memcmp(values, run_start, width))
+                        break;
+                }
+                result += ub_i_varint_size((values - run_start) / width) + width;
+            }
+            return result;
+
+        default:
+            return width * num_values;
+    }
+}
+
+ub_bool_t ub_codec_supports(ub_codec_t codec, ub_datatype_t type) {
+    ub_typeinfo_t info = ub_datatype_get_info(type);
+
+    if (info.is_variable_length || info.length == 0)
+        return 0;
+
+    switch (codec) {
+        case UB_CODEC_RAW:
+        case UB_CODEC_RLE:
+            return 1;
+
+        case UB_CODEC_DELTA:
+            switch (type) {
+                case UB_DATATYPE_U8:
+                case UB_DATATYPE_S8:
+                case UB_DATATYPE_U16:
+                case UB_DATATYPE_S16:
+                case UB_DATATYPE_U32:
+                case UB_DATATYPE_S32:
+                case UB_DATATYPE_U64:
+                case UB_DATATYPE_S64:
+                case UB_DATATYPE_UNIX_TIMESTAMP:
+                    return 1;
+                default:
+                    return 0;
+            }
+
+        default:
+            return 0;
+    }
+}
+
+ub_error_t ub_codec_encode(ub_codec_t codec, ub_datatype_t type,
+        const void* values_, size_t num_values, ub_buffer_writer_t* writer) {
+    const uint8_t* values = (const uint8_t*)values_;
+    size_t width = ub_datatype_get_info(type).length;
+    const uint8_t* end = values + width * num_values;
+    const uint8_t* run_start;
+    uint64_t value, prev;
+
+    if (!ub_codec_supports(codec, type))
+        return UB_EUNSUPPORTED;
+
+    if (num_values == 0)
+        return UB_SUCCESS;
+
+    switch (codec) {
+        case UB_CODEC_RAW:
+            UB_CHECK(ub_i_write_bytes(writer, values, end - values));
+            break;
+
+        case UB_CODEC_DELTA:
+            UB_CHECK(ub_i_write_bytes(writer, values, width));
+            prev = ub_i_load_be(values, width);
+            for (values += width; values < end; values += width) {
+                value = ub_i_load_be(values, width);
+                UB_CHECK(ub_i_write_varint(writer, ub_i_zigzag_diff(value, prev, width)));
+                prev = value;
+            }
+            break;
+
+        case UB_CODEC_RLE:
+            while (values < end) {
+                run_start = values;
+                for (values += width; values < end; values += width) {
+                    if (memcmp(values, run_start, width))
+                        break;
+                }
+                UB_CHECK(ub_i_write_varint(writer, (values - run_start) / width));
+                UB_CHECK(ub_i_write_bytes(writer, run_start, width));
+            }
+            break;
+
+        default:
+            return UB_EUNSUPPORTED;
+    }
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_codec_decode(ub_codec_t codec, ub_datatype_t type,
+        const void* data_, size_t size, size_t num_values, void* values_) {
+    const uint8_t* data = (const uint8_t*)data_;
+    const uint8_t* data_end = data + size;
+    uint8_t* values = (uint8_t*)values_;
+    size_t width = ub_datatype_get_info(type).length;
+    uint64_t value, zigzag, run_length;
+
+    if (!ub_codec_supports(codec, type))
+        return UB_EUNSUPPORTED;
+
+    if (num_values == 0)
+        return UB_SUCCESS;
+
+    switch (codec) {
+        case UB_CODEC_RAW:
+            if (size < width * num_values)
+                return UB_EPARSE;
+            memcpy(values, data, width * num_values);
+            break;
+
+        case UB_CODEC_DELTA:
+            if (size < width)
+                return UB_EPARSE;
+            value = ub_i_load_be(data, width);
+            ub_i_store_be(values, width, value);
+            data += width; values += width; num_values--;
+            while (num_values > 0) {
+                UB_CHECK(ub_i_read_varint(&data, data_end, &zigzag));
+                value += (zigzag >> 1) ^ (~(zigzag & 1) + 1);
+                ub_i_store_be(values, width, value);
+                values += width; num_values--;
+            }
+            break;
+
+        case UB_CODEC_RLE:
+            while (num_values > 0) {
+                UB_CHECK(ub_i_read_varint(&data, data_end, &run_length));
+                if (run_length == 0 || run_length > num_values ||
+                        data_end - data < width)
+                    return UB_EPARSE;
+                num_values -= run_length;
+                while (run_length > 0) {
+                    memcpy(values, data, width);
+                    values += width; run_length--;
+                }
+                data += width;
+            }
+            break;
+
+        default:
+            return UB_EUNSUPPORTED;
+    }
+
+    return UB_SUCCESS;
+}
+
+ub_codec_t ub_codec_select(ub_datatype_t type, const void* values,
+        size_t num_values, size_t sample_size) {
+    size_t width = ub_datatype_get_info(type).length;
+    ub_codec_t codec, best_codec = UB_CODEC_RAW;
+    size_t size, best_size;
+
+    if (sample_size > 0 && sample_size < num_values)
+        num_values = sample_size;
+
+    best_size = width * num_values;
+    for (codec = UB_CODEC_RAW + 1; codec < UB_MAX_CODEC; codec++) {
+        if (!ub_codec_supports(codec, type))
+            continue;
+
+        size = ub_i_codec_encoded_size(codec, width, values, num_values);
+        if (size < best_size) {
+            best_size = size;
+            best_codec = codec;
+        }
+    }
+
+    return best_codec;
+}
+
+ub_error_t ub_codec_encode_log_entries(const ub_log_column_t* columns,
+        size_t num_columns, const void* rows_, size_t num_rows,
+        ub_codec_t codec, size_t sample_size, ub_buffer_t* payload) {
+    const uint8_t* rows = (const uint8_t*)rows_;
+    size_t row_length = ub_log_columns_get_total_length(columns, num_columns);
+    size_t i, j, offset, width, encoded_size;
+    long header, start, end;
+    ub_buffer_writer_t writer;
+    ub_buffer_pool_t* pool;
+    ub_buffer_t column;
+    ub_datatype_t type;
+    ub_codec_t column_codec;
+    ub_error_t retval = UB_SUCCESS;
+
+    if (row_length == 0)
+        return UB_EUNSUPPORTED;
+
+    if (num_rows > 65535)
+        return UB_ETOOLONG;
+
+    /* the values of a column are gathered into a buffer of the shared pool */
+    pool = ub_buffer_pool_get_shared();
+    UB_CHECK(ub_buffer_pool_acquire(pool, &column));
+    retval = ub_buffer_resize(&column, num_rows * 8);
+    if (retval == UB_SUCCESS)
+        retval = ub_buffer_writer_init(&writer, payload, 0, /* grow = */ 1);
+    if (retval != UB_SUCCESS) {
+        ub_buffer_pool_release(pool, &column);
+        return retval;
+    }
+
+    retval = ub_buffer_writer_write_u16(&writer, num_rows);
+
+    for (i = 0, offset = 0; i < num_columns && retval == UB_SUCCESS; i++) {
+        type = ub_log_column_get_type(&columns[i]);
+        width = ub_log_column_get_length(&columns[i]);
+
+        /* gather the values of the column */
+        for (j = 0; j < num_rows; j++) {
+            memcpy(UB_BUFFER(column) + j * width, rows + j * row_length + offset,
+                    width);
+        }
+        offset += width;
+
+        /* select the codec to use for this column */
+        column_codec = codec;
+        if (column_codec == UB_CODEC_AUTO) {
+            column_codec = ub_codec_select(type, UB_BUFFER(column), num_rows,
+                    sample_size);
+        }
+        if (!ub_codec_supports(column_codec, type)) {
+            column_codec = UB_CODEC_RAW;
+        }
+
+        /* the header is written with a placeholder length that is patched
+         * once the column is encoded */
+        header = ub_buffer_writer_tell(&writer);
+        retval = ub_buffer_writer_write_u8(&writer, column_codec);
+        if (retval == UB_SUCCESS)
+            retval = ub_buffer_writer_write_u16(&writer, 0);
+        if (retval != UB_SUCCESS)
+            break;
+
+        start = ub_buffer_writer_tell(&writer);
+        retval = ub_codec_encode(column_codec, type, UB_BUFFER(column),
+                num_rows, &writer);
+        if (retval != UB_SUCCESS)
+            break;
+        encoded_size = ub_buffer_writer_tell(&writer) - start;
+
+        /* never store a column in a form larger than its raw form */
+        if (encoded_size > width * num_rows) {
+            column_codec = UB_CODEC_RAW;
+            retval = ub_buffer_writer_seek(&writer, start, SEEK_SET);
+            if (retval == UB_SUCCESS)
+                retval = ub_codec_encode(column_codec, type, UB_BUFFER(column),
+                        num_rows, &writer);
+            if (retval != UB_SUCCESS)
+                break;
+            encoded_size = width * num_rows;
+        }
+
+        if (encoded_size > 65535) {
+            retval = UB_ETOOLONG;
+            break;
+        }
+
+        end = ub_buffer_writer_tell(&writer);
+        retval = ub_buffer_writer_seek(&writer, header, SEEK_SET);
+        if (retval == UB_SUCCESS)
+            retval = ub_buffer_writer_write_u8(&writer, column_codec);
+        if (retval == UB_SUCCESS)
+            retval = ub_buffer_writer_write_u16(&writer, encoded_size);
+        if (retval == UB_SUCCESS)
+            retval = ub_buffer_writer_seek(&writer, end, SEEK_SET);
+    }
+
+    if (retval == UB_SUCCESS)
+        retval = ub_buffer_resize(payload, ub_buffer_writer_tell(&writer));
+
+    ub_buffer_writer_destroy(&writer);
+    ub_buffer_pool_release(pool, &column);
+
+    return retval;
+}
+
+ub_error_t ub_codec_decode_log_entries(const ub_log_column_t* columns,
+        size_t num_columns, const void* payload, size_t size,
+        ub_buffer_t* rows, size_t* num_rows) {
+    const uint8_t* data = (const uint8_t*)payload;
+    const uint8_t* data_end = data + size;
+    size_t row_length = ub_log_columns_get_total_length(columns, num_columns);
+    size_t i, j, n, offset, width, encoded_size;
+    ub_buffer_pool_t* pool;
+    ub_buffer_t column;
+    ub_codec_t codec;
+    ub_error_t retval = UB_SUCCESS;
+
+    if (row_length == 0)
+        return UB_EUNSUPPORTED;
+
+    if (size < 2)
+        return UB_EPARSE;
+
+    n = ub_i_load_be(data, 2);
+    data += 2;
+
+    UB_CHECK(ub_buffer_resize(rows, n * row_length));
+    pool = ub_buffer_pool_get_shared();
+    UB_CHECK(ub_buffer_pool_acquire(pool, &column));
+    retval = ub_buffer_resize(&column, n * 8);
+    if (retval != UB_SUCCESS) {
+        ub_buffer_pool_release(pool, &column);
+        return retval;
+    }
+
+    for (i = 0, offset = 0; i < num_columns; i++) {
+        width = ub_log_column_get_length(&columns[i]);
+
+        if (data_end - data < 3) {
+            retval = UB_EPARSE;
+            break;
+        }
+
+        codec = data[0];
+        encoded_size = ub_i_load_be(data + 1, 2);
+        data += 3;
+        if (data_end - data < encoded_size) {
+            retval = UB_EPARSE;
+            break;
+        }
+
+        retval = ub_codec_decode(codec, ub_log_column_get_type(&columns[i]),
+                data, encoded_size, n, UB_BUFFER(column));
+        if (retval != UB_SUCCESS)
+            break;
+        data += encoded_size;
+
+        /* scatter the values of the column */
+        for (j = 0; j < n; j++) {
+            memcpy(UB_BUFFER(*rows) + j * row_length + offset,
+                    UB_BUFFER(column) + j * width, width);
+        }
+        offset += width;
+    }
+
+    ub_buffer_pool_release(pool, &column);
+
+    if (retval == UB_SUCCESS && num_rows != 0)
+        *num_rows = n;
+
+    return retval;
+}
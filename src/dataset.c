@@ -0,0 +1,867 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <unibinlog/block_index.h>
+#include <unibinlog/buffer.h>
+#include <unibinlog/byteorder.h>
+#include <unibinlog/dataset.h>
+#include <unibinlog/lowlevel.h>
+#include <unibinlog/memory.h>
+
+#include "config.h"
+
+#ifdef HAVE_FSYNC
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
+
+/**
+ * The name of the manifest file in the directory of a dataset.
+ */
+#define UB_I_MANIFEST_NAME "MANIFEST"
+
+/**
+ * A scan over some chunks of a dataset, shared by the worker threads.
+ */
+typedef struct {
+    const ub_dataset_t* dataset;
+    size_t first;
+    size_t count;
+    ub_scan_block_func_t* block_func;
+    uint8_t* states;
+    size_t state_size;
+    ub_error_t* results;
+} ub_i_dataset_scan_t;
+
+/**
+ * A worker thread of a scan; it takes every \c num_threads -th chunk,
+ * starting from \c thread.
+ */
+typedef struct {
+    ub_i_dataset_scan_t* scan;
+    size_t thread;
+    size_t num_threads;
+} ub_i_dataset_worker_t;
+
+/**
+ * The state passed to the scanner of a single chunk.
+ */
+typedef struct {
+    ub_i_dataset_scan_t* scan;
+    size_t index;
+} ub_i_dataset_chunk_scan_t;
+
+/**
+ * Loads an unsigned integer of the given width (in bytes) stored in network
+ * byte order.
+ */
+static uint64_t ub_i_load_be(const uint8_t* bytes, size_t width) {
+    uint64_t result = 0;
+    while (width > 0) {
+        result = (result << 8) | *bytes;
+        bytes++; width--;
+    }
+    return result;
+}
+
+/**
+ * Stores an unsigned integer on the given number of bytes in network byte
+ * order.
+ */
+static void ub_i_store_be(uint8_t* bytes, size_t width, uint64_t value) {
+    while (width > 0) {
+        width--;
+        bytes[width] = value & 0xFF;
+        value >>= 8;
+    }
+}
+
+/**
+ * Returns the path of the given file in the directory of the dataset, or
+ * null if there is not enough memory.
+ */
+static char* ub_i_dataset_get_path(const ub_dataset_t* dataset,
+        const char* name) {
+    char* path = ub_calloc(char, strlen(dataset->path) + strlen(name) + 2);
+
+    if (path != 0)
+        sprintf(path, "%s/%s", dataset->path, name);
+
+    return path;
+}
+
+static ub_error_t ub_i_dataset_init(ub_dataset_t* dataset, const char* path) {
+    dataset->path = ub_calloc(char, strlen(path) + 1);
+    if (dataset->path == 0)
+        return UB_ENOMEM;
+
+    strcpy(dataset->path, path);
+    dataset->chksum_type = UB_CHKSUM_FLETCHER_16;
+    dataset->timestamp_column = UB_BLOCK_INDEX_NO_TIMESTAMP;
+    dataset->partition_length = 0;
+    dataset->chunks = 0;
+    dataset->num_chunks = 0;
+    dataset->capacity = 0;
+    dataset->num_threads = 1;
+
+    return UB_SUCCESS;
+}
+
+static ub_error_t ub_i_dataset_append(ub_dataset_t* dataset,
+        const ub_dataset_chunk_t* chunk) {
+    ub_dataset_chunk_t* chunks;
+    size_t capacity;
+
+    if (dataset->num_chunks == dataset->capacity) {
+        capacity = dataset->capacity > 0 ? dataset->capacity * 2 : 16;
+        chunks = ub_realloc(dataset->chunks, ub_dataset_chunk_t, capacity);
+        if (chunks == 0)
+            return UB_ENOMEM;
+        dataset->chunks = chunks;
+        dataset->capacity = capacity;
+    }
+
+    dataset->chunks[dataset->num_chunks] = *chunk;
+    dataset->num_chunks++;
+
+    return UB_SUCCESS;
+}
+
+/**
+ * Parses the chunks of a manifest block and adds them to the dataset.
+ */
+static ub_error_t ub_i_dataset_parse_block(ub_dataset_t* dataset,
+        const uint8_t* data, size_t size) {
+    ub_dataset_chunk_t chunk;
+
+    if (size % UB_DATASET_CHUNK_LENGTH != 0)
+        return UB_EPARSE;
+
+    for (; size > 0; data += UB_DATASET_CHUNK_LENGTH,
+            size -= UB_DATASET_CHUNK_LENGTH) {
+        chunk.sequence = ub_i_load_be(data, 8);
+        chunk.first_timestamp = (int64_t)ub_i_load_be(data + 8, 8);
+        chunk.last_timestamp = (int64_t)ub_i_load_be(data + 16, 8);
+        chunk.num_rows = ub_i_load_be(data + 24, 8);
+        chunk.schema_id = ub_i_load_be(data + 32, 8);
+        UB_CHECK(ub_i_dataset_append(dataset, &chunk));
+    }
+
+    return UB_SUCCESS;
+}
+
+/**
+ * Reads the manifest of the dataset from the given file.
+ */
+static ub_error_t ub_i_dataset_read_manifest(ub_dataset_t* dataset, FILE* f) {
+    ub_block_type_t block_type;
+    ub_buffer_t payload;
+    const uint8_t* data;
+    uint64_t num_chunks = 0;
+    ub_bool_t has_header = 0;
+    ub_error_t retval;
+    uint8_t version;
+    size_t size;
+
+    UB_CHECK(ub_read_header(f, &version, &dataset->chksum_type));
+    UB_CHECK(ub_buffer_init(&payload, 0));
+
+    while (1) {
+        retval = ub_read_block(f, &block_type, &payload, dataset->chksum_type);
+        if (retval != UB_SUCCESS)
+            break;
+
+        data = UB_BUFFER(payload);
+        size = ub_buffer_size(&payload);
+
+        if (block_type == UB_BLOCK_COMMENT) {
+            continue;
+        } else if (block_type == UB_BLOCK_MANIFEST_HEADER && !has_header) {
+            if (size != UB_DATASET_MANIFEST_HEADER_LENGTH) {
+                retval = UB_EPARSE;
+                break;
+            }
+            dataset->timestamp_column = data[0];
+            dataset->partition_length = ub_i_load_be(data + 1, 8);
+            num_chunks = ub_i_load_be(data + 9, 8);
+            has_header = 1;
+        } else if (block_type == UB_BLOCK_MANIFEST && has_header) {
+            retval = ub_i_dataset_parse_block(dataset, data, size);
+        } else {
+            retval = UB_EPARSE;
+        }
+
+        if (retval != UB_SUCCESS)
+            break;
+    }
+
+    if (retval == UB_EOF) {
+        retval = has_header && dataset->num_chunks == num_chunks ?
+            UB_SUCCESS : UB_EPARSE;
+    }
+
+    ub_buffer_destroy(&payload);
+    return retval;
+}
+
+/**
+ * Opens the manifest of the dataset and reads it. \p missing is set if the
+ * manifest does not exist.
+ */
+static ub_error_t ub_i_dataset_load(ub_dataset_t* dataset,
+        ub_bool_t* missing) {
+    ub_error_t retval;
+    char* path;
+    FILE* f;
+
+    path = ub_i_dataset_get_path(dataset, UB_I_MANIFEST_NAME);
+    if (path == 0)
+        return UB_ENOMEM;
+
+    f = fopen(path, "rb");
+    *missing = f == 0 && errno == ENOENT;
+    ub_free(path);
+    if (f == 0)
+        return UB_EOPEN;
+
+    retval = ub_i_dataset_read_manifest(dataset, f);
+    fclose(f);
+
+    return retval;
+}
+
+/**
+ * Writes the chunks of the dataset from the given one onwards into the
+ * given file as a manifest.
+ */
+static ub_error_t ub_i_dataset_write_chunks(const ub_dataset_t* dataset,
+        size_t first, FILE* f) {
+    const ub_dataset_chunk_t* chunk;
+    size_t i, size, max_size;
+    ub_buffer_t payload;
+    ub_error_t retval;
+    uint8_t* data;
+
+    UB_CHECK(ub_write_header(f, 1, dataset->chksum_type));
+    UB_CHECK(ub_buffer_init(&payload, UB_DATASET_MANIFEST_HEADER_LENGTH));
+
+    data = UB_BUFFER(payload);
+    data[0] = dataset->timestamp_column;
+    ub_i_store_be(data + 1, 8, dataset->partition_length);
+    ub_i_store_be(data + 9, 8, dataset->num_chunks - first);
+
+    retval = ub_write_block_from_buffer(f, UB_BLOCK_MANIFEST_HEADER,
+            &payload, dataset->chksum_type);
+
+    /* pack as many chunks into each block as possible */
+    max_size = 65535 - 65535 % UB_DATASET_CHUNK_LENGTH;
+    ub_buffer_resize(&payload, 0);
+    for (i = first; i < dataset->num_chunks && retval == UB_SUCCESS; i++) {
+        size = ub_buffer_size(&payload);
+        if (size == max_size) {
+            retval = ub_write_block_from_buffer(f, UB_BLOCK_MANIFEST,
+                    &payload, dataset->chksum_type);
+            ub_buffer_resize(&payload, 0);
+            size = 0;
+        }
+
+        if (retval == UB_SUCCESS)
+            retval = ub_buffer_resize(&payload, size + UB_DATASET_CHUNK_LENGTH);
+        if (retval != UB_SUCCESS)
+            break;
+
+        chunk = &dataset->chunks[i];
+        data = UB_BUFFER(payload) + size;
+        ub_i_store_be(data, 8, chunk->sequence);
+        ub_i_store_be(data + 8, 8, (uint64_t)chunk->first_timestamp);
+        ub_i_store_be(data + 16, 8, (uint64_t)chunk->last_timestamp);
+        ub_i_store_be(data + 24, 8, chunk->num_rows);
+        ub_i_store_be(data + 32, 8, chunk->schema_id);
+    }
+
+    if (retval == UB_SUCCESS && ub_buffer_size(&payload) > 0) {
+        retval = ub_write_block_from_buffer(f, UB_BLOCK_MANIFEST,
+                &payload, dataset->chksum_type);
+    }
+
+    ub_buffer_destroy(&payload);
+    return retval;
+}
+
+/**
+ * Syncs the directory of the dataset, so the files created or renamed in it
+ * survive a crash. File systems that cannot sync directories are ignored.
+ */
+static ub_error_t ub_i_dataset_sync_dir(const ub_dataset_t* dataset) {
+#ifdef HAVE_FSYNC
+    ub_error_t retval = UB_SUCCESS;
+    int fd;
+
+    fd = open(dataset->path, O_RDONLY);
+    if (fd < 0)
+        return UB_EOPEN;
+
+    if (fsync(fd) && errno != EINVAL)
+        retval = UB_EWRITE;
+    close(fd);
+
+    return retval;
+#else
+    (void)dataset;
+    return UB_SUCCESS;
+#endif
+}
+
+/**
+ * Replaces the manifest of the dataset with one that lists the chunks from
+ * the given one onwards. The new manifest is written into a temporary file
+ * and synced first, then renamed over the old one, and the rename is synced
+ * with the directory.
+ */
+static ub_error_t ub_i_dataset_save(const ub_dataset_t* dataset,
+        size_t first) {
+    char *path, *temp_path;
+    ub_error_t retval;
+    FILE* f;
+
+    path = ub_i_dataset_get_path(dataset, UB_I_MANIFEST_NAME);
+    temp_path = ub_i_dataset_get_path(dataset, UB_I_MANIFEST_NAME ".tmp");
+    if (path == 0 || temp_path == 0) {
+        ub_free_unless_null(path);
+        ub_free_unless_null(temp_path);
+        return UB_ENOMEM;
+    }
+
+    f = fopen(temp_path, "wb");
+    if (f == 0) {
+        retval = UB_EOPEN;
+    } else {
+        retval = ub_i_dataset_write_chunks(dataset, first, f);
+        if (retval == UB_SUCCESS)
+            retval = ub_sync_file(f);
+        if (fclose(f) && retval == UB_SUCCESS)
+            retval = UB_EWRITE;
+
+        if (retval == UB_SUCCESS && rename(temp_path, path))
+            retval = UB_EWRITE;
+        if (retval != UB_SUCCESS)
+            remove(temp_path);
+        else
+            retval = ub_i_dataset_sync_dir(dataset);
+    }
+
+    ub_free(path);
+    ub_free(temp_path);
+
+    return retval;
+}
+
+uint64_t ub_dataset_get_schema_id(const ub_log_column_t* columns,
+        size_t num_columns) {
+    /* 64-bit FNV-1a over the type and the name of each column */
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    const char* name;
+    size_t i;
+
+    for (i = 0; i < num_columns; i++) {
+        hash = (hash ^ (uint8_t)columns[i].type) * 0x100000001B3ULL;
+        name = columns[i].name != 0 ? columns[i].name : "";
+        do {
+            hash = (hash ^ (uint8_t)*name) * 0x100000001B3ULL;
+        } while (*name++);
+    }
+
+    return hash;
+}
+
+ub_error_t ub_dataset_open(ub_dataset_t* dataset, const char* path) {
+    ub_bool_t missing;
+    ub_error_t retval;
+
+    UB_CHECK(ub_i_dataset_init(dataset, path));
+
+    retval = ub_i_dataset_load(dataset, &missing);
+    if (retval != UB_SUCCESS)
+        ub_dataset_destroy(dataset);
+
+    return retval;
+}
+
+void ub_dataset_destroy(ub_dataset_t* dataset) {
+    ub_free_unless_null(dataset->chunks);
+    ub_free_unless_null(dataset->path);
+    dataset->num_chunks = 0;
+    dataset->capacity = 0;
+}
+
+ub_error_t ub_dataset_set_num_threads(ub_dataset_t* dataset,
+        size_t num_threads) {
+    if (num_threads == 0)
+        return UB_EINVAL;
+
+    dataset->num_threads = num_threads;
+    return UB_SUCCESS;
+}
+
+char* ub_dataset_get_chunk_path(const ub_dataset_t* dataset,
+        uint64_t sequence) {
+    char name[32];
+
+    sprintf(name, "chunk-%06lu.ubl", (unsigned long)sequence);
+    return ub_i_dataset_get_path(dataset, name);
+}
+
+ub_error_t ub_dataset_select(const ub_dataset_t* dataset, int64_t begin,
+        int64_t end, size_t* first, size_t* count) {
+    size_t low, high, middle, last;
+
+    /* the first chunk that does not end before the interval */
+    low = 0; high = dataset->num_chunks;
+    while (low < high) {
+        middle = low + (high - low) / 2;
+        if (dataset->chunks[middle].last_timestamp < begin)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    *first = low;
+
+    /* the first chunk that starts after the interval */
+    high = dataset->num_chunks;
+    while (low < high) {
+        middle = low + (high - low) / 2;
+        if (dataset->chunks[middle].first_timestamp <= end)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    last = low;
+
+    *count = last - *first;
+    return UB_SUCCESS;
+}
+
+static ub_error_t ub_i_dataset_scan_block(const ub_scan_block_t* block,
+        void* state) {
+    ub_i_dataset_chunk_scan_t* chunk_scan = (ub_i_dataset_chunk_scan_t*)state;
+    ub_i_dataset_scan_t* scan = chunk_scan->scan;
+    ub_scan_block_t chunk_block = *block;
+
+    chunk_block.range = chunk_scan->index;
+    return scan->block_func(&chunk_block,
+            scan->states + chunk_scan->index * scan->state_size);
+}
+
+/**
+ * Reads the chunk with the given index into memory and scans it.
+ */
+static ub_error_t ub_i_dataset_scan_chunk(ub_i_dataset_scan_t* scan,
+        size_t index) {
+    const ub_dataset_chunk_t* chunk =
+        &scan->dataset->chunks[scan->first + index];
+    ub_i_dataset_chunk_scan_t chunk_scan;
+    ub_scanner_t scanner;
+    ub_buffer_t contents;
+    ub_error_t retval;
+    char* path;
+    long size;
+    FILE* f;
+
+    path = ub_dataset_get_chunk_path(scan->dataset, chunk->sequence);
+    if (path == 0)
+        return UB_ENOMEM;
+
+    f = fopen(path, "rb");
+    ub_free(path);
+    if (f == 0)
+        return UB_EOPEN;
+
+    if (fseek(f, 0, SEEK_END) || (size = ftell(f)) < 0) {
+        fclose(f);
+        return UB_EREAD;
+    }
+    rewind(f);
+
+    retval = ub_buffer_init(&contents, size);
+    if (retval == UB_SUCCESS && size > 0 &&
+            fread(UB_BUFFER(contents), size, 1, f) != 1)
+        retval = UB_EREAD;
+    fclose(f);
+
+    if (retval == UB_SUCCESS)
+        retval = ub_scanner_init(&scanner, UB_BUFFER(contents), size);
+    if (retval == UB_SUCCESS) {
+        chunk_scan.scan = scan;
+        chunk_scan.index = index;
+        retval = ub_scanner_run(&scanner, 1, ub_i_dataset_scan_block,
+                &chunk_scan, sizeof(chunk_scan), 0);
+        ub_scanner_destroy(&scanner);
+    }
+
+    ub_buffer_destroy(&contents);
+    return retval;
+}
+
+static void* ub_i_dataset_scan_worker(void* arg) {
+    ub_i_dataset_worker_t* worker = (ub_i_dataset_worker_t*)arg;
+    ub_i_dataset_scan_t* scan = worker->scan;
+    size_t i;
+
+    for (i = worker->thread; i < scan->count; i += worker->num_threads)
+        scan->results[i] = ub_i_dataset_scan_chunk(scan, i);
+
+    return 0;
+}
+
+/**
+ * Scans all the chunks of a scan, on the worker threads of the dataset if
+ * possible. Workers whose thread cannot be started run on the calling
+ * thread.
+ */
+static ub_error_t ub_i_dataset_run_scan(ub_i_dataset_scan_t* scan,
+        size_t num_threads) {
+    ub_i_dataset_worker_t* workers;
+    size_t i;
+#ifdef HAVE_PTHREAD
+    pthread_t* threads;
+    ub_bool_t* started;
+#endif
+
+    if (num_threads > scan->count)
+        num_threads = scan->count;
+
+    workers = ub_calloc(ub_i_dataset_worker_t, num_threads);
+    if (workers == 0)
+        return UB_ENOMEM;
+
+    for (i = 0; i < num_threads; i++) {
+        workers[i].scan = scan;
+        workers[i].thread = i;
+        workers[i].num_threads = num_threads;
+    }
+
+#ifdef HAVE_PTHREAD
+    threads = ub_calloc(pthread_t, num_threads);
+    started = ub_calloc(ub_bool_t, num_threads);
+    if (threads == 0 || started == 0) {
+        ub_free_unless_null(threads);
+        ub_free_unless_null(started);
+        ub_free(workers);
+        return UB_ENOMEM;
+    }
+
+    for (i = 1; i < num_threads; i++)
+        started[i] = pthread_create(&threads[i], 0, ub_i_dataset_scan_worker,
+                &workers[i]) == 0;
+
+    for (i = 0; i < num_threads; i++) {
+        if (!started[i])
+            ub_i_dataset_scan_worker(&workers[i]);
+    }
+
+    for (i = 1; i < num_threads; i++) {
+        if (started[i])
+            pthread_join(threads[i], 0);
+    }
+
+    ub_free(started);
+    ub_free(threads);
+#else
+    for (i = 0; i < num_threads; i++)
+        ub_i_dataset_scan_worker(&workers[i]);
+#endif
+
+    ub_free(workers);
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_dataset_scan(const ub_dataset_t* dataset, size_t first,
+        size_t count, ub_scan_block_func_t* block_func, void* states,
+        size_t state_size, ub_scan_reduce_func_t* reduce_func) {
+    ub_i_dataset_scan_t scan;
+    ub_error_t retval;
+    size_t i;
+
+    if (first > dataset->num_chunks || count > dataset->num_chunks - first)
+        return UB_EINVAL;
+    if (count == 0)
+        return UB_SUCCESS;
+
+    scan.dataset = dataset;
+    scan.first = first;
+    scan.count = count;
+    scan.block_func = block_func;
+    scan.states = (uint8_t*)states;
+    scan.state_size = state_size;
+    scan.results = ub_calloc(ub_error_t, count);
+    if (scan.results == 0)
+        return UB_ENOMEM;
+
+    retval = ub_i_dataset_run_scan(&scan, dataset->num_threads);
+    for (i = 0; i < count && retval == UB_SUCCESS; i++)
+        retval = scan.results[i];
+
+    ub_free(scan.results);
+
+    /* merge the states of the chunks in order */
+    for (i = 1; i < count && retval == UB_SUCCESS && reduce_func; i++)
+        retval = reduce_func(states, scan.states + i * state_size);
+
+    return retval;
+}
+
+ub_error_t ub_dataset_remove_before(ub_dataset_t* dataset,
+        int64_t timestamp) {
+    size_t i, count = 0;
+    char* path;
+
+    while (count < dataset->num_chunks &&
+            dataset->chunks[count].last_timestamp < timestamp)
+        count++;
+    if (count == 0)
+        return UB_SUCCESS;
+
+    /* the manifest must stop referring to the chunks before they go */
+    UB_CHECK(ub_i_dataset_save(dataset, count));
+
+    for (i = 0; i < count; i++) {
+        path = ub_dataset_get_chunk_path(dataset, dataset->chunks[i].sequence);
+        if (path != 0) {
+            remove(path);
+            ub_free(path);
+        }
+    }
+
+    memmove(dataset->chunks, dataset->chunks + count,
+            (dataset->num_chunks - count) * sizeof(ub_dataset_chunk_t));
+    dataset->num_chunks -= count;
+
+    return UB_SUCCESS;
+}
+
+/**
+ * Decodes the timestamp of the given row.
+ */
+static ub_error_t ub_i_dataset_writer_get_timestamp(
+        const ub_dataset_writer_t* writer, const uint8_t* row, size_t size,
+        int64_t* value) {
+    size_t i, length, offset = writer->timestamp_offset;
+    size_t column = writer->dataset.timestamp_column;
+
+    if (offset == SIZE_MAX) {
+        /* rows have variable length; skip the columns before the
+         * timestamp one by one */
+        for (i = 0, offset = 0; i <= column; i++, offset += length) {
+            length = ub_datatype_get_value_length(writer->columns[i].type,
+                    row + offset, size - offset);
+            if (length == 0)
+                return UB_EINVAL;
+            if (i == column)
+                break;
+        }
+    } else if (offset + ub_log_column_get_length(&writer->columns[column]) >
+            size) {
+        return UB_EINVAL;
+    }
+
+    return ub_byteorder_decode_int64(writer->columns[column].type,
+            UB_BIG_ENDIAN, row + offset, value);
+}
+
+/**
+ * Returns the partition of the given timestamp, rounding towards negative
+ * infinity.
+ */
+static int64_t ub_i_dataset_writer_get_partition(
+        const ub_dataset_writer_t* writer, int64_t timestamp) {
+    int64_t length = (int64_t)writer->dataset.partition_length;
+    int64_t partition = timestamp / length;
+
+    return timestamp % length < 0 ? partition - 1 : partition;
+}
+
+/**
+ * Opens the next chunk file and its log writer.
+ */
+static ub_error_t ub_i_dataset_writer_start(ub_dataset_writer_t* writer,
+        int64_t partition) {
+    ub_error_t retval;
+    char* path;
+
+    path = ub_dataset_get_chunk_path(&writer->dataset, writer->next_sequence);
+    if (path == 0)
+        return UB_ENOMEM;
+
+    writer->file = fopen(path, "wb");
+    ub_free(path);
+    if (writer->file == 0)
+        return UB_EOPEN;
+
+    retval = ub_log_writer_init(&writer->writer, writer->file,
+            writer->columns, writer->num_columns, writer->chksum_type);
+    if (retval == UB_SUCCESS) {
+        retval = ub_log_writer_set_index(&writer->writer, 1);
+        if (retval == UB_SUCCESS) {
+            retval = ub_log_writer_set_timestamp_column(&writer->writer,
+                    writer->dataset.timestamp_column);
+        }
+        if (retval != UB_SUCCESS)
+            ub_log_writer_destroy(&writer->writer);
+    }
+
+    if (retval != UB_SUCCESS) {
+        fclose(writer->file);
+        writer->file = 0;
+        return retval;
+    }
+
+    writer->chunk.sequence = writer->next_sequence;
+    writer->chunk.num_rows = 0;
+    writer->chunk.schema_id = ub_dataset_get_schema_id(writer->columns,
+            writer->num_columns);
+    writer->partition = partition;
+    writer->next_sequence++;
+
+    return UB_SUCCESS;
+}
+
+/**
+ * Closes the current chunk file and adds it to the manifest. The chunk and
+ * its directory entry are synced before the manifest refers to it.
+ */
+static ub_error_t ub_i_dataset_writer_finish(ub_dataset_writer_t* writer) {
+    ub_error_t retval;
+
+    retval = ub_log_writer_close(&writer->writer);
+    ub_log_writer_destroy(&writer->writer);
+    if (retval == UB_SUCCESS)
+        retval = ub_sync_file(writer->file);
+    if (fclose(writer->file) && retval == UB_SUCCESS)
+        retval = UB_EWRITE;
+    writer->file = 0;
+
+    if (retval != UB_SUCCESS || writer->chunk.num_rows == 0)
+        return retval;
+
+    UB_CHECK(ub_i_dataset_sync_dir(&writer->dataset));
+    UB_CHECK(ub_i_dataset_append(&writer->dataset, &writer->chunk));
+    retval = ub_i_dataset_save(&writer->dataset, 0);
+    if (retval != UB_SUCCESS)
+        writer->dataset.num_chunks--;
+
+    return retval;
+}
+
+ub_error_t ub_dataset_writer_init(ub_dataset_writer_t* writer,
+        const char* path, ub_log_column_t* columns, size_t num_columns,
+        ub_chksum_type_t chksum_type, size_t timestamp_column,
+        uint64_t partition_length) {
+    size_t offsets[255];
+    uint8_t zeros[8] = { 0 };
+    ub_dataset_chunk_t* last;
+    ub_bool_t missing;
+    ub_error_t retval;
+    int64_t value;
+
+    if (partition_length == 0 || partition_length > INT64_MAX ||
+            timestamp_column >= num_columns ||
+            timestamp_column >= UB_BLOCK_INDEX_NO_TIMESTAMP)
+        return UB_EINVAL;
+    if (ub_byteorder_decode_int64(columns[timestamp_column].type,
+                UB_BIG_ENDIAN, zeros, &value))
+        return UB_EUNSUPPORTED;
+
+    UB_CHECK(ub_i_dataset_init(&writer->dataset, path));
+
+    retval = ub_i_dataset_load(&writer->dataset, &missing);
+    if (retval == UB_EOPEN && missing) {
+        /* a new dataset */
+        writer->dataset.chksum_type = chksum_type;
+        writer->dataset.timestamp_column = timestamp_column;
+        writer->dataset.partition_length = partition_length;
+        retval = UB_SUCCESS;
+    } else if (retval == UB_SUCCESS &&
+            (writer->dataset.timestamp_column != timestamp_column ||
+             writer->dataset.partition_length != partition_length)) {
+        retval = UB_EINVAL;
+    }
+
+    if (retval != UB_SUCCESS) {
+        ub_dataset_destroy(&writer->dataset);
+        return retval;
+    }
+
+    writer->columns = columns;
+    writer->num_columns = num_columns;
+    writer->chksum_type = chksum_type;
+    writer->timestamp_offset = ub_log_columns_get_layout(columns, num_columns,
+            0, offsets) > 0 ? offsets[timestamp_column] : SIZE_MAX;
+    writer->file = 0;
+    writer->partition = 0;
+    memset(&writer->chunk, 0, sizeof(writer->chunk));
+
+    /* continue after the chunks of the existing manifest */
+    last = writer->dataset.num_chunks > 0 ?
+        &writer->dataset.chunks[writer->dataset.num_chunks - 1] : 0;
+    writer->next_sequence = last != 0 ? last->sequence + 1 : 0;
+
+    return UB_SUCCESS;
+}
+
+void ub_dataset_writer_destroy(ub_dataset_writer_t* writer) {
+    if (writer->file != 0) {
+        ub_log_writer_destroy(&writer->writer);
+        fclose(writer->file);
+        writer->file = 0;
+    }
+
+    ub_dataset_destroy(&writer->dataset);
+}
+
+ub_error_t ub_dataset_writer_write_row(ub_dataset_writer_t* writer,
+        const void* row, size_t length) {
+    const ub_dataset_t* dataset = &writer->dataset;
+    const ub_dataset_chunk_t* last = 0;
+    int64_t timestamp, partition;
+
+    UB_CHECK(ub_i_dataset_writer_get_timestamp(writer, (const uint8_t*)row,
+                length, &timestamp));
+
+    /* the previous row is in the current chunk or in the last finished one */
+    if (writer->file != 0 && writer->chunk.num_rows > 0)
+        last = &writer->chunk;
+    else if (dataset->num_chunks > 0)
+        last = &dataset->chunks[dataset->num_chunks - 1];
+    if (last != 0 && timestamp < last->last_timestamp)
+        return UB_EINVAL;
+
+    partition = ub_i_dataset_writer_get_partition(writer, timestamp);
+    if (last == &writer->chunk && partition != writer->partition)
+        UB_CHECK(ub_i_dataset_writer_finish(writer));
+
+    if (writer->file == 0)
+        UB_CHECK(ub_i_dataset_writer_start(writer, partition));
+
+    UB_CHECK(ub_log_writer_write_row(&writer->writer, row, length));
+
+    if (writer->chunk.num_rows == 0)
+        writer->chunk.first_timestamp = timestamp;
+    writer->chunk.last_timestamp = timestamp;
+    writer->chunk.num_rows++;
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_dataset_writer_close(ub_dataset_writer_t* writer) {
+    if (writer->file == 0)
+        return UB_SUCCESS;
+
+    return ub_i_dataset_writer_finish(writer);
+}
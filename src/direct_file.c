@@ -0,0 +1,429 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+/* for fopencookie(), O_DIRECT and statx() */
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <unibinlog/direct_file.h>
+#include <unibinlog/memory.h>
+
+#include "config.h"
+
+/**
+ * The smallest alignment used by a direct file.
+ */
+#define UB_I_DIRECT_FILE_MIN_ALIGNMENT 512
+
+/**
+ * The buffer of a direct file and the part of the file that it holds.
+ *
+ * The buffer holds the bytes of the file from \c offset, which is aligned,
+ * up to \c offset + \c length. The bytes before the write position are
+ * always there, read back from the file if needed; the bytes after it are
+ * there if they were written before the stream moved back.
+ */
+typedef struct {
+    uint8_t* data;                 /**< The buffer, followed by a block of scratch space */
+    uint64_t offset;               /**< The file offset of the first byte of the buffer */
+    size_t length;                 /**< The number of bytes held by the buffer */
+    size_t cursor;                 /**< The write position within the buffer */
+    uint64_t size;                 /**< The length of the file, without padding */
+    ub_bool_t dirty;               /**< Whether the buffer was written into since the last flush */
+} ub_i_direct_state_t;
+
+/**
+ * Records the first write error of the file.
+ */
+static void ub_i_direct_file_fail(ub_direct_file_t* file) {
+    if (file->error == UB_SUCCESS)
+        file->error = UB_EWRITE;
+}
+
+/**
+ * Returns the alignment of direct I/O on the given file descriptor: the one
+ * reported by the kernel if it can tell, or the block size of the file
+ * system, which is a multiple of the logical block size of the device.
+ */
+static size_t ub_i_direct_file_get_alignment(int fd) {
+    size_t alignment = 0;
+    struct stat info;
+#ifdef HAVE_STATX_DIOALIGN
+    struct statx extended;
+
+    if (statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &extended) == 0 &&
+            (extended.stx_mask & STATX_DIOALIGN)) {
+        alignment = extended.stx_dio_offset_align;
+        if (alignment < extended.stx_dio_mem_align)
+            alignment = extended.stx_dio_mem_align;
+    }
+#endif
+
+    if (alignment == 0 && fstat(fd, &info) == 0)
+        alignment = info.st_blksize;
+
+    /* only powers of two make sense */
+    if (alignment < UB_I_DIRECT_FILE_MIN_ALIGNMENT ||
+            (alignment & (alignment - 1)) != 0)
+        alignment = 4096;
+
+    return alignment;
+}
+
+/**
+ * Reads the block of the file at the given aligned offset into the given
+ * aligned memory, zeroing whatever lies past the end of the file.
+ */
+static ub_error_t ub_i_direct_file_read_block(ub_direct_file_t* file,
+        uint64_t offset, uint8_t* data) {
+    ssize_t result;
+    size_t length = 0;
+
+    while (length < file->alignment) {
+        result = pread(file->fd, data + length, file->alignment - length,
+                offset + length);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result < 0)
+            return UB_EREAD;
+        if (result == 0)
+            break;
+        length += result;
+    }
+
+    memset(data + length, 0, file->alignment - length);
+    return UB_SUCCESS;
+}
+
+/**
+ * Writes the given aligned bytes at the given aligned offset. If the file
+ * system turns out to refuse direct I/O with this alignment, the file
+ * falls back to writing through the page cache.
+ */
+static ub_error_t ub_i_direct_file_pwrite(ub_direct_file_t* file,
+        const uint8_t* data, size_t length, uint64_t offset) {
+    ssize_t result;
+    int flags;
+
+    while (length > 0) {
+        result = pwrite(file->fd, data, length, offset);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result < 0 && errno == EINVAL && file->direct) {
+            flags = fcntl(file->fd, F_GETFL);
+            if (flags < 0 || fcntl(file->fd, F_SETFL, flags & ~O_DIRECT))
+                return UB_EWRITE;
+            file->direct = 0;
+            continue;
+        }
+        if (result <= 0)
+            return UB_EWRITE;
+        data += result; length -= result; offset += result;
+    }
+
+    return UB_SUCCESS;
+}
+
+/**
+ * Writes the bytes held by the buffer into the file, padding the last
+ * partial block, and keeps that block in the buffer so the next writes can
+ * complete it.
+ */
+static void ub_i_direct_file_flush(ub_direct_file_t* file) {
+    ub_i_direct_state_t* state = (ub_i_direct_state_t*)file->state;
+    uint8_t* scratch = state->data + file->buffer_size;
+    size_t tail, padded, keep, rest;
+    uint64_t end;
+
+    if (!state->dirty)
+        return;
+    state->dirty = 0;
+
+    /* the rest of a partial last block may still be in the file */
+    tail = state->length % file->alignment;
+    end = state->offset + state->length;
+    if (tail > 0 && end < state->size) {
+        if (ub_i_direct_file_read_block(file, end - tail, scratch)) {
+            ub_i_direct_file_fail(file);
+            return;
+        }
+        rest = state->size - end;
+        if (rest > file->alignment - tail)
+            rest = file->alignment - tail;
+        memcpy(state->data + state->length, scratch + tail, rest);
+        state->length += rest;
+        end += rest;
+    }
+
+    padded = (state->length + file->alignment - 1) / file->alignment *
+        file->alignment;
+    memset(state->data + state->length, 0, padded - state->length);
+
+    if (ub_i_direct_file_pwrite(file, state->data, padded, state->offset)) {
+        ub_i_direct_file_fail(file);
+        return;
+    }
+
+    if (end > state->size)
+        state->size = end;
+    if (state->offset + padded > state->size &&
+            ftruncate(file->fd, state->size))
+        ub_i_direct_file_fail(file);
+
+    /* keep the block of the write position and what follows it */
+    keep = state->cursor / file->alignment * file->alignment;
+    memmove(state->data, state->data + keep, state->length - keep);
+    state->offset += keep;
+    state->length -= keep;
+    state->cursor -= keep;
+}
+
+/**
+ * Moves the write position to the given file offset, reading the bytes of
+ * its block before it back from the file.
+ */
+static void ub_i_direct_file_move(ub_direct_file_t* file, uint64_t position) {
+    ub_i_direct_state_t* state = (ub_i_direct_state_t*)file->state;
+
+    state->offset = position / file->alignment * file->alignment;
+    state->cursor = position - state->offset;
+    state->length = 0;
+
+    if (state->cursor == 0)
+        return;
+
+    /* bytes past the end of the file read as zeros, as in a hole */
+    if (ub_i_direct_file_read_block(file, state->offset, state->data)) {
+        ub_i_direct_file_fail(file);
+        return;
+    }
+    state->length = state->size > state->offset ?
+        state->size - state->offset : 0;
+    if (state->length > file->alignment)
+        state->length = file->alignment;
+    if (state->length < state->cursor)
+        state->length = state->cursor;
+}
+
+#ifdef HAVE_FOPENCOOKIE
+
+static ssize_t ub_i_direct_file_write(void* cookie, const char* data,
+        size_t size) {
+    ub_direct_file_t* file = (ub_direct_file_t*)cookie;
+    ub_i_direct_state_t* state = (ub_i_direct_state_t*)file->state;
+    size_t length, left = size;
+
+    while (left > 0) {
+        length = file->buffer_size - state->cursor;
+        if (length > left)
+            length = left;
+
+        memcpy(state->data + state->cursor, data, length);
+        state->cursor += length;
+        if (state->length < state->cursor)
+            state->length = state->cursor;
+        state->dirty = 1;
+        data += length;
+        left -= length;
+
+        /* a full buffer needs no padding and is dropped by the flush */
+        if (state->cursor == file->buffer_size)
+            ub_i_direct_file_flush(file);
+    }
+
+    if (file->error != UB_SUCCESS) {
+        errno = EIO;
+        return -1;
+    }
+
+    return size;
+}
+
+static int ub_i_direct_file_seek(void* cookie, off64_t* offset, int whence) {
+    ub_direct_file_t* file = (ub_direct_file_t*)cookie;
+    ub_i_direct_state_t* state = (ub_i_direct_state_t*)file->state;
+    uint64_t position = state->offset + state->cursor;
+    off64_t target;
+
+    switch (whence) {
+        case SEEK_SET:
+            target = *offset;
+            break;
+
+        case SEEK_CUR:
+            target = (off64_t)position + *offset;
+            break;
+
+        case SEEK_END:
+            ub_i_direct_file_flush(file);
+            target = (off64_t)state->size + *offset;
+            break;
+
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+
+    if (target < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* ftell() lands here without moving; keep the buffer */
+    if ((uint64_t)target != state->offset + state->cursor) {
+        ub_i_direct_file_flush(file);
+        ub_i_direct_file_move(file, target);
+    }
+
+    *offset = target;
+    return 0;
+}
+
+static int ub_i_direct_file_close_stream(void* cookie) {
+    ub_direct_file_t* file = (ub_direct_file_t*)cookie;
+
+    ub_i_direct_file_flush(file);
+    return file->error == UB_SUCCESS ? 0 : -1;
+}
+
+#endif
+
+ub_error_t ub_direct_file_init(ub_direct_file_t* file, int fd,
+        size_t buffer_size, ub_bool_t direct) {
+#ifdef HAVE_FOPENCOOKIE
+    cookie_io_functions_t functions;
+    ub_i_direct_state_t* state;
+    struct stat info;
+    off_t position;
+    int flags;
+
+    if (buffer_size == 0)
+        return UB_EINVAL;
+
+    /* positioned writes would go to the end of the file */
+    flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || (flags & O_APPEND))
+        return UB_EINVAL;
+
+    state = ub_calloc(ub_i_direct_state_t, 1);
+    if (state == 0)
+        return UB_ENOMEM;
+
+    file->fd = fd;
+    file->alignment = ub_i_direct_file_get_alignment(fd);
+    file->buffer_size = (buffer_size + file->alignment - 1) /
+        file->alignment * file->alignment;
+    file->direct = 0;
+    file->error = UB_SUCCESS;
+    file->state = state;
+
+    state->data = ub_memory_aligned_alloc(file->alignment,
+            file->buffer_size + file->alignment);
+    if (state->data == 0) {
+        ub_free(file->state);
+        return UB_ENOMEM;
+    }
+
+#ifdef O_DIRECT
+    /* file systems without direct I/O refuse the flag */
+    if (direct && fcntl(fd, F_SETFL, flags | O_DIRECT) == 0)
+        file->direct = 1;
+#else
+    (void)direct;
+#endif
+
+    position = lseek(fd, 0, SEEK_CUR);
+    state->size = fstat(fd, &info) == 0 ? info.st_size : 0;
+    ub_i_direct_file_move(file, position > 0 ? position : 0);
+    if (file->error != UB_SUCCESS) {
+        ub_memory_aligned_free(state->data);
+        ub_free(file->state);
+        return UB_EREAD;
+    }
+
+    functions.read = 0;
+    functions.write = ub_i_direct_file_write;
+    functions.seek = ub_i_direct_file_seek;
+    functions.close = ub_i_direct_file_close_stream;
+
+    file->file = fopencookie(file, "w", functions);
+    if (file->file == 0) {
+        ub_memory_aligned_free(state->data);
+        ub_free(file->state);
+        return UB_ENOMEM;
+    }
+
+    /* the stream is buffered by the file itself */
+    setvbuf(file->file, 0, _IONBF, 0);
+
+    return UB_SUCCESS;
+#else
+    (void)file; (void)fd; (void)buffer_size; (void)direct;
+    return UB_EUNSUPPORTED;
+#endif
+}
+
+void ub_direct_file_destroy(ub_direct_file_t* file) {
+    ub_i_direct_state_t* state = (ub_i_direct_state_t*)file->state;
+
+    if (state == 0)
+        return;
+
+    ub_direct_file_close(file);
+
+    ub_memory_aligned_free(state->data);
+    ub_free(file->state);
+}
+
+ub_error_t ub_direct_file_sync(ub_direct_file_t* file) {
+    if (file->file == 0)
+        return UB_EWRITE;
+
+    if (fflush(file->file))
+        ub_i_direct_file_fail(file);
+    ub_i_direct_file_flush(file);
+
+    /* direct writes skip the page cache, but not the metadata of the file */
+#if defined(HAVE_FDATASYNC)
+    if (fdatasync(file->fd))
+        ub_i_direct_file_fail(file);
+#elif defined(HAVE_FSYNC)
+    if (fsync(file->fd))
+        ub_i_direct_file_fail(file);
+#endif
+
+    return file->error;
+}
+
+/**
+ * Syncs the direct file given as user data; see \ref ub_direct_file_attach().
+ */
+static ub_error_t ub_i_direct_file_sync_writer(void* user_data) {
+    return ub_direct_file_sync((ub_direct_file_t*)user_data);
+}
+
+ub_error_t ub_direct_file_attach(ub_direct_file_t* file, ub_log_writer_t* writer) {
+    return ub_log_writer_set_sync_func(writer, ub_i_direct_file_sync_writer, file);
+}
+
+ub_error_t ub_direct_file_close(ub_direct_file_t* file) {
+    if (file->file == 0)
+        return file->error;
+
+    if (fclose(file->file))
+        ub_i_direct_file_fail(file);
+    file->file = 0;
+
+    if (close(file->fd))
+        ub_i_direct_file_fail(file);
+
+    return file->error;
+}
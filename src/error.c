@@ -15,6 +15,7 @@ static char* ub_i_error_messages[] = {
     "Unsupported operation",                        /* UB_EUNSUPPORTED */
     "Unimplemented operation",                      /* UB_EUNIMPLEMENTED */
     "Payload too long",                             /* UB_ETOOLONG */
+    "End of file",                                  /* UB_EOF */
 };
 
 const char* ub_error_to_string(int code) {
@@ -1,5 +1,7 @@
 /* vim:set ts=4 sw=4 sts=4 et: */
 
+#include <string.h>
+
 #include <unibinlog/log_column.h>
 #include <unibinlog/memory.h>
 #include <unibinlog/types.h>
@@ -58,6 +60,31 @@ size_t ub_log_columns_get_total_length(const ub_log_column_t* columns,
     return result;
 }
 
+size_t ub_log_columns_get_layout(const ub_log_column_t* columns,
+        size_t num_columns, ub_bool_t aligned, size_t* offsets) {
+    size_t i, alignment, length = 0, max_alignment = 1;
+    ub_datatype_t type;
+
+    for (i = 0; i < num_columns; i++) {
+        type = ub_log_column_get_type(&columns[i]);
+        alignment = ub_datatype_get_alignment(type);
+        if (alignment == 0)
+            return 0;
+
+        if (aligned) {
+            length = (length + alignment - 1) / alignment * alignment;
+            if (alignment > max_alignment)
+                max_alignment = alignment;
+        }
+
+        if (offsets)
+            offsets[i] = length;
+        length += ub_datatype_get_info(type).length;
+    }
+
+    return (length + max_alignment - 1) / max_alignment * max_alignment;
+}
+
 ub_datatype_t ub_log_column_get_type(const ub_log_column_t* column) {
 	return column->type;
 }
@@ -65,7 +92,7 @@ ub_datatype_t ub_log_column_get_type(const ub_log_column_t* column) {
 ub_error_t ub_log_column_set_name(ub_log_column_t* column, const char* name) {
 	ub_free_unless_null(column->name);
 	if (name != 0) {
-		column->name = strdup(name);
+		column->name = ub_memory_strdup(name);
 		if (column->name == 0) {
 			return UB_ENOMEM;
 		}
@@ -108,3 +135,39 @@ ub_error_t ub_log_column_write(const ub_log_column_t* column,
 
 	return UB_SUCCESS;
 }
+
+ub_error_t ub_log_column_read(ub_log_column_t* column, const void* data,
+        size_t size, size_t* consumed) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    size_t name_length;
+
+    if (size < 1)
+        return UB_EPARSE;
+
+    name_length = bytes[0];
+    if (size < name_length + 3)
+        return UB_EPARSE;
+
+    /* The type indexes the type information table, so it must be valid */
+    if (bytes[name_length + 1] == UB_DATATYPE_UNKNOWN ||
+            bytes[name_length + 1] >= UB_MAX_DATATYPE)
+        return UB_EPARSE;
+
+    /* Safety check: only the identity transformation is implemented now */
+    if (bytes[name_length + 2] != UB_XFORM_IDENTITY)
+        return UB_EUNIMPLEMENTED;
+
+    column->name = ub_calloc(char, name_length + 1);
+    if (column->name == 0)
+        return UB_ENOMEM;
+    memcpy(column->name, bytes + 1, name_length);
+
+    column->type = bytes[name_length + 1];
+    column->xform = UB_XFORM_IDENTITY;
+    column->xform_params = 0;
+
+    if (consumed)
+        *consumed = name_length + 3;
+
+    return UB_SUCCESS;
+}
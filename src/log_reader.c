@@ -0,0 +1,1039 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <unibinlog/byteorder.h>
+#include <unibinlog/codec.h>
+#include <unibinlog/log_reader.h>
+#include <unibinlog/lowlevel.h>
+#include <unibinlog/memory.h>
+
+#include "config.h"
+#include "uring.h"
+
+/**
+ * The number of bytes read at once by \ref ub_log_reader_seek_sync() while
+ * looking for a sync block.
+ */
+#define UB_I_SYNC_CHUNK_SIZE 4096
+
+/**
+ * A read of a single block by \ref ub_log_reader_fetch_blocks().
+ */
+typedef struct {
+    size_t index;                  /**< The index of the offset of the block */
+    uint64_t offset;               /**< The file offset of the block */
+    ub_buffer_t data;              /**< The bytes of the block; its size is the number of bytes wanted so far */
+    size_t length;                 /**< The number of bytes read so far */
+#ifdef HAVE_IO_URING
+    struct iovec iovec;            /**< The target of the read in flight */
+#endif
+} ub_i_fetch_t;
+
+static void ub_i_log_reader_clear_rows(ub_log_reader_t* reader) {
+    reader->rows = 0;
+    reader->rows_length = 0;
+    reader->num_rows = 0;
+}
+
+static void ub_i_log_reader_clear_columns(ub_log_reader_t* reader) {
+    if (reader->columns) {
+        ub_log_column_destroy_array(reader->columns, reader->num_columns);
+        ub_free(reader->columns);
+        reader->columns = 0;
+    }
+    if (reader->offsets) {
+        ub_free(reader->offsets);
+        reader->offsets = 0;
+    }
+    reader->num_columns = 0;
+    reader->row_length = 0;
+}
+
+/**
+ * Parses the log header block stored in the block buffer of the reader and
+ * replaces the columns of the reader with the ones found in the block.
+ */
+static ub_error_t ub_i_log_reader_parse_log_header(ub_log_reader_t* reader) {
+    const uint8_t* data = UB_BUFFER(reader->block);
+    size_t size = ub_buffer_size(&reader->block);
+    size_t i, num_columns, consumed;
+    ub_error_t retval;
+
+    ub_i_log_reader_clear_columns(reader);
+
+    if (size < 1)
+        return UB_EPARSE;
+
+    num_columns = data[0];
+    data++; size--;
+
+    reader->columns = ub_calloc(ub_log_column_t, num_columns > 0 ? num_columns : 1);
+    if (reader->columns == 0)
+        return UB_ENOMEM;
+
+    for (i = 0; i < num_columns; i++) {
+        retval = ub_log_column_read(&reader->columns[i], data, size, &consumed);
+        if (retval != UB_SUCCESS) {
+            reader->num_columns = i;
+            ub_i_log_reader_clear_columns(reader);
+            return retval;
+        }
+        data += consumed; size -= consumed;
+    }
+
+    reader->num_columns = num_columns;
+
+    reader->offsets = ub_calloc(size_t, num_columns > 0 ? num_columns : 1);
+    if (reader->offsets == 0) {
+        ub_i_log_reader_clear_columns(reader);
+        return UB_ENOMEM;
+    }
+
+    reader->row_length = ub_log_columns_get_layout(reader->columns,
+            num_columns, reader->aligned, reader->offsets);
+    if (reader->row_length == 0) {
+        ub_free(reader->offsets);
+        reader->offsets = 0;
+
+        /* aligned logs cannot have variable-length rows */
+        if (reader->aligned) {
+            ub_i_log_reader_clear_columns(reader);
+            return UB_EPARSE;
+        }
+    }
+
+    return UB_SUCCESS;
+}
+
+/**
+ * Returns the length of the variable-length row at the given address, or
+ * zero if the row does not fit into the given number of bytes.
+ */
+static size_t ub_i_log_reader_get_row_length(const ub_log_reader_t* reader,
+        const uint8_t* row, size_t size) {
+    size_t i, length, result = 0;
+
+    for (i = 0; i < reader->num_columns; i++) {
+        length = ub_datatype_get_value_length(reader->columns[i].type,
+                row + result, size - result);
+        if (length == 0)
+            return 0;
+        result += length;
+    }
+
+    return result;
+}
+
+/**
+ * Counts the variable-length rows in the given payload of a log entry
+ * block.
+ */
+static ub_error_t ub_i_log_reader_count_rows_in(const ub_log_reader_t* reader,
+        const uint8_t* data, size_t size, size_t* num_rows) {
+    size_t length;
+
+    *num_rows = 0;
+    if (reader->num_columns == 0)
+        return size == 0 ? UB_SUCCESS : UB_EPARSE;
+
+    while (size > 0) {
+        length = ub_i_log_reader_get_row_length(reader, data, size);
+        if (length == 0)
+            return UB_EPARSE;
+        data += length; size -= length;
+        (*num_rows)++;
+    }
+
+    return UB_SUCCESS;
+}
+
+/**
+ * Counts the rows in the current block when the rows have variable length.
+ */
+static ub_error_t ub_i_log_reader_count_rows(ub_log_reader_t* reader) {
+    return ub_i_log_reader_count_rows_in(reader, reader->rows,
+            reader->rows_length, &reader->num_rows);
+}
+
+ub_error_t ub_log_reader_init(ub_log_reader_t* reader, FILE* f) {
+    ub_block_type_t block_type;
+    ub_error_t retval;
+    uint8_t flags = 0;
+    long pos;
+
+    reader->file = f;
+    reader->version = 0;
+    reader->chksum_type = UB_CHKSUM_NONE;
+    reader->byte_order = UB_BIG_ENDIAN;
+    reader->aligned = 0;
+    reader->columns = 0;
+    reader->offsets = 0;
+    reader->num_columns = 0;
+    reader->row_length = 0;
+    reader->first_row = 0;
+    reader->block_offset = 0;
+    reader->header_offset = 0;
+    ub_i_log_reader_clear_rows(reader);
+    ub_block_index_init(&reader->index);
+    reader->filters = 0;
+    reader->num_filters = 0;
+    ub_zone_map_init(&reader->zone_map);
+    reader->keys = 0;
+    reader->num_keys = 0;
+    reader->access_pattern = UB_ACCESS_NORMAL;
+    reader->advised_offset = 0;
+    reader->dropped_offset = 0;
+
+    UB_CHECK(ub_buffer_init(&reader->block, 0));
+    if (ub_buffer_init(&reader->decoded, 0)) {
+        ub_buffer_destroy(&reader->block);
+        return UB_ENOMEM;
+    }
+
+    retval = ub_read_header_with_flags(f, &reader->version,
+            &reader->chksum_type, &flags);
+    if (retval == UB_SUCCESS) {
+        if (flags & ~(UB_HEADER_FLAG_LITTLE_ENDIAN | UB_HEADER_FLAG_ALIGNED))
+            retval = UB_EUNSUPPORTED;
+        if (flags & UB_HEADER_FLAG_LITTLE_ENDIAN)
+            reader->byte_order = UB_LITTLE_ENDIAN;
+        if (flags & UB_HEADER_FLAG_ALIGNED)
+            reader->aligned = 1;
+    }
+
+    /* skip everything up to the log header block */
+    while (retval == UB_SUCCESS) {
+        pos = ftell(f);
+        retval = ub_read_block(f, &block_type, &reader->block,
+                reader->chksum_type);
+        if (retval != UB_SUCCESS)
+            break;
+
+        if (block_type == UB_BLOCK_LOG_HEADER) {
+            reader->header_offset = pos;
+            retval = ub_i_log_reader_parse_log_header(reader);
+            break;
+        }
+
+        if (block_type == UB_BLOCK_LOG_ENTRY ||
+                block_type == UB_BLOCK_ENCODED_LOG_ENTRY)
+            retval = UB_EPARSE;
+    }
+
+    if (retval == UB_EOF)
+        retval = UB_EPARSE;
+
+    if (retval != UB_SUCCESS)
+        ub_log_reader_destroy(reader);
+
+    return retval;
+}
+
+void ub_log_reader_destroy(ub_log_reader_t* reader) {
+    ub_i_log_reader_clear_columns(reader);
+    ub_i_log_reader_clear_rows(reader);
+    ub_buffer_destroy(&reader->block);
+    ub_buffer_destroy(&reader->decoded);
+    ub_block_index_destroy(&reader->index);
+    ub_log_reader_clear_filters(reader);
+    ub_zone_map_destroy(&reader->zone_map);
+    ub_log_reader_clear_keys(reader);
+    reader->file = 0;
+}
+
+const uint8_t* ub_log_reader_get_row(const ub_log_reader_t* reader,
+        size_t index) {
+    if (reader->row_length == 0)
+        return 0;
+    return reader->rows + index * reader->row_length;
+}
+
+ub_error_t ub_log_reader_read_column(const ub_log_reader_t* reader,
+        size_t column, void* dest) {
+    const uint8_t* src;
+    uint8_t* d = (uint8_t*)dest;
+    size_t i, width;
+
+    if (column >= reader->num_columns)
+        return UB_EINVAL;
+    if (reader->row_length == 0)
+        return UB_EUNSUPPORTED;
+
+    width = ub_datatype_get_info(reader->columns[column].type).length;
+
+    /* gather the encoded values first, then convert them in one batch */
+    src = reader->rows + reader->offsets[column];
+    for (i = 0; i < reader->num_rows; i++, src += reader->row_length, d += width)
+        memcpy(d, src, width);
+
+    return ub_byteorder_decode_column(reader->columns[column].type,
+            reader->byte_order, dest, dest, reader->num_rows);
+}
+
+ub_error_t ub_log_reader_seek_block(ub_log_reader_t* reader, uint64_t offset,
+        uint64_t first_row) {
+    if (fseek(reader->file, offset, SEEK_SET))
+        return UB_EREAD;
+
+    ub_i_log_reader_clear_rows(reader);
+    reader->first_row = first_row;
+
+    return ub_log_reader_next_block(reader);
+}
+
+/**
+ * Reloads the columns from the log header block at the given file offset.
+ */
+static ub_error_t ub_i_log_reader_load_log_header(ub_log_reader_t* reader,
+        uint64_t offset) {
+    ub_block_type_t block_type;
+
+    if (fseek(reader->file, offset, SEEK_SET))
+        return UB_EREAD;
+
+    UB_CHECK(ub_read_block(reader->file, &block_type, &reader->block,
+                reader->chksum_type));
+    if (block_type != UB_BLOCK_LOG_HEADER)
+        return UB_EPARSE;
+
+    UB_CHECK(ub_i_log_reader_parse_log_header(reader));
+    reader->header_offset = offset;
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_log_reader_seek_sync(ub_log_reader_t* reader, uint64_t offset) {
+    size_t sync_length = 3 + UB_SYNC_BLOCK_LENGTH +
+        ub_chksum_size(reader->chksum_type);
+    size_t length, found;
+    uint64_t schema_id, row;
+    ub_error_t retval;
+
+    ub_i_log_reader_clear_rows(reader);
+    UB_CHECK(ub_buffer_resize(&reader->block, UB_I_SYNC_CHUNK_SIZE));
+
+    /* read the file in overlapping chunks so that sync blocks that cross
+     * the end of a chunk are found in the next one */
+    while (1) {
+        if (fseek(reader->file, offset, SEEK_SET))
+            return UB_EREAD;
+
+        length = fread(UB_BUFFER(reader->block), 1, UB_I_SYNC_CHUNK_SIZE,
+                reader->file);
+        if (length < UB_I_SYNC_CHUNK_SIZE && ferror(reader->file))
+            return UB_EREAD;
+
+        retval = ub_find_sync_block(UB_BUFFER(reader->block), length,
+                reader->chksum_type, &found, &schema_id, &row);
+        if (retval == UB_SUCCESS)
+            break;
+        if (length < UB_I_SYNC_CHUNK_SIZE)
+            return UB_EOF;
+
+        offset += length - (sync_length - 1);
+    }
+
+    if (schema_id != reader->header_offset)
+        UB_CHECK(ub_i_log_reader_load_log_header(reader, schema_id));
+
+    offset += found + sync_length;
+    if (fseek(reader->file, offset, SEEK_SET))
+        return UB_EREAD;
+
+    reader->first_row = row;
+
+    return ub_log_reader_next_block(reader);
+}
+
+/**
+ * Seeks to the log entry block with the given index entry and reads it.
+ */
+static ub_error_t ub_i_log_reader_seek_block(ub_log_reader_t* reader,
+        const ub_block_index_entry_t* entry) {
+    UB_CHECK(ub_log_reader_seek_block(reader, entry->offset,
+                entry->first_row));
+
+    return reader->num_rows == entry->num_rows ? UB_SUCCESS : UB_EPARSE;
+}
+
+/**
+ * Decodes the timestamp of the row at the given address in the current block.
+ */
+static ub_error_t ub_i_log_reader_get_timestamp(const ub_log_reader_t* reader,
+        const uint8_t* row, int64_t* value) {
+    size_t column = reader->index.timestamp_column;
+    size_t i, length, offset;
+
+    if (column >= reader->num_columns)
+        return UB_EPARSE;
+
+    if (reader->offsets) {
+        offset = reader->offsets[column];
+    } else {
+        for (i = 0, offset = 0; i < column; i++, offset += length) {
+            length = ub_datatype_get_value_length(reader->columns[i].type,
+                    row + offset, reader->rows + reader->rows_length - row - offset);
+            if (length == 0)
+                return UB_EPARSE;
+        }
+    }
+
+    return ub_byteorder_decode_int64(reader->columns[column].type,
+            reader->byte_order, row + offset, value);
+}
+
+ub_error_t ub_log_reader_load_index(ub_log_reader_t* reader) {
+    ub_error_t retval;
+    long pos;
+
+    pos = ftell(reader->file);
+    if (pos < 0)
+        return UB_EUNSUPPORTED;
+
+    retval = ub_block_index_read(&reader->index, reader->file,
+            reader->chksum_type);
+
+    if (fseek(reader->file, pos, SEEK_SET) && retval == UB_SUCCESS)
+        retval = UB_EREAD;
+
+    return retval;
+}
+
+ub_error_t ub_log_reader_seek_row(ub_log_reader_t* reader, uint64_t row,
+        size_t* index) {
+    size_t entry;
+
+    if (reader->index.entries == 0)
+        return UB_EINVAL;
+
+    UB_CHECK(ub_block_index_find_row(&reader->index, row, &entry));
+    UB_CHECK(ub_i_log_reader_seek_block(reader, &reader->index.entries[entry]));
+
+    if (index)
+        *index = row - reader->first_row;
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_log_reader_seek_timestamp(ub_log_reader_t* reader,
+        int64_t timestamp, size_t* index) {
+    const uint8_t* row;
+    size_t lo, hi, mid, entry, length;
+    int64_t value;
+
+    if (reader->index.entries == 0)
+        return UB_EINVAL;
+
+    UB_CHECK(ub_block_index_find_timestamp(&reader->index, timestamp, &entry));
+    UB_CHECK(ub_i_log_reader_seek_block(reader, &reader->index.entries[entry]));
+
+    lo = 0;
+    if (reader->row_length > 0) {
+        /* binary search for the first row that is not older than the
+         * timestamp */
+        hi = reader->num_rows;
+        while (lo < hi) {
+            mid = lo + (hi - lo) / 2;
+            UB_CHECK(ub_i_log_reader_get_timestamp(reader,
+                        ub_log_reader_get_row(reader, mid), &value));
+            if (value < timestamp)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+    } else {
+        /* rows have variable length so we need to scan them */
+        row = reader->rows;
+        for (; lo < reader->num_rows; lo++, row += length) {
+            UB_CHECK(ub_i_log_reader_get_timestamp(reader, row, &value));
+            if (value >= timestamp)
+                break;
+
+            length = ub_i_log_reader_get_row_length(reader, row,
+                    reader->rows + reader->rows_length - row);
+            if (length == 0)
+                return UB_EPARSE;
+        }
+    }
+
+    if (index)
+        *index = lo;
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_log_reader_add_filter(ub_log_reader_t* reader, size_t column,
+        ub_filter_op_t op, const void* value) {
+    ub_filter_t filter;
+    ub_filter_t* filters;
+    size_t count;
+
+    if (column >= reader->num_columns)
+        return UB_EINVAL;
+
+    UB_CHECK(ub_filter_init(&filter, column, reader->columns[column].type,
+                op, value));
+
+    count = reader->num_filters + 1;
+    filters = ub_realloc(reader->filters, ub_filter_t, count);
+    if (filters == 0)
+        return UB_ENOMEM;
+
+    filters[reader->num_filters++] = filter;
+    reader->filters = filters;
+
+    return UB_SUCCESS;
+}
+
+void ub_log_reader_clear_filters(ub_log_reader_t* reader) {
+    ub_free_unless_null(reader->filters);
+    reader->num_filters = 0;
+}
+
+ub_error_t ub_log_reader_add_key(ub_log_reader_t* reader, size_t column,
+        const void* value, size_t length) {
+    ub_bloom_key_t key;
+    ub_bloom_key_t* keys;
+    size_t count;
+
+    if (column >= reader->num_columns)
+        return UB_EINVAL;
+
+    UB_CHECK(ub_bloom_key_init(&key, column, reader->columns[column].type,
+                value, length));
+
+    count = reader->num_keys + 1;
+    keys = ub_realloc(reader->keys, ub_bloom_key_t, count);
+    if (keys == 0)
+        return UB_ENOMEM;
+
+    keys[reader->num_keys++] = key;
+    reader->keys = keys;
+
+    return UB_SUCCESS;
+}
+
+void ub_log_reader_clear_keys(ub_log_reader_t* reader) {
+    ub_free_unless_null(reader->keys);
+    reader->num_keys = 0;
+}
+
+/**
+ * Skips the next log entry block, which has the given number of rows,
+ * without reading its payload.
+ */
+static ub_error_t ub_i_log_reader_skip_block(ub_log_reader_t* reader,
+        size_t num_rows) {
+    ub_block_type_t block_type;
+    ub_error_t retval;
+
+    while (1) {
+        retval = ub_skip_block(reader->file, &block_type, reader->chksum_type);
+        if (retval == UB_EOF)
+            return UB_EPARSE;
+        UB_CHECK(retval);
+
+        switch (block_type) {
+            case UB_BLOCK_LOG_ENTRY:
+            case UB_BLOCK_ENCODED_LOG_ENTRY:
+                reader->first_row += num_rows;
+                return UB_SUCCESS;
+
+            case UB_BLOCK_LOG_HEADER:
+            case UB_BLOCK_ZONE_MAP:
+                /* a zone map is followed by its Bloom filters, if any, and
+                 * then by its log entry block */
+                return UB_EPARSE;
+
+            default:
+                break;
+        }
+    }
+}
+
+/**
+ * Keeps the kernel reading ahead of a sequential reader and drops the pages
+ * behind a one-pass reader, after the reader moved to a new block.
+ */
+static void ub_i_log_reader_follow(ub_log_reader_t* reader) {
+#ifdef HAVE_POSIX_FADVISE
+    uint64_t offset = reader->block_offset;
+    int fd;
+
+    if (reader->access_pattern != UB_ACCESS_SEQUENTIAL &&
+            reader->access_pattern != UB_ACCESS_ONCE)
+        return;
+
+    fd = fileno(reader->file);
+
+    /* the next window is requested when the reader is halfway through the
+     * current one, or anew when the reader jumped away from it */
+    if (offset > reader->advised_offset ||
+            offset + 2 * UB_LOG_READER_READAHEAD_LENGTH < reader->advised_offset)
+        reader->advised_offset = offset;
+    if (offset + UB_LOG_READER_READAHEAD_LENGTH / 2 >= reader->advised_offset) {
+        posix_fadvise(fd, reader->advised_offset,
+                UB_LOG_READER_READAHEAD_LENGTH, POSIX_FADV_WILLNEED);
+        reader->advised_offset += UB_LOG_READER_READAHEAD_LENGTH;
+    }
+
+    /* the kernel keeps the partial pages at the ends of the range */
+    if (reader->access_pattern == UB_ACCESS_ONCE) {
+        if (offset < reader->dropped_offset) {
+            reader->dropped_offset = offset;
+        } else if (offset - reader->dropped_offset >=
+                UB_LOG_READER_READAHEAD_LENGTH) {
+            posix_fadvise(fd, reader->dropped_offset,
+                    offset - reader->dropped_offset, POSIX_FADV_DONTNEED);
+            reader->dropped_offset = offset;
+        }
+    }
+#endif
+}
+
+ub_error_t ub_log_reader_next_block(ub_log_reader_t* reader) {
+    ub_block_type_t block_type;
+    ub_bool_t match;
+    size_t num_rows;
+
+    reader->first_row += reader->num_rows;
+    ub_i_log_reader_clear_rows(reader);
+
+    while (1) {
+        reader->block_offset = ftell(reader->file);
+        ub_i_log_reader_follow(reader);
+        UB_CHECK(ub_read_block(reader->file, &block_type, &reader->block,
+                    reader->chksum_type));
+
+        switch (block_type) {
+            case UB_BLOCK_LOG_HEADER:
+                UB_CHECK(ub_i_log_reader_parse_log_header(reader));
+                reader->header_offset = reader->block_offset;
+                break;
+
+            case UB_BLOCK_ZONE_MAP:
+                UB_CHECK(ub_zone_map_decode(&reader->zone_map,
+                            UB_BUFFER(reader->block),
+                            ub_buffer_size(&reader->block)));
+                if (!ub_zone_map_may_match(&reader->zone_map,
+                            reader->columns, reader->num_columns,
+                            reader->filters, reader->num_filters))
+                    UB_CHECK(ub_i_log_reader_skip_block(reader,
+                                reader->zone_map.num_rows));
+                break;
+
+            case UB_BLOCK_BLOOM_FILTER:
+                if (reader->num_keys == 0)
+                    break;
+                UB_CHECK(ub_bloom_filter_may_contain(UB_BUFFER(reader->block),
+                            ub_buffer_size(&reader->block), reader->keys,
+                            reader->num_keys, &num_rows, &match));
+                if (!match)
+                    UB_CHECK(ub_i_log_reader_skip_block(reader, num_rows));
+                break;
+
+            case UB_BLOCK_LOG_ENTRY:
+                reader->rows = UB_BUFFER(reader->block);
+                reader->rows_length = ub_buffer_size(&reader->block);
+                if (reader->row_length == 0)
+                    return ub_i_log_reader_count_rows(reader);
+                if (reader->rows_length % reader->row_length != 0)
+                    return UB_EPARSE;
+                reader->num_rows = reader->rows_length / reader->row_length;
+                return UB_SUCCESS;
+
+            case UB_BLOCK_ENCODED_LOG_ENTRY:
+                /* codecs are not supported with the aligned layout */
+                if (reader->aligned)
+                    return UB_EPARSE;
+                UB_CHECK(ub_codec_decode_log_entries(reader->columns,
+                            reader->num_columns, UB_BUFFER(reader->block),
+                            ub_buffer_size(&reader->block), &reader->decoded,
+                            &reader->num_rows));
+                reader->rows = UB_BUFFER(reader->decoded);
+                reader->rows_length = ub_buffer_size(&reader->decoded);
+                return UB_SUCCESS;
+
+            default:
+                break;
+        }
+    }
+}
+
+ub_error_t ub_log_reader_set_access_pattern(ub_log_reader_t* reader,
+        ub_access_pattern_t pattern) {
+#ifdef HAVE_POSIX_FADVISE
+    int advice, fd;
+#endif
+
+    switch (pattern) {
+        case UB_ACCESS_NORMAL:
+        case UB_ACCESS_SEQUENTIAL:
+        case UB_ACCESS_RANDOM:
+        case UB_ACCESS_ONCE:
+            break;
+
+        default:
+            return UB_EINVAL;
+    }
+
+#ifdef HAVE_POSIX_FADVISE
+    fd = fileno(reader->file);
+    if (fd < 0)
+        return UB_EUNSUPPORTED;
+
+    if (pattern == UB_ACCESS_NORMAL)
+        advice = POSIX_FADV_NORMAL;
+    else if (pattern == UB_ACCESS_RANDOM)
+        advice = POSIX_FADV_RANDOM;
+    else
+        advice = POSIX_FADV_SEQUENTIAL;
+
+    if (posix_fadvise(fd, 0, 0, advice))
+        return UB_EUNSUPPORTED;
+
+    reader->access_pattern = pattern;
+    reader->advised_offset = reader->block_offset;
+    reader->dropped_offset = reader->block_offset;
+
+    return UB_SUCCESS;
+#else
+    return UB_EUNSUPPORTED;
+#endif
+}
+
+ub_error_t ub_log_reader_prefetch_rows(ub_log_reader_t* reader,
+        uint64_t first_row, uint64_t num_rows) {
+#ifdef HAVE_POSIX_FADVISE
+    const ub_block_index_t* index = &reader->index;
+    uint64_t begin, end, last_row;
+    size_t first, last;
+    int fd;
+
+    if (index->entries == 0)
+        return UB_EINVAL;
+
+    fd = fileno(reader->file);
+    if (fd < 0)
+        return UB_EUNSUPPORTED;
+    if (num_rows == 0)
+        return UB_SUCCESS;
+
+    UB_CHECK(ub_block_index_find_row(index, first_row, &first));
+    last_row = first_row + num_rows - 1;
+    if (last_row < first_row ||
+            ub_block_index_find_row(index, last_row, &last) != UB_SUCCESS)
+        last = index->num_entries - 1;
+
+    /* the blocks are contiguous; the range ends where the block after the
+     * last one starts, or at the end of the file */
+    begin = index->entries[first].offset;
+    end = last + 1 < index->num_entries ? index->entries[last + 1].offset : 0;
+
+    posix_fadvise(fd, begin, end > begin ? end - begin : 0,
+            POSIX_FADV_WILLNEED);
+
+    return UB_SUCCESS;
+#else
+    return UB_EUNSUPPORTED;
+#endif
+}
+
+/**
+ * Starts the read of the block at the given offset.
+ */
+static ub_error_t ub_i_fetch_start(ub_i_fetch_t* fetch, size_t index,
+        uint64_t offset) {
+    fetch->index = index;
+    fetch->offset = offset;
+    fetch->length = 0;
+    return ub_buffer_resize(&fetch->data, UB_LOG_READER_FETCH_LENGTH);
+}
+
+/**
+ * Accounts for the result of a read into a fetch. \p complete is set if
+ * the whole block has arrived; otherwise the fetch needs another read,
+ * which may be longer if the header of the block has arrived.
+ */
+static ub_error_t ub_i_fetch_advance(const ub_log_reader_t* reader,
+        ub_i_fetch_t* fetch, long result, ub_bool_t* complete) {
+    const uint8_t* data = UB_BUFFER(fetch->data);
+    size_t length;
+
+    *complete = 0;
+    if (result < 0)
+        return UB_EREAD;
+    if (result == 0)
+        return UB_EPARSE;        /* the file ends within the block */
+
+    fetch->length += result;
+    if (fetch->length < 3)
+        return UB_SUCCESS;
+
+    length = 3 + ((data[1] << 8) | data[2]) +
+        ub_chksum_size(reader->chksum_type);
+    if (fetch->length >= length) {
+        *complete = 1;
+        return UB_SUCCESS;
+    }
+
+    return ub_buffer_resize_if_smaller(&fetch->data, length);
+}
+
+/**
+ * Decodes a fetched block and passes it to the block function.
+ */
+static ub_error_t ub_i_fetch_deliver(const ub_log_reader_t* reader,
+        const ub_i_fetch_t* fetch, ub_buffer_t* decoded,
+        ub_scan_block_func_t* block_func, void* user_data) {
+    ub_block_type_t block_type;
+    ub_scan_block_t block;
+    const uint8_t* payload;
+    size_t length;
+
+    UB_CHECK(ub_parse_block(UB_BUFFER(fetch->data), fetch->length,
+                &block_type, &payload, &length, reader->chksum_type));
+
+    block.range = fetch->index;
+    block.offset = fetch->offset;
+    block.columns = reader->columns;
+    block.num_columns = reader->num_columns;
+    block.offsets = reader->offsets;
+    block.row_length = reader->row_length;
+    block.byte_order = reader->byte_order;
+    block.rows = payload;
+    block.rows_length = length;
+
+    switch (block_type) {
+        case UB_BLOCK_LOG_ENTRY:
+            if (reader->row_length == 0) {
+                UB_CHECK(ub_i_log_reader_count_rows_in(reader, payload,
+                            length, &block.num_rows));
+            } else if (length % reader->row_length != 0) {
+                return UB_EPARSE;
+            } else {
+                block.num_rows = length / reader->row_length;
+            }
+            break;
+
+        case UB_BLOCK_ENCODED_LOG_ENTRY:
+            /* codecs are not supported with the aligned layout */
+            if (reader->aligned)
+                return UB_EPARSE;
+            UB_CHECK(ub_codec_decode_log_entries(reader->columns,
+                        reader->num_columns, payload, length, decoded,
+                        &block.num_rows));
+            block.rows = UB_BUFFER(*decoded);
+            block.rows_length = ub_buffer_size(decoded);
+            break;
+
+        default:
+            return UB_EPARSE;
+    }
+
+    return block_func(&block, user_data);
+}
+
+/**
+ * Reads the blocks one by one with \c pread().
+ */
+static ub_error_t ub_i_log_reader_fetch_sync(ub_log_reader_t* reader,
+        int fd, const uint64_t* offsets, size_t count, ub_i_fetch_t* fetch,
+        ub_buffer_t* decoded, ub_scan_block_func_t* block_func,
+        void* user_data) {
+    ub_bool_t complete;
+    ssize_t result;
+    size_t i;
+
+#ifdef HAVE_POSIX_FADVISE
+    /* let the kernel read the blocks in parallel while we wait for them one
+     * by one */
+    for (i = 0; i < count; i++)
+        posix_fadvise(fd, offsets[i], UB_LOG_READER_FETCH_LENGTH,
+                POSIX_FADV_WILLNEED);
+#endif
+
+    for (i = 0; i < count; i++) {
+        UB_CHECK(ub_i_fetch_start(fetch, i, offsets[i]));
+
+        do {
+            do {
+                result = pread(fd, UB_BUFFER(fetch->data) + fetch->length,
+                        ub_buffer_size(&fetch->data) - fetch->length,
+                        fetch->offset + fetch->length);
+            } while (result < 0 && errno == EINTR);
+            UB_CHECK(ub_i_fetch_advance(reader, fetch, result, &complete));
+        } while (!complete);
+
+        UB_CHECK(ub_i_fetch_deliver(reader, fetch, decoded, block_func,
+                    user_data));
+    }
+
+    return UB_SUCCESS;
+}
+
+#ifdef HAVE_IO_URING
+
+/**
+ * Queues the next read of a fetch into the ring.
+ */
+static ub_error_t ub_i_fetch_queue(ub_uring_t* ring, int fd,
+        ub_i_fetch_t* fetch, size_t slot) {
+    struct io_uring_sqe* sqe;
+
+    /* there is an entry for each fetch, so the queue is never full */
+    sqe = ub_uring_get_sqe(ring);
+    if (sqe == 0)
+        return UB_FAILURE;
+
+    fetch->iovec.iov_base = UB_BUFFER(fetch->data) + fetch->length;
+    fetch->iovec.iov_len = ub_buffer_size(&fetch->data) - fetch->length;
+
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)&fetch->iovec;
+    sqe->len = 1;
+    sqe->off = fetch->offset + fetch->length;
+    sqe->user_data = slot;
+
+    return UB_SUCCESS;
+}
+
+/**
+ * Reads the blocks through the given ring, keeping a read in flight for
+ * each fetch until all the blocks are read. After an error, the reads in
+ * flight are waited for but their blocks are dropped. If their completions
+ * cannot be waited for, they are cancelled, and the buffers of the fetches
+ * are leaked unless the cancellation completes.
+ */
+static ub_error_t ub_i_log_reader_fetch_async(ub_log_reader_t* reader,
+        ub_uring_t* ring, int fd, const uint64_t* offsets, size_t count,
+        ub_i_fetch_t* fetches, size_t depth, ub_buffer_t* decoded,
+        ub_scan_block_func_t* block_func, void* user_data) {
+    ub_error_t result, retval = UB_SUCCESS;
+    size_t i, next, in_flight = 0;
+    ub_i_fetch_t* fetch;
+    ub_bool_t complete;
+    uint64_t slot;
+    int32_t value;
+
+    /* the first reads go out as a single batch */
+    for (next = 0; next < depth && retval == UB_SUCCESS; next++) {
+        retval = ub_i_fetch_start(&fetches[next], next, offsets[next]);
+        if (retval == UB_SUCCESS)
+            retval = ub_i_fetch_queue(ring, fd, &fetches[next], next);
+        if (retval == UB_SUCCESS)
+            in_flight++;
+    }
+    if (ub_uring_submit(ring, 0) && retval == UB_SUCCESS)
+        retval = UB_EREAD;
+
+    while (in_flight > 0) {
+        if (ub_uring_wait(ring, &slot, &value)) {
+            /* the reads in flight write into the buffers of the fetches,
+             * which must outlive them */
+            if (ub_uring_cancel(ring, in_flight)) {
+                for (i = 0; i < depth; i++)
+                    fetches[i].data.owner = 0;
+            }
+            return UB_EREAD;
+        }
+
+        fetch = &fetches[slot];
+        if (retval != UB_SUCCESS) {
+            in_flight--;
+            continue;
+        }
+
+        /* the rest of the block, if needed, goes out with the next wait */
+        result = ub_i_fetch_advance(reader, fetch, value, &complete);
+        if (result == UB_SUCCESS && !complete) {
+            result = ub_i_fetch_queue(ring, fd, fetch, slot);
+            if (result == UB_SUCCESS)
+                continue;
+        }
+        in_flight--;
+
+        if (result == UB_SUCCESS)
+            result = ub_i_fetch_deliver(reader, fetch, decoded, block_func,
+                    user_data);
+
+        if (result == UB_SUCCESS && next < count) {
+            result = ub_i_fetch_start(fetch, next, offsets[next]);
+            if (result == UB_SUCCESS)
+                result = ub_i_fetch_queue(ring, fd, fetch, slot);
+            if (result == UB_SUCCESS)
+                in_flight++;
+            next++;
+        }
+
+        retval = result;
+    }
+
+    return retval;
+}
+
+#endif
+
+ub_error_t ub_log_reader_fetch_blocks(ub_log_reader_t* reader,
+        const uint64_t* offsets, size_t count,
+        ub_scan_block_func_t* block_func, void* user_data) {
+    ub_i_fetch_t* fetches;
+    ub_buffer_t decoded;
+    ub_error_t retval = UB_SUCCESS;
+    size_t i, depth;
+    int fd;
+#ifdef HAVE_IO_URING
+    ub_uring_t ring;
+#endif
+
+    if (count == 0)
+        return UB_SUCCESS;
+
+    fd = fileno(reader->file);
+    if (fd < 0)
+        return UB_EUNSUPPORTED;
+
+    depth = count < UB_LOG_READER_FETCH_DEPTH ?
+        count : UB_LOG_READER_FETCH_DEPTH;
+    fetches = ub_calloc(ub_i_fetch_t, depth);
+    if (fetches == 0)
+        return UB_ENOMEM;
+
+    for (i = 0; i < depth && retval == UB_SUCCESS; i++)
+        retval = ub_buffer_init(&fetches[i].data, UB_LOG_READER_FETCH_LENGTH);
+    if (retval == UB_SUCCESS)
+        retval = ub_buffer_init(&decoded, 0);
+    if (retval != UB_SUCCESS) {
+        /* the buffers are zeroed, so destroying the missing ones is a no-op */
+        for (i = 0; i < depth; i++)
+            ub_buffer_destroy(&fetches[i].data);
+        ub_free(fetches);
+        return retval;
+    }
+
+#ifdef HAVE_IO_URING
+    if (ub_uring_init(&ring, depth) == UB_SUCCESS) {
+        retval = ub_i_log_reader_fetch_async(reader, &ring, fd, offsets,
+                count, fetches, depth, &decoded, block_func, user_data);
+        ub_uring_destroy(&ring);
+    } else {
+        retval = ub_i_log_reader_fetch_sync(reader, fd, offsets, count,
+                fetches, &decoded, block_func, user_data);
+    }
+#else
+    retval = ub_i_log_reader_fetch_sync(reader, fd, offsets, count,
+            fetches, &decoded, block_func, user_data);
+#endif
+
+    ub_buffer_destroy(&decoded);
+    for (i = 0; i < depth; i++)
+        ub_buffer_destroy(&fetches[i].data);
+    ub_free(fetches);
+
+    return retval;
+}
@@ -0,0 +1,1080 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <unibinlog/log_writer.h>
+#include <unibinlog/lowlevel.h>
+#include <unibinlog/memory.h>
+
+#include "config.h"
+#include "sync_thread.h"
+#include "utils.h"
+
+#ifdef HAVE_FTRUNCATE
+#  include <unistd.h>
+#endif
+
+/**
+ * The number of values converted into network byte order at once by
+ * \ref ub_log_writer_write_columns().
+ */
+#define UB_I_COLUMN_CHUNK_SIZE 256
+
+/**
+ * The largest number of bytes at the end of the file that
+ * \ref ub_log_writer_init_append() reads when the file has no block index.
+ * It holds a few blocks of the maximum length.
+ */
+#define UB_I_RECOVERY_WINDOW 262144
+
+/**
+ * Returns the maximum number of bytes of row data that fit into a single
+ * block, taking into account the overhead of encoded log entry blocks.
+ */
+static size_t ub_i_log_writer_block_capacity(const ub_log_writer_t* writer) {
+    size_t overhead = 0;
+
+    if (writer->codec != UB_CODEC_RAW) {
+        overhead = 2 + 3 * writer->num_columns;
+    }
+
+    return writer->max_block_length > overhead ?
+        writer->max_block_length - overhead : 0;
+}
+
+/**
+ * Decodes the timestamp of the row at the given offset in the block of rows
+ * not written yet. The timestamp is zero if the log has no timestamp column.
+ */
+static ub_error_t ub_i_log_writer_get_timestamp(const ub_log_writer_t* writer,
+        size_t row_offset, int64_t* value) {
+    const uint8_t* row = UB_BUFFER(writer->block) + row_offset;
+    size_t i, length, size, offset = writer->timestamp_offset;
+    size_t column = writer->index.timestamp_column;
+
+    if (column == UB_BLOCK_INDEX_NO_TIMESTAMP) {
+        *value = 0;
+        return UB_SUCCESS;
+    }
+
+    if (offset == SIZE_MAX) {
+        /* rows have variable length; skip the columns before the
+         * timestamp one by one */
+        size = ub_buffer_size(&writer->block) - row_offset;
+        for (i = 0, offset = 0; i <= column; i++, offset += length) {
+            length = ub_datatype_get_value_length(writer->columns[i].type,
+                    row + offset, size - offset);
+            if (length == 0)
+                return UB_EINVAL;
+            if (i == column)
+                break;
+        }
+    }
+
+    return ub_byteorder_decode_int64(writer->columns[column].type,
+            writer->byte_order, row + offset, value);
+}
+
+static ub_error_t ub_i_log_writer_write_header(ub_log_writer_t* writer) {
+    size_t offsets[255];
+    uint8_t flags = 0;
+    long pos;
+
+    if (writer->header_written)
+        return UB_SUCCESS;
+
+    if (writer->index.timestamp_column != UB_BLOCK_INDEX_NO_TIMESTAMP) {
+        if (writer->row_length > 0) {
+            ub_log_columns_get_layout(writer->columns, writer->num_columns,
+                    writer->aligned, offsets);
+            writer->timestamp_offset = offsets[writer->index.timestamp_column];
+        } else {
+            writer->timestamp_offset = SIZE_MAX;
+        }
+    }
+
+    /* appending to a file that has its headers already */
+    if (writer->appending) {
+        writer->header_written = 1;
+        return UB_SUCCESS;
+    }
+
+    if (writer->byte_order == UB_LITTLE_ENDIAN)
+        flags |= UB_HEADER_FLAG_LITTLE_ENDIAN;
+    if (writer->aligned)
+        flags |= UB_HEADER_FLAG_ALIGNED;
+
+    UB_CHECK(ub_write_header_with_flags(writer->file, writer->version,
+                writer->chksum_type, flags));
+
+    if (writer->sync_interval > 0) {
+        pos = ftell(writer->file);
+        if (pos < 0)
+            return UB_EUNSUPPORTED;
+        writer->header_offset = pos;
+    }
+
+    UB_CHECK(ub_write_log_header_block(writer->file, writer->columns,
+                writer->num_columns, writer->chksum_type));
+
+    writer->header_written = 1;
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_log_writer_init(ub_log_writer_t* writer, FILE* f,
+        ub_log_column_t* columns, size_t num_columns,
+        ub_chksum_type_t chksum_type) {
+    if (num_columns > 255)
+        return UB_ETOOLONG;
+
+    writer->file = f;
+    writer->columns = columns;
+    writer->num_columns = num_columns;
+    writer->row_length = ub_log_columns_get_total_length(columns, num_columns);
+    writer->version = 1;
+    writer->chksum_type = chksum_type;
+    writer->header_written = 0;
+    writer->num_rows = 0;
+    writer->max_block_length = UB_LOG_WRITER_DEFAULT_BLOCK_LENGTH;
+    writer->codec = UB_CODEC_RAW;
+    writer->codec_sample_size = 0;
+    writer->byte_order = UB_BIG_ENDIAN;
+    writer->aligned = 0;
+    writer->indexed = 0;
+    writer->num_rows_written = 0;
+    writer->last_row_offset = 0;
+    writer->timestamp_offset = 0;
+    writer->zone_maps = 0;
+    writer->bloom_columns = 0;
+    writer->num_bloom_columns = 0;
+    writer->sync_interval = 0;
+    writer->next_sync = 0;
+    writer->header_offset = 0;
+    writer->appending = 0;
+    writer->rows_unknown = 0;
+    writer->durability = UB_DURABILITY_NONE;
+    writer->durability_param = 0;
+    writer->unsynced_blocks = 0;
+    writer->last_sync = ub_get_monotonic_ms();
+    writer->sync_thread = 0;
+    writer->sync_func = 0;
+    writer->sync_data = 0;
+    ub_block_index_init(&writer->index);
+    ub_zone_map_init(&writer->zone_map);
+
+    UB_CHECK(ub_buffer_init(&writer->block, writer->max_block_length));
+    UB_CHECK(ub_buffer_resize(&writer->block, 0));
+
+    if (ub_buffer_init(&writer->payload, writer->max_block_length)) {
+        ub_buffer_destroy(&writer->block);
+        return UB_ENOMEM;
+    }
+
+    return UB_SUCCESS;
+}
+
+/**
+ * Checks that the log header block with the given payload defines the
+ * columns of the writer.
+ */
+static ub_error_t ub_i_log_writer_check_columns(const ub_log_writer_t* writer,
+        const uint8_t* data, size_t size) {
+    ub_log_column_t column;
+    size_t i, consumed;
+    ub_bool_t match;
+
+    if (size < 1 || data[0] != writer->num_columns)
+        return UB_EINVAL;
+    data++; size--;
+
+    for (i = 0; i < writer->num_columns; i++) {
+        UB_CHECK(ub_log_column_read(&column, data, size, &consumed));
+        match = column.type == writer->columns[i].type &&
+            !strcmp(column.name, writer->columns[i].name);
+        ub_log_column_destroy(&column);
+        if (!match)
+            return UB_EINVAL;
+        data += consumed; size -= consumed;
+    }
+
+    return UB_SUCCESS;
+}
+
+/**
+ * Reads the log header block at the given file offset and checks that it
+ * defines the columns of the writer.
+ */
+static ub_error_t ub_i_log_writer_check_log_header(ub_log_writer_t* writer,
+        uint64_t offset) {
+    ub_block_type_t block_type;
+
+    if (fseek(writer->file, offset, SEEK_SET))
+        return UB_EUNSUPPORTED;
+
+    UB_CHECK(ub_read_block(writer->file, &block_type, &writer->payload,
+                writer->chksum_type));
+    if (block_type != UB_BLOCK_LOG_HEADER)
+        return UB_EPARSE;
+
+    return ub_i_log_writer_check_columns(writer, UB_BUFFER(writer->payload),
+            ub_buffer_size(&writer->payload));
+}
+
+/**
+ * Returns the number of rows in the payload of a log entry block, or zero
+ * if the payload is malformed.
+ */
+static size_t ub_i_log_writer_count_rows(const ub_log_writer_t* writer,
+        ub_block_type_t block_type, const uint8_t* data, size_t size) {
+    size_t i, length, num_rows = 0;
+
+    if (block_type == UB_BLOCK_ENCODED_LOG_ENTRY)
+        return size < 2 ? 0 : (data[0] << 8) | data[1];
+
+    if (writer->row_length > 0)
+        return size % writer->row_length ? 0 : size / writer->row_length;
+
+    while (size > 0 && writer->num_columns > 0) {
+        for (i = 0; i < writer->num_columns; i++) {
+            length = ub_datatype_get_value_length(writer->columns[i].type,
+                    data, size);
+            if (length == 0)
+                return 0;
+            data += length; size -= length;
+        }
+        num_rows++;
+    }
+
+    return num_rows;
+}
+
+/**
+ * Decides whether the given byte is the type of a block that may appear in
+ * a log.
+ */
+static ub_bool_t ub_i_log_writer_is_block_type(uint8_t block_type) {
+    switch (block_type) {
+        case UB_BLOCK_COMMENT:
+        case UB_BLOCK_LOG_HEADER:
+        case UB_BLOCK_LOG_ENTRY:
+        case UB_BLOCK_EVENT:
+        case UB_BLOCK_ENCODED_LOG_ENTRY:
+        case UB_BLOCK_PADDING:
+        case UB_BLOCK_INDEX:
+        case UB_BLOCK_INDEX_TRAILER:
+        case UB_BLOCK_ZONE_MAP:
+        case UB_BLOCK_BLOOM_FILTER:
+        case UB_BLOCK_SYNC:
+            return 1;
+
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Walks the intact blocks at the end of a file, read into the given memory
+ * area from file offset \p base, starting from the block at offset \p pos
+ * of the area. The walk stops at the first block that is truncated, has an
+ * invalid checksum or belongs to a block index. \p end is set to the
+ * offset after the last block that can be kept, \p num_rows is advanced by
+ * the number of rows in the blocks up to there and \p header_offset is set
+ * to the offset of the last log header block found.
+ *
+ * \return the offset of the area where the walk stopped; \p at_index is
+ *         set if the walk stopped at a block index
+ */
+static size_t ub_i_log_writer_walk_tail(const ub_log_writer_t* writer,
+        const uint8_t* data, size_t size, uint64_t base, size_t pos,
+        uint64_t* end, uint64_t* num_rows, uint64_t* header_offset,
+        ub_bool_t* at_index) {
+    ub_block_type_t block_type;
+    const uint8_t* payload;
+    size_t length, count = 0;
+
+    *at_index = 0;
+
+    while (ub_parse_block(data + pos, size - pos, &block_type, &payload,
+                &length, writer->chksum_type) == UB_SUCCESS) {
+        switch (block_type) {
+            case UB_BLOCK_INDEX:
+            case UB_BLOCK_INDEX_TRAILER:
+                *at_index = 1;
+                return pos;
+
+            case UB_BLOCK_LOG_HEADER:
+                *header_offset = base + pos;
+                break;
+
+            case UB_BLOCK_LOG_ENTRY:
+            case UB_BLOCK_ENCODED_LOG_ENTRY:
+                count = ub_i_log_writer_count_rows(writer, block_type,
+                        payload, length);
+                if (count == 0 && length > 0)
+                    return pos;
+                break;
+
+            default:
+                break;
+        }
+
+        pos += 3 + length + ub_chksum_size(writer->chksum_type);
+
+        /* these blocks are useless without the log entry block after them */
+        if (block_type == UB_BLOCK_ZONE_MAP ||
+                block_type == UB_BLOCK_BLOOM_FILTER ||
+                block_type == UB_BLOCK_PADDING || block_type == UB_BLOCK_SYNC)
+            continue;
+
+        *end = base + pos;
+        *num_rows += count;
+        count = 0;
+    }
+
+    return pos;
+}
+
+/**
+ * Decides whether the bytes after the last intact block can be a torn
+ * write: a single block whose header says that it runs past the end of
+ * the file, or zeros that the file system left behind after a power loss.
+ */
+static ub_bool_t ub_i_log_writer_is_torn(const ub_log_writer_t* writer,
+        const uint8_t* data, size_t size) {
+    size_t i;
+
+    if (size > 0 && ub_i_log_writer_is_block_type(data[0]) && (size < 3 ||
+                3 + ((data[1] << 8) | data[2]) +
+                ub_chksum_size(writer->chksum_type) > size))
+        return 1;
+
+    for (i = 0; i < size; i++) {
+        if (data[i] != 0)
+            return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Finds the first block boundary in the end of a file, read into the given
+ * memory area from file offset \p base, where the area starts in the
+ * middle of a block. Each offset is tried in turn: a block whose type is
+ * known and whose checksum is valid has to start there, and the chain of
+ * blocks from there has to run to the end of the file, apart from a block
+ * index or a torn write. The tail is then walked from the boundary as in
+ * \ref ub_i_log_writer_walk_tail(); the rows before the boundary are
+ * unknown, so the rows are not counted.
+ *
+ * \return \c UB_SUCCESS or \c UB_EPARSE if no boundary was found
+ */
+static ub_error_t ub_i_log_writer_resync_tail(const ub_log_writer_t* writer,
+        const uint8_t* data, size_t size, uint64_t base, uint64_t* end,
+        uint64_t* header_offset) {
+    size_t chksum_size = ub_chksum_size(writer->chksum_type);
+    size_t pos, next, stop;
+    uint64_t candidate_end, candidate_rows, candidate_header;
+    ub_bool_t at_index;
+
+    for (pos = 0; pos + 3 <= size; pos++) {
+        if (!ub_i_log_writer_is_block_type(data[pos]))
+            continue;
+
+        /* the type of the next block is cheaper to check than the checksum */
+        next = pos + 3 + ((data[pos + 1] << 8) | data[pos + 2]) + chksum_size;
+        if (next > size || (next < size &&
+                    !ub_i_log_writer_is_block_type(data[next])))
+            continue;
+
+        candidate_end = base + pos;
+        candidate_rows = 0;
+        candidate_header = *header_offset;
+        stop = ub_i_log_writer_walk_tail(writer, data, size, base, pos,
+                &candidate_end, &candidate_rows, &candidate_header, &at_index);
+        if (stop == pos)
+            continue;
+
+        if (at_index || ub_i_log_writer_is_torn(writer, data + stop,
+                    size - stop)) {
+            *end = candidate_end;
+            *header_offset = candidate_header;
+            return UB_SUCCESS;
+        }
+    }
+
+    return UB_EPARSE;
+}
+
+/**
+ * Reads the end of the file, starting from the given offset, into the
+ * given buffer.
+ */
+static ub_error_t ub_i_log_writer_read_tail(ub_log_writer_t* writer,
+        ub_buffer_t* tail, uint64_t offset, uint64_t size) {
+    if (fseek(writer->file, offset, SEEK_SET))
+        return UB_EUNSUPPORTED;
+
+    UB_CHECK(ub_buffer_resize(tail, size - offset));
+    if (fread(UB_BUFFER(*tail), 1, size - offset, writer->file) !=
+            size - offset)
+        return UB_EREAD;
+
+    return UB_SUCCESS;
+}
+
+/**
+ * Cuts the file at the given length.
+ */
+static ub_error_t ub_i_log_writer_truncate(ub_log_writer_t* writer,
+        uint64_t length) {
+#ifdef HAVE_FTRUNCATE
+    if (fflush(writer->file) == 0 && fileno(writer->file) >= 0 &&
+            ftruncate(fileno(writer->file), length) == 0)
+        return UB_SUCCESS;
+#endif
+    return UB_EUNSUPPORTED;
+}
+
+/**
+ * Finds the end of the last intact block of the file of the writer, whose
+ * blocks start at offset \p start and which is \p size bytes long. Only
+ * the end of the file is read, into the given buffer: the blocks from the
+ * last one in the block index of the file if it has one, or else at most
+ * \ref UB_I_RECOVERY_WINDOW bytes. \p num_rows is set to the number of rows
+ * before the end, or to zero with \c rows_unknown set on the writer if
+ * that cannot be told from the end of the file.
+ */
+static ub_error_t ub_i_log_writer_find_end(ub_log_writer_t* writer,
+        ub_buffer_t* tail, uint64_t start, uint64_t size, uint64_t* end,
+        uint64_t* num_rows, uint64_t* header_offset) {
+    const ub_block_index_entry_t* last;
+    uint64_t from, schema_id, row;
+    size_t offset, found, sync = SIZE_MAX;
+    ub_bool_t at_index;
+
+    if (ub_block_index_read(&writer->index, writer->file,
+                writer->chksum_type) == UB_SUCCESS &&
+            writer->index.num_entries > 0) {
+        /* the index points to the last log entry block; it is written again
+         * with the new blocks when the writer is closed */
+        last = &writer->index.entries[writer->index.num_entries - 1];
+        if (last->offset < start || last->offset >= size)
+            return UB_EPARSE;
+
+        writer->indexed = 1;
+        from = last->offset;
+        *num_rows = last->first_row;
+        offset = 0;
+    } else {
+        ub_block_index_clear(&writer->index);
+        writer->index.timestamp_column = UB_BLOCK_INDEX_NO_TIMESTAMP;
+
+        from = size - start > UB_I_RECOVERY_WINDOW ?
+            size - UB_I_RECOVERY_WINDOW : start;
+        offset = 0;
+    }
+
+    UB_CHECK(ub_i_log_writer_read_tail(writer, tail, from, size));
+
+    if (!writer->indexed && from > start) {
+        /* the last sync block in the window tells the row number and the
+         * log header block */
+        for (offset = 0; ub_find_sync_block(UB_BUFFER(*tail) + offset,
+                    size - from - offset, writer->chksum_type, &found,
+                    &schema_id, &row) == UB_SUCCESS; offset += found + 1) {
+            sync = offset + found;
+            *header_offset = schema_id;
+            *num_rows = row;
+        }
+
+        /* otherwise the window starts in the middle of a block, and the
+         * rows before the window are not counted */
+        if (sync == SIZE_MAX) {
+            writer->rows_unknown = 1;
+            *num_rows = 0;
+            return ub_i_log_writer_resync_tail(writer, UB_BUFFER(*tail),
+                    size - from, from, end, header_offset);
+        }
+
+        offset = sync;
+    }
+
+    /* everything before the block that the walk starts from is intact */
+    *end = from + offset;
+
+    offset = ub_i_log_writer_walk_tail(writer, UB_BUFFER(*tail), size - from,
+            from, offset, end, num_rows, header_offset, &at_index);
+
+    /* a damaged block with intact blocks after it is not cut off */
+    if (!at_index && !ub_i_log_writer_is_torn(writer,
+                UB_BUFFER(*tail) + offset, size - from - offset))
+        return UB_EPARSE;
+
+    return UB_SUCCESS;
+}
+
+/**
+ * Parses the headers of the file of the writer, finds the last intact block
+ * and prepares the writer to write after it.
+ */
+static ub_error_t ub_i_log_writer_recover(ub_log_writer_t* writer) {
+    FILE* f = writer->file;
+    ub_block_type_t block_type;
+    ub_buffer_t tail;
+    uint64_t start, size, end = 0, num_rows = 0;
+    uint64_t first_header, header_offset;
+    uint8_t flags = 0;
+    ub_error_t retval;
+    long pos;
+
+    if (fseek(f, 0, SEEK_SET))
+        return UB_EUNSUPPORTED;
+
+    retval = ub_read_header_with_flags(f, &writer->version,
+            &writer->chksum_type, &flags);
+    if (retval == UB_EOF)
+        return UB_EPARSE;
+    UB_CHECK(retval);
+    if (flags & ~(UB_HEADER_FLAG_LITTLE_ENDIAN | UB_HEADER_FLAG_ALIGNED))
+        return UB_EUNSUPPORTED;
+    writer->byte_order = (flags & UB_HEADER_FLAG_LITTLE_ENDIAN) ?
+        UB_LITTLE_ENDIAN : UB_BIG_ENDIAN;
+    writer->aligned = (flags & UB_HEADER_FLAG_ALIGNED) ? 1 : 0;
+    writer->row_length = ub_log_columns_get_layout(writer->columns,
+            writer->num_columns, writer->aligned, 0);
+
+    /* find the first log header block */
+    do {
+        pos = ftell(f);
+        if (pos < 0)
+            return UB_EUNSUPPORTED;
+        retval = ub_read_block(f, &block_type, &writer->payload,
+                writer->chksum_type);
+        if (retval == UB_EOF || block_type == UB_BLOCK_LOG_ENTRY ||
+                block_type == UB_BLOCK_ENCODED_LOG_ENTRY)
+            retval = UB_EPARSE;
+        UB_CHECK(retval);
+    } while (block_type != UB_BLOCK_LOG_HEADER);
+
+    first_header = header_offset = pos;
+    UB_CHECK(ub_i_log_writer_check_columns(writer,
+                UB_BUFFER(writer->payload), ub_buffer_size(&writer->payload)));
+
+    start = ftell(f);
+    if (fseek(f, 0, SEEK_END) || (pos = ftell(f)) < 0)
+        return UB_EUNSUPPORTED;
+    size = pos;
+
+    UB_CHECK(ub_buffer_init(&tail, 0));
+    retval = ub_i_log_writer_find_end(writer, &tail, start, size, &end,
+            &num_rows, &header_offset);
+    ub_buffer_destroy(&tail);
+    UB_CHECK(retval);
+
+    /* the blocks that are kept may refer to another log header block */
+    if (header_offset != first_header)
+        UB_CHECK(ub_i_log_writer_check_log_header(writer, header_offset));
+
+    if (end < size)
+        UB_CHECK(ub_i_log_writer_truncate(writer, end));
+    if (fseek(f, end, SEEK_SET))
+        return UB_EUNSUPPORTED;
+
+    writer->header_offset = header_offset;
+    writer->num_rows_written = num_rows;
+    writer->appending = 1;
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_log_writer_init_append(ub_log_writer_t* writer, FILE* f,
+        ub_log_column_t* columns, size_t num_columns) {
+    ub_error_t retval;
+
+    UB_CHECK(ub_log_writer_init(writer, f, columns, num_columns,
+                UB_CHKSUM_NONE));
+
+    retval = ub_i_log_writer_recover(writer);
+    if (retval != UB_SUCCESS)
+        ub_log_writer_destroy(writer);
+
+    return retval;
+}
+
+/**
+ * Gives back the sync thread of the writer, if it has one.
+ */
+static void ub_i_log_writer_release_sync_thread(ub_log_writer_t* writer) {
+#ifdef HAVE_PTHREAD
+    if (writer->sync_thread != 0) {
+        ub_sync_thread_release((ub_sync_thread_t*)writer->sync_thread);
+        writer->sync_thread = 0;
+    }
+#else
+    (void)writer;
+#endif
+}
+
+void ub_log_writer_destroy(ub_log_writer_t* writer) {
+    ub_i_log_writer_release_sync_thread(writer);
+    ub_buffer_destroy(&writer->block);
+    ub_buffer_destroy(&writer->payload);
+    ub_block_index_destroy(&writer->index);
+    ub_zone_map_destroy(&writer->zone_map);
+    ub_free_unless_null(writer->bloom_columns);
+    writer->num_bloom_columns = 0;
+    writer->file = 0;
+    writer->columns = 0;
+    writer->num_columns = 0;
+    writer->num_rows = 0;
+}
+
+/**
+ * Syncs the file of the writer and restarts counting the blocks and the
+ * time until the next sync.
+ */
+static ub_error_t ub_i_log_writer_sync_file(ub_log_writer_t* writer) {
+    if (writer->sync_func != 0) {
+        UB_CHECK(writer->sync_func(writer->sync_data));
+    } else {
+        UB_CHECK(ub_sync_file(writer->file));
+    }
+
+    writer->unsynced_blocks = 0;
+    writer->last_sync = ub_get_monotonic_ms();
+
+    return UB_SUCCESS;
+}
+
+/**
+ * Syncs the file of the writer after a log entry block was written if the
+ * durability policy of the writer requires it.
+ */
+static ub_error_t ub_i_log_writer_commit(ub_log_writer_t* writer) {
+    writer->unsynced_blocks++;
+
+    switch (writer->durability) {
+        case UB_DURABILITY_BLOCK:
+            break;
+
+        case UB_DURABILITY_BLOCK_COUNT:
+            if (writer->unsynced_blocks < writer->durability_param)
+                return UB_SUCCESS;
+            break;
+
+        case UB_DURABILITY_INTERVAL:
+#ifdef HAVE_PTHREAD
+            /* the sync thread syncs what has reached the kernel */
+            if (fflush(writer->file))
+                return UB_EWRITE;
+            ub_sync_thread_notify((ub_sync_thread_t*)writer->sync_thread);
+            return UB_SUCCESS;
+#else
+            if (ub_get_monotonic_ms() - writer->last_sync <
+                    writer->durability_param)
+                return UB_SUCCESS;
+            break;
+#endif
+
+        default:
+            return UB_SUCCESS;
+    }
+
+    return ub_i_log_writer_sync_file(writer);
+}
+
+ub_error_t ub_log_writer_close(ub_log_writer_t* writer) {
+    UB_CHECK(ub_i_log_writer_write_header(writer));
+    UB_CHECK(ub_log_writer_flush(writer));
+
+    if (writer->indexed) {
+        UB_CHECK(ub_block_index_write(&writer->index, writer->file,
+                    writer->chksum_type));
+        writer->indexed = 0;
+        ub_block_index_clear(&writer->index);
+    }
+
+    if (writer->durability != UB_DURABILITY_NONE)
+        UB_CHECK(ub_i_log_writer_sync_file(writer));
+
+    /* the file may be closed as soon as the writer is */
+    ub_i_log_writer_release_sync_thread(writer);
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_log_writer_sync(ub_log_writer_t* writer) {
+    UB_CHECK(ub_log_writer_flush(writer));
+    return ub_i_log_writer_sync_file(writer);
+}
+
+ub_error_t ub_log_writer_flush(ub_log_writer_t* writer) {
+    ub_block_index_entry_t entry;
+    long pos;
+
+#ifdef HAVE_PTHREAD
+    if (writer->sync_thread != 0)
+        UB_CHECK(ub_sync_thread_get_error(
+                    (ub_sync_thread_t*)writer->sync_thread));
+#endif
+
+    if (writer->num_rows == 0)
+        return UB_SUCCESS;
+
+    UB_CHECK(ub_i_log_writer_write_header(writer));
+
+    if (writer->sync_interval > 0) {
+        pos = ftell(writer->file);
+        if (pos < 0)
+            return UB_EUNSUPPORTED;
+
+        if ((uint64_t)pos >= writer->next_sync) {
+            UB_CHECK(ub_write_sync_block(writer->file, writer->header_offset,
+                        writer->num_rows_written, writer->chksum_type));
+            writer->next_sync = pos + writer->sync_interval;
+        }
+    }
+
+    if (writer->zone_maps) {
+        UB_CHECK(ub_zone_map_compute(&writer->zone_map, writer->columns,
+                    writer->num_columns, writer->aligned, writer->byte_order,
+                    UB_BUFFER(writer->block), ub_buffer_size(&writer->block)));
+        UB_CHECK(ub_zone_map_encode(&writer->zone_map, &writer->payload));
+        UB_CHECK(ub_write_block_from_buffer(writer->file, UB_BLOCK_ZONE_MAP,
+                    &writer->payload, writer->chksum_type));
+    }
+
+    if (writer->num_bloom_columns > 0) {
+        UB_CHECK(ub_bloom_filter_encode(&writer->payload, writer->columns,
+                    writer->num_columns, writer->aligned, writer->byte_order,
+                    UB_BUFFER(writer->block), ub_buffer_size(&writer->block),
+                    writer->bloom_columns, writer->num_bloom_columns));
+        UB_CHECK(ub_write_block_from_buffer(writer->file,
+                    UB_BLOCK_BLOOM_FILTER, &writer->payload,
+                    writer->chksum_type));
+    }
+
+    if (writer->aligned) {
+        UB_CHECK(ub_write_padding_block(writer->file, UB_ROW_ALIGNMENT,
+                    writer->chksum_type));
+    }
+
+    if (writer->indexed) {
+        pos = ftell(writer->file);
+        if (pos < 0)
+            return UB_EUNSUPPORTED;
+
+        entry.offset = pos;
+        entry.first_row = writer->num_rows_written;
+        entry.num_rows = writer->num_rows;
+        UB_CHECK(ub_i_log_writer_get_timestamp(writer, 0,
+                    &entry.first_timestamp));
+        UB_CHECK(ub_i_log_writer_get_timestamp(writer,
+                    writer->last_row_offset, &entry.last_timestamp));
+    }
+
+    if (writer->codec == UB_CODEC_RAW) {
+        UB_CHECK(ub_write_block_from_buffer(writer->file, UB_BLOCK_LOG_ENTRY,
+                    &writer->block, writer->chksum_type));
+    } else {
+        UB_CHECK(ub_codec_encode_log_entries(writer->columns,
+                    writer->num_columns, UB_BUFFER(writer->block),
+                    writer->num_rows, writer->codec,
+                    writer->codec_sample_size, &writer->payload));
+        UB_CHECK(ub_write_block_from_buffer(writer->file,
+                    UB_BLOCK_ENCODED_LOG_ENTRY, &writer->payload,
+                    writer->chksum_type));
+    }
+
+    if (writer->indexed)
+        UB_CHECK(ub_block_index_append(&writer->index, &entry));
+
+    writer->num_rows_written += writer->num_rows;
+    writer->num_rows = 0;
+    UB_CHECK(ub_buffer_resize(&writer->block, 0));
+
+    return ub_i_log_writer_commit(writer);
+}
+
+ub_error_t ub_log_writer_set_durability(ub_log_writer_t* writer,
+        ub_durability_t policy, uint64_t param) {
+    switch (policy) {
+        case UB_DURABILITY_NONE:
+        case UB_DURABILITY_BLOCK:
+            param = 0;
+            break;
+
+        case UB_DURABILITY_BLOCK_COUNT:
+        case UB_DURABILITY_INTERVAL:
+            if (param == 0)
+                return UB_EINVAL;
+            break;
+
+        default:
+            return UB_EINVAL;
+    }
+
+#ifdef HAVE_PTHREAD
+    if (policy == UB_DURABILITY_INTERVAL) {
+        ub_sync_thread_t* thread;
+
+        if (writer->sync_func != 0 || fileno(writer->file) < 0)
+            return UB_EUNSUPPORTED;
+        UB_CHECK(ub_sync_thread_acquire(fileno(writer->file), param,
+                    &thread));
+
+        ub_i_log_writer_release_sync_thread(writer);
+        writer->sync_thread = thread;
+    } else {
+        ub_i_log_writer_release_sync_thread(writer);
+    }
+#endif
+
+    writer->durability = policy;
+    writer->durability_param = param;
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_log_writer_set_sync_func(ub_log_writer_t* writer,
+        ub_log_writer_sync_func_t* func, void* user_data) {
+    if (writer->sync_thread != 0)
+        return UB_EUNSUPPORTED;
+
+    writer->sync_func = func;
+    writer->sync_data = user_data;
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_log_writer_set_block_length(ub_log_writer_t* writer,
+        size_t length) {
+    if (length == 0 || length > 65535 || writer->num_rows > 0)
+        return UB_EINVAL;
+
+    writer->max_block_length = length;
+    UB_CHECK(ub_buffer_reserve(&writer->block, length));
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_log_writer_set_codec(ub_log_writer_t* writer, ub_codec_t codec,
+        size_t sample_size) {
+    if ((codec >= UB_MAX_CODEC && codec != UB_CODEC_AUTO) ||
+            writer->num_rows > 0)
+        return UB_EINVAL;
+
+    if (codec != UB_CODEC_RAW && (writer->row_length == 0 ||
+                writer->byte_order != UB_BIG_ENDIAN || writer->aligned))
+        return UB_EUNSUPPORTED;
+
+    writer->codec = codec;
+    writer->codec_sample_size = sample_size;
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_log_writer_set_byte_order(ub_log_writer_t* writer,
+        ub_byte_order_t order) {
+    if ((order != UB_BIG_ENDIAN && order != UB_LITTLE_ENDIAN) ||
+            writer->header_written || writer->appending ||
+            writer->num_rows > 0)
+        return UB_EINVAL;
+
+    if (order != UB_BIG_ENDIAN && writer->codec != UB_CODEC_RAW)
+        return UB_EUNSUPPORTED;
+
+    writer->byte_order = order;
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_log_writer_set_aligned(ub_log_writer_t* writer,
+        ub_bool_t aligned) {
+    if (writer->header_written || writer->appending || writer->num_rows > 0)
+        return UB_EINVAL;
+
+    if (aligned && (writer->row_length == 0 || writer->codec != UB_CODEC_RAW))
+        return UB_EUNSUPPORTED;
+
+    writer->aligned = aligned ? 1 : 0;
+    writer->row_length = ub_log_columns_get_layout(writer->columns,
+            writer->num_columns, writer->aligned, 0);
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_log_writer_set_index(ub_log_writer_t* writer, ub_bool_t indexed) {
+    if (writer->header_written)
+        return UB_EINVAL;
+
+    /* the blocks already in the file cannot be indexed when appending
+     * unless the file had an index */
+    if (indexed && writer->appending && !writer->indexed)
+        return UB_EUNSUPPORTED;
+
+    writer->indexed = indexed ? 1 : 0;
+    if (!writer->indexed)
+        ub_block_index_clear(&writer->index);
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_log_writer_set_timestamp_column(ub_log_writer_t* writer,
+        size_t column) {
+    uint8_t zeros[8] = { 0 };
+    int64_t value;
+
+    if (writer->header_written || (writer->appending && writer->indexed &&
+                column != writer->index.timestamp_column))
+        return UB_EINVAL;
+
+    if (column != UB_BLOCK_INDEX_NO_TIMESTAMP) {
+        if (column >= writer->num_columns)
+            return UB_EINVAL;
+        if (ub_byteorder_decode_int64(writer->columns[column].type,
+                    UB_BIG_ENDIAN, zeros, &value))
+            return UB_EUNSUPPORTED;
+    }
+
+    writer->index.timestamp_column = column;
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_log_writer_set_zone_maps(ub_log_writer_t* writer,
+        ub_bool_t zone_maps) {
+    if (writer->header_written)
+        return UB_EINVAL;
+
+    writer->zone_maps = zone_maps ? 1 : 0;
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_log_writer_add_bloom_filter(ub_log_writer_t* writer,
+        size_t column) {
+    size_t* columns;
+    size_t i, count;
+
+    if (writer->header_written || column >= writer->num_columns)
+        return UB_EINVAL;
+
+    for (i = 0; i < writer->num_bloom_columns; i++) {
+        if (writer->bloom_columns[i] == column)
+            return UB_SUCCESS;
+    }
+
+    count = writer->num_bloom_columns + 1;
+    columns = ub_realloc(writer->bloom_columns, size_t, count);
+    if (columns == 0)
+        return UB_ENOMEM;
+
+    columns[writer->num_bloom_columns++] = column;
+    writer->bloom_columns = columns;
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_log_writer_set_sync_interval(ub_log_writer_t* writer,
+        uint64_t interval) {
+    if (writer->header_written)
+        return UB_EINVAL;
+
+    /* sync blocks hold row numbers, which continue from the rows already
+     * in the file */
+    if (interval > 0 && writer->rows_unknown)
+        return UB_EUNSUPPORTED;
+
+    writer->sync_interval = interval;
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_log_writer_write_row(ub_log_writer_t* writer, const void* row,
+        size_t length) {
+    size_t capacity = ub_i_log_writer_block_capacity(writer);
+    ub_buffer_location_t loc;
+
+    if (writer->row_length > 0 && length != writer->row_length)
+        return UB_EINVAL;
+
+    if (length > capacity)
+        return UB_ETOOLONG;
+
+    if (ub_buffer_size(&writer->block) + length > capacity) {
+        UB_CHECK(ub_log_writer_flush(writer));
+    }
+
+    writer->last_row_offset = ub_buffer_size(&writer->block);
+    loc = ub_buffer_location(&writer->block, writer->last_row_offset);
+    UB_CHECK(ub_buffer_update_and_grow_from_array(&loc, row, length));
+    writer->num_rows++;
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_log_writer_write_columns(ub_log_writer_t* writer,
+        const void* const* values, size_t num_rows) {
+    size_t capacity = ub_i_log_writer_block_capacity(writer);
+    uint8_t chunk[UB_I_COLUMN_CHUNK_SIZE * 8];
+    size_t offsets[255];
+    const uint8_t* src;
+    uint8_t *rows, *dest;
+    size_t i, j, k, n, count, offset, width, done = 0;
+    ub_datatype_t type;
+
+    if (writer->row_length == 0)
+        return UB_EUNSUPPORTED;
+
+    ub_log_columns_get_layout(writer->columns, writer->num_columns,
+            writer->aligned, offsets);
+
+    for (i = 0; i < writer->num_columns; i++) {
+        if (!ub_byteorder_supports_type(writer->columns[i].type,
+                    writer->byte_order))
+            return UB_EUNSUPPORTED;
+    }
+
+    if (writer->row_length > capacity)
+        return UB_ETOOLONG;
+
+    while (done < num_rows) {
+        n = (capacity - ub_buffer_size(&writer->block)) / writer->row_length;
+        if (n == 0) {
+            UB_CHECK(ub_log_writer_flush(writer));
+            continue;
+        }
+        if (n > num_rows - done)
+            n = num_rows - done;
+
+        offset = ub_buffer_size(&writer->block);
+        UB_CHECK(ub_buffer_resize(&writer->block, offset + n * writer->row_length));
+        rows = UB_BUFFER(writer->block) + offset;
+        if (writer->aligned)
+            memset(rows, 0, n * writer->row_length);
+
+        /* convert each column in chunks, then scatter the chunks into the
+         * rows */
+        for (i = 0; i < writer->num_columns; i++) {
+            type = writer->columns[i].type;
+            width = ub_datatype_get_info(type).length;
+            src = (const uint8_t*)values[i] + done * width;
+            dest = rows + offsets[i];
+
+            for (j = 0; j < n; j += count) {
+                count = n - j < UB_I_COLUMN_CHUNK_SIZE ? n - j : UB_I_COLUMN_CHUNK_SIZE;
+                ub_byteorder_encode_column(type, writer->byte_order, chunk,
+                        src + j * width, count);
+                for (k = 0; k < count; k++, dest += writer->row_length)
+                    memcpy(dest, chunk + k * width, width);
+            }
+        }
+
+        writer->num_rows += n;
+        writer->last_row_offset = ub_buffer_size(&writer->block) -
+            writer->row_length;
+        done += n;
+    }
+
+    return UB_SUCCESS;
+}
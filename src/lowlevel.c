@@ -5,11 +5,31 @@
 #include <string.h>
 #include <arpa/inet.h>
 
+#include <unibinlog/buffer_pool.h>
 #include <unibinlog/lowlevel.h>
 
+#include "config.h"
+
+#if defined(HAVE_FDATASYNC) || defined(HAVE_FSYNC)
+#  include <unistd.h>
+#endif
+
 static const char* ub_i_header_marker = "UNIBIN";
 static size_t ub_i_header_marker_length = 6;
 
+/**
+ * Loads a 64-bit unsigned integer stored in network byte order.
+ */
+static uint64_t ub_i_load_u64(const uint8_t* bytes) {
+    uint64_t result = 0;
+    size_t i;
+
+    for (i = 0; i < 8; i++)
+        result = (result << 8) | bytes[i];
+
+    return result;
+}
+
 ub_error_t ub_write_byte_array(FILE* f, const void* array, size_t length) {
     if (fwrite(array, 1, length, f) != length) {
         return UB_EWRITE;
@@ -19,18 +39,26 @@ ub_error_t ub_write_byte_array(FILE* f, const void* array, size_t length) {
 }
 
 ub_error_t ub_write_header(FILE* f, uint8_t version, ub_chksum_type_t chksum_type) {
-	uint8_t header[ub_i_header_marker_length+2];
+    return ub_write_header_with_flags(f, version, chksum_type, 0);
+}
+
+ub_error_t ub_write_header_with_flags(FILE* f, uint8_t version,
+        ub_chksum_type_t chksum_type, uint8_t flags) {
+    uint8_t header[ub_i_header_marker_length+2];
     size_t pos;
 
-	/* format marker */
-	memcpy(header, ub_i_header_marker, ub_i_header_marker_length);
+    if (flags & ~UB_HEADER_FLAGS_MASK)
+        return UB_EINVAL;
+
+    /* format marker */
+    memcpy(header, ub_i_header_marker, ub_i_header_marker_length);
     pos = ub_i_header_marker_length;
 
-	/* version number */
-	header[pos] = version;
+    /* version number */
+    header[pos] = version;
 
-	/* checksum type */
-	header[pos+1] = chksum_type;
+    /* checksum type and header flags */
+    header[pos+1] = chksum_type | flags;
 
     /* write the header */
     UB_CHECK(ub_write_byte_array(f, header, sizeof(header)));
@@ -40,37 +68,45 @@ ub_error_t ub_write_header(FILE* f, uint8_t version, ub_chksum_type_t chksum_typ
 
 ub_error_t ub_write_block(FILE* f, ub_block_type_t block_type,
         const void* payload, size_t length, ub_chksum_type_t chksum_type) {
+    ub_buffer_pool_t* pool;
     ub_buffer_t buf;
     ub_buffer_location_t loc;
     size_t buf_size;
     size_t chksum_size;
+    ub_error_t retval;
 
     if (length > 65535)
         return UB_ETOOLONG;
 
-    /* create the buffer where we will assemble the block */
+    /* take the buffer where we will assemble the block from the shared
+     * pool, so writing a block does not allocate memory in steady state */
     chksum_size = ub_chksum_size(chksum_type);
     buf_size = length + chksum_size + 3;
-    UB_CHECK(ub_buffer_init(&buf, buf_size));
+    pool = ub_buffer_pool_get_shared();
+    UB_CHECK(ub_buffer_pool_acquire(pool, &buf));
 
-    /* write the header */
-    UB_BUFFER(buf)[0] = block_type;
-    UB_BUFFER_FROM_INDEX_AS(buf, 1, uint16_t)[0] = htons(length);
+    retval = ub_buffer_resize(&buf, buf_size);
+    if (retval == UB_SUCCESS) {
+        /* write the header */
+        UB_BUFFER(buf)[0] = block_type;
+        UB_BUFFER_FROM_INDEX_AS(buf, 1, uint16_t)[0] = htons(length);
 
-    /* copy the payload */
-    loc = ub_buffer_location(&buf, 3);
-    ub_buffer_update_from_array(&loc, payload, length);
+        /* copy the payload */
+        loc = ub_buffer_location(&buf, 3);
+        ub_buffer_update_from_array(&loc, payload, length);
 
-    /* write the checksum if needed */
-    UB_CHECK(ub_buffer_update_checksum(&buf, chksum_type));
+        /* write the checksum if needed */
+        retval = ub_buffer_update_checksum(&buf, chksum_type);
+    }
 
     /* write the entire buffer into a file */
-    UB_CHECK(ub_buffer_fwrite(&buf, f));
+    if (retval == UB_SUCCESS)
+        retval = ub_buffer_fwrite(&buf, f);
 
-    /* destroy the buffer */
-    ub_buffer_destroy(&buf);
+    /* give the buffer back to the pool */
+    ub_buffer_pool_release(pool, &buf);
 
-    return UB_SUCCESS;
+    return retval;
 }
 
 ub_error_t ub_write_block_from_buffer(FILE* f, ub_block_type_t block_type,
@@ -85,34 +121,261 @@ ub_error_t ub_write_comment_block(FILE* f, const char* comment,
             chksum_type);
 }
 
+ub_error_t ub_write_padding_block(FILE* f, size_t alignment,
+        ub_chksum_type_t chksum_type) {
+    static const uint8_t zeros[256] = { 0 };
+    size_t length, overhead = ub_chksum_size(chksum_type) + 3;
+    long pos;
+
+    if (alignment == 0 || alignment > sizeof(zeros))
+        return UB_EINVAL;
+
+    pos = ftell(f);
+    if (pos < 0)
+        return UB_EUNSUPPORTED;
+
+    /* the next payload starts after its own three-byte block header */
+    if ((pos + 3) % alignment == 0)
+        return UB_SUCCESS;
+
+    length = (alignment - (pos + 3 + overhead) % alignment) % alignment;
+    return ub_write_block(f, UB_BLOCK_PADDING, zeros, length, chksum_type);
+}
+
 ub_error_t ub_write_log_header_block(FILE* f, ub_log_column_t* columns,
         size_t num_columns, ub_chksum_type_t chksum_type) {
+    ub_buffer_pool_t* pool;
     ub_buffer_t buf;
     ub_buffer_location_t loc;
+    ub_error_t retval;
 
     if (num_columns > 255)
         return UB_ETOOLONG;
 
-    /* create the buffer where we will assemble the block */
-    UB_CHECK(ub_buffer_init(&buf, 1));
+    /* take the buffer where we will assemble the block from the shared pool */
+    pool = ub_buffer_pool_get_shared();
+    UB_CHECK(ub_buffer_pool_acquire(pool, &buf));
 
-    /* write the number of columns */
-    UB_BUFFER(buf)[0] = num_columns;
+    retval = ub_buffer_resize(&buf, 1);
+    if (retval == UB_SUCCESS) {
+        /* write the number of columns */
+        UB_BUFFER(buf)[0] = num_columns;
 
-    /* write the columns themselves */
-    loc = ub_buffer_location(&buf, 1);
-    while (num_columns > 0) {
-        UB_CHECK(ub_log_column_write(columns, &loc));
-        columns++;
-        num_columns--;
+        /* write the columns themselves */
+        loc = ub_buffer_location(&buf, 1);
+        while (num_columns > 0 && retval == UB_SUCCESS) {
+            retval = ub_log_column_write(columns, &loc);
+            columns++;
+            num_columns--;
+        }
     }
 
     /* write the entire buffer into a file */
-    UB_CHECK(ub_write_block_from_buffer(f, UB_BLOCK_LOG_HEADER, &buf, chksum_type));
+    if (retval == UB_SUCCESS)
+        retval = ub_write_block_from_buffer(f, UB_BLOCK_LOG_HEADER, &buf,
+                chksum_type);
+
+    /* give the buffer back to the pool */
+    ub_buffer_pool_release(pool, &buf);
+
+    return retval;
+}
+
+ub_error_t ub_write_sync_block(FILE* f, uint64_t schema_id, uint64_t row,
+        ub_chksum_type_t chksum_type) {
+    uint8_t payload[UB_SYNC_BLOCK_LENGTH];
+    size_t i;
+
+    memcpy(payload, UB_SYNC_MAGIC, UB_SYNC_MAGIC_LENGTH);
+    for (i = 0; i < 8; i++) {
+        payload[UB_SYNC_MAGIC_LENGTH + i] = schema_id >> (56 - 8 * i);
+        payload[UB_SYNC_MAGIC_LENGTH + 8 + i] = row >> (56 - 8 * i);
+    }
+
+    return ub_write_block(f, UB_BLOCK_SYNC, payload, sizeof(payload),
+            chksum_type);
+}
+
+ub_error_t ub_sync_file(FILE* f) {
+    if (fflush(f))
+        return UB_EWRITE;
+
+    /* streams without a file descriptor have nothing to sync it with */
+    if (fileno(f) < 0)
+        return UB_EUNSUPPORTED;
+
+#if defined(HAVE_FDATASYNC)
+    if (fdatasync(fileno(f)))
+        return UB_EWRITE;
+#elif defined(HAVE_FSYNC)
+    if (fsync(fileno(f)))
+        return UB_EWRITE;
+#else
+    return UB_EUNSUPPORTED;
+#endif
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_read_header(FILE* f, uint8_t* version, ub_chksum_type_t* chksum_type) {
+    return ub_read_header_with_flags(f, version, chksum_type, 0);
+}
+
+ub_error_t ub_read_header_with_flags(FILE* f, uint8_t* version,
+        ub_chksum_type_t* chksum_type, uint8_t* flags) {
+    uint8_t header[ub_i_header_marker_length+2];
+    size_t bytes_read;
+
+    bytes_read = fread(header, 1, sizeof(header), f);
+    if (bytes_read == 0 && feof(f))
+        return UB_EOF;
+    if (bytes_read != sizeof(header))
+        return UB_EREAD;
+
+    return ub_parse_header(header, sizeof(header), version, chksum_type,
+            flags);
+}
+
+ub_error_t ub_parse_header(const void* data, size_t size, uint8_t* version,
+        ub_chksum_type_t* chksum_type, uint8_t* flags) {
+    const uint8_t* header = (const uint8_t*)data;
+
+    if (size == 0)
+        return UB_EOF;
+    if (size < ub_i_header_marker_length+2 ||
+            memcmp(header, ub_i_header_marker, ub_i_header_marker_length))
+        return UB_EPARSE;
+
+    if (version != 0)
+        *version = header[ub_i_header_marker_length];
+    if (chksum_type != 0)
+        *chksum_type = header[ub_i_header_marker_length+1] & ~UB_HEADER_FLAGS_MASK;
+    if (flags != 0)
+        *flags = header[ub_i_header_marker_length+1] & UB_HEADER_FLAGS_MASK;
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_read_block(FILE* f, ub_block_type_t* block_type,
+        ub_buffer_t* payload, ub_chksum_type_t chksum_type) {
+    uint8_t header[3];
+    size_t bytes_read, length, rest;
+
+    bytes_read = fread(header, 1, sizeof(header), f);
+    if (bytes_read == 0 && feof(f))
+        return UB_EOF;
+    if (bytes_read != sizeof(header))
+        return UB_EREAD;
+
+    /* read the entire block into the buffer as the checksum covers the
+     * block header as well */
+    length = ntohs(*((uint16_t*)(header+1)));
+    rest = length + ub_chksum_size(chksum_type);
+    UB_CHECK(ub_buffer_resize(payload, sizeof(header) + rest));
+    memcpy(UB_BUFFER(*payload), header, sizeof(header));
+    if (fread(UB_BUFFER(*payload) + sizeof(header), 1, rest, f) != rest)
+        return UB_EREAD;
+
+    if (ub_buffer_validate_checksum(payload, chksum_type) != UB_SUCCESS)
+        return UB_EPARSE;
+
+    /* strip the block header and the checksum */
+    memmove(UB_BUFFER(*payload), UB_BUFFER(*payload) + sizeof(header), length);
+    UB_CHECK(ub_buffer_resize(payload, length));
+
+    *block_type = header[0];
+    return UB_SUCCESS;
+}
 
-    /* destroy the buffer */
-    ub_buffer_destroy(&buf);
+ub_error_t ub_parse_block(const void* data, size_t size,
+        ub_block_type_t* block_type, const uint8_t** payload, size_t* length,
+        ub_chksum_type_t chksum_type) {
+    const uint8_t* block = (const uint8_t*)data;
+    size_t chksum_size = ub_chksum_size(chksum_type);
+    uint8_t chksum[2];
+
+    if (size == 0)
+        return UB_EOF;
+    if (size < 3)
+        return UB_EPARSE;
+
+    *length = (block[1] << 8) | block[2];
+    if (size - 3 < *length + chksum_size || chksum_size > sizeof(chksum))
+        return UB_EPARSE;
+
+    /* the checksum covers the block header as well */
+    if (chksum_size > 0) {
+        UB_CHECK(ub_get_chksum_of_array(block, 3 + *length, chksum,
+                    chksum_type));
+        if (memcmp(chksum, block + 3 + *length, chksum_size))
+            return UB_EPARSE;
+    }
 
+    *block_type = block[0];
+    *payload = block + 3;
     return UB_SUCCESS;
 }
 
+ub_error_t ub_find_sync_block(const void* data, size_t size,
+        ub_chksum_type_t chksum_type, size_t* offset, uint64_t* schema_id,
+        uint64_t* row) {
+    static const uint8_t header[3] = {
+        UB_BLOCK_SYNC, UB_SYNC_BLOCK_LENGTH >> 8, UB_SYNC_BLOCK_LENGTH & 0xFF
+    };
+    const uint8_t* start = (const uint8_t*)data;
+    const uint8_t* end = start + size;
+    const uint8_t* p = start;
+    const uint8_t* payload;
+    ub_block_type_t block_type;
+    size_t length;
+
+    while (end - p >= 3 + UB_SYNC_BLOCK_LENGTH) {
+        p = memchr(p, UB_BLOCK_SYNC, end - p - 3 - UB_SYNC_BLOCK_LENGTH + 1);
+        if (p == 0)
+            break;
+
+        if (!memcmp(p, header, sizeof(header)) &&
+                !memcmp(p + 3, UB_SYNC_MAGIC, UB_SYNC_MAGIC_LENGTH) &&
+                ub_parse_block(p, end - p, &block_type, &payload, &length,
+                    chksum_type) == UB_SUCCESS) {
+            payload += UB_SYNC_MAGIC_LENGTH;
+            if (schema_id)
+                *schema_id = ub_i_load_u64(payload);
+            if (row)
+                *row = ub_i_load_u64(payload + 8);
+            *offset = p - start;
+            return UB_SUCCESS;
+        }
+
+        p++;
+    }
+
+    return UB_EOF;
+}
+
+ub_error_t ub_skip_block(FILE* f, ub_block_type_t* block_type,
+        ub_chksum_type_t chksum_type) {
+    uint8_t header[3], scratch[256];
+    size_t bytes_read, rest, count;
+
+    bytes_read = fread(header, 1, sizeof(header), f);
+    if (bytes_read == 0 && feof(f))
+        return UB_EOF;
+    if (bytes_read != sizeof(header))
+        return UB_EREAD;
+
+    rest = ntohs(*((uint16_t*)(header+1))) + ub_chksum_size(chksum_type);
+
+    /* fall back to reading if the file does not support seeking */
+    if (fseek(f, rest, SEEK_CUR)) {
+        while (rest > 0) {
+            count = rest < sizeof(scratch) ? rest : sizeof(scratch);
+            if (fread(scratch, 1, count, f) != count)
+                return UB_EREAD;
+            rest -= count;
+        }
+    }
+
+    *block_type = header[0];
+    return UB_SUCCESS;
+}
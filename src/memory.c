@@ -0,0 +1,124 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <unibinlog/memory.h>
+
+#include "utils.h"
+
+static void* ub_i_libc_malloc(size_t size, void* context) {
+    (void)context;
+    return malloc(size);
+}
+
+static void* ub_i_libc_calloc(size_t count, size_t size, void* context) {
+    (void)context;
+    return calloc(count, size);
+}
+
+static void* ub_i_libc_realloc(void* ptr, size_t size, void* context) {
+    (void)context;
+    return realloc(ptr, size);
+}
+
+static void ub_i_libc_free(void* ptr, void* context) {
+    (void)context;
+    free(ptr);
+}
+
+/**
+ * The allocator of the library.
+ */
+static ub_allocator_t ub_i_allocator = {
+    ub_i_libc_malloc, ub_i_libc_calloc, ub_i_libc_realloc, ub_i_libc_free, 0
+};
+
+ub_error_t ub_memory_set_allocator(const ub_allocator_t* allocator) {
+    static const ub_allocator_t libc_allocator = {
+        ub_i_libc_malloc, ub_i_libc_calloc, ub_i_libc_realloc,
+        ub_i_libc_free, 0
+    };
+
+    if (allocator == 0) {
+        ub_buffer_pool_trim_shared();
+        ub_i_allocator = libc_allocator;
+        return UB_SUCCESS;
+    }
+
+    if (allocator->malloc == 0 || allocator->realloc == 0 ||
+            allocator->free == 0)
+        return UB_EINVAL;
+
+    /* the idle buffers of the shared pool belong to the old allocator */
+    ub_buffer_pool_trim_shared();
+    ub_i_allocator = *allocator;
+    return UB_SUCCESS;
+}
+
+const ub_allocator_t* ub_memory_get_allocator(void) {
+    return &ub_i_allocator;
+}
+
+void* ub_memory_calloc(size_t count, size_t size) {
+    void* ptr;
+
+    if (ub_i_allocator.calloc)
+        return ub_i_allocator.calloc(count, size, ub_i_allocator.context);
+
+    if (size > 0 && count > SIZE_MAX / size)
+        return 0;
+
+    ptr = ub_i_allocator.malloc(count * size, ub_i_allocator.context);
+    if (ptr != 0)
+        memset(ptr, 0, count * size);
+
+    return ptr;
+}
+
+void* ub_memory_realloc(void* ptr, size_t size) {
+    return ub_i_allocator.realloc(ptr, size, ub_i_allocator.context);
+}
+
+void ub_memory_free(void* ptr) {
+    ub_i_allocator.free(ptr, ub_i_allocator.context);
+}
+
+char* ub_memory_strdup(const char* str) {
+    size_t length = strlen(str) + 1;
+    char* copy;
+
+    copy = (char*)ub_i_allocator.malloc(length, ub_i_allocator.context);
+    if (copy != 0)
+        memcpy(copy, str, length);
+
+    return copy;
+}
+
+void* ub_memory_aligned_alloc(size_t alignment, size_t size) {
+    uint8_t* block;
+    uintptr_t address;
+
+    if (alignment < sizeof(void*))
+        alignment = sizeof(void*);
+    if (size > SIZE_MAX - alignment - sizeof(void*))
+        return 0;
+
+    /* the pointer to the whole block is stored right before the aligned
+     * memory, so the memory can be freed with the same allocator */
+    block = (uint8_t*)ub_i_allocator.malloc(size + alignment - 1 +
+            sizeof(void*), ub_i_allocator.context);
+    if (block == 0)
+        return 0;
+
+    address = ((uintptr_t)(block + sizeof(void*)) + alignment - 1) &
+        ~(uintptr_t)(alignment - 1);
+    ((void**)address)[-1] = block;
+
+    return (void*)address;
+}
+
+void ub_memory_aligned_free(void* ptr) {
+    if (ptr != 0)
+        ub_memory_free(((void**)ptr)[-1]);
+}
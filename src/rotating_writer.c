@@ -0,0 +1,368 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+/* for fallocate() */
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif
+
+#include <string.h>
+
+#include <unibinlog/memory.h>
+#include <unibinlog/rotating_writer.h>
+
+#include "config.h"
+#include "utils.h"
+
+#ifdef HAVE_FALLOCATE
+#  include <fcntl.h>
+#endif
+
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
+
+/**
+ * The preparation of the next file of a rotating writer: closing the
+ * previous file, then creating the next one and reserving its disk space.
+ */
+typedef struct {
+    char* path;                    /**< The path of the next file */
+    uint64_t length;               /**< The number of bytes to reserve */
+    FILE* previous;                /**< The file to close first; may be null */
+    FILE* file;                    /**< The next file, once it is created */
+    ub_error_t retval;             /**< The result of the preparation */
+#ifdef HAVE_PTHREAD
+    pthread_t thread;              /**< The thread doing the preparation */
+    ub_bool_t running;             /**< Whether \c thread has to be joined */
+#endif
+} ub_i_rotation_job_t;
+
+/**
+ * Returns the path of the file with the given sequence number, or null if
+ * there is not enough memory.
+ */
+static char* ub_i_rotating_writer_get_path(const ub_rotating_writer_t* writer,
+        uint64_t index) {
+    size_t length = strlen(writer->prefix) + strlen(writer->suffix) + 21;
+    char* path = ub_calloc(char, length);
+
+    if (path != 0) {
+        sprintf(path, "%s%06lu%s", writer->prefix, (unsigned long)index,
+                writer->suffix);
+    }
+
+    return path;
+}
+
+static void* ub_i_rotation_job_run(void* arg) {
+    ub_i_rotation_job_t* job = (ub_i_rotation_job_t*)arg;
+
+    if (job->previous != 0) {
+        if (fclose(job->previous))
+            job->retval = UB_EWRITE;
+        job->previous = 0;
+    }
+
+    /* an existing file is never truncated, so the file is only ever
+     * removed again by the writer that created it */
+    job->file = fopen(job->path, "wx");
+    if (job->file == 0) {
+        job->retval = UB_EWRITE;
+        return 0;
+    }
+
+#ifdef HAVE_FALLOCATE
+    /* reserve the space without changing the size of the file, so readers
+     * and crash recovery never see the reserved bytes; this is only a hint */
+    if (job->length > 0)
+        fallocate(fileno(job->file), FALLOC_FL_KEEP_SIZE, 0, job->length);
+#endif
+
+    return 0;
+}
+
+/**
+ * Starts preparing the file with the given sequence number, on a
+ * background thread if possible. The given file is closed first.
+ */
+static ub_error_t ub_i_rotating_writer_prepare(ub_rotating_writer_t* writer,
+        uint64_t index, FILE* previous) {
+    ub_i_rotation_job_t* job = (ub_i_rotation_job_t*)writer->next;
+
+    job->path = ub_i_rotating_writer_get_path(writer, index);
+    job->length = writer->max_bytes;
+    job->previous = previous;
+    job->file = 0;
+    job->retval = UB_SUCCESS;
+
+    if (job->path == 0) {
+        job->retval = UB_ENOMEM;
+        return UB_ENOMEM;
+    }
+
+#ifdef HAVE_PTHREAD
+    job->running = pthread_create(&job->thread, 0, ub_i_rotation_job_run,
+            job) == 0;
+    if (!job->running)
+        ub_i_rotation_job_run(job);
+#else
+    ub_i_rotation_job_run(job);
+#endif
+
+    return UB_SUCCESS;
+}
+
+/**
+ * Waits until the preparation of the next file is done.
+ */
+static void ub_i_rotating_writer_wait(ub_rotating_writer_t* writer) {
+#ifdef HAVE_PTHREAD
+    ub_i_rotation_job_t* job = (ub_i_rotation_job_t*)writer->next;
+
+    if (job->running) {
+        pthread_join(job->thread, 0);
+        job->running = 0;
+    }
+#else
+    (void)writer;
+#endif
+}
+
+/**
+ * Starts writing into the given file with a new log writer, then starts
+ * preparing the next file, which closes the previous file first.
+ */
+static ub_error_t ub_i_rotating_writer_start(ub_rotating_writer_t* writer,
+        FILE* f, char* path, FILE* previous) {
+    ub_error_t retval;
+
+    writer->file = f;
+    writer->path = path;
+    writer->opened_at = ub_get_monotonic_ms();
+    writer->rows_checked = 0;
+
+    retval = ub_log_writer_init(&writer->writer, f, writer->columns,
+            writer->num_columns, writer->chksum_type);
+    if (retval == UB_SUCCESS && writer->setup_func != 0) {
+        retval = writer->setup_func(&writer->writer, writer->user_data);
+        if (retval != UB_SUCCESS)
+            ub_log_writer_destroy(&writer->writer);
+    }
+
+    if (retval != UB_SUCCESS) {
+        writer->file = 0;
+        writer->path = 0;
+        return retval;
+    }
+
+    return ub_i_rotating_writer_prepare(writer, writer->index + 1, previous);
+}
+
+/**
+ * Opens the first file of the writer.
+ */
+static ub_error_t ub_i_rotating_writer_open(ub_rotating_writer_t* writer) {
+    ub_error_t retval;
+    char* path;
+    FILE* f;
+
+    path = ub_i_rotating_writer_get_path(writer, writer->index);
+    if (path == 0)
+        return UB_ENOMEM;
+
+    f = fopen(path, "wx");
+    if (f == 0) {
+        ub_free(path);
+        return UB_EWRITE;
+    }
+
+    retval = ub_i_rotating_writer_start(writer, f, path, 0);
+    if (writer->file == 0) {
+        fclose(f);
+        ub_free(path);
+    }
+
+    return retval;
+}
+
+/**
+ * Moves on to the next file if the current one reached one of the limits
+ * since a log entry block was written.
+ */
+static ub_error_t ub_i_rotating_writer_check(ub_rotating_writer_t* writer) {
+    long pos;
+
+    if (writer->writer.num_rows_written == writer->rows_checked)
+        return UB_SUCCESS;
+    writer->rows_checked = writer->writer.num_rows_written;
+
+    if (writer->max_age > 0 &&
+            ub_get_monotonic_ms() - writer->opened_at >= writer->max_age)
+        return ub_rotating_writer_rotate(writer);
+
+    if (writer->max_bytes > 0) {
+        pos = ftell(writer->file);
+        if (pos >= 0 && (uint64_t)pos >= writer->max_bytes)
+            return ub_rotating_writer_rotate(writer);
+    }
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_rotating_writer_init(ub_rotating_writer_t* writer,
+        const char* prefix, const char* suffix, uint64_t first_index,
+        ub_log_column_t* columns, size_t num_columns,
+        ub_chksum_type_t chksum_type) {
+    writer->prefix = ub_calloc(char, strlen(prefix) + 1);
+    writer->suffix = ub_calloc(char, strlen(suffix) + 1);
+    writer->next = ub_calloc(ub_i_rotation_job_t, 1);
+    if (writer->prefix == 0 || writer->suffix == 0 || writer->next == 0) {
+        ub_free_unless_null(writer->prefix);
+        ub_free_unless_null(writer->suffix);
+        ub_free_unless_null(writer->next);
+        return UB_ENOMEM;
+    }
+
+    strcpy(writer->prefix, prefix);
+    strcpy(writer->suffix, suffix);
+    writer->columns = columns;
+    writer->num_columns = num_columns;
+    writer->chksum_type = chksum_type;
+    writer->max_bytes = 0;
+    writer->max_age = 0;
+    writer->setup_func = 0;
+    writer->user_data = 0;
+    writer->index = first_index;
+    writer->path = 0;
+    writer->file = 0;
+    writer->opened_at = 0;
+    writer->rows_checked = 0;
+
+    return UB_SUCCESS;
+}
+
+void ub_rotating_writer_destroy(ub_rotating_writer_t* writer) {
+    ub_i_rotation_job_t* job = (ub_i_rotation_job_t*)writer->next;
+
+    if (job != 0) {
+        ub_i_rotating_writer_wait(writer);
+        if (job->previous != 0)
+            fclose(job->previous);
+        if (job->file != 0) {
+            fclose(job->file);
+            remove(job->path);
+        }
+        ub_free_unless_null(job->path);
+        ub_free(writer->next);
+    }
+
+    if (writer->file != 0) {
+        ub_log_writer_destroy(&writer->writer);
+        fclose(writer->file);
+        writer->file = 0;
+    }
+
+    ub_free_unless_null(writer->path);
+    ub_free_unless_null(writer->prefix);
+    ub_free_unless_null(writer->suffix);
+}
+
+ub_error_t ub_rotating_writer_set_limits(ub_rotating_writer_t* writer,
+        uint64_t max_bytes, uint64_t max_age) {
+    writer->max_bytes = max_bytes;
+    writer->max_age = max_age;
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_rotating_writer_set_setup_func(ub_rotating_writer_t* writer,
+        ub_rotating_writer_setup_func_t* setup_func, void* user_data) {
+    writer->setup_func = setup_func;
+    writer->user_data = user_data;
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_rotating_writer_write_row(ub_rotating_writer_t* writer,
+        const void* row, size_t length) {
+    if (writer->file == 0)
+        UB_CHECK(ub_i_rotating_writer_open(writer));
+
+    UB_CHECK(ub_log_writer_write_row(&writer->writer, row, length));
+
+    return ub_i_rotating_writer_check(writer);
+}
+
+ub_error_t ub_rotating_writer_flush(ub_rotating_writer_t* writer) {
+    if (writer->file == 0)
+        return UB_SUCCESS;
+
+    UB_CHECK(ub_log_writer_flush(&writer->writer));
+
+    return ub_i_rotating_writer_check(writer);
+}
+
+ub_error_t ub_rotating_writer_rotate(ub_rotating_writer_t* writer) {
+    ub_i_rotation_job_t* job = (ub_i_rotation_job_t*)writer->next;
+    FILE* previous = writer->file;
+    ub_error_t retval, error;
+
+    if (previous == 0)
+        return UB_SUCCESS;
+
+    retval = ub_log_writer_close(&writer->writer);
+    ub_log_writer_destroy(&writer->writer);
+
+    /* the next file should be ready by now */
+    ub_i_rotating_writer_wait(writer);
+    if (retval == UB_SUCCESS)
+        retval = job->retval;
+
+    ub_free(writer->path);
+    writer->file = 0;
+    writer->index++;
+
+    if (job->file == 0) {
+        fclose(previous);
+        ub_free_unless_null(job->path);
+        return retval != UB_SUCCESS ? retval : UB_EWRITE;
+    }
+
+    /* the previous file is closed with the preparation of the next one;
+     * the errors of closing the files come first */
+    error = ub_i_rotating_writer_start(writer, job->file, job->path,
+            previous);
+    if (writer->file == 0) {
+        fclose(job->file);
+        remove(job->path);
+        ub_free(job->path);
+        job->file = 0;
+        fclose(previous);
+    }
+
+    return retval != UB_SUCCESS ? retval : error;
+}
+
+ub_error_t ub_rotating_writer_close(ub_rotating_writer_t* writer) {
+    ub_i_rotation_job_t* job = (ub_i_rotation_job_t*)writer->next;
+    ub_error_t retval;
+
+    if (writer->file == 0)
+        return UB_SUCCESS;
+
+    retval = ub_log_writer_close(&writer->writer);
+    ub_log_writer_destroy(&writer->writer);
+    if (fclose(writer->file) && retval == UB_SUCCESS)
+        retval = UB_EWRITE;
+    writer->file = 0;
+
+    ub_i_rotating_writer_wait(writer);
+    if (retval == UB_SUCCESS)
+        retval = job->retval;
+    if (job->file != 0) {
+        fclose(job->file);
+        remove(job->path);
+        job->file = 0;
+    }
+    ub_free_unless_null(job->path);
+
+    return retval;
+}
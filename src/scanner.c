@@ -0,0 +1,586 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#include <string.h>
+
+#include <unibinlog/codec.h>
+#include <unibinlog/lowlevel.h>
+#include <unibinlog/memory.h>
+#include <unibinlog/scanner.h>
+
+#include "config.h"
+
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
+
+#ifdef HAVE_MADVISE
+#  include <stdint.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+/**
+ * The length of the file header of a \c unibin file.
+ */
+#define UB_I_FILE_HEADER_LENGTH 8
+
+/**
+ * The byte range of a single scan range and the block boundaries found in
+ * it.
+ */
+typedef struct {
+    size_t begin;                  /**< Offset of the first byte of the range */
+    size_t end;                    /**< Offset after the last byte of the range */
+    size_t first;                  /**< Offset of the first block of the range */
+    size_t last;                   /**< Offset after the last block of the range */
+    ub_error_t retval;             /**< The result of decoding the range */
+} ub_i_scan_range_t;
+
+/**
+ * A scan job, i.e. a piece of work to do for each range, shared by the
+ * worker threads.
+ */
+typedef struct ub_i_scan_job_s {
+    const ub_scanner_t* scanner;
+    ub_i_scan_range_t* ranges;
+    size_t num_ranges;
+    void (*work)(struct ub_i_scan_job_s* job, size_t range);
+    ub_scan_block_func_t* block_func;
+    uint8_t* states;
+    size_t state_size;
+} ub_i_scan_job_t;
+
+/**
+ * A worker thread of a scan job; it takes every \c num_threads -th range,
+ * starting from \c thread.
+ */
+typedef struct {
+    ub_i_scan_job_t* job;
+    size_t thread;
+    size_t num_threads;
+} ub_i_scan_worker_t;
+
+static ub_error_t ub_i_scanner_parse_columns(ub_scanner_t* scanner) {
+    const uint8_t* data = UB_BUFFER(scanner->header);
+    size_t size = ub_buffer_size(&scanner->header);
+    size_t i, num_columns, consumed;
+
+    if (size < 1)
+        return UB_EPARSE;
+
+    num_columns = data[0];
+    data++; size--;
+
+    scanner->columns = ub_calloc(ub_log_column_t,
+            num_columns > 0 ? num_columns : 1);
+    scanner->offsets = ub_calloc(size_t, num_columns > 0 ? num_columns : 1);
+    if (scanner->columns == 0 || scanner->offsets == 0)
+        return UB_ENOMEM;
+
+    for (i = 0; i < num_columns; i++) {
+        UB_CHECK(ub_log_column_read(&scanner->columns[i], data, size,
+                    &consumed));
+        scanner->num_columns++;
+        data += consumed; size -= consumed;
+    }
+
+    scanner->row_length = ub_log_columns_get_layout(scanner->columns,
+            num_columns, scanner->aligned, scanner->offsets);
+    if (scanner->row_length == 0) {
+        ub_free(scanner->offsets);
+
+        /* aligned logs cannot have variable-length rows */
+        if (scanner->aligned)
+            return UB_EPARSE;
+    }
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_scanner_init(ub_scanner_t* scanner, const void* data,
+        size_t size) {
+    ub_block_type_t block_type;
+    const uint8_t* payload;
+    size_t pos, length;
+    ub_error_t retval;
+    uint8_t flags = 0;
+
+    scanner->data = (const uint8_t*)data;
+    scanner->size = size;
+    scanner->chksum_type = UB_CHKSUM_NONE;
+    scanner->byte_order = UB_BIG_ENDIAN;
+    scanner->aligned = 0;
+    scanner->columns = 0;
+    scanner->num_columns = 0;
+    scanner->offsets = 0;
+    scanner->row_length = 0;
+    scanner->start = size;
+    scanner->num_threads = 1;
+
+    UB_CHECK(ub_buffer_init(&scanner->header, 0));
+
+    retval = ub_parse_header(data, size, 0, &scanner->chksum_type, &flags);
+    if (retval == UB_SUCCESS) {
+        if (flags & ~(UB_HEADER_FLAG_LITTLE_ENDIAN | UB_HEADER_FLAG_ALIGNED))
+            retval = UB_EUNSUPPORTED;
+        if (flags & UB_HEADER_FLAG_LITTLE_ENDIAN)
+            scanner->byte_order = UB_LITTLE_ENDIAN;
+        if (flags & UB_HEADER_FLAG_ALIGNED)
+            scanner->aligned = 1;
+    }
+
+    /* skip everything up to the log header block */
+    pos = UB_I_FILE_HEADER_LENGTH;
+    while (retval == UB_SUCCESS) {
+        retval = ub_parse_block(scanner->data + pos, size - pos, &block_type,
+                &payload, &length, scanner->chksum_type);
+        if (retval != UB_SUCCESS)
+            break;
+
+        pos += 3 + length + ub_chksum_size(scanner->chksum_type);
+
+        if (block_type == UB_BLOCK_LOG_HEADER) {
+            scanner->start = pos;
+            retval = ub_buffer_resize(&scanner->header, length);
+            if (retval == UB_SUCCESS) {
+                memcpy(UB_BUFFER(scanner->header), payload, length);
+                retval = ub_i_scanner_parse_columns(scanner);
+            }
+            break;
+        }
+
+        if (block_type == UB_BLOCK_LOG_ENTRY ||
+                block_type == UB_BLOCK_ENCODED_LOG_ENTRY)
+            retval = UB_EPARSE;
+    }
+
+    if (retval == UB_EOF)
+        retval = UB_EPARSE;
+
+    if (retval != UB_SUCCESS)
+        ub_scanner_destroy(scanner);
+
+    return retval;
+}
+
+void ub_scanner_destroy(ub_scanner_t* scanner) {
+    if (scanner->columns) {
+        ub_log_column_destroy_array(scanner->columns, scanner->num_columns);
+        ub_free(scanner->columns);
+    }
+    ub_free_unless_null(scanner->offsets);
+    scanner->num_columns = 0;
+    ub_buffer_destroy(&scanner->header);
+    scanner->data = 0;
+}
+
+ub_error_t ub_scanner_set_num_threads(ub_scanner_t* scanner,
+        size_t num_threads) {
+    if (num_threads == 0)
+        return UB_EINVAL;
+
+    scanner->num_threads = num_threads;
+    return UB_SUCCESS;
+}
+
+/**
+ * Returns the offset of the block after the one at the given offset, based
+ * on the length in the block header only. Blocks that run past the end of
+ * the log end at the end of the log.
+ */
+static size_t ub_i_scanner_next_block(const ub_scanner_t* scanner,
+        size_t offset) {
+    const uint8_t* header = scanner->data + offset;
+    size_t length;
+
+    if (scanner->size - offset < 3)
+        return scanner->size;
+
+    length = 3 + ((header[1] << 8) | header[2]) +
+        ub_chksum_size(scanner->chksum_type);
+
+    return scanner->size - offset < length ? scanner->size : offset + length;
+}
+
+/**
+ * Decides whether the given byte is the type of a block that may appear in
+ * a log.
+ */
+static ub_bool_t ub_i_scanner_is_known_type(uint8_t block_type) {
+    switch (block_type) {
+        case UB_BLOCK_COMMENT:
+        case UB_BLOCK_LOG_HEADER:
+        case UB_BLOCK_LOG_ENTRY:
+        case UB_BLOCK_EVENT:
+        case UB_BLOCK_ENCODED_LOG_ENTRY:
+        case UB_BLOCK_PADDING:
+        case UB_BLOCK_INDEX:
+        case UB_BLOCK_INDEX_TRAILER:
+        case UB_BLOCK_ZONE_MAP:
+        case UB_BLOCK_BLOOM_FILTER:
+        case UB_BLOCK_SYNC:
+            return 1;
+
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Decides whether a valid block starts at the given offset.
+ */
+static ub_bool_t ub_i_scanner_is_block(const ub_scanner_t* scanner,
+        size_t offset) {
+    ub_block_type_t block_type;
+    const uint8_t* payload;
+    size_t length;
+
+    return ub_parse_block(scanner->data + offset, scanner->size - offset,
+            &block_type, &payload, &length, scanner->chksum_type) ==
+        UB_SUCCESS;
+}
+
+ub_error_t ub_scanner_find_block(const ub_scanner_t* scanner, size_t offset,
+        size_t* result) {
+    size_t next;
+
+    if (offset < scanner->start)
+        offset = scanner->start;
+
+    for (; offset < scanner->size; offset++) {
+        if (!ub_i_scanner_is_known_type(scanner->data[offset]))
+            continue;
+
+        /* a single block may match by chance, so check the next one too.
+         * The block types are checked first as they are cheaper than the
+         * checksums */
+        next = ub_i_scanner_next_block(scanner, offset);
+        if (next < scanner->size &&
+                !ub_i_scanner_is_known_type(scanner->data[next]))
+            continue;
+
+        if (ub_i_scanner_is_block(scanner, offset) &&
+                (next == scanner->size || ub_i_scanner_is_block(scanner, next))) {
+            *result = offset;
+            return UB_SUCCESS;
+        }
+    }
+
+    return UB_EOF;
+}
+
+/**
+ * Walks the block headers from the first block of the range to the first
+ * block that starts at or after the end of the range.
+ */
+static void ub_i_scan_walk(const ub_scanner_t* scanner,
+        ub_i_scan_range_t* range) {
+    size_t pos = range->first;
+
+    while (pos < range->end)
+        pos = ub_i_scanner_next_block(scanner, pos);
+
+    range->last = pos;
+}
+
+static void ub_i_scan_walk_range(ub_i_scan_job_t* job, size_t index) {
+    ub_i_scan_walk(job->scanner, &job->ranges[index]);
+}
+
+/**
+ * Finds the first block of a range: the first sync block that starts in the
+ * range if there is one, since sync blocks cannot be mistaken for something
+ * else, or the first block boundary at or after the start of the range.
+ */
+static void ub_i_scan_sync(ub_i_scan_job_t* job, size_t index) {
+    const ub_scanner_t* scanner = job->scanner;
+    ub_i_scan_range_t* range = &job->ranges[index];
+    size_t end, offset;
+
+    if (index == 0) {
+        range->first = scanner->start;
+        return;
+    }
+
+    end = range->end + 3 + UB_SYNC_BLOCK_LENGTH +
+        ub_chksum_size(scanner->chksum_type) - 1;
+    if (end > scanner->size)
+        end = scanner->size;
+
+    if (ub_find_sync_block(scanner->data + range->begin, end - range->begin,
+                scanner->chksum_type, &offset, 0, 0) == UB_SUCCESS &&
+            range->begin + offset < range->end) {
+        range->first = range->begin + offset;
+    } else if (ub_scanner_find_block(scanner, range->begin,
+                &range->first) != UB_SUCCESS) {
+        range->first = scanner->size;
+    }
+}
+
+/**
+ * Counts the rows in the given block when the rows have variable length.
+ */
+static ub_error_t ub_i_scan_count_rows(const ub_scanner_t* scanner,
+        ub_scan_block_t* block) {
+    const uint8_t* data = block->rows;
+    size_t size = block->rows_length;
+    size_t i, length;
+
+    if (scanner->num_columns == 0)
+        return size == 0 ? UB_SUCCESS : UB_EPARSE;
+
+    while (size > 0) {
+        for (i = 0; i < scanner->num_columns; i++) {
+            length = ub_datatype_get_value_length(scanner->columns[i].type,
+                    data, size);
+            if (length == 0)
+                return UB_EPARSE;
+            data += length; size -= length;
+        }
+        block->num_rows++;
+    }
+
+    return UB_SUCCESS;
+}
+
+static ub_error_t ub_i_scan_decode_range(ub_i_scan_job_t* job, size_t index,
+        ub_buffer_t* decoded) {
+    const ub_scanner_t* scanner = job->scanner;
+    ub_i_scan_range_t* range = &job->ranges[index];
+    void* state = job->states + index * job->state_size;
+    ub_block_type_t block_type;
+    ub_scan_block_t block;
+    const uint8_t* payload;
+    size_t pos, length;
+
+    block.range = index;
+    block.columns = scanner->columns;
+    block.num_columns = scanner->num_columns;
+    block.offsets = scanner->offsets;
+    block.row_length = scanner->row_length;
+    block.byte_order = scanner->byte_order;
+
+    for (pos = range->first; pos < range->last; ) {
+        if (ub_parse_block(scanner->data + pos, scanner->size - pos,
+                    &block_type, &payload, &length, scanner->chksum_type))
+            return UB_EPARSE;
+
+        block.offset = pos;
+        block.rows = payload;
+        block.rows_length = length;
+        block.num_rows = 0;
+        pos += 3 + length + ub_chksum_size(scanner->chksum_type);
+
+        switch (block_type) {
+            case UB_BLOCK_LOG_HEADER:
+                if (length != ub_buffer_size(&scanner->header) ||
+                        memcmp(payload, UB_BUFFER(scanner->header), length))
+                    return UB_EUNSUPPORTED;
+                continue;
+
+            case UB_BLOCK_LOG_ENTRY:
+                if (scanner->row_length == 0) {
+                    UB_CHECK(ub_i_scan_count_rows(scanner, &block));
+                } else if (length % scanner->row_length != 0) {
+                    return UB_EPARSE;
+                } else {
+                    block.num_rows = length / scanner->row_length;
+                }
+                break;
+
+            case UB_BLOCK_ENCODED_LOG_ENTRY:
+                /* codecs are not supported with the aligned layout */
+                if (scanner->aligned)
+                    return UB_EPARSE;
+                UB_CHECK(ub_codec_decode_log_entries(scanner->columns,
+                            scanner->num_columns, payload, length, decoded,
+                            &block.num_rows));
+                block.rows = UB_BUFFER(*decoded);
+                block.rows_length = ub_buffer_size(decoded);
+                break;
+
+            default:
+                continue;
+        }
+
+        UB_CHECK(job->block_func(&block, state));
+    }
+
+    return UB_SUCCESS;
+}
+
+static void ub_i_scan_decode(ub_i_scan_job_t* job, size_t index) {
+    ub_i_scan_range_t* range = &job->ranges[index];
+    ub_buffer_t decoded;
+
+    range->retval = ub_buffer_init(&decoded, 0);
+    if (range->retval != UB_SUCCESS)
+        return;
+
+    range->retval = ub_i_scan_decode_range(job, index, &decoded);
+    ub_buffer_destroy(&decoded);
+}
+
+static void* ub_i_scan_worker(void* arg) {
+    ub_i_scan_worker_t* worker = (ub_i_scan_worker_t*)arg;
+    size_t i;
+
+    for (i = worker->thread; i < worker->job->num_ranges;
+            i += worker->num_threads)
+        worker->job->work(worker->job, i);
+
+    return 0;
+}
+
+/**
+ * Does the work of a job for all the ranges, on the worker threads of the
+ * scanner if possible. Workers whose thread cannot be started run on the
+ * calling thread.
+ */
+static ub_error_t ub_i_scan_run_job(ub_i_scan_job_t* job,
+        size_t num_threads) {
+    ub_i_scan_worker_t* workers;
+    size_t i;
+#ifdef HAVE_PTHREAD
+    pthread_t* threads;
+    ub_bool_t* started;
+#endif
+
+    if (num_threads > job->num_ranges)
+        num_threads = job->num_ranges;
+
+    workers = ub_calloc(ub_i_scan_worker_t, num_threads);
+    if (workers == 0)
+        return UB_ENOMEM;
+
+    for (i = 0; i < num_threads; i++) {
+        workers[i].job = job;
+        workers[i].thread = i;
+        workers[i].num_threads = num_threads;
+    }
+
+#ifdef HAVE_PTHREAD
+    threads = ub_calloc(pthread_t, num_threads);
+    started = ub_calloc(ub_bool_t, num_threads);
+    if (threads == 0 || started == 0) {
+        ub_free_unless_null(threads);
+        ub_free_unless_null(started);
+        ub_free(workers);
+        return UB_ENOMEM;
+    }
+
+    for (i = 1; i < num_threads; i++)
+        started[i] = pthread_create(&threads[i], 0, ub_i_scan_worker,
+                &workers[i]) == 0;
+
+    for (i = 0; i < num_threads; i++) {
+        if (!started[i])
+            ub_i_scan_worker(&workers[i]);
+    }
+
+    for (i = 1; i < num_threads; i++) {
+        if (started[i])
+            pthread_join(threads[i], 0);
+    }
+
+    ub_free(started);
+    ub_free(threads);
+#else
+    for (i = 0; i < num_threads; i++)
+        ub_i_scan_worker(&workers[i]);
+#endif
+
+    ub_free(workers);
+    return UB_SUCCESS;
+}
+
+/**
+ * Tells the kernel that the log is about to be read sequentially, so if it
+ * is a memory-mapped file, the kernel reads it ahead aggressively and frees
+ * the pages behind the scan first. Each range is read sequentially, even
+ * if the ranges are read at the same time. Errors are ignored, since the
+ * log may not be a mapping at all.
+ */
+static void ub_i_scanner_advise(const ub_scanner_t* scanner) {
+#ifdef HAVE_MADVISE
+    uintptr_t page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (uintptr_t)scanner->data & ~(page_size - 1);
+    uintptr_t end = (uintptr_t)scanner->data + scanner->size;
+
+    if (scanner->size > 0)
+        madvise((void*)begin, end - begin, MADV_SEQUENTIAL);
+#endif
+}
+
+ub_error_t ub_scanner_run(ub_scanner_t* scanner, size_t num_ranges,
+        ub_scan_block_func_t* block_func, void* states, size_t state_size,
+        ub_scan_reduce_func_t* reduce_func) {
+    ub_i_scan_job_t job;
+    ub_i_scan_range_t* ranges;
+    uint64_t length = scanner->size - scanner->start;
+    ub_error_t retval = UB_SUCCESS;
+    size_t i;
+
+    if (num_ranges == 0)
+        return UB_EINVAL;
+
+    ranges = ub_calloc(ub_i_scan_range_t, num_ranges);
+    if (ranges == 0)
+        return UB_ENOMEM;
+
+    for (i = 0; i < num_ranges; i++) {
+        ranges[i].begin = scanner->start + length * i / num_ranges;
+        ranges[i].end = scanner->start + length * (i + 1) / num_ranges;
+    }
+
+    ub_i_scanner_advise(scanner);
+
+    job.scanner = scanner;
+    job.ranges = ranges;
+    job.num_ranges = num_ranges;
+    job.block_func = block_func;
+    job.states = (uint8_t*)states;
+    job.state_size = state_size;
+
+    /* find the first block of each range in parallel, then move the end
+     * of each range to the first block of the next one and walk the block
+     * headers up to there */
+    job.work = ub_i_scan_sync;
+    retval = ub_i_scan_run_job(&job, scanner->num_threads);
+
+    for (i = 0; i < num_ranges && retval == UB_SUCCESS; i++) {
+        ranges[i].end = i + 1 < num_ranges ?
+            ranges[i + 1].first : scanner->size;
+    }
+
+    if (retval == UB_SUCCESS) {
+        job.work = ub_i_scan_walk_range;
+        retval = ub_i_scan_run_job(&job, scanner->num_threads);
+    }
+
+    /* the end of the previous range is a true block boundary; a range that
+     * starts elsewhere was resynchronized on a false positive */
+    for (i = 1; i < num_ranges && retval == UB_SUCCESS; i++) {
+        if (ranges[i].first != ranges[i - 1].last) {
+            ranges[i].first = ranges[i - 1].last;
+            ub_i_scan_walk(scanner, &ranges[i]);
+        }
+    }
+
+    /* decode the ranges in parallel */
+    if (retval == UB_SUCCESS) {
+        job.work = ub_i_scan_decode;
+        retval = ub_i_scan_run_job(&job, scanner->num_threads);
+    }
+
+    for (i = 0; i < num_ranges && retval == UB_SUCCESS; i++)
+        retval = ranges[i].retval;
+
+    ub_free(ranges);
+
+    /* merge the states of the ranges in order */
+    for (i = 1; i < num_ranges && retval == UB_SUCCESS && reduce_func; i++)
+        retval = reduce_func(states, (uint8_t*)states + i * state_size);
+
+    return retval;
+}
@@ -0,0 +1,571 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <unibinlog/byteorder.h>
+#include <unibinlog/lowlevel.h>
+#include <unibinlog/memory.h>
+#include <unibinlog/secondary_index.h>
+
+/**
+ * The length of the fixed part of a serialized entry in a secondary index
+ * block; the key comes on top of this.
+ */
+#define UB_I_ENTRY_LENGTH 20
+
+/**
+ * The length of the fixed part of the payload of a secondary index header
+ * block; the name of the column comes on top of this.
+ */
+#define UB_I_HEADER_LENGTH 18
+
+/**
+ * Loads an unsigned integer of the given width (in bytes) stored in network
+ * byte order.
+ */
+static uint64_t ub_i_load_be(const uint8_t* bytes, size_t width) {
+    uint64_t result = 0;
+    while (width > 0) {
+        result = (result << 8) | *bytes;
+        bytes++; width--;
+    }
+    return result;
+}
+
+/**
+ * Stores an unsigned integer on the given number of bytes in network byte
+ * order.
+ */
+static void ub_i_store_be(uint8_t* bytes, size_t width, uint64_t value) {
+    while (width > 0) {
+        width--;
+        bytes[width] = value & 0xFF;
+        value >>= 8;
+    }
+}
+
+/**
+ * Converts a single serialized value of the given type, stored in the given
+ * byte order, into its sortable form (see \ref ub_secondary_index_t).
+ * Numeric keys are written into \p scratch, which must have room for eight
+ * bytes; the keys of strings and blobs point into the value itself.
+ */
+static const uint8_t* ub_i_make_key(ub_datatype_t type, const uint8_t* value,
+        size_t length, ub_byte_order_t order, uint8_t* scratch,
+        size_t* key_length) {
+    size_t i, j, unit;
+
+    switch (type) {
+        case UB_DATATYPE_STRING:
+            *key_length = length - 1;
+            return value;
+
+        case UB_DATATYPE_SHORT_BLOB:
+            *key_length = length - 1;
+            return value + 1;
+
+        case UB_DATATYPE_BLOB:
+            *key_length = length - 2;
+            return value + 2;
+
+        default:
+            break;
+    }
+
+    /* a timeval is stored as two 32-bit integers */
+    unit = type == UB_DATATYPE_TIMEVAL ? 4 : length;
+    for (i = 0; i < length; i += unit) {
+        for (j = 0; j < unit; j++) {
+            scratch[i + j] = order == UB_BIG_ENDIAN ?
+                value[i + j] : value[i + unit - 1 - j];
+        }
+    }
+
+    switch (type) {
+        case UB_DATATYPE_S8:
+        case UB_DATATYPE_S16:
+        case UB_DATATYPE_S32:
+        case UB_DATATYPE_S64:
+            scratch[0] ^= 0x80;
+            break;
+
+        case UB_DATATYPE_FLOAT:
+        case UB_DATATYPE_DOUBLE:
+            /* negative numbers sort in reverse order of their magnitude */
+            if (scratch[0] & 0x80) {
+                for (i = 0; i < length; i++)
+                    scratch[i] = ~scratch[i];
+            } else {
+                scratch[0] ^= 0x80;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    *key_length = length;
+    return scratch;
+}
+
+/**
+ * Converts a bound given by the user into its sortable form.
+ */
+static const uint8_t* ub_i_make_bound(ub_datatype_t type, const void* value,
+        size_t length, uint8_t* scratch, size_t* key_length) {
+    switch (type) {
+        case UB_DATATYPE_STRING:
+        case UB_DATATYPE_SHORT_BLOB:
+        case UB_DATATYPE_BLOB:
+            *key_length = length;
+            return (const uint8_t*)value;
+
+        default:
+            return ub_i_make_key(type, (const uint8_t*)value,
+                    ub_datatype_get_info(type).length, ub_byteorder_native(),
+                    scratch, key_length);
+    }
+}
+
+/**
+ * Compares two keys in their sortable form; shorter keys come first when
+ * one key is a prefix of the other.
+ */
+static int ub_i_compare_keys(const uint8_t* a, size_t a_length,
+        const uint8_t* b, size_t b_length) {
+    int result = memcmp(a, b, a_length < b_length ? a_length : b_length);
+
+    if (result != 0)
+        return result;
+
+    return a_length < b_length ? -1 : (a_length > b_length ? 1 : 0);
+}
+
+static int ub_i_compare_entries(const void* a, const void* b) {
+    const ub_secondary_index_entry_t* x = (const ub_secondary_index_entry_t*)a;
+    const ub_secondary_index_entry_t* y = (const ub_secondary_index_entry_t*)b;
+    int result;
+
+    result = ub_i_compare_keys(x->key, x->key_length, y->key, y->key_length);
+    if (result != 0)
+        return result;
+
+    return x->row < y->row ? -1 : (x->row > y->row ? 1 : 0);
+}
+
+/**
+ * Removes all the entries and keys of the index.
+ */
+static void ub_i_secondary_index_clear(ub_secondary_index_t* index) {
+    index->num_entries = 0;
+    ub_buffer_resize(&index->keys, 0);
+}
+
+/**
+ * Appends an entry to the index, copying its key into the key buffer. The
+ * \c key field of the new entry is set only by
+ * \ref ub_i_secondary_index_finish(), since the key buffer may move until
+ * then.
+ */
+static ub_error_t ub_i_secondary_index_append(ub_secondary_index_t* index,
+        const uint8_t* key, size_t key_length, uint64_t offset, uint64_t row,
+        size_t row_index) {
+    ub_secondary_index_entry_t* entries;
+    ub_secondary_index_entry_t* entry;
+    size_t capacity, key_offset;
+
+    if (index->num_entries == index->capacity) {
+        capacity = index->capacity > 0 ? index->capacity * 2 : 256;
+        entries = ub_realloc(index->entries, ub_secondary_index_entry_t,
+                capacity);
+        if (entries == 0)
+            return UB_ENOMEM;
+        index->entries = entries;
+        index->capacity = capacity;
+    }
+
+    key_offset = ub_buffer_size(&index->keys);
+    UB_CHECK(ub_buffer_resize(&index->keys, key_offset + key_length));
+    memcpy(UB_BUFFER(index->keys) + key_offset, key, key_length);
+
+    entry = &index->entries[index->num_entries++];
+    entry->key = 0;
+    entry->key_offset = key_offset;
+    entry->key_length = key_length;
+    entry->offset = offset;
+    entry->row = row;
+    entry->index = row_index;
+
+    return UB_SUCCESS;
+}
+
+/**
+ * Points the keys of the entries into the key buffer once all the entries
+ * have been added.
+ */
+static void ub_i_secondary_index_finish(ub_secondary_index_t* index) {
+    size_t i;
+
+    for (i = 0; i < index->num_entries; i++)
+        index->entries[i].key = UB_BUFFER(index->keys) +
+            index->entries[i].key_offset;
+}
+
+/**
+ * Replaces the name of the indexed column.
+ */
+static ub_error_t ub_i_secondary_index_set_name(ub_secondary_index_t* index,
+        const char* name, size_t length) {
+    char* copy = ub_calloc(char, length + 1);
+
+    if (copy == 0)
+        return UB_ENOMEM;
+
+    memcpy(copy, name, length);
+    ub_free_unless_null(index->column_name);
+    index->column_name = copy;
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_secondary_index_init(ub_secondary_index_t* index) {
+    index->column = 0;
+    index->type = UB_DATATYPE_UNKNOWN;
+    index->column_name = 0;
+    index->log_length = 0;
+    index->entries = 0;
+    index->num_entries = 0;
+    index->capacity = 0;
+    return ub_buffer_init(&index->keys, 0);
+}
+
+void ub_secondary_index_destroy(ub_secondary_index_t* index) {
+    ub_free_unless_null(index->column_name);
+    ub_free_unless_null(index->entries);
+    index->num_entries = 0;
+    index->capacity = 0;
+    ub_buffer_destroy(&index->keys);
+}
+
+/**
+ * Adds the rows of the current block of the reader to the index.
+ */
+static ub_error_t ub_i_secondary_index_add_block(ub_secondary_index_t* index,
+        const ub_log_reader_t* reader) {
+    const uint8_t* end = reader->rows + reader->rows_length;
+    const uint8_t* row = reader->rows;
+    const uint8_t* value;
+    const uint8_t* key;
+    uint8_t scratch[8];
+    size_t i, j, length, key_length;
+
+    for (i = 0; i < reader->num_rows; i++) {
+        if (reader->row_length > 0) {
+            value = row + reader->offsets[index->column];
+            length = ub_datatype_get_info(index->type).length;
+            row += reader->row_length;
+        } else {
+            value = 0;
+            length = 0;
+            for (j = 0; j < reader->num_columns; j++) {
+                length = ub_datatype_get_value_length(reader->columns[j].type,
+                        row, end - row);
+                if (length == 0)
+                    return UB_EPARSE;
+                if (j == index->column)
+                    value = row;
+                row += length;
+            }
+            length = ub_datatype_get_value_length(index->type, value,
+                    end - value);
+        }
+
+        key = ub_i_make_key(index->type, value, length, reader->byte_order,
+                scratch, &key_length);
+        UB_CHECK(ub_i_secondary_index_append(index, key, key_length,
+                    reader->block_offset, reader->first_row + i, i));
+    }
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_secondary_index_build(ub_secondary_index_t* index,
+        ub_log_reader_t* reader, size_t column) {
+    const ub_log_column_t* info;
+    ub_error_t retval;
+    long length;
+
+    if (column >= reader->num_columns)
+        return UB_EINVAL;
+
+    info = &reader->columns[column];
+    if (info->type == UB_DATATYPE_UNKNOWN || info->type >= UB_MAX_DATATYPE)
+        return UB_EUNSUPPORTED;
+
+    UB_CHECK(ub_i_secondary_index_set_name(index, info->name,
+                strlen(info->name)));
+    index->column = column;
+    index->type = info->type;
+    ub_i_secondary_index_clear(index);
+
+    while ((retval = ub_log_reader_next_block(reader)) == UB_SUCCESS) {
+        if (reader->block_offset == (uint64_t)-1)
+            retval = UB_EUNSUPPORTED;
+        else if (column >= reader->num_columns ||
+                reader->columns[column].type != index->type)
+            retval = UB_EUNSUPPORTED;
+        else
+            retval = ub_i_secondary_index_add_block(index, reader);
+
+        if (retval != UB_SUCCESS)
+            break;
+    }
+
+    if (retval == UB_EOF) {
+        length = ftell(reader->file);
+        retval = length >= 0 ? UB_SUCCESS : UB_EUNSUPPORTED;
+        index->log_length = length;
+    }
+
+    if (retval != UB_SUCCESS) {
+        ub_i_secondary_index_clear(index);
+        return retval;
+    }
+
+    ub_i_secondary_index_finish(index);
+    qsort(index->entries, index->num_entries,
+            sizeof(ub_secondary_index_entry_t), ub_i_compare_entries);
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_secondary_index_write(const ub_secondary_index_t* index,
+        FILE* f, ub_chksum_type_t chksum_type) {
+    const ub_secondary_index_entry_t* entry;
+    size_t i, name_length, size;
+    ub_buffer_t payload;
+    ub_error_t retval;
+    uint8_t* data;
+
+    name_length = index->column_name ? strlen(index->column_name) : 0;
+    if (name_length + 1 + UB_I_HEADER_LENGTH > 65535)
+        return UB_ETOOLONG;
+
+    UB_CHECK(ub_write_header(f, 1, chksum_type));
+    UB_CHECK(ub_buffer_init(&payload, UB_I_HEADER_LENGTH + name_length + 1));
+
+    data = UB_BUFFER(payload);
+    data[0] = index->column;
+    data[1] = index->type;
+    ub_i_store_be(data + 2, 8, index->log_length);
+    ub_i_store_be(data + 10, 8, index->num_entries);
+    memcpy(data + UB_I_HEADER_LENGTH, index->column_name, name_length);
+    data[UB_I_HEADER_LENGTH + name_length] = 0;
+
+    retval = ub_write_block_from_buffer(f, UB_BLOCK_SECONDARY_INDEX_HEADER,
+            &payload, chksum_type);
+
+    /* pack as many entries into each block as possible */
+    ub_buffer_resize(&payload, 0);
+    for (i = 0; i < index->num_entries && retval == UB_SUCCESS; i++) {
+        entry = &index->entries[i];
+        if (entry->key_length + UB_I_ENTRY_LENGTH > 65535) {
+            retval = UB_ETOOLONG;
+            break;
+        }
+
+        size = ub_buffer_size(&payload);
+        if (size + entry->key_length + UB_I_ENTRY_LENGTH > 65535) {
+            retval = ub_write_block_from_buffer(f, UB_BLOCK_SECONDARY_INDEX,
+                    &payload, chksum_type);
+            ub_buffer_resize(&payload, 0);
+            size = 0;
+        }
+
+        if (retval == UB_SUCCESS) {
+            retval = ub_buffer_resize(&payload,
+                    size + entry->key_length + UB_I_ENTRY_LENGTH);
+        }
+        if (retval != UB_SUCCESS)
+            break;
+
+        data = UB_BUFFER(payload) + size;
+        ub_i_store_be(data, 2, entry->key_length);
+        memcpy(data + 2, entry->key, entry->key_length);
+        data += 2 + entry->key_length;
+        ub_i_store_be(data, 8, entry->offset);
+        ub_i_store_be(data + 8, 8, entry->row);
+        ub_i_store_be(data + 16, 2, entry->index);
+    }
+
+    if (retval == UB_SUCCESS && ub_buffer_size(&payload) > 0) {
+        retval = ub_write_block_from_buffer(f, UB_BLOCK_SECONDARY_INDEX,
+                &payload, chksum_type);
+    }
+
+    ub_buffer_destroy(&payload);
+    return retval;
+}
+
+/**
+ * Parses the entries of a secondary index block and adds them to the index.
+ */
+static ub_error_t ub_i_secondary_index_parse_block(ub_secondary_index_t* index,
+        const uint8_t* data, size_t size) {
+    const uint8_t* end = data + size;
+    size_t key_length;
+
+    while (data < end) {
+        if (end - data < 2)
+            return UB_EPARSE;
+
+        key_length = ub_i_load_be(data, 2);
+        if ((size_t)(end - data) < key_length + UB_I_ENTRY_LENGTH)
+            return UB_EPARSE;
+
+        UB_CHECK(ub_i_secondary_index_append(index, data + 2, key_length,
+                    ub_i_load_be(data + 2 + key_length, 8),
+                    ub_i_load_be(data + 10 + key_length, 8),
+                    ub_i_load_be(data + 18 + key_length, 2)));
+        data += key_length + UB_I_ENTRY_LENGTH;
+    }
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_secondary_index_read(ub_secondary_index_t* index, FILE* f) {
+    ub_block_type_t block_type;
+    ub_chksum_type_t chksum_type;
+    ub_buffer_t payload;
+    const uint8_t* data;
+    uint64_t num_entries = 0;
+    ub_bool_t has_header = 0;
+    ub_error_t retval;
+    uint8_t version;
+    size_t size;
+
+    UB_CHECK(ub_read_header(f, &version, &chksum_type));
+    UB_CHECK(ub_buffer_init(&payload, 0));
+
+    ub_i_secondary_index_clear(index);
+
+    while (1) {
+        retval = ub_read_block(f, &block_type, &payload, chksum_type);
+        if (retval != UB_SUCCESS)
+            break;
+
+        data = UB_BUFFER(payload);
+        size = ub_buffer_size(&payload);
+
+        if (block_type == UB_BLOCK_COMMENT) {
+            continue;
+        } else if (block_type == UB_BLOCK_SECONDARY_INDEX_HEADER && !has_header) {
+            if (size <= UB_I_HEADER_LENGTH || data[size - 1] != 0 ||
+                    data[1] == UB_DATATYPE_UNKNOWN ||
+                    data[1] >= UB_MAX_DATATYPE) {
+                retval = UB_EPARSE;
+                break;
+            }
+            index->column = data[0];
+            index->type = (ub_datatype_t)data[1];
+            index->log_length = ub_i_load_be(data + 2, 8);
+            num_entries = ub_i_load_be(data + 10, 8);
+            retval = ub_i_secondary_index_set_name(index,
+                    (const char*)data + UB_I_HEADER_LENGTH,
+                    size - UB_I_HEADER_LENGTH - 1);
+            has_header = 1;
+        } else if (block_type == UB_BLOCK_SECONDARY_INDEX && has_header) {
+            retval = ub_i_secondary_index_parse_block(index, data, size);
+        } else {
+            retval = UB_EPARSE;
+        }
+
+        if (retval != UB_SUCCESS)
+            break;
+    }
+
+    if (retval == UB_EOF) {
+        retval = has_header && index->num_entries == num_entries ?
+            UB_SUCCESS : UB_EPARSE;
+    }
+
+    ub_buffer_destroy(&payload);
+
+    if (retval != UB_SUCCESS) {
+        ub_i_secondary_index_clear(index);
+        return retval;
+    }
+
+    ub_i_secondary_index_finish(index);
+    return UB_SUCCESS;
+}
+
+/**
+ * Returns the index of the first entry whose key is greater than (or, if
+ * \p inclusive is true, greater than or equal to) the given key.
+ */
+static size_t ub_i_secondary_index_bisect(const ub_secondary_index_t* index,
+        const uint8_t* key, size_t key_length, ub_bool_t inclusive) {
+    const ub_secondary_index_entry_t* entry;
+    size_t lo = 0, hi = index->num_entries, mid;
+    int result;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        entry = &index->entries[mid];
+        result = ub_i_compare_keys(entry->key, entry->key_length, key,
+                key_length);
+        if (result < 0 || (result == 0 && !inclusive))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+ub_error_t ub_secondary_index_find(const ub_secondary_index_t* index,
+        const void* lower, size_t lower_length, const void* upper,
+        size_t upper_length, size_t* begin, size_t* end) {
+    const uint8_t* key;
+    uint8_t scratch[8];
+    size_t key_length;
+
+    if (index->type == UB_DATATYPE_UNKNOWN || index->type >= UB_MAX_DATATYPE)
+        return UB_EUNSUPPORTED;
+
+    *begin = 0;
+    *end = index->num_entries;
+
+    if (lower) {
+        key = ub_i_make_bound(index->type, lower, lower_length, scratch,
+                &key_length);
+        *begin = ub_i_secondary_index_bisect(index, key, key_length, 1);
+    }
+
+    if (upper) {
+        key = ub_i_make_bound(index->type, upper, upper_length, scratch,
+                &key_length);
+        *end = ub_i_secondary_index_bisect(index, key, key_length, 0);
+    }
+
+    if (*end < *begin)
+        *end = *begin;
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_log_reader_seek_entry(ub_log_reader_t* reader,
+        const ub_secondary_index_entry_t* entry) {
+    /* stay on the current block if it holds the row already */
+    if (reader->rows == 0 || reader->block_offset != entry->offset ||
+            reader->first_row + entry->index != entry->row) {
+        if (entry->index > entry->row)
+            return UB_EPARSE;
+        UB_CHECK(ub_log_reader_seek_block(reader, entry->offset,
+                    entry->row - entry->index));
+    }
+
+    return entry->index < reader->num_rows ? UB_SUCCESS : UB_EPARSE;
+}
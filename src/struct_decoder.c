@@ -0,0 +1,280 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#include <string.h>
+#include <sys/time.h>
+
+#include <unibinlog/struct_decoder.h>
+
+/**
+ * Numeric categories of the data types, used to decide which conversions
+ * are allowed between a column and a field.
+ */
+typedef enum {
+    UB_I_NOT_NUMERIC = 0,
+    UB_I_UNSIGNED,
+    UB_I_SIGNED,
+    UB_I_REAL
+} ub_i_numeric_kind_t;
+
+static ub_i_numeric_kind_t ub_i_numeric_kind(ub_datatype_t type) {
+    switch (type) {
+        case UB_DATATYPE_BOOLEAN:
+        case UB_DATATYPE_U8:
+        case UB_DATATYPE_U16:
+        case UB_DATATYPE_U32:
+        case UB_DATATYPE_U64:
+        case UB_DATATYPE_CHAR:
+        case UB_DATATYPE_UNIX_TIMESTAMP:
+            return UB_I_UNSIGNED;
+
+        case UB_DATATYPE_S8:
+        case UB_DATATYPE_S16:
+        case UB_DATATYPE_S32:
+        case UB_DATATYPE_S64:
+            return UB_I_SIGNED;
+
+        case UB_DATATYPE_FLOAT:
+        case UB_DATATYPE_DOUBLE:
+            return UB_I_REAL;
+
+        default:
+            return UB_I_NOT_NUMERIC;
+    }
+}
+
+/**
+ * Loads an unsigned integer of the given width stored in the given byte
+ * order.
+ */
+static uint64_t ub_i_load(const uint8_t* bytes, size_t width,
+        ub_byte_order_t order) {
+    uint64_t result = 0;
+    size_t i;
+
+    if (order == UB_LITTLE_ENDIAN) {
+        for (i = width; i > 0; i--)
+            result = (result << 8) | bytes[i - 1];
+    } else {
+        for (i = 0; i < width; i++)
+            result = (result << 8) | bytes[i];
+    }
+
+    return result;
+}
+
+/**
+ * Decodes a single numeric value of the given column type and stores it in
+ * a field of the given native type.
+ */
+static void ub_i_store_numeric(uint8_t* dest, ub_datatype_t field_type,
+        ub_datatype_t column_type, const uint8_t* src, size_t length,
+        ub_byte_order_t order) {
+    ub_i_numeric_kind_t kind = ub_i_numeric_kind(column_type);
+    uint64_t bits = ub_i_load(src, length, order);
+    double real = 0;
+    uint8_t u8;
+    uint16_t u16;
+    uint32_t u32;
+    float f;
+
+    if (kind == UB_I_SIGNED && length < 8 && (bits >> (length * 8 - 1)) & 1) {
+        /* sign extension */
+        bits |= ~(uint64_t)0 << (length * 8);
+    } else if (column_type == UB_DATATYPE_FLOAT) {
+        u32 = (uint32_t)bits;
+        memcpy(&f, &u32, sizeof(f));
+        real = f;
+    } else if (column_type == UB_DATATYPE_DOUBLE) {
+        memcpy(&real, &bits, sizeof(real));
+    }
+
+    switch (field_type) {
+        case UB_DATATYPE_BOOLEAN:
+            *dest = kind == UB_I_REAL ? real != 0 : bits != 0;
+            break;
+
+        case UB_DATATYPE_U8:
+        case UB_DATATYPE_S8:
+        case UB_DATATYPE_CHAR:
+            u8 = (uint8_t)bits;
+            memcpy(dest, &u8, sizeof(u8));
+            break;
+
+        case UB_DATATYPE_U16:
+        case UB_DATATYPE_S16:
+            u16 = (uint16_t)bits;
+            memcpy(dest, &u16, sizeof(u16));
+            break;
+
+        case UB_DATATYPE_U32:
+        case UB_DATATYPE_S32:
+            u32 = (uint32_t)bits;
+            memcpy(dest, &u32, sizeof(u32));
+            break;
+
+        case UB_DATATYPE_U64:
+        case UB_DATATYPE_S64:
+        case UB_DATATYPE_UNIX_TIMESTAMP:
+            memcpy(dest, &bits, sizeof(bits));
+            break;
+
+        case UB_DATATYPE_FLOAT:
+            f = kind == UB_I_REAL ? (float)real :
+                kind == UB_I_SIGNED ? (float)(int64_t)bits : (float)bits;
+            memcpy(dest, &f, sizeof(f));
+            break;
+
+        case UB_DATATYPE_DOUBLE:
+            real = kind == UB_I_REAL ? real :
+                kind == UB_I_SIGNED ? (double)(int64_t)bits : (double)bits;
+            memcpy(dest, &real, sizeof(real));
+            break;
+
+        default:
+            break;
+    }
+}
+
+ub_error_t ub_struct_decoder_validate(const ub_log_column_t* columns,
+        size_t num_columns, const ub_struct_field_t* fields) {
+    ub_i_numeric_kind_t column_kind, field_kind;
+    size_t i;
+
+    for (i = 0; i < num_columns; i++) {
+        if (columns[i].type == UB_DATATYPE_UNKNOWN ||
+                columns[i].type >= UB_MAX_DATATYPE)
+            return UB_EUNSUPPORTED;
+
+        if (fields[i].type == UB_DATATYPE_UNKNOWN)
+            continue;
+
+        column_kind = ub_i_numeric_kind(columns[i].type);
+        field_kind = ub_i_numeric_kind(fields[i].type);
+
+        if (column_kind == UB_I_NOT_NUMERIC || field_kind == UB_I_NOT_NUMERIC) {
+            /* strings and timevals can only be decoded as they are */
+            if (columns[i].type != fields[i].type ||
+                    columns[i].type == UB_DATATYPE_SHORT_BLOB ||
+                    columns[i].type == UB_DATATYPE_BLOB)
+                return UB_EINVAL;
+        } else if (column_kind == UB_I_REAL && field_kind != UB_I_REAL &&
+                fields[i].type != UB_DATATYPE_BOOLEAN) {
+            return UB_EINVAL;
+        }
+    }
+
+    return UB_SUCCESS;
+}
+
+/**
+ * Stores the value of a column into its field in a struct.
+ */
+static void ub_i_struct_decode_value(uint8_t* dest,
+        const ub_struct_field_t* field, ub_datatype_t type,
+        const uint8_t* src, size_t length, ub_byte_order_t order) {
+    struct timeval tv;
+
+    switch (field->type) {
+        case UB_DATATYPE_UNKNOWN:
+            break;
+
+        case UB_DATATYPE_STRING:
+            memcpy(dest + field->offset, &src, sizeof(const char*));
+            break;
+
+        case UB_DATATYPE_TIMEVAL:
+            tv.tv_sec = ub_i_load(src, 4, order);
+            tv.tv_usec = ub_i_load(src + 4, 4, order);
+            memcpy(dest + field->offset, &tv, sizeof(tv));
+            break;
+
+        default:
+            ub_i_store_numeric(dest + field->offset, field->type, type, src,
+                    length, order);
+    }
+}
+
+/**
+ * Decodes rows in the aligned layout, which all have the same length.
+ */
+static ub_error_t ub_i_struct_decode_aligned(const ub_log_column_t* columns,
+        size_t num_columns, const ub_struct_field_t* fields,
+        const uint8_t* src, size_t size, ub_byte_order_t order,
+        uint8_t* dest, size_t struct_size, size_t max_structs,
+        size_t* count) {
+    size_t i, row_length, offsets[255];
+
+    /* variable-length rows cannot be aligned */
+    row_length = ub_log_columns_get_layout(columns, num_columns, 1, offsets);
+    if (row_length == 0)
+        return UB_EUNSUPPORTED;
+
+    for (; size > 0; src += row_length, size -= row_length) {
+        if (*count == max_structs)
+            return UB_ETOOLONG;
+        if (size < row_length)
+            return UB_EPARSE;
+
+        for (i = 0; i < num_columns; i++) {
+            ub_i_struct_decode_value(dest, &fields[i], columns[i].type,
+                    src + offsets[i], ub_datatype_get_info(columns[i].type).length,
+                    order);
+        }
+
+        dest += struct_size;
+        (*count)++;
+    }
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_struct_decode_log_entries(const ub_log_column_t* columns,
+        size_t num_columns, const ub_struct_field_t* fields,
+        const void* rows, size_t size, ub_byte_order_t order,
+        ub_bool_t aligned, void* structs, size_t struct_size,
+        size_t max_structs, size_t* num_structs) {
+    const uint8_t* src = (const uint8_t*)rows;
+    uint8_t* dest = (uint8_t*)structs;
+    size_t i, length, count = 0;
+    ub_error_t retval = UB_SUCCESS;
+
+    UB_CHECK(ub_struct_decoder_validate(columns, num_columns, fields));
+    if (num_columns > 255)
+        return UB_ETOOLONG;
+
+    if (aligned && num_columns > 0) {
+        retval = ub_i_struct_decode_aligned(columns, num_columns, fields,
+                src, size, order, dest, struct_size, max_structs, &count);
+        size = 0;
+    }
+
+    while (size > 0 && num_columns > 0) {
+        if (count == max_structs) {
+            retval = UB_ETOOLONG;
+            break;
+        }
+
+        for (i = 0; i < num_columns; i++) {
+            length = ub_datatype_get_value_length(columns[i].type, src, size);
+            if (length == 0) {
+                retval = UB_EPARSE;
+                break;
+            }
+
+            ub_i_struct_decode_value(dest, &fields[i], columns[i].type, src,
+                    length, order);
+            src += length; size -= length;
+        }
+
+        if (retval != UB_SUCCESS)
+            break;
+
+        dest += struct_size;
+        count++;
+    }
+
+    if (num_structs)
+        *num_structs = count;
+
+    return retval;
+}
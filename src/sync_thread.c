@@ -0,0 +1,203 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#include "sync_thread.h"
+
+#ifdef HAVE_PTHREAD
+
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <unibinlog/basic_types.h>
+#include <unibinlog/memory.h>
+
+#include "utils.h"
+
+struct ub_i_sync_thread_s {
+    int fd;                        /**< The file descriptor to sync */
+    uint64_t interval;             /**< The time between syncs in milliseconds */
+    size_t refs;                   /**< The number of users of the thread; guarded by the list lock */
+    ub_bool_t dirty;               /**< Whether data was written since the last sync */
+    ub_bool_t stop;                /**< Whether the thread has to exit */
+    uint64_t last_sync;            /**< Time of the last sync on a monotonic clock, in milliseconds */
+    ub_error_t error;              /**< The first error of the syncs */
+    pthread_mutex_t lock;          /**< Guards the state of the thread */
+    pthread_cond_t cond;           /**< Signalled when the state of the thread changes */
+    pthread_t thread;              /**< The thread */
+    struct ub_i_sync_thread_s* next; /**< The next thread in the list */
+};
+
+/** The sync threads, one per file descriptor */
+static ub_sync_thread_t* ub_i_sync_threads = 0;
+
+/** Guards \ref ub_i_sync_threads */
+static pthread_mutex_t ub_i_sync_threads_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Returns the absolute time on the clock of the condition variables after
+ * the given number of milliseconds.
+ */
+static void ub_i_sync_thread_get_deadline(uint64_t ms,
+        struct timespec* deadline) {
+#ifdef HAVE_CLOCK_GETTIME
+    if (clock_gettime(CLOCK_REALTIME, deadline))
+#endif
+    {
+        deadline->tv_sec = time(0);
+        deadline->tv_nsec = 0;
+    }
+
+    deadline->tv_sec += ms / 1000;
+    deadline->tv_nsec += (ms % 1000) * 1000000;
+    if (deadline->tv_nsec >= 1000000000) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+}
+
+static void* ub_i_sync_thread_run(void* arg) {
+    ub_sync_thread_t* thread = (ub_sync_thread_t*)arg;
+    struct timespec deadline;
+    uint64_t elapsed;
+    int failed;
+
+    pthread_mutex_lock(&thread->lock);
+    while (!thread->stop) {
+        if (!thread->dirty) {
+            pthread_cond_wait(&thread->cond, &thread->lock);
+            continue;
+        }
+
+        /* the data written until the interval is over shares the sync */
+        elapsed = ub_get_monotonic_ms() - thread->last_sync;
+        if (elapsed < thread->interval) {
+            ub_i_sync_thread_get_deadline(thread->interval - elapsed,
+                    &deadline);
+            pthread_cond_timedwait(&thread->cond, &thread->lock, &deadline);
+            continue;
+        }
+
+        thread->dirty = 0;
+        pthread_mutex_unlock(&thread->lock);
+#if defined(HAVE_FDATASYNC)
+        failed = fdatasync(thread->fd);
+#elif defined(HAVE_FSYNC)
+        failed = fsync(thread->fd);
+#else
+        failed = 1;
+#endif
+        pthread_mutex_lock(&thread->lock);
+
+        if (failed && thread->error == UB_SUCCESS)
+            thread->error = UB_EWRITE;
+        thread->last_sync = ub_get_monotonic_ms();
+    }
+    pthread_mutex_unlock(&thread->lock);
+
+    return 0;
+}
+
+ub_error_t ub_sync_thread_acquire(int fd, uint64_t interval,
+        ub_sync_thread_t** result) {
+    ub_sync_thread_t* thread;
+    ub_error_t retval = UB_SUCCESS;
+
+    pthread_mutex_lock(&ub_i_sync_threads_lock);
+
+    for (thread = ub_i_sync_threads; thread != 0; thread = thread->next) {
+        if (thread->fd == fd)
+            break;
+    }
+
+    if (thread != 0) {
+        thread->refs++;
+        pthread_mutex_lock(&thread->lock);
+        if (interval < thread->interval) {
+            thread->interval = interval;
+            pthread_cond_signal(&thread->cond);
+        }
+        pthread_mutex_unlock(&thread->lock);
+    } else {
+        thread = ub_calloc(ub_sync_thread_t, 1);
+        if (thread == 0) {
+            retval = UB_ENOMEM;
+        } else {
+            thread->fd = fd;
+            thread->interval = interval;
+            thread->refs = 1;
+            thread->last_sync = ub_get_monotonic_ms();
+            thread->error = UB_SUCCESS;
+
+            if (pthread_mutex_init(&thread->lock, 0)) {
+                retval = UB_FAILURE;
+            } else if (pthread_cond_init(&thread->cond, 0)) {
+                pthread_mutex_destroy(&thread->lock);
+                retval = UB_FAILURE;
+            } else if (pthread_create(&thread->thread, 0,
+                        ub_i_sync_thread_run, thread)) {
+                pthread_cond_destroy(&thread->cond);
+                pthread_mutex_destroy(&thread->lock);
+                retval = UB_FAILURE;
+            }
+
+            if (retval != UB_SUCCESS) {
+                ub_free(thread);
+            } else {
+                thread->next = ub_i_sync_threads;
+                ub_i_sync_threads = thread;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&ub_i_sync_threads_lock);
+
+    if (retval == UB_SUCCESS)
+        *result = thread;
+    return retval;
+}
+
+void ub_sync_thread_release(ub_sync_thread_t* thread) {
+    ub_sync_thread_t** link;
+
+    pthread_mutex_lock(&ub_i_sync_threads_lock);
+    if (--thread->refs > 0) {
+        pthread_mutex_unlock(&ub_i_sync_threads_lock);
+        return;
+    }
+
+    for (link = &ub_i_sync_threads; *link != thread; link = &(*link)->next)
+        ;
+    *link = thread->next;
+    pthread_mutex_unlock(&ub_i_sync_threads_lock);
+
+    pthread_mutex_lock(&thread->lock);
+    thread->stop = 1;
+    pthread_cond_signal(&thread->cond);
+    pthread_mutex_unlock(&thread->lock);
+
+    pthread_join(thread->thread, 0);
+    pthread_cond_destroy(&thread->cond);
+    pthread_mutex_destroy(&thread->lock);
+    ub_free(thread);
+}
+
+void ub_sync_thread_notify(ub_sync_thread_t* thread) {
+    pthread_mutex_lock(&thread->lock);
+    if (!thread->dirty) {
+        thread->dirty = 1;
+        pthread_cond_signal(&thread->cond);
+    }
+    pthread_mutex_unlock(&thread->lock);
+}
+
+ub_error_t ub_sync_thread_get_error(ub_sync_thread_t* thread) {
+    ub_error_t error;
+
+    pthread_mutex_lock(&thread->lock);
+    error = thread->error;
+    pthread_mutex_unlock(&thread->lock);
+
+    return error;
+}
+
+#endif
@@ -0,0 +1,63 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_I_SYNC_THREAD_H
+#define UNIBINLOG_I_SYNC_THREAD_H
+
+#include "config.h"
+
+#ifdef HAVE_PTHREAD
+
+#include <stdint.h>
+
+#include <unibinlog/error.h>
+
+/**
+ * A background thread that syncs a file descriptor once a given time has
+ * passed since the last sync and data was written into it since, so all
+ * the writers of the file share a single sync (group commit). There is at
+ * most one thread per file descriptor; the writers of the same file
+ * descriptor share it, and the shortest of their intervals is used.
+ */
+typedef struct ub_i_sync_thread_s ub_sync_thread_t;
+
+/**
+ * Returns the sync thread of the given file descriptor, starting it if
+ * there is none yet.
+ *
+ * \param  fd        the file descriptor
+ * \param  interval  the time between syncs in milliseconds
+ * \param  thread    the sync thread will be returned here
+ * \return \c UB_SUCCESS, \c UB_ENOMEM or \c UB_FAILURE if the thread could
+ *         not be started
+ */
+ub_error_t ub_sync_thread_acquire(int fd, uint64_t interval,
+        ub_sync_thread_t** thread);
+
+/**
+ * Gives back a sync thread returned by \ref ub_sync_thread_acquire(); the
+ * thread is stopped when its last user gives it back.
+ *
+ * \param  thread  the sync thread
+ */
+void ub_sync_thread_release(ub_sync_thread_t* thread);
+
+/**
+ * Tells the sync thread that data was written into the file descriptor,
+ * which is synced when the interval since the last sync is over. The data
+ * must have reached the kernel already.
+ *
+ * \param  thread  the sync thread
+ */
+void ub_sync_thread_notify(ub_sync_thread_t* thread);
+
+/**
+ * Returns the first error of the syncs done by the thread.
+ *
+ * \param  thread  the sync thread
+ * \return \c UB_SUCCESS or \c UB_EWRITE if a sync failed
+ */
+ub_error_t ub_sync_thread_get_error(ub_sync_thread_t* thread);
+
+#endif
+
+#endif
@@ -1,6 +1,7 @@
 /* vim:set ts=4 sw=4 sts=4 et: */
 
 #include <assert.h>
+#include <string.h>
 #include <unibinlog/types.h>
 
 static ub_typeinfo_t ub_i_datatype_info[] = {
@@ -154,3 +155,39 @@ ub_typeinfo_t ub_datatype_get_info(ub_datatype_t type) {
 	return ub_i_datatype_info[type];
 }
 
+
+size_t ub_datatype_get_value_length(ub_datatype_t type, const void* data,
+        size_t size) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    size_t length;
+
+    switch (type) {
+        case UB_DATATYPE_STRING:
+            length = bytes ? strnlen((const char*)bytes, size) + 1 : 1;
+            break;
+
+        case UB_DATATYPE_SHORT_BLOB:
+            length = size >= 1 ? 1 + bytes[0] : 1;
+            break;
+
+        case UB_DATATYPE_BLOB:
+            length = size >= 2 ? 2 + ((bytes[0] << 8) | bytes[1]) : 2;
+            break;
+
+        default:
+            length = type < UB_MAX_DATATYPE ? ub_i_datatype_info[type].length : 0;
+    }
+
+    return length <= size ? length : 0;
+}
+
+size_t ub_datatype_get_alignment(ub_datatype_t type) {
+    if (type >= UB_MAX_DATATYPE || ub_i_datatype_info[type].is_variable_length)
+        return 0;
+
+    /* a timeval is stored as two 32-bit integers */
+    if (type == UB_DATATYPE_TIMEVAL)
+        return 4;
+
+    return ub_i_datatype_info[type].length;
+}
@@ -0,0 +1,194 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#include "uring.h"
+
+#ifdef HAVE_IO_URING
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+ub_error_t ub_uring_init(ub_uring_t* ring, unsigned entries) {
+    struct io_uring_params params;
+    uint8_t *sq, *cq;
+    void* sqes;
+
+    memset(ring, 0, sizeof(ub_uring_t));
+    memset(&params, 0, sizeof(params));
+
+    ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0)
+        return UB_EUNSUPPORTED;
+
+    ring->sq_ring_size = params.sq_off.array +
+        params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes +
+        params.cq_entries * sizeof(struct io_uring_cqe);
+
+    /* newer kernels map both queues with a single mapping */
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size)
+            ring->sq_ring_size = ring->cq_ring_size;
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap(0, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        close(ring->fd);
+        return UB_EUNSUPPORTED;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(0, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            munmap(ring->sq_ring, ring->sq_ring_size);
+            close(ring->fd);
+            return UB_EUNSUPPORTED;
+        }
+    }
+
+    sqes = mmap(0, params.sq_entries * sizeof(struct io_uring_sqe),
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+            IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        if (ring->cq_ring != ring->sq_ring)
+            munmap(ring->cq_ring, ring->cq_ring_size);
+        munmap(ring->sq_ring, ring->sq_ring_size);
+        close(ring->fd);
+        return UB_EUNSUPPORTED;
+    }
+
+    sq = (uint8_t*)ring->sq_ring;
+    cq = (uint8_t*)ring->cq_ring;
+    ring->sq_head = (unsigned*)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->sq_mask = *(unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_entries = params.sq_entries;
+    ring->sqes = (struct io_uring_sqe*)sqes;
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = *(unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    return UB_SUCCESS;
+}
+
+void ub_uring_destroy(ub_uring_t* ring) {
+    munmap(ring->sqes, ring->sq_entries * sizeof(struct io_uring_sqe));
+    if (ring->cq_ring != ring->sq_ring)
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+    ring->fd = -1;
+}
+
+ub_error_t ub_uring_register_buffers(ub_uring_t* ring,
+        const struct iovec* iovecs, unsigned count) {
+    if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS,
+                iovecs, count) < 0)
+        return UB_EUNSUPPORTED;
+
+    return UB_SUCCESS;
+}
+
+struct io_uring_sqe* ub_uring_get_sqe(ub_uring_t* ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *ring->sq_tail;
+    struct io_uring_sqe* sqe;
+
+    if (tail - head >= ring->sq_entries)
+        return 0;
+
+    sqe = &ring->sqes[tail & ring->sq_mask];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    ring->sq_array[tail & ring->sq_mask] = tail & ring->sq_mask;
+
+    /* the kernel only looks at the queue when the entries are submitted,
+     * so the entry may be published before it is filled in */
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->to_submit++;
+
+    return sqe;
+}
+
+ub_error_t ub_uring_submit(ub_uring_t* ring, unsigned wait_nr) {
+    unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+    long retval;
+
+    do {
+        retval = syscall(__NR_io_uring_enter, ring->fd, ring->to_submit,
+                wait_nr, flags, 0, 0);
+        if (retval < 0 && errno != EINTR)
+            return UB_FAILURE;
+        if (retval > 0)
+            ring->to_submit -= retval;
+    } while (retval < 0);
+
+    return UB_SUCCESS;
+}
+
+ub_bool_t ub_uring_peek(ub_uring_t* ring, uint64_t* user_data,
+        int32_t* result) {
+    unsigned head = *ring->cq_head;
+    struct io_uring_cqe* cqe;
+
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+        return 0;
+
+    cqe = &ring->cqes[head & ring->cq_mask];
+    *user_data = cqe->user_data;
+    *result = cqe->res;
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+ub_error_t ub_uring_wait(ub_uring_t* ring, uint64_t* user_data,
+        int32_t* result) {
+    while (!ub_uring_peek(ring, user_data, result)) {
+        /* the kernel may be short of memory or of room for completions for
+         * a while; the completions in flight still arrive */
+        if (ub_uring_submit(ring, 1) && errno != EAGAIN && errno != EBUSY)
+            return UB_FAILURE;
+    }
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_uring_cancel(ub_uring_t* ring, size_t count) {
+    struct io_uring_sqe* sqe = 0;
+    ub_bool_t cancelling = 0;
+    uint64_t user_data;
+    int32_t result;
+
+#ifdef IORING_ASYNC_CANCEL_ANY
+    /* the cancellation has a completion of its own */
+    if (count > 0)
+        sqe = ub_uring_get_sqe(ring);
+    if (sqe != 0) {
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+        sqe->user_data = UINT64_MAX;
+        cancelling = 1;
+    }
+#endif
+
+    while (count > 0 || cancelling) {
+        UB_CHECK(ub_uring_wait(ring, &user_data, &result));
+        if (user_data == UINT64_MAX)
+            cancelling = 0;
+        else
+            count--;
+    }
+
+    return UB_SUCCESS;
+}
+
+#endif
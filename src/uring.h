@@ -0,0 +1,134 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#ifndef UNIBINLOG_I_URING_H
+#define UNIBINLOG_I_URING_H
+
+#include "config.h"
+
+#ifdef HAVE_IO_URING
+
+#include <stdint.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#include <unibinlog/basic_types.h>
+#include <unibinlog/error.h>
+
+/**
+ * A minimal io_uring instance driven by raw system calls: a submission
+ * queue and a completion queue shared with the kernel. Not thread-safe.
+ */
+typedef struct {
+    int fd;                        /**< The file descriptor of the ring */
+    unsigned* sq_head;             /**< Head of the submission queue; advanced by the kernel */
+    unsigned* sq_tail;             /**< Tail of the submission queue; advanced by us */
+    unsigned* sq_array;            /**< Indices of the queued submission entries */
+    unsigned sq_mask;              /**< Mask to turn a queue position into an index */
+    unsigned sq_entries;           /**< The number of entries in the submission queue */
+    struct io_uring_sqe* sqes;     /**< The submission entries */
+    unsigned* cq_head;             /**< Head of the completion queue; advanced by us */
+    unsigned* cq_tail;             /**< Tail of the completion queue; advanced by the kernel */
+    unsigned cq_mask;              /**< Mask to turn a queue position into an index */
+    struct io_uring_cqe* cqes;     /**< The completion entries */
+    void* sq_ring;                 /**< The mapping of the submission queue */
+    size_t sq_ring_size;           /**< The length of \c sq_ring */
+    void* cq_ring;                 /**< The mapping of the completion queue; may be \c sq_ring */
+    size_t cq_ring_size;           /**< The length of \c cq_ring */
+    unsigned to_submit;            /**< The number of entries queued but not submitted yet */
+} ub_uring_t;
+
+/**
+ * Sets up an io_uring instance.
+ *
+ * \param  ring     the ring to initialize
+ * \param  entries  the minimum number of submission entries
+ * \return \c UB_SUCCESS or \c UB_EUNSUPPORTED if the kernel does not
+ *         support io_uring or the ring cannot be set up
+ */
+ub_error_t ub_uring_init(ub_uring_t* ring, unsigned entries);
+
+/**
+ * Tears down an io_uring instance. Operations still in flight are
+ * completed by the kernel, but their results are lost.
+ *
+ * \param  ring  the ring to destroy
+ */
+void ub_uring_destroy(ub_uring_t* ring);
+
+/**
+ * Registers buffers with the ring, so they can be used with the fixed
+ * read and write operations, which spare the kernel mapping them for each
+ * operation.
+ *
+ * \param  ring    the ring
+ * \param  iovecs  the buffers
+ * \param  count   the number of buffers
+ * \return \c UB_SUCCESS or \c UB_EUNSUPPORTED if the buffers cannot be
+ *         registered (e.g. because of the locked memory limit)
+ */
+ub_error_t ub_uring_register_buffers(ub_uring_t* ring,
+        const struct iovec* iovecs, unsigned count);
+
+/**
+ * Returns the next free submission entry, zeroed, or null if the
+ * submission queue is full. The entry is submitted with the next call to
+ * \ref ub_uring_submit().
+ *
+ * \param  ring  the ring
+ * \return the submission entry or null
+ */
+struct io_uring_sqe* ub_uring_get_sqe(ub_uring_t* ring);
+
+/**
+ * Submits the queued entries to the kernel and optionally waits for
+ * completions.
+ *
+ * \param  ring     the ring
+ * \param  wait_nr  the number of completions to wait for
+ * \return \c UB_SUCCESS or \c UB_FAILURE
+ */
+ub_error_t ub_uring_submit(ub_uring_t* ring, unsigned wait_nr);
+
+/**
+ * Takes the next completion from the completion queue without waiting.
+ *
+ * \param  ring       the ring
+ * \param  user_data  the user data of the completed entry will be returned
+ *                    here
+ * \param  result     the result of the operation will be returned here
+ * \return whether there was a completion
+ */
+ub_bool_t ub_uring_peek(ub_uring_t* ring, uint64_t* user_data,
+        int32_t* result);
+
+/**
+ * Takes the next completion from the completion queue, submitting the
+ * queued entries and waiting for a completion if there is none. Waits that
+ * fail with \c EAGAIN or \c EBUSY are retried.
+ *
+ * \param  ring       the ring
+ * \param  user_data  the user data of the completed entry will be returned
+ *                    here
+ * \param  result     the result of the operation will be returned here
+ * \return \c UB_SUCCESS or \c UB_FAILURE, in which case the operations in
+ *         flight may still be running
+ */
+ub_error_t ub_uring_wait(ub_uring_t* ring, uint64_t* user_data,
+        int32_t* result);
+
+/**
+ * Cancels the operations in flight and waits for them to complete, so the
+ * kernel no longer accesses their buffers. Kernels that cannot cancel all
+ * the operations at once let them run to completion instead. The
+ * operations must not use \c UINT64_MAX as their user data.
+ *
+ * \param  ring   the ring
+ * \param  count  the number of operations in flight
+ * \return \c UB_SUCCESS or \c UB_FAILURE if their completions cannot be
+ *         waited for, in which case their buffers must never be freed
+ */
+ub_error_t ub_uring_cancel(ub_uring_t* ring, size_t count);
+
+#endif
+
+#endif
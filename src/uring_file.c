@@ -0,0 +1,441 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+/* for fopencookie() */
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <unibinlog/memory.h>
+#include <unibinlog/uring_file.h>
+
+#include "config.h"
+#include "uring.h"
+
+/**
+ * The alignment of the buffers of an io_uring file.
+ */
+#define UB_I_URING_FILE_ALIGNMENT 4096
+
+/**
+ * A buffer of an io_uring file and the write that it is part of.
+ */
+typedef struct {
+    uint8_t* data;                 /**< The contents of the buffer */
+    size_t length;                 /**< The number of bytes in the buffer */
+    size_t done;                   /**< The number of bytes written so far */
+    uint64_t offset;               /**< The file offset of the first byte of the buffer */
+    ub_bool_t busy;                /**< Whether the buffer is being written */
+} ub_i_uring_buffer_t;
+
+/**
+ * The buffers and the ring of an io_uring file.
+ */
+typedef struct {
+    ub_i_uring_buffer_t* buffers;  /**< The buffers */
+    uint8_t* memory;               /**< The memory of all the buffers */
+    size_t current;                /**< The index of the buffer being filled */
+    size_t in_flight;              /**< The number of buffers being written */
+    ub_bool_t broken;              /**< Whether the writes in flight cannot be waited for any more; their buffers stay busy until the ring is torn down */
+    uint64_t position;             /**< The file offset of the next byte written into the stream */
+#ifdef HAVE_IO_URING
+    ub_uring_t ring;               /**< The ring; valid if the file is asynchronous */
+#endif
+} ub_i_uring_state_t;
+
+/**
+ * Records the first write error of the file.
+ */
+static void ub_i_uring_file_fail(ub_uring_file_t* file) {
+    if (file->error == UB_SUCCESS)
+        file->error = UB_EWRITE;
+}
+
+#ifdef HAVE_IO_URING
+
+/**
+ * Queues the write of the rest of the given buffer.
+ */
+static ub_error_t ub_i_uring_file_queue(ub_uring_file_t* file, size_t index) {
+    ub_i_uring_state_t* state = (ub_i_uring_state_t*)file->state;
+    ub_i_uring_buffer_t* buffer = &state->buffers[index];
+    struct io_uring_sqe* sqe;
+
+    /* there is an entry for each buffer, so the queue is never full */
+    sqe = ub_uring_get_sqe(&state->ring);
+    if (sqe == 0)
+        return UB_FAILURE;
+
+    sqe->opcode = file->fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = file->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(buffer->data + buffer->done);
+    sqe->len = buffer->length - buffer->done;
+    sqe->off = buffer->offset + buffer->done;
+    sqe->buf_index = index;
+    sqe->user_data = index;
+
+    /* if the entry cannot be submitted now, it goes out with the next wait */
+    ub_uring_submit(&state->ring, 0);
+
+    return UB_SUCCESS;
+}
+
+/**
+ * Waits for the next write to complete, and either releases its buffer or
+ * queues the rest of it after a short write.
+ */
+static void ub_i_uring_file_reap(ub_uring_file_t* file) {
+    ub_i_uring_state_t* state = (ub_i_uring_state_t*)file->state;
+    ub_i_uring_buffer_t* buffer;
+    uint64_t index;
+    int32_t result;
+
+    if (ub_uring_wait(&state->ring, &index, &result)) {
+        /* the writes in flight cannot be tracked any more, but the kernel
+         * may still read their buffers, so they are never reused */
+        ub_i_uring_file_fail(file);
+        state->broken = 1;
+        return;
+    }
+
+    buffer = &state->buffers[index];
+    if (result > 0) {
+        buffer->done += result;
+        if (buffer->done < buffer->length &&
+                ub_i_uring_file_queue(file, index) == UB_SUCCESS)
+            return;
+    }
+
+    if (result <= 0 || buffer->done < buffer->length)
+        ub_i_uring_file_fail(file);
+
+    buffer->busy = 0;
+    state->in_flight--;
+}
+
+#endif
+
+/**
+ * Writes the given buffer synchronously.
+ */
+static void ub_i_uring_file_pwrite(ub_uring_file_t* file,
+        ub_i_uring_buffer_t* buffer) {
+    ssize_t result;
+
+    while (buffer->done < buffer->length) {
+        result = pwrite(file->fd, buffer->data + buffer->done,
+                buffer->length - buffer->done, buffer->offset + buffer->done);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0) {
+            ub_i_uring_file_fail(file);
+            break;
+        }
+        buffer->done += result;
+    }
+}
+
+/**
+ * Starts writing the buffer being filled, if it is not empty, and moves on
+ * to the next buffer, waiting for it to be written first if needed.
+ */
+static void ub_i_uring_file_submit(ub_uring_file_t* file) {
+    ub_i_uring_state_t* state = (ub_i_uring_state_t*)file->state;
+    ub_i_uring_buffer_t* buffer = &state->buffers[state->current];
+
+    /* the buffer is still busy only if the ring is broken */
+    if (buffer->length == 0 || buffer->busy)
+        return;
+
+#ifdef HAVE_IO_URING
+    if (file->async) {
+        buffer->busy = 1;
+        state->in_flight++;
+        if (ub_i_uring_file_queue(file, state->current)) {
+            ub_i_uring_file_fail(file);
+            buffer->busy = 0;
+            state->in_flight--;
+        }
+
+        state->current = (state->current + 1) % file->num_buffers;
+        buffer = &state->buffers[state->current];
+        while (buffer->busy && !state->broken)
+            ub_i_uring_file_reap(file);
+        if (buffer->busy)
+            return;
+    } else {
+        ub_i_uring_file_pwrite(file, buffer);
+    }
+#else
+    ub_i_uring_file_pwrite(file, buffer);
+#endif
+
+    buffer->length = 0;
+    buffer->done = 0;
+    buffer->offset = state->position;
+}
+
+/**
+ * Starts writing the buffer being filled and waits for all the writes to
+ * complete.
+ */
+static void ub_i_uring_file_drain(ub_uring_file_t* file) {
+    ub_i_uring_state_t* state = (ub_i_uring_state_t*)file->state;
+
+    ub_i_uring_file_submit(file);
+
+#ifdef HAVE_IO_URING
+    while (state->in_flight > 0 && !state->broken)
+        ub_i_uring_file_reap(file);
+#else
+    (void)state;
+#endif
+}
+
+#ifdef HAVE_FOPENCOOKIE
+
+static ssize_t ub_i_uring_file_write(void* cookie, const char* data,
+        size_t size) {
+    ub_uring_file_t* file = (ub_uring_file_t*)cookie;
+    ub_i_uring_state_t* state = (ub_i_uring_state_t*)file->state;
+    ub_i_uring_buffer_t* buffer;
+    size_t length, left = size;
+
+    while (left > 0) {
+        buffer = &state->buffers[state->current];
+        if (buffer->busy)
+            break;
+
+        length = file->buffer_size - buffer->length;
+        if (length > left)
+            length = left;
+
+        memcpy(buffer->data + buffer->length, data, length);
+        buffer->length += length;
+        state->position += length;
+        data += length;
+        left -= length;
+
+        if (buffer->length == file->buffer_size)
+            ub_i_uring_file_submit(file);
+    }
+
+    if (file->error != UB_SUCCESS) {
+        errno = EIO;
+        return -1;
+    }
+
+    return size;
+}
+
+static int ub_i_uring_file_seek(void* cookie, off64_t* offset, int whence) {
+    ub_uring_file_t* file = (ub_uring_file_t*)cookie;
+    ub_i_uring_state_t* state = (ub_i_uring_state_t*)file->state;
+    struct stat info;
+    off64_t target;
+
+    switch (whence) {
+        case SEEK_SET:
+            target = *offset;
+            break;
+
+        case SEEK_CUR:
+            target = (off64_t)state->position + *offset;
+            break;
+
+        case SEEK_END:
+            ub_i_uring_file_drain(file);
+            if (fstat(file->fd, &info))
+                return -1;
+            target = info.st_size + *offset;
+            break;
+
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+
+    if (target < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* ftell() lands here without moving; keep the writes in flight */
+    if ((uint64_t)target != state->position) {
+        ub_i_uring_file_drain(file);
+        state->position = target;
+        state->buffers[state->current].offset = target;
+    }
+
+    *offset = target;
+    return 0;
+}
+
+static int ub_i_uring_file_close_stream(void* cookie) {
+    ub_uring_file_t* file = (ub_uring_file_t*)cookie;
+
+    ub_i_uring_file_drain(file);
+    return file->error == UB_SUCCESS ? 0 : -1;
+}
+
+#endif
+
+ub_error_t ub_uring_file_init(ub_uring_file_t* file, int fd,
+        size_t buffer_size, size_t num_buffers, ub_bool_t async) {
+#ifdef HAVE_FOPENCOOKIE
+    cookie_io_functions_t functions;
+    ub_i_uring_state_t* state;
+    off_t position;
+    size_t i, length;
+#ifdef HAVE_IO_URING
+    struct iovec* iovecs;
+#endif
+
+    if (buffer_size == 0 || num_buffers < 2)
+        return UB_EINVAL;
+
+    state = ub_calloc(ub_i_uring_state_t, 1);
+    if (state == 0)
+        return UB_ENOMEM;
+
+    /* page-aligned buffers can be registered and written without copying */
+    length = (buffer_size + UB_I_URING_FILE_ALIGNMENT - 1) /
+        UB_I_URING_FILE_ALIGNMENT * UB_I_URING_FILE_ALIGNMENT;
+    state->buffers = ub_calloc(ub_i_uring_buffer_t, num_buffers);
+    state->memory = ub_memory_aligned_alloc(UB_I_URING_FILE_ALIGNMENT,
+            length * num_buffers);
+    if (state->buffers == 0 || state->memory == 0) {
+        ub_memory_aligned_free(state->memory);
+        ub_free_unless_null(state->buffers);
+        ub_free(state);
+        return UB_ENOMEM;
+    }
+
+    position = lseek(fd, 0, SEEK_CUR);
+    state->position = position > 0 ? position : 0;
+    for (i = 0; i < num_buffers; i++) {
+        state->buffers[i].data = state->memory + i * length;
+        state->buffers[i].offset = state->position;
+    }
+
+    file->fd = fd;
+    file->buffer_size = buffer_size;
+    file->num_buffers = num_buffers;
+    file->async = 0;
+    file->fixed = 0;
+    file->error = UB_SUCCESS;
+    file->state = state;
+
+#ifdef HAVE_IO_URING
+    if (async && ub_uring_init(&state->ring, num_buffers) == UB_SUCCESS) {
+        file->async = 1;
+
+        iovecs = ub_calloc(struct iovec, num_buffers);
+        if (iovecs != 0) {
+            for (i = 0; i < num_buffers; i++) {
+                iovecs[i].iov_base = state->buffers[i].data;
+                iovecs[i].iov_len = length;
+            }
+            file->fixed = ub_uring_register_buffers(&state->ring, iovecs,
+                    num_buffers) == UB_SUCCESS;
+            ub_free(iovecs);
+        }
+    }
+#else
+    (void)async;
+#endif
+
+    functions.read = 0;
+    functions.write = ub_i_uring_file_write;
+    functions.seek = ub_i_uring_file_seek;
+    functions.close = ub_i_uring_file_close_stream;
+
+    file->file = fopencookie(file, "w", functions);
+    if (file->file == 0) {
+#ifdef HAVE_IO_URING
+        if (file->async)
+            ub_uring_destroy(&state->ring);
+#endif
+        ub_memory_aligned_free(state->memory);
+        ub_free(state->buffers);
+        ub_free(file->state);
+        return UB_ENOMEM;
+    }
+
+    /* the stream is buffered by the file itself */
+    setvbuf(file->file, 0, _IONBF, 0);
+
+    return UB_SUCCESS;
+#else
+    (void)file; (void)fd; (void)buffer_size; (void)num_buffers; (void)async;
+    return UB_EUNSUPPORTED;
+#endif
+}
+
+void ub_uring_file_destroy(ub_uring_file_t* file) {
+    ub_i_uring_state_t* state = (ub_i_uring_state_t*)file->state;
+
+    if (state == 0)
+        return;
+
+    ub_uring_file_close(file);
+
+#ifdef HAVE_IO_URING
+    if (file->async)
+        ub_uring_destroy(&state->ring);
+#endif
+
+    ub_memory_aligned_free(state->memory);
+    ub_free(state->buffers);
+    ub_free(file->state);
+}
+
+ub_error_t ub_uring_file_sync(ub_uring_file_t* file) {
+    if (file->file == 0)
+        return UB_EWRITE;
+
+    if (fflush(file->file))
+        ub_i_uring_file_fail(file);
+    ub_i_uring_file_drain(file);
+
+#if defined(HAVE_FDATASYNC)
+    if (fdatasync(file->fd))
+        ub_i_uring_file_fail(file);
+#elif defined(HAVE_FSYNC)
+    if (fsync(file->fd))
+        ub_i_uring_file_fail(file);
+#endif
+
+    return file->error;
+}
+
+/**
+ * Syncs the io_uring file given as user data; see \ref ub_uring_file_attach().
+ */
+static ub_error_t ub_i_uring_file_sync_writer(void* user_data) {
+    return ub_uring_file_sync((ub_uring_file_t*)user_data);
+}
+
+ub_error_t ub_uring_file_attach(ub_uring_file_t* file, ub_log_writer_t* writer) {
+    return ub_log_writer_set_sync_func(writer, ub_i_uring_file_sync_writer, file);
+}
+
+ub_error_t ub_uring_file_close(ub_uring_file_t* file) {
+    if (file->file == 0)
+        return file->error;
+
+    if (fclose(file->file))
+        ub_i_uring_file_fail(file);
+    file->file = 0;
+
+    if (close(file->fd))
+        ub_i_uring_file_fail(file);
+
+    return file->error;
+}
@@ -1,8 +1,19 @@
 /* vim:set ts=4 sw=4 sts=4 et: */
 
 #include <arpa/inet.h>
+#include <time.h>
 #include "utils.h"
 
+uint64_t ub_get_monotonic_ms(void) {
+#ifdef HAVE_CLOCK_GETTIME
+	struct timespec now;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &now) == 0)
+		return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+#endif
+	return (uint64_t)time(0) * 1000;
+}
+
 #ifdef HAVE_UINT64
 #  ifndef HAVE_HTONLL
 uint64_t htonll(uint64_t value) {
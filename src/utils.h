@@ -18,6 +18,20 @@ uint64_t htonll(uint64_t value);
 #  endif
 #endif
 
+/**
+ * Returns the current time of a monotonic clock in milliseconds. The clock
+ * has an arbitrary starting point; only differences are meaningful.
+ *
+ * \return the current time in milliseconds
+ */
+uint64_t ub_get_monotonic_ms(void);
+
+/**
+ * Frees the idle buffers of the shared buffer pool of the library if it
+ * was set up, e.g. before the allocator that allocated them is replaced.
+ */
+void ub_buffer_pool_trim_shared(void);
+
 #ifdef HAVE_IEEE754_FLOATS
 
 /**
@@ -0,0 +1,375 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+#include <string.h>
+
+#include <unibinlog/memory.h>
+#include <unibinlog/zone_map.h>
+
+/**
+ * Numeric categories of the data types, deciding which member of
+ * \ref ub_zone_value_t holds the values of a column.
+ */
+typedef enum {
+    UB_I_NOT_NUMERIC = 0,
+    UB_I_UNSIGNED,
+    UB_I_SIGNED,
+    UB_I_REAL
+} ub_i_numeric_kind_t;
+
+static ub_i_numeric_kind_t ub_i_numeric_kind(ub_datatype_t type) {
+    switch (type) {
+        case UB_DATATYPE_BOOLEAN:
+        case UB_DATATYPE_U8:
+        case UB_DATATYPE_U16:
+        case UB_DATATYPE_U32:
+        case UB_DATATYPE_U64:
+        case UB_DATATYPE_CHAR:
+        case UB_DATATYPE_UNIX_TIMESTAMP:
+            return UB_I_UNSIGNED;
+
+        case UB_DATATYPE_S8:
+        case UB_DATATYPE_S16:
+        case UB_DATATYPE_S32:
+        case UB_DATATYPE_S64:
+            return UB_I_SIGNED;
+
+        case UB_DATATYPE_FLOAT:
+        case UB_DATATYPE_DOUBLE:
+            return UB_I_REAL;
+
+        default:
+            return UB_I_NOT_NUMERIC;
+    }
+}
+
+/**
+ * Loads an unsigned integer of the given width stored in the given byte
+ * order.
+ */
+static uint64_t ub_i_load(const uint8_t* bytes, size_t width,
+        ub_byte_order_t order) {
+    uint64_t result = 0;
+    size_t i;
+
+    if (order == UB_LITTLE_ENDIAN) {
+        for (i = width; i > 0; i--)
+            result = (result << 8) | bytes[i - 1];
+    } else {
+        for (i = 0; i < width; i++)
+            result = (result << 8) | bytes[i];
+    }
+
+    return result;
+}
+
+/**
+ * Stores an unsigned integer on the given number of bytes in network byte
+ * order.
+ */
+static void ub_i_store_be(uint8_t* bytes, size_t width, uint64_t value) {
+    while (width > 0) {
+        width--;
+        bytes[width] = value & 0xFF;
+        value >>= 8;
+    }
+}
+
+/**
+ * Decodes a single value of the given type stored in the given byte order.
+ */
+static ub_zone_value_t ub_i_decode_value(ub_datatype_t type,
+        const uint8_t* bytes, ub_byte_order_t order) {
+    size_t width = ub_datatype_get_info(type).length;
+    ub_zone_value_t result;
+    uint32_t u32;
+    float f;
+
+    result.u = ub_i_load(bytes, width, order);
+
+    if (type == UB_DATATYPE_FLOAT) {
+        u32 = (uint32_t)result.u;
+        memcpy(&f, &u32, sizeof(f));
+        result.f = f;
+    } else if (type == UB_DATATYPE_DOUBLE) {
+        /* the bits are in place already */
+    } else if (ub_i_numeric_kind(type) == UB_I_SIGNED && width < 8 &&
+            (result.u >> (width * 8 - 1)) & 1) {
+        /* sign extension */
+        result.u |= ~(uint64_t)0 << (width * 8);
+    }
+
+    return result;
+}
+
+static ub_bool_t ub_i_less(ub_i_numeric_kind_t kind, ub_zone_value_t a,
+        ub_zone_value_t b) {
+    switch (kind) {
+        case UB_I_SIGNED: return a.s < b.s;
+        case UB_I_REAL: return a.f < b.f;
+        default: return a.u < b.u;
+    }
+}
+
+static ub_bool_t ub_i_equal(ub_i_numeric_kind_t kind, ub_zone_value_t a,
+        ub_zone_value_t b) {
+    return kind == UB_I_REAL ? a.f == b.f : a.u == b.u;
+}
+
+static ub_bool_t ub_i_less_or_equal(ub_i_numeric_kind_t kind,
+        ub_zone_value_t a, ub_zone_value_t b) {
+    return ub_i_less(kind, a, b) || ub_i_equal(kind, a, b);
+}
+
+ub_bool_t ub_zone_map_supports_type(ub_datatype_t type) {
+    return ub_i_numeric_kind(type) != UB_I_NOT_NUMERIC;
+}
+
+ub_error_t ub_zone_map_init(ub_zone_map_t* map) {
+    map->entries = 0;
+    map->num_entries = 0;
+    map->capacity = 0;
+    map->num_rows = 0;
+    return UB_SUCCESS;
+}
+
+void ub_zone_map_destroy(ub_zone_map_t* map) {
+    ub_free_unless_null(map->entries);
+    map->num_entries = 0;
+    map->capacity = 0;
+    map->num_rows = 0;
+}
+
+/**
+ * Makes sure that the zone map has room for the given number of entries.
+ */
+static ub_error_t ub_i_zone_map_reserve(ub_zone_map_t* map, size_t count) {
+    ub_zone_map_entry_t* entries;
+
+    if (count <= map->capacity)
+        return UB_SUCCESS;
+
+    entries = ub_realloc(map->entries, ub_zone_map_entry_t, count);
+    if (entries == 0)
+        return UB_ENOMEM;
+
+    map->entries = entries;
+    map->capacity = count;
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_zone_map_compute(ub_zone_map_t* map,
+        const ub_log_column_t* columns, size_t num_columns, ub_bool_t aligned,
+        ub_byte_order_t order, const uint8_t* rows, size_t length) {
+    size_t offsets[255], slots[255];
+    ub_bool_t seen[255];
+    const uint8_t* end = rows + length;
+    size_t i, row_length, offset, value_length;
+    ub_zone_map_entry_t* entry;
+    ub_i_numeric_kind_t kind;
+    ub_zone_value_t value;
+
+    map->num_entries = 0;
+    map->num_rows = 0;
+
+    if (num_columns > 255 || (num_columns == 0 && length > 0))
+        return UB_EINVAL;
+
+    UB_CHECK(ub_i_zone_map_reserve(map, num_columns));
+
+    for (i = 0; i < num_columns; i++) {
+        if (!ub_zone_map_supports_type(columns[i].type))
+            continue;
+
+        slots[i] = map->num_entries;
+        seen[i] = 0;
+        entry = &map->entries[map->num_entries++];
+        entry->column = i;
+        entry->min.u = entry->max.u = 0;
+        entry->num_nans = 0;
+    }
+
+    row_length = ub_log_columns_get_layout(columns, num_columns, aligned,
+            offsets);
+
+    while (rows < end) {
+        if (row_length > 0 && (size_t)(end - rows) < row_length)
+            return UB_EINVAL;
+
+        for (i = 0, offset = 0; i < num_columns; i++, offset += value_length) {
+            if (row_length > 0)
+                offset = offsets[i];
+
+            value_length = ub_datatype_get_value_length(columns[i].type,
+                    rows + offset, end - rows - offset);
+            if (value_length == 0)
+                return UB_EINVAL;
+
+            if (!ub_zone_map_supports_type(columns[i].type))
+                continue;
+
+            kind = ub_i_numeric_kind(columns[i].type);
+            value = ub_i_decode_value(columns[i].type, rows + offset, order);
+            entry = &map->entries[slots[i]];
+
+            if (kind == UB_I_REAL && value.f != value.f) {
+                entry->num_nans++;
+            } else if (!seen[i]) {
+                entry->min = entry->max = value;
+                seen[i] = 1;
+            } else if (ub_i_less(kind, value, entry->min)) {
+                entry->min = value;
+            } else if (ub_i_less(kind, entry->max, value)) {
+                entry->max = value;
+            }
+        }
+
+        rows += row_length > 0 ? row_length : offset;
+        map->num_rows++;
+    }
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_zone_map_encode(const ub_zone_map_t* map, ub_buffer_t* payload) {
+    const ub_zone_map_entry_t* entry;
+    uint8_t* data;
+    size_t i;
+
+    UB_CHECK(ub_buffer_resize(payload,
+                3 + map->num_entries * UB_ZONE_MAP_ENTRY_LENGTH));
+
+    data = UB_BUFFER(*payload);
+    ub_i_store_be(data, 2, map->num_rows);
+    data[2] = map->num_entries;
+    data += 3;
+
+    for (i = 0, entry = map->entries; i < map->num_entries; i++, entry++) {
+        data[0] = entry->column;
+        ub_i_store_be(data + 1, 8, entry->min.u);
+        ub_i_store_be(data + 9, 8, entry->max.u);
+        ub_i_store_be(data + 17, 2, entry->num_nans);
+        data += UB_ZONE_MAP_ENTRY_LENGTH;
+    }
+
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_zone_map_decode(ub_zone_map_t* map, const uint8_t* data,
+        size_t size) {
+    ub_zone_map_entry_t* entry;
+    size_t i, num_entries;
+
+    map->num_entries = 0;
+    map->num_rows = 0;
+
+    if (size < 3)
+        return UB_EPARSE;
+
+    num_entries = data[2];
+    if (size != 3 + num_entries * UB_ZONE_MAP_ENTRY_LENGTH)
+        return UB_EPARSE;
+
+    UB_CHECK(ub_i_zone_map_reserve(map, num_entries));
+
+    map->num_rows = ub_i_load(data, 2, UB_BIG_ENDIAN);
+    data += 3;
+
+    for (i = 0, entry = map->entries; i < num_entries; i++, entry++) {
+        entry->column = data[0];
+        entry->min.u = ub_i_load(data + 1, 8, UB_BIG_ENDIAN);
+        entry->max.u = ub_i_load(data + 9, 8, UB_BIG_ENDIAN);
+        entry->num_nans = ub_i_load(data + 17, 2, UB_BIG_ENDIAN);
+        data += UB_ZONE_MAP_ENTRY_LENGTH;
+    }
+
+    map->num_entries = num_entries;
+    return UB_SUCCESS;
+}
+
+ub_error_t ub_filter_init(ub_filter_t* filter, size_t column,
+        ub_datatype_t type, ub_filter_op_t op, const void* value) {
+    if (op >= UB_MAX_FILTER_OP)
+        return UB_EINVAL;
+
+    if (!ub_zone_map_supports_type(type))
+        return UB_EUNSUPPORTED;
+
+    filter->column = column;
+    filter->type = type;
+    filter->op = op;
+    filter->value = ub_i_decode_value(type, (const uint8_t*)value,
+            ub_byteorder_native());
+
+    return UB_SUCCESS;
+}
+
+ub_bool_t ub_zone_map_may_match(const ub_zone_map_t* map,
+        const ub_log_column_t* columns, size_t num_columns,
+        const ub_filter_t* filters, size_t num_filters) {
+    const ub_zone_map_entry_t* entry;
+    ub_i_numeric_kind_t kind;
+    ub_zone_value_t value;
+    ub_bool_t has_values, result;
+    size_t i, j;
+
+    for (i = 0; i < num_filters; i++, filters++) {
+        if (filters->column >= num_columns ||
+                columns[filters->column].type != filters->type)
+            continue;
+
+        for (j = 0, entry = 0; j < map->num_entries; j++) {
+            if (map->entries[j].column == filters->column) {
+                entry = &map->entries[j];
+                break;
+            }
+        }
+        if (entry == 0)
+            continue;
+
+        kind = ub_i_numeric_kind(filters->type);
+        value = filters->value;
+        has_values = map->num_rows > entry->num_nans;
+
+        /* NaN values only match UB_FILTER_NE, and comparisons with a NaN
+         * constant are false, just like in C */
+        switch (filters->op) {
+            case UB_FILTER_EQ:
+                result = has_values &&
+                    ub_i_less_or_equal(kind, entry->min, value) &&
+                    ub_i_less_or_equal(kind, value, entry->max);
+                break;
+
+            case UB_FILTER_NE:
+                result = entry->num_nans > 0 || (has_values &&
+                        !(ub_i_equal(kind, entry->min, value) &&
+                          ub_i_equal(kind, entry->max, value)));
+                break;
+
+            case UB_FILTER_LT:
+                result = has_values && ub_i_less(kind, entry->min, value);
+                break;
+
+            case UB_FILTER_LE:
+                result = has_values &&
+                    ub_i_less_or_equal(kind, entry->min, value);
+                break;
+
+            case UB_FILTER_GT:
+                result = has_values && ub_i_less(kind, value, entry->max);
+                break;
+
+            case UB_FILTER_GE:
+                result = has_values &&
+                    ub_i_less_or_equal(kind, value, entry->max);
+                break;
+
+            default:
+                result = 1;
+        }
+
+        if (!result)
+            return 0;
+    }
+
+    return 1;
+}
@@ -0,0 +1,116 @@
+#include <string.h>
+
+#include <unibinlog/block_index.h>
+#include <unibinlog/lowlevel.h>
+#include "fmemopen.h"
+#include "common.c"
+
+/* Fills the index with blocks of 10 rows each, with ten timestamps per
+ * second */
+static int fill_index(ub_block_index_t* index, size_t num_entries) {
+    ub_block_index_entry_t entry;
+    size_t i;
+
+    for (i = 0; i < num_entries; i++) {
+        entry.offset = 100 + i * 50;
+        entry.first_row = i * 10;
+        entry.num_rows = 10;
+        entry.first_timestamp = i * 1000;
+        entry.last_timestamp = i * 1000 + 900;
+        if (ub_block_index_append(index, &entry))
+            return 1;
+    }
+
+    return 0;
+}
+
+TEST_CASE(find) {
+    ub_block_index_t index;
+    size_t entry;
+    int retval = 0;
+
+    ub_block_index_init(&index);
+
+    if (ub_block_index_find_row(&index, 0, &entry) != UB_EOF)
+        retval = 1;
+    else if (fill_index(&index, 100))
+        retval = 2;
+    else if (ub_block_index_get_num_rows(&index) != 1000)
+        retval = 3;
+    else if (ub_block_index_find_timestamp(&index, 0, &entry) !=
+            UB_EUNSUPPORTED)
+        retval = 4;
+
+    if (!retval) {
+        if (ub_block_index_find_row(&index, 0, &entry) || entry != 0)
+            retval = 5;
+        else if (ub_block_index_find_row(&index, 459, &entry) || entry != 45)
+            retval = 6;
+        else if (ub_block_index_find_row(&index, 999, &entry) || entry != 99)
+            retval = 7;
+        else if (ub_block_index_find_row(&index, 1000, &entry) != UB_EOF)
+            retval = 8;
+    }
+
+    index.timestamp_column = 0;
+    if (!retval) {
+        if (ub_block_index_find_timestamp(&index, -5, &entry) || entry != 0)
+            retval = 9;
+        else if (ub_block_index_find_timestamp(&index, 45900, &entry) ||
+                entry != 45)
+            retval = 10;
+        else if (ub_block_index_find_timestamp(&index, 45901, &entry) ||
+                entry != 46)
+            retval = 11;
+        else if (ub_block_index_find_timestamp(&index, 99901, &entry) !=
+                UB_EOF)
+            retval = 12;
+    }
+
+    ub_block_index_destroy(&index);
+    return retval;
+}
+
+TEST_CASE(write_and_read) {
+    static char buffer[131072];
+    ub_block_index_t index, loaded;
+    FILE* f;
+    int retval = 0;
+
+    ub_block_index_init(&index);
+    ub_block_index_init(&loaded);
+
+    /* enough entries to need more than one index block */
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    ub_write_comment_block(f, "some data", UB_CHKSUM_FLETCHER_16);
+    index.timestamp_column = 3;
+    if (fill_index(&index, 2500))
+        retval = 1;
+    else if (ub_block_index_write(&index, f, UB_CHKSUM_FLETCHER_16))
+        retval = 2;
+    else if (ub_block_index_read(&loaded, f, UB_CHKSUM_FLETCHER_16))
+        retval = 3;
+    else if (loaded.num_entries != 2500 || loaded.timestamp_column != 3)
+        retval = 4;
+    else if (memcmp(loaded.entries, index.entries,
+                2500 * sizeof(ub_block_index_entry_t)))
+        retval = 5;
+    fclose(f);
+
+    /* files without a trailer have no index */
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    ub_write_comment_block(f, "no index here, just a comment", UB_CHKSUM_FLETCHER_16);
+    if (!retval && ub_block_index_read(&loaded, f, UB_CHKSUM_FLETCHER_16) !=
+            UB_EOF)
+        retval = 6;
+    fclose(f);
+
+    ub_block_index_destroy(&index);
+    ub_block_index_destroy(&loaded);
+    return retval;
+}
+
+START_OF_TESTS;
+RUN_TEST_CASE(find);
+RUN_TEST_CASE(write_and_read);
+NO_MORE_TEST_CASES;
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <unibinlog/bloom_filter.h>
+#include "common.c"
+
+#define NUM_ROWS 100
+
+/* Builds rows with a STRING and a U32 column: ("device-<i % 10>", i * 7) */
+static size_t make_rows(uint8_t* rows, ub_byte_order_t order) {
+    uint8_t* p = rows;
+    uint32_t id;
+    size_t i;
+
+    for (i = 0; i < NUM_ROWS; i++) {
+        p += sprintf((char*)p, "device-%d", (int)(i % 10)) + 1;
+        id = i * 7;
+        if (order == UB_BIG_ENDIAN) {
+            p[0] = id >> 24; p[1] = id >> 16; p[2] = id >> 8; p[3] = id;
+        } else {
+            p[3] = id >> 24; p[2] = id >> 16; p[1] = id >> 8; p[0] = id;
+        }
+        p += 4;
+    }
+
+    return p - rows;
+}
+
+static void make_columns(ub_log_column_t* columns) {
+    ub_log_column_init(&columns[0], "device", UB_DATATYPE_STRING);
+    ub_log_column_init(&columns[1], "id", UB_DATATYPE_U32);
+}
+
+static int contains(const ub_buffer_t* payload, const ub_bloom_key_t* keys,
+        size_t num_keys) {
+    ub_bool_t result;
+    size_t num_rows;
+
+    if (ub_bloom_filter_may_contain(UB_BUFFER(*payload),
+                ub_buffer_size(payload), keys, num_keys, &num_rows, &result) ||
+            num_rows != NUM_ROWS)
+        return -1;
+
+    return result;
+}
+
+static int check_filters(ub_byte_order_t order) {
+    static uint8_t rows[NUM_ROWS * 16];
+    const size_t filter_columns[] = { 0, 1 };
+    ub_log_column_t columns[2];
+    ub_bloom_key_t keys[2];
+    ub_buffer_t payload;
+    char device[32];
+    uint32_t id;
+    size_t i, length, false_positives = 0;
+    int retval = 0;
+
+    make_columns(columns);
+    length = make_rows(rows, order);
+    ub_buffer_init(&payload, 0);
+
+    if (ub_bloom_filter_encode(&payload, columns, 2, 0, order, rows, length,
+                filter_columns, 2))
+        retval = 1;
+
+    /* all the values that were added must be found */
+    for (i = 0; i < NUM_ROWS && !retval; i++) {
+        sprintf(device, "device-%d", (int)(i % 10));
+        id = i * 7;
+        ub_bloom_key_init(&keys[0], 0, UB_DATATYPE_STRING, device,
+                strlen(device));
+        ub_bloom_key_init(&keys[1], 1, UB_DATATYPE_U32, &id, 0);
+        if (contains(&payload, keys, 2) != 1)
+            retval = 2;
+    }
+
+    /* most of the values that were not added must not be found */
+    for (i = 0; i < 1000 && !retval; i++) {
+        id = i * 7 + 3;
+        ub_bloom_key_init(&keys[0], 1, UB_DATATYPE_U32, &id, 0);
+        if (contains(&payload, keys, 1))
+            false_positives++;
+    }
+    if (!retval && false_positives > 50)
+        retval = 3;
+
+    /* keys of the same column are alternatives, keys of different columns
+     * must all match */
+    id = 3;
+    ub_bloom_key_init(&keys[0], 0, UB_DATATYPE_STRING, "device-42", 9);
+    ub_bloom_key_init(&keys[1], 0, UB_DATATYPE_STRING, "device-4", 8);
+    if (!retval && (contains(&payload, keys, 1) != 0 ||
+                contains(&payload, keys, 2) != 1))
+        retval = 4;
+    ub_bloom_key_init(&keys[0], 0, UB_DATATYPE_STRING, "device-4", 8);
+    ub_bloom_key_init(&keys[1], 1, UB_DATATYPE_U32, &id, 0);
+    if (!retval && contains(&payload, keys + 1, 1) == 0 &&
+            contains(&payload, keys, 2) != 0)
+        retval = 5;
+
+    ub_buffer_destroy(&payload);
+    ub_log_column_destroy_array(columns, 2);
+    return retval;
+}
+
+TEST_CASE(lookup) {
+    return check_filters(UB_BIG_ENDIAN);
+}
+
+TEST_CASE(little_endian) {
+    return check_filters(UB_LITTLE_ENDIAN);
+}
+
+TEST_CASE(malformed) {
+    const uint8_t payload[] = { 0, 1, 1, 0, 7, 0, 2, 0xFF };
+    ub_bloom_key_t key;
+    ub_bool_t result;
+    uint32_t id = 1;
+
+    ub_bloom_key_init(&key, 0, UB_DATATYPE_U32, &id, 0);
+
+    if (ub_bloom_filter_may_contain(payload, sizeof(payload), &key, 1, 0,
+                &result) != UB_EPARSE)
+        return 1;
+    if (ub_bloom_filter_may_contain(payload, 2, &key, 1, 0, &result) !=
+            UB_EPARSE)
+        return 2;
+    if (ub_bloom_key_init(&key, 0, UB_DATATYPE_UNKNOWN, &id, 0) !=
+            UB_EUNSUPPORTED)
+        return 3;
+
+    return 0;
+}
+
+START_OF_TESTS;
+RUN_TEST_CASE(lookup);
+RUN_TEST_CASE(little_endian);
+RUN_TEST_CASE(malformed);
+NO_MORE_TEST_CASES;
@@ -0,0 +1,175 @@
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <unibinlog/buffer.hpp>
+#include <unibinlog/log_column.hpp>
+#include "common.c"
+
+using namespace unibinlog;
+
+TEST_CASE(move_buffer) {
+    buffer buf(16);
+    const std::byte* data = buf.bytes().data();
+    ub_buffer_t* native = buf.native();
+    std::vector<buffer> buffers;
+
+    /* moving must not copy the memory area or move the C structure */
+    buffer moved(std::move(buf));
+    if (moved.bytes().data() != data || moved.native() != native)
+        return 1;
+    if (buf.size() != 0 || buf.native() != nullptr || !buf.bytes().empty())
+        return 2;
+
+    buffers.push_back(std::move(moved));
+    buffers.emplace_back(8);
+    if (buffers[0].bytes().data() != data || buffers[0].size() != 16)
+        return 3;
+
+    /* copies are deep */
+    buffer copy = buffers[0].copy();
+    if (copy.bytes().data() == data || copy.size() != 16 || !copy.is_owner())
+        return 4;
+
+    return 0;
+}
+
+TEST_CASE(moved_from_buffer) {
+    buffer buf(16);
+    buffer moved(std::move(buf));
+    char data[] = "spam";
+    buffer view = buffer::view(data, 4);
+
+    /* a moved-from or released buffer cannot be resized, nor can a view */
+    try {
+        buf.resize(32);
+        return 1;
+    } catch (const error& ex) {
+        if (ex.code() != UB_EINVAL)
+            return 2;
+    }
+    try {
+        buf.reserve(32);
+        return 3;
+    } catch (const error& ex) {
+        if (ex.code() != UB_EINVAL)
+            return 4;
+    }
+    try {
+        view.resize(2);
+        return 5;
+    } catch (const error& ex) {
+        if (ex.code() != UB_EINVAL)
+            return 6;
+    }
+
+    ub_buffer_t c_buf = moved.release();
+    ub_buffer_destroy(&c_buf);
+    try {
+        moved.reserve(1);
+        return 7;
+    } catch (const error& ex) {
+        if (ex.code() != UB_EINVAL)
+            return 8;
+    }
+
+    /* copying a moved-from buffer gives an empty buffer */
+    buffer copy = buf.copy();
+    if (copy.size() != 0 || !copy.is_owner())
+        return 9;
+
+    return 0;
+}
+
+TEST_CASE(adopt_release) {
+    ub_buffer_t c_buf;
+    uint8_t* data;
+
+    ub_buffer_init(&c_buf, 4);
+    data = c_buf.bytes;
+
+    buffer buf = buffer::adopt(c_buf);
+    if (reinterpret_cast<const uint8_t*>(buf.bytes().data()) != data)
+        return 1;
+    if (c_buf.owner)
+        return 2;
+
+    c_buf = buf.release();
+    if (c_buf.bytes != data || !c_buf.owner || buf.native() != nullptr)
+        return 3;
+    ub_buffer_destroy(&c_buf);
+
+    return 0;
+}
+
+TEST_CASE(view) {
+    char data[] = "spam";
+    buffer buf = buffer::view(data, 4);
+
+    if (buf.is_owner() || buf.size() != 4)
+        return 1;
+    buf.mutable_bytes()[0] = std::byte('S');
+    if (std::strcmp(data, "Spam"))
+        return 2;
+
+    return 0;
+}
+
+TEST_CASE(writer) {
+    buffer buf;
+    buffer_writer writer(buf);
+
+    writer.write<std::uint16_t>(0x1234);
+    writer.write(-1.0f);
+    writer.write_string("ok");
+
+    /* moving the buffer and the writer must keep the writer usable */
+    buffer moved(std::move(buf));
+    buffer_writer moved_writer(std::move(writer));
+    moved_writer.write(true);
+
+    if (moved.size() != 10 || moved_writer.tell() != 10)
+        return 1;
+    if (std::memcmp(moved.bytes().data(), "\x12\x34\xBF\x80\x00\x00ok\x00\x01", 10))
+        return 2;
+
+    /* non-growing writers must not overflow the buffer */
+    buffer small(1);
+    buffer_writer small_writer(small, 0, false);
+    try {
+        small_writer.write<std::uint32_t>(1);
+        return 3;
+    } catch (const error& ex) {
+        if (ex.code() != UB_EINVAL)
+            return 4;
+    }
+
+    return 0;
+}
+
+TEST_CASE(move_column) {
+    log_column column("lat", UB_DATATYPE_FLOAT);
+    const char* name = column.name();
+
+    log_column moved(std::move(column));
+    if (moved.name() != name || column.name() != nullptr)
+        return 1;
+    if (moved.type() != UB_DATATYPE_FLOAT || moved.length() != 4)
+        return 2;
+
+    ub_log_column_t c_column = moved.release();
+    if (c_column.name != name || moved.name() != nullptr)
+        return 3;
+    ub_log_column_destroy(&c_column);
+
+    return 0;
+}
+
+START_OF_TESTS;
+RUN_TEST_CASE(move_buffer);
+RUN_TEST_CASE(moved_from_buffer);
+RUN_TEST_CASE(adopt_release);
+RUN_TEST_CASE(view);
+RUN_TEST_CASE(writer);
+RUN_TEST_CASE(move_column);
+NO_MORE_TEST_CASES;
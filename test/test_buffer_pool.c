@@ -0,0 +1,283 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <unibinlog/buffer_pool.h>
+#include <unibinlog/log_writer.h>
+#include <unibinlog/memory.h>
+#include "config.h"
+#include "common.c"
+
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
+
+#define NUM_THREADS 8
+#define NUM_ROUNDS 1000
+
+/* State of the counting allocator */
+typedef struct {
+    size_t allocations;
+    size_t live;
+} counter_t;
+
+static void* counting_malloc(size_t size, void* context) {
+    counter_t* counter = (counter_t*)context;
+
+    counter->allocations++;
+    counter->live++;
+    return malloc(size);
+}
+
+static void* counting_realloc(void* ptr, size_t size, void* context) {
+    counter_t* counter = (counter_t*)context;
+
+    counter->allocations++;
+    if (ptr == 0)
+        counter->live++;
+    return realloc(ptr, size);
+}
+
+static void counting_free(void* ptr, void* context) {
+    counter_t* counter = (counter_t*)context;
+
+    if (ptr != 0)
+        counter->live--;
+    free(ptr);
+}
+
+TEST_CASE(reuse) {
+    ub_buffer_pool_t pool;
+    ub_buffer_t buf;
+    uint8_t* bytes;
+    int retval = 0;
+
+    if (ub_buffer_pool_init(&pool, 0, 1000) != UB_EINVAL)
+        return 1;
+    if (ub_buffer_pool_init(&pool, 100, 100000))
+        return 2;
+
+    if (ub_buffer_pool_acquire(&pool, &buf))
+        return 3;
+    if (ub_buffer_size(&buf) != 0 || ub_buffer_capacity(&buf) < 100)
+        retval = 4;
+
+    /* the buffer keeps the capacity that it grew to */
+    if (!retval && ub_buffer_resize(&buf, 500))
+        retval = 5;
+    bytes = UB_BUFFER(buf);
+    ub_buffer_pool_release(&pool, &buf);
+    if (!retval && pool.idle_bytes < 500)
+        retval = 6;
+
+    if (!retval && ub_buffer_pool_acquire(&pool, &buf))
+        retval = 7;
+    if (!retval) {
+        if (UB_BUFFER(buf) != bytes || ub_buffer_size(&buf) != 0 ||
+                ub_buffer_capacity(&buf) < 500 || pool.idle_bytes != 0)
+            retval = 8;
+        ub_buffer_pool_release(&pool, &buf);
+    }
+
+    /* trimming frees the idle buffers */
+    ub_buffer_pool_trim(&pool);
+    if (!retval && pool.idle_bytes != 0)
+        retval = 9;
+
+    ub_buffer_pool_destroy(&pool);
+    return retval;
+}
+
+TEST_CASE(limit) {
+    ub_buffer_pool_t pool;
+    ub_buffer_t bufs[3];
+    size_t i;
+    int retval = 0;
+
+    if (ub_buffer_pool_init(&pool, 100, 250))
+        return 1;
+
+    for (i = 0; i < 3; i++) {
+        if (ub_buffer_pool_acquire(&pool, &bufs[i]))
+            return 2;
+    }
+
+    /* the third buffer does not fit into the pool and is freed */
+    for (i = 0; i < 3; i++)
+        ub_buffer_pool_release(&pool, &bufs[i]);
+    if (pool.idle_bytes != 200)
+        retval = 3;
+
+    /* buffers that are not owned are not kept */
+    bufs[0] = ub_buffer_view(bufs, sizeof(bufs));
+    ub_buffer_pool_release(&pool, &bufs[0]);
+    if (!retval && pool.idle_bytes != 200)
+        retval = 4;
+
+    ub_buffer_pool_destroy(&pool);
+    return retval;
+}
+
+TEST_CASE(no_pool) {
+    ub_buffer_t buf;
+
+    if (ub_buffer_pool_acquire(0, &buf))
+        return 1;
+    if (ub_buffer_size(&buf) != 0 ||
+            ub_buffer_capacity(&buf) != UB_BUFFER_POOL_BUFFER_SIZE) {
+        ub_buffer_destroy(&buf);
+        return 2;
+    }
+    ub_buffer_pool_release(0, &buf);
+
+    if (ub_buffer_pool_get_shared() == 0 ||
+            ub_buffer_pool_get_shared() != ub_buffer_pool_get_shared())
+        return 3;
+
+    return 0;
+}
+
+#ifdef HAVE_PTHREAD
+
+/* Takes buffers from the pool, fills them and gives them back */
+static void* use_pool(void* arg) {
+    ub_buffer_pool_t* pool = (ub_buffer_pool_t*)arg;
+    ub_buffer_t bufs[2];
+    size_t i, j;
+
+    for (i = 0; i < NUM_ROUNDS; i++) {
+        for (j = 0; j < 2; j++) {
+            if (ub_buffer_pool_acquire(pool, &bufs[j]) ||
+                    ub_buffer_resize(&bufs[j], 100 + (i + j) % 300))
+                return arg;
+            ub_buffer_fill(&bufs[j], (uint8_t)i);
+        }
+        for (j = 0; j < 2; j++)
+            ub_buffer_pool_release(pool, &bufs[j]);
+    }
+
+    return 0;
+}
+
+#endif
+
+TEST_CASE(threads) {
+#ifdef HAVE_PTHREAD
+    pthread_t threads[NUM_THREADS];
+    ub_buffer_pool_t pool;
+    ub_buffer_t buf;
+    void* result;
+    size_t i, idle_bytes;
+    int retval = 0;
+
+    if (ub_buffer_pool_init(&pool, 100, 4096))
+        return 1;
+
+    for (i = 0; i < NUM_THREADS; i++) {
+        if (pthread_create(&threads[i], 0, use_pool, &pool))
+            return 2;
+    }
+    for (i = 0; i < NUM_THREADS; i++) {
+        pthread_join(threads[i], &result);
+        if (result != 0)
+            retval = 3;
+    }
+
+    /* the caches of the threads were given back when they exited, so their
+     * buffers are shared with this thread now */
+    idle_bytes = pool.idle_bytes;
+    if (!retval && (idle_bytes == 0 || idle_bytes > 4096))
+        retval = 4;
+    if (!retval && ub_buffer_pool_acquire(&pool, &buf))
+        retval = 5;
+    if (!retval) {
+        if (pool.idle_bytes >= idle_bytes)
+            retval = 6;
+        ub_buffer_pool_release(&pool, &buf);
+    }
+
+    ub_buffer_pool_destroy(&pool);
+    return retval;
+#else
+    return 0;
+#endif
+}
+
+/* Writes the given number of rows with a log writer */
+static ub_error_t write_rows(ub_log_writer_t* writer, size_t num_rows) {
+    uint8_t row[5];
+    size_t i;
+
+    for (i = 0; i < num_rows; i++) {
+        row[0] = i >> 24;
+        row[1] = i >> 16;
+        row[2] = i >> 8;
+        row[3] = i & 0xFF;
+        row[4] = i % 2;
+        UB_CHECK(ub_log_writer_write_row(writer, row, 5));
+    }
+
+    return UB_SUCCESS;
+}
+
+TEST_CASE(writer_steady_state) {
+    counter_t counter = { 0, 0 };
+    ub_allocator_t allocator;
+    ub_log_column_t columns[2];
+    ub_log_writer_t writer;
+    size_t allocations = 0;
+    int retval = 0;
+    FILE* f;
+
+    allocator.malloc = counting_malloc;
+    allocator.calloc = 0;
+    allocator.realloc = counting_realloc;
+    allocator.free = counting_free;
+    allocator.context = &counter;
+    if (ub_memory_set_allocator(&allocator))
+        return 1;
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U32);
+    ub_log_column_init(&columns[1], "flag", UB_DATATYPE_BOOLEAN);
+
+    f = tmpfile();
+    if (f == 0 || ub_log_writer_init(&writer, f, columns, 2,
+                UB_CHKSUM_FLETCHER_16)) {
+        retval = 2;
+    } else {
+        if (ub_log_writer_set_block_length(&writer, 500) ||
+                ub_log_writer_set_codec(&writer, UB_CODEC_AUTO, 0))
+            retval = 3;
+
+        /* once the pool is warm, writing blocks does not allocate */
+        if (!retval && write_rows(&writer, 5000))
+            retval = 4;
+        allocations = counter.allocations;
+        if (!retval && write_rows(&writer, 50000))
+            retval = 5;
+        if (!retval && counter.allocations != allocations)
+            retval = 6;
+
+        if (!retval && ub_log_writer_close(&writer))
+            retval = 7;
+        ub_log_writer_destroy(&writer);
+    }
+    ub_log_column_destroy_array(columns, 2);
+    if (f != 0)
+        fclose(f);
+
+    /* the idle buffers of the shared pool are freed with the allocator that
+     * allocated them */
+    ub_memory_set_allocator(0);
+    if (!retval && (allocations == 0 || counter.live != 0))
+        retval = 8;
+
+    return retval;
+}
+
+START_OF_TESTS;
+RUN_TEST_CASE(reuse);
+RUN_TEST_CASE(limit);
+RUN_TEST_CASE(no_pool);
+RUN_TEST_CASE(threads);
+RUN_TEST_CASE(writer_steady_state);
+NO_MORE_TEST_CASES;
@@ -0,0 +1,218 @@
+#include <string.h>
+
+#include <unibinlog/byteorder.h>
+#include "config.h"
+#include "common.c"
+
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
+
+#define NUM_BYTES 520
+
+static void reference_swap(uint8_t* dest, const uint8_t* src, size_t length,
+        size_t width) {
+    size_t i, j;
+    for (i = 0; i < length; i += width)
+        for (j = 0; j < width; j++)
+            dest[i + j] = src[i + width - 1 - j];
+}
+
+/* Tests one kernel with all value widths, several lengths to exercise the
+ * scalar tails, an unaligned start and in-place conversion */
+static int test_kernel(void) {
+    uint8_t src[NUM_BYTES + 1], dest[NUM_BYTES + 1], expected[NUM_BYTES];
+    size_t width, count, i;
+
+    for (i = 0; i < sizeof(src); i++)
+        src[i] = i * 7 + 3;
+
+    for (width = 2; width <= 8; width *= 2) {
+        for (count = 0; count * width <= NUM_BYTES; count += 1 + count / 4) {
+            reference_swap(expected, src + 1, count * width, width);
+
+            memset(dest, 0, sizeof(dest));
+            if (width == 2)
+                ub_byteorder_swap16(dest + 1, src + 1, count);
+            else if (width == 4)
+                ub_byteorder_swap32(dest + 1, src + 1, count);
+            else
+                ub_byteorder_swap64(dest + 1, src + 1, count);
+
+            if (memcmp(dest + 1, expected, count * width))
+                return 1;
+            if (dest[0] != 0 || (count * width < NUM_BYTES &&
+                        dest[count * width + 1] != 0))
+                return 2;
+
+            memcpy(dest, src, sizeof(src));
+            if (width == 2)
+                ub_byteorder_swap16(dest + 1, dest + 1, count);
+            else if (width == 4)
+                ub_byteorder_swap32(dest + 1, dest + 1, count);
+            else
+                ub_byteorder_swap64(dest + 1, dest + 1, count);
+
+            if (memcmp(dest + 1, expected, count * width))
+                return 3;
+        }
+    }
+
+    return 0;
+}
+
+TEST_CASE(kernels) {
+    ub_byteorder_kernel_t kernel;
+    int retval, num_tested = 0;
+
+    if (ub_byteorder_get_kernel() == UB_BYTEORDER_KERNEL_AUTO)
+        return 1;
+
+    for (kernel = UB_BYTEORDER_KERNEL_SCALAR; kernel < UB_MAX_BYTEORDER_KERNEL;
+            kernel++) {
+        if (ub_byteorder_set_kernel(kernel) != UB_SUCCESS)
+            continue;
+
+        if (ub_byteorder_get_kernel() != kernel)
+            return 2;
+
+        retval = test_kernel();
+        if (retval) {
+            fprintf(stderr, "kernel %d failed\n", (int)kernel);
+            return 10 * kernel + retval;
+        }
+
+        num_tested++;
+    }
+
+    if (ub_byteorder_set_kernel(UB_BYTEORDER_KERNEL_AUTO) || num_tested == 0)
+        return 3;
+    if (ub_byteorder_set_kernel(UB_MAX_BYTEORDER_KERNEL) != UB_EUNSUPPORTED)
+        return 4;
+
+    return 0;
+}
+
+#ifdef HAVE_PTHREAD
+
+#define NUM_THREADS 4
+
+/* Swaps values with whichever kernel is selected and checks the results */
+static void* swap_values(void* arg) {
+    uint8_t src[NUM_BYTES], dest[NUM_BYTES], expected[NUM_BYTES];
+    size_t i;
+
+    for (i = 0; i < NUM_BYTES; i++)
+        src[i] = (uint8_t)(i * 7);
+    reference_swap(expected, src, NUM_BYTES, 4);
+
+    for (i = 0; i < 1000; i++) {
+        ub_byteorder_swap32(dest, src, NUM_BYTES / 4);
+        if (memcmp(dest, expected, NUM_BYTES))
+            return arg;
+    }
+
+    return 0;
+}
+
+#endif
+
+TEST_CASE(threads) {
+#ifdef HAVE_PTHREAD
+    pthread_t threads[NUM_THREADS];
+    ub_byteorder_kernel_t kernel;
+    void* result;
+    size_t i;
+    int retval = 0;
+
+    /* the kernel is selected by the first thread that needs it */
+    for (i = 0; i < NUM_THREADS; i++) {
+        if (pthread_create(&threads[i], 0, swap_values, &retval))
+            return 1;
+    }
+
+    /* and may be overridden while the threads are swapping */
+    for (i = 0; i < 100; i++) {
+        kernel = i % 2 ? UB_BYTEORDER_KERNEL_SCALAR : UB_BYTEORDER_KERNEL_AUTO;
+        if (ub_byteorder_set_kernel(kernel))
+            retval = 2;
+    }
+
+    for (i = 0; i < NUM_THREADS; i++) {
+        pthread_join(threads[i], &result);
+        if (result != 0 && !retval)
+            retval = 3;
+    }
+
+    if (!retval && ub_byteorder_get_kernel() == UB_BYTEORDER_KERNEL_AUTO)
+        retval = 4;
+
+    return retval;
+#else
+    return 0;
+#endif
+}
+
+TEST_CASE(decode_column) {
+    const uint8_t u16s[] = { 0x12, 0x34, 0xFF, 0xFE };
+    const uint8_t doubles[] = {
+        0x3F, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,   /* 1.5 */
+        0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00    /* -2.0 */
+    };
+    uint16_t u16_values[2];
+    int16_t s16_values[2];
+    double double_values[2];
+    uint8_t encoded[16];
+    char chars[3];
+
+    if (ub_byteorder_decode_column(UB_DATATYPE_U16, UB_BIG_ENDIAN,
+                u16_values, u16s, 2) ||
+            u16_values[0] != 0x1234 || u16_values[1] != 0xFFFE)
+        return 1;
+
+    if (ub_byteorder_decode_column(UB_DATATYPE_S16, UB_BIG_ENDIAN,
+                s16_values, u16s, 2) ||
+            s16_values[1] != -2)
+        return 2;
+
+    if (ub_byteorder_decode_column(UB_DATATYPE_DOUBLE, UB_BIG_ENDIAN,
+                double_values, doubles, 2) ||
+            double_values[0] != 1.5 || double_values[1] != -2.0)
+        return 3;
+
+    if (ub_byteorder_encode_column(UB_DATATYPE_DOUBLE, UB_BIG_ENDIAN,
+                encoded, double_values, 2) ||
+            memcmp(encoded, doubles, sizeof(doubles)))
+        return 4;
+
+    if (ub_byteorder_decode_column(UB_DATATYPE_CHAR, UB_BIG_ENDIAN,
+                chars, "abc", 3) ||
+            memcmp(chars, "abc", 3))
+        return 5;
+
+    /* values already in the requested byte order are copied as they are */
+    if (ub_byteorder_decode_column(UB_DATATYPE_U16, ub_byteorder_native(),
+                u16_values, u16s, 2) || memcmp(u16_values, u16s, 4))
+        return 8;
+
+    if (ub_byteorder_decode_column(UB_DATATYPE_STRING, UB_BIG_ENDIAN,
+                chars, "abc", 1) != UB_EUNSUPPORTED)
+        return 6;
+    if (ub_byteorder_decode_column(UB_DATATYPE_TIMEVAL, UB_BIG_ENDIAN,
+                encoded, doubles, 1) != UB_EUNSUPPORTED)
+        return 7;
+
+    if (!ub_byteorder_supports_type(UB_DATATYPE_U16, UB_LITTLE_ENDIAN) ||
+            !ub_byteorder_supports_type(UB_DATATYPE_DOUBLE, UB_BIG_ENDIAN) ||
+            ub_byteorder_supports_type(UB_DATATYPE_STRING, UB_BIG_ENDIAN) ||
+            ub_byteorder_supports_type(UB_DATATYPE_TIMEVAL, UB_BIG_ENDIAN))
+        return 9;
+
+    return 0;
+}
+
+START_OF_TESTS;
+RUN_TEST_CASE(kernels);
+RUN_TEST_CASE(threads);
+RUN_TEST_CASE(decode_column);
+NO_MORE_TEST_CASES;
@@ -0,0 +1,185 @@
+#include <string.h>
+
+#include <unibinlog/codec.h>
+#include "common.c"
+
+static int roundtrip(ub_codec_t codec, ub_datatype_t type, const void* values,
+        size_t num_values, size_t expected_size) {
+    ub_buffer_t buffer;
+    ub_buffer_writer_t writer;
+    uint8_t decoded[64];
+    size_t width = ub_datatype_get_info(type).length;
+    int retval = 0;
+
+    ub_buffer_init(&buffer, 0);
+    ub_buffer_writer_init(&writer, &buffer, 0, /* grow = */ 1);
+
+    if (ub_codec_encode(codec, type, values, num_values, &writer) != UB_SUCCESS)
+        retval = 1;
+    else if (ub_buffer_writer_tell(&writer) != expected_size)
+        retval = 2;
+    else if (ub_codec_decode(codec, type, UB_BUFFER(buffer), expected_size,
+                num_values, decoded) != UB_SUCCESS)
+        retval = 3;
+    else if (memcmp(decoded, values, width * num_values))
+        retval = 4;
+    else if (expected_size > 0 && ub_codec_decode(codec, type, UB_BUFFER(buffer),
+                expected_size - 1, num_values, decoded) != UB_EPARSE) {
+        /* truncated input must be detected */
+        retval = 5;
+    }
+
+    ub_buffer_writer_destroy(&writer);
+    ub_buffer_destroy(&buffer);
+
+    return retval;
+}
+
+TEST_CASE(supports) {
+    if (!ub_codec_supports(UB_CODEC_RAW, UB_DATATYPE_DOUBLE))
+        return 1;
+    if (!ub_codec_supports(UB_CODEC_RLE, UB_DATATYPE_TIMEVAL))
+        return 2;
+    if (!ub_codec_supports(UB_CODEC_DELTA, UB_DATATYPE_S16))
+        return 3;
+    if (ub_codec_supports(UB_CODEC_DELTA, UB_DATATYPE_FLOAT))
+        return 4;
+    if (ub_codec_supports(UB_CODEC_RAW, UB_DATATYPE_STRING))
+        return 5;
+    if (ub_codec_supports(UB_CODEC_AUTO, UB_DATATYPE_U8))
+        return 6;
+    return 0;
+}
+
+TEST_CASE(raw) {
+    const uint8_t values[] = { 0x00, 0x01, 0x00, 0x02, 0x00, 0x03 };
+    return roundtrip(UB_CODEC_RAW, UB_DATATYPE_U16, values, 3, 6);
+}
+
+TEST_CASE(delta) {
+    /* 1000, 1001, 999, 999 as big-endian 32-bit integers */
+    const uint8_t values[] = {
+        0x00, 0x00, 0x03, 0xE8, 0x00, 0x00, 0x03, 0xE9,
+        0x00, 0x00, 0x03, 0xE7, 0x00, 0x00, 0x03, 0xE7
+    };
+    /* -1, 1, -128 as big-endian signed 8-bit integers */
+    const uint8_t small_values[] = { 0xFF, 0x01, 0x80 };
+    int retval;
+
+    retval = roundtrip(UB_CODEC_DELTA, UB_DATATYPE_U32, values, 4, 7);
+    if (retval)
+        return retval;
+
+    retval = roundtrip(UB_CODEC_DELTA, UB_DATATYPE_S8, small_values, 3, 4);
+    if (retval)
+        return 10 + retval;
+
+    if (roundtrip(UB_CODEC_DELTA, UB_DATATYPE_DOUBLE, values, 2, 0) != 1)
+        return 20;
+
+    return 0;
+}
+
+TEST_CASE(rle) {
+    const uint8_t values[] = { 0x00, 0x07, 0x00, 0x07, 0x00, 0x07, 0x01, 0x00 };
+    return roundtrip(UB_CODEC_RLE, UB_DATATYPE_U16, values, 4, 6);
+}
+
+TEST_CASE(select) {
+    const uint8_t constant[] = { 5, 5, 5, 5, 5, 5, 5, 5 };
+    const uint8_t ramp[] = {
+        0x00, 0x10, 0x00, 0x11, 0x00, 0x12, 0x00, 0x13,
+        0x00, 0x14, 0x00, 0x15, 0x00, 0x16, 0x00, 0x17
+    };
+    const uint8_t noise[] = { 0x3A, 0x91, 0x07, 0xE2 };
+    const uint8_t mixed[] = { 7, 7, 7, 7, 1, 9, 3, 250 };
+
+    if (ub_codec_select(UB_DATATYPE_U8, constant, 8, 0) != UB_CODEC_RLE)
+        return 1;
+    if (ub_codec_select(UB_DATATYPE_U16, ramp, 8, 0) != UB_CODEC_DELTA)
+        return 2;
+    if (ub_codec_select(UB_DATATYPE_U8, noise, 4, 0) != UB_CODEC_RAW)
+        return 3;
+    if (ub_codec_select(UB_DATATYPE_STRING, noise, 4, 0) != UB_CODEC_RAW)
+        return 4;
+
+    /* only the sample is taken into account */
+    if (ub_codec_select(UB_DATATYPE_U8, mixed, 8, 0) != UB_CODEC_RAW)
+        return 5;
+    if (ub_codec_select(UB_DATATYPE_U8, mixed, 8, 4) != UB_CODEC_RLE)
+        return 6;
+
+    return 0;
+}
+
+TEST_CASE(log_entries) {
+    ub_log_column_t columns[3];
+    ub_buffer_t payload, rows;
+    uint8_t data[10 * 7];
+    ub_codec_t codecs[] = {
+        UB_CODEC_RAW, UB_CODEC_DELTA, UB_CODEC_RLE, UB_CODEC_AUTO
+    };
+    size_t i, num_rows;
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U32);
+    ub_log_column_init(&columns[1], "flag", UB_DATATYPE_BOOLEAN);
+    ub_log_column_init(&columns[2], "noise", UB_DATATYPE_U16);
+
+    for (i = 0; i < 10; i++) {
+        data[i*7+0] = 0; data[i*7+1] = 0; data[i*7+2] = 1; data[i*7+3] = i;
+        data[i*7+4] = 1;
+        data[i*7+5] = i * 37; data[i*7+6] = i * 91;
+    }
+
+    ub_buffer_init(&payload, 0);
+    ub_buffer_init(&rows, 0);
+
+    for (i = 0; i < sizeof(codecs) / sizeof(codecs[0]); i++) {
+        if (ub_codec_encode_log_entries(columns, 3, data, 10, codecs[i], 4,
+                    &payload) != UB_SUCCESS)
+            return 1;
+        if (ub_codec_decode_log_entries(columns, 3, UB_BUFFER(payload),
+                    ub_buffer_size(&payload), &rows, &num_rows) != UB_SUCCESS)
+            return 2;
+        if (num_rows != 10 || ub_buffer_size(&rows) != sizeof(data))
+            return 3;
+        if (memcmp(UB_BUFFER(rows), data, sizeof(data)))
+            return 4;
+        if (ub_codec_decode_log_entries(columns, 3, UB_BUFFER(payload),
+                    ub_buffer_size(&payload) - 1, &rows, 0) != UB_EPARSE)
+            return 5;
+    }
+
+    /* automatic selection must pick delta, RLE and raw for the columns */
+    if (ub_buffer_size(&payload) != 2 + (3+13) + (3+2) + (3+20))
+        return 6;
+    if (UB_BUFFER(payload)[2] != UB_CODEC_DELTA ||
+            UB_BUFFER(payload)[2+3+13] != UB_CODEC_RLE ||
+            UB_BUFFER(payload)[2+3+13+3+2] != UB_CODEC_RAW)
+        return 7;
+
+    /* a column that grows when delta-encoded is stored raw */
+    if (ub_codec_encode_log_entries(columns, 3, data, 10, UB_CODEC_DELTA, 0,
+                &payload) != UB_SUCCESS)
+        return 8;
+    i = ub_buffer_size(&payload) - (3+20);
+    if (UB_BUFFER(payload)[i] != UB_CODEC_RAW ||
+            UB_BUFFER(payload)[i+1] != 0 || UB_BUFFER(payload)[i+2] != 20 ||
+            memcmp(UB_BUFFER(payload) + 2, "\x01\x00\x0d", 3))
+        return 9;
+
+    ub_buffer_destroy(&payload);
+    ub_buffer_destroy(&rows);
+    ub_log_column_destroy_array(columns, 3);
+
+    return 0;
+}
+
+START_OF_TESTS;
+RUN_TEST_CASE(supports);
+RUN_TEST_CASE(raw);
+RUN_TEST_CASE(delta);
+RUN_TEST_CASE(rle);
+RUN_TEST_CASE(select);
+RUN_TEST_CASE(log_entries);
+NO_MORE_TEST_CASES;
@@ -0,0 +1,289 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <unibinlog/dataset.h>
+#include "common.c"
+
+#define NUM_ROWS 3000
+#define TIME_STEP 7
+#define PARTITION_LENGTH 1000
+
+/* Summary of the rows of a chunk: the timestamps must come in order */
+typedef struct {
+    size_t num_rows;
+    long first;
+    long last;
+    int ordered;
+} summary_t;
+
+static void make_row(uint8_t* row, uint32_t timestamp) {
+    row[0] = timestamp >> 24;
+    row[1] = (timestamp >> 16) & 0xFF;
+    row[2] = (timestamp >> 8) & 0xFF;
+    row[3] = timestamp & 0xFF;
+    row[4] = (timestamp / TIME_STEP) % 2;
+}
+
+/* Writes the rows with the given numbers into the dataset in the given
+ * directory */
+static ub_error_t write_rows(const char* dir, size_t first, size_t last,
+        uint64_t partition_length) {
+    ub_log_column_t columns[2];
+    ub_dataset_writer_t writer;
+    ub_error_t retval;
+    uint8_t row[5];
+    size_t i;
+
+    ub_log_column_init(&columns[0], "time", UB_DATATYPE_U32);
+    ub_log_column_init(&columns[1], "flag", UB_DATATYPE_BOOLEAN);
+
+    retval = ub_dataset_writer_init(&writer, dir, columns, 2,
+            UB_CHKSUM_FLETCHER_16, 0, partition_length);
+    if (retval == UB_SUCCESS) {
+        for (i = first; i < last && retval == UB_SUCCESS; i++) {
+            make_row(row, i * TIME_STEP);
+            retval = ub_dataset_writer_write_row(&writer, row, 5);
+        }
+
+        /* timestamps must not decrease */
+        make_row(row, 0);
+        if (retval == UB_SUCCESS && last > 0 &&
+                ub_dataset_writer_write_row(&writer, row, 5) != UB_EINVAL)
+            retval = UB_FAILURE;
+
+        if (retval == UB_SUCCESS)
+            retval = ub_dataset_writer_close(&writer);
+        ub_dataset_writer_destroy(&writer);
+    }
+
+    ub_log_column_destroy_array(columns, 2);
+    return retval;
+}
+
+/* Removes the files of the dataset and the directory */
+static void remove_dataset(const char* dir) {
+    char path[256];
+    size_t i;
+
+    for (i = 0; i < 64; i++) {
+        sprintf(path, "%s/chunk-%06lu.ubl", dir, (unsigned long)i);
+        remove(path);
+    }
+    sprintf(path, "%s/MANIFEST", dir);
+    remove(path);
+    rmdir(dir);
+}
+
+static ub_error_t summarize_block(const ub_scan_block_t* block, void* state) {
+    summary_t* summary = (summary_t*)state;
+    const uint8_t* row;
+    size_t i;
+    long timestamp;
+
+    if (block->row_length != 5)
+        return UB_EINVAL;
+
+    for (i = 0, row = block->rows; i < block->num_rows; i++, row += 5) {
+        timestamp = ((long)row[0] << 24) | (row[1] << 16) | (row[2] << 8) |
+            row[3];
+        if (row[4] != (timestamp / TIME_STEP) % 2)
+            return UB_EPARSE;
+        if (summary->num_rows > 0 && timestamp != summary->last + TIME_STEP)
+            summary->ordered = 0;
+        if (summary->num_rows == 0)
+            summary->first = timestamp;
+        summary->last = timestamp;
+        summary->num_rows++;
+    }
+
+    return UB_SUCCESS;
+}
+
+static ub_error_t merge_summaries(void* state, const void* other) {
+    summary_t* summary = (summary_t*)state;
+    const summary_t* next = (const summary_t*)other;
+
+    if (next->num_rows == 0)
+        return UB_SUCCESS;
+
+    if (!next->ordered || (summary->num_rows > 0 &&
+                next->first != summary->last + TIME_STEP))
+        summary->ordered = 0;
+    if (summary->num_rows == 0)
+        summary->first = next->first;
+    summary->last = next->last;
+    summary->num_rows += next->num_rows;
+
+    return UB_SUCCESS;
+}
+
+/* Scans the chunks that may hold the given time interval and checks that
+ * they hold the rows from the start of the first partition to the end of
+ * the last one */
+static int query(const ub_dataset_t* dataset, int64_t begin, int64_t end) {
+    static summary_t states[64];
+    size_t i, first, count;
+    long expected_first, expected_last;
+
+    if (ub_dataset_select(dataset, begin, end, &first, &count))
+        return 1;
+
+    expected_first = (begin / PARTITION_LENGTH) * PARTITION_LENGTH;
+    expected_first += (TIME_STEP - expected_first % TIME_STEP) % TIME_STEP;
+    expected_last = (end / PARTITION_LENGTH + 1) * PARTITION_LENGTH - 1;
+    expected_last -= expected_last % TIME_STEP;
+    /* a partition may be split between chunks */
+    if (count < (size_t)(end / PARTITION_LENGTH - begin / PARTITION_LENGTH + 1))
+        return 2;
+
+    for (i = 0; i < count; i++) {
+        memset(&states[i], 0, sizeof(summary_t));
+        states[i].ordered = 1;
+    }
+
+    if (ub_dataset_scan(dataset, first, count, summarize_block, states,
+                sizeof(summary_t), merge_summaries))
+        return 3;
+    if (!states[0].ordered || states[0].first != expected_first ||
+            states[0].last != expected_last ||
+            states[0].num_rows != (size_t)(expected_last - expected_first) /
+            TIME_STEP + 1)
+        return 4;
+
+    return 0;
+}
+
+TEST_CASE(write_and_query) {
+    char dir[] = "/tmp/unibinlog-dataset-XXXXXX";
+    ub_dataset_t dataset;
+    uint64_t num_rows = 0;
+    size_t i, first, count;
+    int retval = 0;
+
+    if (mkdtemp(dir) == 0)
+        return 1;
+
+    if (write_rows(dir, 0, NUM_ROWS, PARTITION_LENGTH)) {
+        remove_dataset(dir);
+        return 2;
+    }
+
+    if (ub_dataset_open(&dataset, dir)) {
+        remove_dataset(dir);
+        return 3;
+    }
+
+    /* one chunk per partition, in order */
+    if (dataset.num_chunks != (NUM_ROWS * TIME_STEP - 1) / PARTITION_LENGTH + 1 ||
+            dataset.timestamp_column != 0 ||
+            dataset.partition_length != PARTITION_LENGTH)
+        retval = 4;
+    for (i = 0; i < dataset.num_chunks && !retval; i++) {
+        if (dataset.chunks[i].sequence != i ||
+                dataset.chunks[i].first_timestamp / PARTITION_LENGTH != (int64_t)i ||
+                dataset.chunks[i].last_timestamp / PARTITION_LENGTH != (int64_t)i ||
+                dataset.chunks[i].schema_id != dataset.chunks[0].schema_id)
+            retval = 5;
+        num_rows += dataset.chunks[i].num_rows;
+    }
+    if (!retval && num_rows != NUM_ROWS)
+        retval = 6;
+
+    /* queries on one and four threads */
+    for (i = 1; i <= 4 && !retval; i += 3) {
+        ub_dataset_set_num_threads(&dataset, i);
+        retval = query(&dataset, 2500, 5499);
+        if (!retval)
+            retval = query(&dataset, 0, 20999);
+        if (!retval)
+            retval = query(&dataset, 7000, 7000);
+        if (retval)
+            retval += 10 * i;
+    }
+
+    /* intervals outside the dataset select nothing */
+    if (!retval && (ub_dataset_select(&dataset, -100, -1, &first, &count) ||
+                count != 0 || ub_dataset_select(&dataset, 30000, 40000,
+                    &first, &count) || count != 0))
+        retval = 50;
+    if (!retval && ub_dataset_scan(&dataset, dataset.num_chunks, 1,
+                summarize_block, 0, 0, 0) != UB_EINVAL)
+        retval = 51;
+
+    ub_dataset_destroy(&dataset);
+    remove_dataset(dir);
+
+    return retval;
+}
+
+TEST_CASE(append_and_remove) {
+    char dir[] = "/tmp/unibinlog-dataset-XXXXXX";
+    char path[256];
+    ub_dataset_t dataset;
+    int retval = 0;
+    FILE* f;
+
+    if (mkdtemp(dir) == 0)
+        return 1;
+
+    /* the second writer continues after the chunks of the first one */
+    if (write_rows(dir, 0, NUM_ROWS / 2, PARTITION_LENGTH) ||
+            write_rows(dir, NUM_ROWS / 2, NUM_ROWS, PARTITION_LENGTH))
+        retval = 2;
+    else if (write_rows(dir, NUM_ROWS, NUM_ROWS + 1, PARTITION_LENGTH / 2) !=
+            UB_EINVAL)
+        retval = 3;
+    else if (ub_dataset_open(&dataset, dir))
+        retval = 4;
+    if (retval) {
+        remove_dataset(dir);
+        return retval;
+    }
+
+    /* the partition in the middle was split between the writers */
+    if (dataset.num_chunks != (NUM_ROWS * TIME_STEP - 1) / PARTITION_LENGTH + 2 ||
+            dataset.chunks[dataset.num_chunks - 1].sequence !=
+            dataset.num_chunks - 1)
+        retval = 5;
+    if (!retval) {
+        ub_dataset_set_num_threads(&dataset, 3);
+        retval = query(&dataset, 0, 20999);
+        if (retval)
+            retval += 10;
+    }
+
+    /* retention drops whole chunks */
+    if (!retval && ub_dataset_remove_before(&dataset, 5000))
+        retval = 20;
+    if (!retval && (dataset.num_chunks != 17 ||
+                dataset.chunks[0].first_timestamp != 5005))
+        retval = 21;
+    if (!retval) {
+        sprintf(path, "%s/chunk-%06lu.ubl", dir, 4UL);
+        f = fopen(path, "rb");
+        if (f != 0) {
+            fclose(f);
+            retval = 22;
+        }
+    }
+
+    ub_dataset_destroy(&dataset);
+
+    if (!retval && ub_dataset_open(&dataset, dir))
+        retval = 23;
+    if (!retval) {
+        if (dataset.num_chunks != 17 || dataset.chunks[0].sequence != 5 ||
+                query(&dataset, 5000, 20999))
+            retval = 24;
+        ub_dataset_destroy(&dataset);
+    }
+
+    remove_dataset(dir);
+    return retval;
+}
+
+START_OF_TESTS;
+RUN_TEST_CASE(write_and_query);
+RUN_TEST_CASE(append_and_remove);
+NO_MORE_TEST_CASES;
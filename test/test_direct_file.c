@@ -0,0 +1,259 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <unibinlog/direct_file.h>
+#include <unibinlog/log_writer.h>
+#include "common.c"
+
+#define NUM_ROWS 20000
+#define MAX_LENGTH 262144
+
+/* Writes a log with an index into the given stream, syncing the direct
+ * file through the writer and every sync_interval rows if it is given */
+static ub_error_t write_log(FILE* f, ub_direct_file_t* file,
+        size_t sync_interval) {
+    ub_log_column_t columns[2];
+    ub_log_writer_t writer;
+    ub_error_t retval;
+    uint8_t row[3];
+    size_t i;
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "flag", UB_DATATYPE_BOOLEAN);
+
+    retval = ub_log_writer_init(&writer, f, columns, 2, UB_CHKSUM_FLETCHER_16);
+    if (retval == UB_SUCCESS) {
+        retval = ub_log_writer_set_block_length(&writer, 300);
+        if (retval == UB_SUCCESS)
+            retval = ub_log_writer_set_index(&writer, 1);
+
+        /* the stream has no file descriptor to sync */
+        if (retval == UB_SUCCESS && file &&
+                ub_log_writer_sync(&writer) != UB_EUNSUPPORTED)
+            retval = UB_FAILURE;
+        if (retval == UB_SUCCESS && file)
+            retval = ub_direct_file_attach(file, &writer);
+        if (retval == UB_SUCCESS && file)
+            retval = ub_log_writer_set_durability(&writer,
+                    UB_DURABILITY_BLOCK_COUNT, 8);
+
+        for (i = 0; i < NUM_ROWS && retval == UB_SUCCESS; i++) {
+            row[0] = i >> 8;
+            row[1] = i & 0xFF;
+            row[2] = i % 2;
+            retval = ub_log_writer_write_row(&writer, row, 3);
+            if (retval == UB_SUCCESS && file && (i + 1) % sync_interval == 0)
+                retval = ub_direct_file_sync(file);
+        }
+
+        if (retval == UB_SUCCESS)
+            retval = ub_log_writer_close(&writer);
+        ub_log_writer_destroy(&writer);
+    }
+
+    ub_log_column_destroy_array(columns, 2);
+    return retval;
+}
+
+/* Reads the file with the given path into the buffer and removes it */
+static size_t read_file(const char* path, uint8_t* buffer, size_t size) {
+    size_t length;
+    FILE* f;
+
+    f = fopen(path, "rb");
+    if (f == 0)
+        return 0;
+
+    length = fread(buffer, 1, size, f);
+    fclose(f);
+    remove(path);
+
+    return length;
+}
+
+/* Writes the log through a direct file and compares it to the log written
+ * by plain stdio */
+static int write_through_direct_file(size_t buffer_size, ub_bool_t direct,
+        size_t sync_interval) {
+    static uint8_t expected[MAX_LENGTH], actual[MAX_LENGTH];
+    char path[] = "/tmp/unibinlog-direct-XXXXXX";
+    ub_direct_file_t file;
+    size_t expected_length, actual_length;
+    int fd, retval = 0;
+    FILE* f;
+
+    f = tmpfile();
+    if (f == 0 || write_log(f, 0, 0))
+        return 1;
+    fflush(f);
+    rewind(f);
+    expected_length = fread(expected, 1, MAX_LENGTH, f);
+    fclose(f);
+
+    fd = mkstemp(path);
+    if (fd < 0)
+        return 2;
+
+    if (ub_direct_file_init(&file, fd, buffer_size, direct)) {
+        close(fd);
+        remove(path);
+        return 3;
+    }
+
+    if ((!direct && file.direct) || file.buffer_size % file.alignment != 0 ||
+            file.buffer_size < buffer_size)
+        retval = 4;
+    else if (write_log(file.file, &file, sync_interval))
+        retval = 5;
+    else if (ub_direct_file_sync(&file))
+        retval = 6;
+    else if (ub_direct_file_close(&file))
+        retval = 7;
+    ub_direct_file_destroy(&file);
+
+    actual_length = read_file(path, actual, MAX_LENGTH);
+    if (!retval && (actual_length != expected_length ||
+                memcmp(actual, expected, expected_length)))
+        retval = 8;
+
+    return retval;
+}
+
+TEST_CASE(write_direct) {
+    if (write_through_direct_file(4096, 1, NUM_ROWS))
+        return 1;
+    if (write_through_direct_file(1000, 1, NUM_ROWS))
+        return 2;
+    if (write_through_direct_file(100000, 1, NUM_ROWS))
+        return 3;
+
+    /* syncing pads the last block, which the next writes complete */
+    if (write_through_direct_file(8192, 1, 777))
+        return 4;
+
+    return 0;
+}
+
+TEST_CASE(write_buffered) {
+    if (write_through_direct_file(4096, 0, NUM_ROWS))
+        return 1;
+    if (write_through_direct_file(4096, 0, 1000))
+        return 2;
+
+    return 0;
+}
+
+TEST_CASE(seek) {
+    char path[] = "/tmp/unibinlog-direct-XXXXXX";
+    uint8_t contents[8192];
+    ub_direct_file_t file;
+    int fd, retval = 0;
+
+    fd = mkstemp(path);
+    if (fd < 0)
+        return 1;
+
+    if (ub_direct_file_init(&file, fd, 4096, 1)) {
+        close(fd);
+        remove(path);
+        return 2;
+    }
+
+    /* seeking back rewrites; seeking to the end appends */
+    if (fputs("abcdefghij", file.file) < 0 || ftell(file.file) != 10)
+        retval = 3;
+    else if (fseek(file.file, 2, SEEK_SET) || fputs("XY", file.file) < 0 ||
+            ftell(file.file) != 4)
+        retval = 4;
+    else if (fseek(file.file, 0, SEEK_END) || ftell(file.file) != 10 ||
+            fputs("k", file.file) < 0)
+        retval = 5;
+    else if (ub_direct_file_close(&file))
+        retval = 6;
+    ub_direct_file_destroy(&file);
+
+    if (!retval && (read_file(path, contents, sizeof(contents)) != 11 ||
+                memcmp(contents, "abXYefghijk", 11)))
+        retval = 7;
+    remove(path);
+
+    return retval;
+}
+
+TEST_CASE(overwrite) {
+    char path[] = "/tmp/unibinlog-direct-XXXXXX";
+    static uint8_t contents[10000], expected[10000];
+    ub_direct_file_t file;
+    int fd, retval = 0;
+    size_t i;
+
+    for (i = 0; i < sizeof(expected); i++)
+        expected[i] = 'a' + i % 26;
+
+    fd = mkstemp(path);
+    if (fd < 0)
+        return 1;
+    if (write(fd, expected, sizeof(expected)) != sizeof(expected) ||
+            lseek(fd, 4000, SEEK_SET) != 4000) {
+        close(fd);
+        remove(path);
+        return 2;
+    }
+
+    /* the bytes around the overwritten ones stay, even within the blocks
+     * that are written */
+    if (ub_direct_file_init(&file, fd, 4096, 1)) {
+        close(fd);
+        remove(path);
+        return 3;
+    }
+
+    memset(expected + 4000, 'X', 300);
+    memset(expected + 9000, 'Y', 10);
+    if (fwrite(expected + 4000, 1, 300, file.file) != 300)
+        retval = 4;
+    else if (fseek(file.file, 9000, SEEK_SET) ||
+            fwrite(expected + 9000, 1, 10, file.file) != 10)
+        retval = 5;
+    else if (ub_direct_file_close(&file))
+        retval = 6;
+    ub_direct_file_destroy(&file);
+
+    if (!retval && (read_file(path, contents, sizeof(contents)) !=
+                sizeof(expected) || memcmp(contents, expected, sizeof(expected))))
+        retval = 7;
+    remove(path);
+
+    return retval;
+}
+
+TEST_CASE(invalid_arguments) {
+    char path[] = "/tmp/unibinlog-direct-XXXXXX";
+    ub_direct_file_t file;
+    int fd, retval = 0;
+
+    fd = mkstemp(path);
+    if (fd < 0)
+        return 1;
+
+    if (ub_direct_file_init(&file, fd, 0, 1) != UB_EINVAL)
+        retval = 2;
+    else if (fcntl(fd, F_SETFL, O_APPEND) ||
+            ub_direct_file_init(&file, fd, 4096, 1) != UB_EINVAL)
+        retval = 3;
+
+    close(fd);
+    remove(path);
+
+    return retval;
+}
+
+START_OF_TESTS;
+RUN_TEST_CASE(write_direct);
+RUN_TEST_CASE(write_buffered);
+RUN_TEST_CASE(seek);
+RUN_TEST_CASE(overwrite);
+RUN_TEST_CASE(invalid_arguments);
+NO_MORE_TEST_CASES;
@@ -45,6 +45,44 @@ TEST_CASE(get_length) {
 	return 0;
 }
 
+TEST_CASE(get_layout) {
+	ub_log_column_t columns[5];
+	size_t offsets[5];
+	int i;
+
+	ub_log_column_init(&columns[0], 0, UB_DATATYPE_U8);
+	ub_log_column_init(&columns[1], 0, UB_DATATYPE_DOUBLE);
+	ub_log_column_init(&columns[2], 0, UB_DATATYPE_S16);
+	ub_log_column_init(&columns[3], 0, UB_DATATYPE_TIMEVAL);
+	ub_log_column_init(&columns[4], 0, UB_DATATYPE_STRING);
+
+	/* packed layout */
+	if (ub_log_columns_get_layout(columns, 4, 0, offsets) != 19)
+		return 1;
+	if (offsets[0] != 0 || offsets[1] != 1 || offsets[2] != 9 ||
+			offsets[3] != 11)
+		return 2;
+
+	/* aligned layout; the row is padded to a multiple of 8 bytes */
+	if (ub_log_columns_get_layout(columns, 4, 1, offsets) != 32)
+		return 3;
+	if (offsets[0] != 0 || offsets[1] != 8 || offsets[2] != 16 ||
+			offsets[3] != 20)
+		return 4;
+	if (ub_log_columns_get_layout(columns + 2, 1, 1, 0) != 2)
+		return 5;
+
+	/* variable-length rows have no layout */
+	if (ub_log_columns_get_layout(columns, 5, 1, offsets) != 0)
+		return 6;
+
+	for (i = 0; i < 5; i++) {
+		ub_log_column_destroy(&columns[i]);
+	}
+
+	return 0;
+}
+
 TEST_CASE(get_set_name) {
     const char* str = "Spanish inquisition";
 	ub_log_column_t col;
@@ -140,8 +178,31 @@ TEST_CASE(write) {
     return 0;
 }
 
+TEST_CASE(read) {
+	ub_log_column_t col;
+	size_t consumed = 0;
+
+	if (ub_log_column_read(&col, "\x03lat\x08\x00", 6, &consumed) != UB_SUCCESS)
+		return 1;
+	if (consumed != 6 || strcmp(col.name, "lat") || col.type != UB_DATATYPE_FLOAT)
+		return 2;
+	ub_log_column_destroy(&col);
+
+	/* truncated descriptions and invalid types are rejected */
+	if (ub_log_column_read(&col, "\x03lat\x08", 5, 0) != UB_EPARSE)
+		return 3;
+	if (ub_log_column_read(&col, "\x03lat\x00\x00", 6, 0) != UB_EPARSE)
+		return 4;
+	if (ub_log_column_read(&col, "\x03lat\xC8\x00", 6, 0) != UB_EPARSE)
+		return 5;
+
+	return 0;
+}
+
 START_OF_TESTS;
+RUN_TEST_CASE(get_layout);
 RUN_TEST_CASE(get_set_name);
 RUN_TEST_CASE(get_set_type);
 RUN_TEST_CASE(write);
+RUN_TEST_CASE(read);
 NO_MORE_TEST_CASES;
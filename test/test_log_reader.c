@@ -0,0 +1,1113 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <unibinlog/byteorder.h>
+#include <unibinlog/log_reader.h>
+#include <unibinlog/log_writer.h>
+#include <unibinlog/lowlevel.h>
+#include "fmemopen.h"
+#include "common.c"
+
+static void make_row(uint8_t* row, uint16_t counter, uint8_t flag) {
+    row[0] = counter >> 8;
+    row[1] = counter & 0xFF;
+    row[2] = flag;
+}
+
+static int write_log(FILE* f, ub_codec_t codec) {
+    ub_log_column_t columns[2];
+    ub_log_writer_t writer;
+    uint8_t row[3];
+    uint16_t i;
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "flag", UB_DATATYPE_BOOLEAN);
+
+    if (ub_log_writer_init(&writer, f, columns, 2, UB_CHKSUM_FLETCHER_16))
+        return 1;
+    if (ub_log_writer_set_codec(&writer, codec, 0))
+        return 2;
+    if (ub_log_writer_set_block_length(&writer, 64))
+        return 3;
+
+    for (i = 0; i < 50; i++) {
+        make_row(row, i, i % 2);
+        if (ub_log_writer_write_row(&writer, row, 3))
+            return 4;
+    }
+
+    if (ub_log_writer_close(&writer))
+        return 5;
+    ub_log_writer_destroy(&writer);
+    ub_log_column_destroy_array(columns, 2);
+
+    return 0;
+}
+
+static int read_log(FILE* f) {
+    ub_log_reader_t reader;
+    ub_error_t retval;
+    uint8_t row[3];
+    size_t i, num_rows = 0, num_blocks = 0;
+
+    if (ub_log_reader_init(&reader, f))
+        return 10;
+
+    if (reader.num_columns != 2 || reader.row_length != 3)
+        return 11;
+    if (strcmp(reader.columns[0].name, "counter") ||
+            reader.columns[1].type != UB_DATATYPE_BOOLEAN)
+        return 12;
+
+    while ((retval = ub_log_reader_next_block(&reader)) == UB_SUCCESS) {
+        num_blocks++;
+        for (i = 0; i < reader.num_rows; i++, num_rows++) {
+            make_row(row, num_rows, num_rows % 2);
+            if (memcmp(ub_log_reader_get_row(&reader, i), row, 3))
+                return 13;
+        }
+    }
+
+    if (retval != UB_EOF)
+        return 14;
+    if (num_rows != 50 || num_blocks < 2)
+        return 15;
+
+    ub_log_reader_destroy(&reader);
+    return 0;
+}
+
+TEST_CASE(read_rows) {
+    char buffer[512];
+    FILE* f;
+    int retval;
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    if ((retval = write_log(f, UB_CODEC_RAW)))
+        return retval;
+
+    /* comment blocks must be skipped */
+    if (ub_write_comment_block(f, "the end", UB_CHKSUM_FLETCHER_16))
+        return 20;
+
+    rewind(f);
+    retval = read_log(f);
+
+    fclose(f);
+    return retval;
+}
+
+TEST_CASE(read_encoded_rows) {
+    char buffer[512];
+    FILE* f;
+    int retval;
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    if ((retval = write_log(f, UB_CODEC_AUTO)))
+        return retval;
+
+    rewind(f);
+    retval = read_log(f);
+
+    fclose(f);
+    return retval;
+}
+
+TEST_CASE(read_column) {
+    char buffer[512];
+    FILE* f;
+    ub_log_reader_t reader;
+    uint16_t counters[64];
+    ub_bool_t flags[64];
+    size_t i, num_rows = 0;
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    if (write_log(f, UB_CODEC_RAW))
+        return 1;
+    rewind(f);
+
+    if (ub_log_reader_init(&reader, f))
+        return 2;
+
+    while (ub_log_reader_next_block(&reader) == UB_SUCCESS) {
+        if (ub_log_reader_read_column(&reader, 0, counters))
+            return 3;
+        if (ub_log_reader_read_column(&reader, 1, flags))
+            return 4;
+        for (i = 0; i < reader.num_rows; i++, num_rows++) {
+            if (counters[i] != num_rows || flags[i] != num_rows % 2)
+                return 5;
+        }
+    }
+
+    if (num_rows != 50)
+        return 6;
+    if (ub_log_reader_read_column(&reader, 2, counters) != UB_EINVAL)
+        return 7;
+
+    ub_log_reader_destroy(&reader);
+    fclose(f);
+
+    return 0;
+}
+
+TEST_CASE(little_endian) {
+    char buffer[512];
+    FILE* f;
+    ub_log_column_t columns[2];
+    ub_log_writer_t writer;
+    ub_log_reader_t reader;
+    uint32_t values[40], decoded[40];
+    int16_t deltas[40], decoded_deltas[40];
+    const void* arrays[2] = { values, deltas };
+    const uint8_t* row;
+    size_t i, num_rows = 0;
+    int retval = 0;
+
+    for (i = 0; i < 40; i++) {
+        values[i] = 0x01020304 * i;
+        deltas[i] = -(int16_t)i;
+    }
+
+    ub_log_column_init(&columns[0], "value", UB_DATATYPE_U32);
+    ub_log_column_init(&columns[1], "delta", UB_DATATYPE_S16);
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    if (ub_log_writer_init(&writer, f, columns, 2, UB_CHKSUM_FLETCHER_16))
+        return 1;
+
+    /* codecs do not support little-endian logs */
+    if (ub_log_writer_set_codec(&writer, UB_CODEC_DELTA, 0) ||
+            ub_log_writer_set_byte_order(&writer, UB_LITTLE_ENDIAN) !=
+            UB_EUNSUPPORTED)
+        retval = 2;
+    else if (ub_log_writer_set_codec(&writer, UB_CODEC_RAW, 0) ||
+            ub_log_writer_set_byte_order(&writer, UB_LITTLE_ENDIAN) ||
+            ub_log_writer_set_codec(&writer, UB_CODEC_DELTA, 0) !=
+            UB_EUNSUPPORTED)
+        retval = 3;
+    else if (ub_log_writer_set_block_length(&writer, 64) ||
+            ub_log_writer_write_columns(&writer, arrays, 40) ||
+            ub_log_writer_close(&writer))
+        retval = 4;
+    else if (ub_log_writer_set_byte_order(&writer, UB_BIG_ENDIAN) != UB_EINVAL)
+        retval = 5;
+
+    ub_log_writer_destroy(&writer);
+    ub_log_column_destroy_array(columns, 2);
+    if (retval)
+        return retval;
+
+    rewind(f);
+    if (ub_log_reader_init(&reader, f))
+        return 6;
+    if (reader.byte_order != UB_LITTLE_ENDIAN)
+        return 7;
+
+    while (ub_log_reader_next_block(&reader) == UB_SUCCESS) {
+        /* the values are stored in little-endian byte order */
+        row = ub_log_reader_get_row(&reader, 1);
+        i = num_rows + 1;
+        if (row[0] != (values[i] & 0xFF) || row[3] != (values[i] >> 24))
+            return 8;
+
+        if (ub_log_reader_read_column(&reader, 0, decoded + num_rows) ||
+                ub_log_reader_read_column(&reader, 1, decoded_deltas + num_rows))
+            return 9;
+        num_rows += reader.num_rows;
+    }
+
+    if (num_rows != 40 || memcmp(decoded, values, sizeof(values)) ||
+            memcmp(decoded_deltas, deltas, sizeof(deltas)))
+        return 10;
+
+    ub_log_reader_destroy(&reader);
+
+    /* header flags that the reader does not know about must be rejected */
+    rewind(f);
+    if (ub_write_header_with_flags(f, 1, UB_CHKSUM_FLETCHER_16, 0x20))
+        return 11;
+    rewind(f);
+    if (ub_log_reader_init(&reader, f) != UB_EUNSUPPORTED)
+        return 12;
+
+    fclose(f);
+    return 0;
+}
+
+TEST_CASE(aligned_rows) {
+    char buffer[1024];
+    FILE* f;
+    ub_log_column_t columns[3];
+    ub_log_writer_t writer;
+    ub_log_reader_t reader;
+    uint8_t flags[30], decoded_flags[30];
+    double values[30], decoded_values[30];
+    uint16_t counters[30], decoded_counters[30];
+    const void* arrays[3] = { flags, values, counters };
+    const uint8_t* row;
+    size_t i, num_rows = 0;
+    int retval = 0;
+
+    for (i = 0; i < 30; i++) {
+        flags[i] = i % 3;
+        values[i] = i * 0.25;
+        counters[i] = 1000 + i;
+    }
+
+    ub_log_column_init(&columns[0], "flag", UB_DATATYPE_U8);
+    ub_log_column_init(&columns[1], "value", UB_DATATYPE_DOUBLE);
+    ub_log_column_init(&columns[2], "counter", UB_DATATYPE_U16);
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    if (ub_log_writer_init(&writer, f, columns, 3, UB_CHKSUM_FLETCHER_16))
+        return 1;
+
+    if (ub_log_writer_set_aligned(&writer, 1) || writer.row_length != 24)
+        retval = 2;
+    else if (ub_log_writer_set_codec(&writer, UB_CODEC_DELTA, 0) !=
+            UB_EUNSUPPORTED)
+        retval = 3;
+    else if (ub_log_writer_set_block_length(&writer, 100) ||
+            ub_log_writer_write_columns(&writer, arrays, 30) ||
+            ub_log_writer_close(&writer))
+        retval = 4;
+
+    ub_log_writer_destroy(&writer);
+    ub_log_column_destroy_array(columns, 3);
+    if (retval)
+        return retval;
+
+    rewind(f);
+    if (ub_log_reader_init(&reader, f))
+        return 5;
+    if (!reader.aligned || reader.row_length != 24 ||
+            reader.offsets[1] != 8 || reader.offsets[2] != 16)
+        return 6;
+
+    while (ub_log_reader_next_block(&reader) == UB_SUCCESS) {
+        /* the payload of the block must be aligned within the file */
+        if ((ftell(f) - reader.rows_length - 2) % UB_ROW_ALIGNMENT != 0)
+            return 7;
+
+        /* padding bytes must be zero */
+        row = ub_log_reader_get_row(&reader, 0);
+        if (row[1] != 0 || row[7] != 0 || row[23] != 0)
+            return 8;
+
+        if (ub_log_reader_read_column(&reader, 0, decoded_flags + num_rows) ||
+                ub_log_reader_read_column(&reader, 1, decoded_values + num_rows) ||
+                ub_log_reader_read_column(&reader, 2, decoded_counters + num_rows))
+            return 9;
+        num_rows += reader.num_rows;
+    }
+
+    if (num_rows != 30 || memcmp(decoded_flags, flags, sizeof(flags)) ||
+            memcmp(decoded_values, values, sizeof(values)) ||
+            memcmp(decoded_counters, counters, sizeof(counters)))
+        return 10;
+
+    ub_log_reader_destroy(&reader);
+    fclose(f);
+
+    return 0;
+}
+
+/* Writes a log of 1000 rows with a timestamp and a name column, with three
+ * timestamps per row number, in blocks of the given length */
+static int write_indexed_log_with_block_length(FILE* f, ub_codec_t codec,
+        ub_datatype_t name_type, size_t block_length) {
+    ub_log_column_t columns[2];
+    ub_log_writer_t writer;
+    ub_buffer_t buf;
+    ub_buffer_writer_t row;
+    uint32_t i;
+    int retval = 0;
+
+    ub_log_column_init(&columns[0], "name", name_type);
+    ub_log_column_init(&columns[1], "time", UB_DATATYPE_UNIX_TIMESTAMP);
+    ub_buffer_init(&buf, 0);
+    ub_buffer_writer_init(&row, &buf, 0, 1);
+
+    if (ub_log_writer_init(&writer, f, columns, 2, UB_CHKSUM_FLETCHER_16))
+        return 1;
+
+    if ((name_type == UB_DATATYPE_STRING &&
+                ub_log_writer_set_timestamp_column(&writer, 0) != UB_EUNSUPPORTED) ||
+            ub_log_writer_set_timestamp_column(&writer, 2) != UB_EINVAL)
+        retval = 2;
+    else if (ub_log_writer_set_index(&writer, 1) ||
+            ub_log_writer_set_timestamp_column(&writer, 1) ||
+            ub_log_writer_set_codec(&writer, codec, 0) ||
+            ub_log_writer_set_block_length(&writer, block_length))
+        retval = 3;
+
+    for (i = 0; i < 1000 && !retval; i++) {
+        ub_buffer_writer_seek(&row, 0, SEEK_SET);
+        if (name_type == UB_DATATYPE_STRING)
+            ub_buffer_writer_write_string(&row, i % 2 ? "odd" : "even");
+        else
+            ub_buffer_writer_write_u32(&row, i);
+        ub_buffer_writer_write_u32(&row, 0);
+        ub_buffer_writer_write_u32(&row, i * 3);
+        if (ub_log_writer_write_row(&writer, UB_BUFFER(buf),
+                    ub_buffer_writer_tell(&row)))
+            retval = 4;
+    }
+
+    if (!retval && ub_log_writer_close(&writer))
+        retval = 5;
+
+    ub_log_writer_destroy(&writer);
+    ub_buffer_writer_destroy(&row);
+    ub_buffer_destroy(&buf);
+    ub_log_column_destroy_array(columns, 2);
+
+    return retval;
+}
+
+static int write_indexed_log(FILE* f, ub_codec_t codec, ub_datatype_t name_type) {
+    return write_indexed_log_with_block_length(f, codec, name_type, 200);
+}
+
+static int seek_indexed_log(FILE* f) {
+    ub_log_reader_t reader;
+    size_t index;
+    uint64_t timestamps[100];
+    int retval = 0;
+
+    if (ub_log_reader_init(&reader, f))
+        return 10;
+
+    if (ub_log_reader_seek_row(&reader, 0, &index) != UB_EINVAL)
+        retval = 11;
+    else if (ub_log_reader_load_index(&reader))
+        retval = 12;
+    else if (reader.index.num_entries < 10 || reader.index.timestamp_column != 1)
+        retval = 13;
+
+    /* loading the index must not move the reader */
+    if (!retval && (ub_log_reader_next_block(&reader) || reader.first_row != 0))
+        retval = 14;
+
+    if (!retval && (ub_log_reader_seek_row(&reader, 567, &index) ||
+                reader.first_row + index != 567))
+        retval = 15;
+    if (!retval && reader.row_length > 0 &&
+            (ub_log_reader_read_column(&reader, 1, timestamps) ||
+             timestamps[index] != 567 * 3))
+        retval = 16;
+
+    /* timestamps 1500 and 1501 belong to rows 500 and 501 */
+    if (!retval && (ub_log_reader_seek_timestamp(&reader, 1500, &index) ||
+                reader.first_row + index != 500))
+        retval = 17;
+    if (!retval && (ub_log_reader_seek_timestamp(&reader, 1501, &index) ||
+                reader.first_row + index != 501))
+        retval = 18;
+    if (!retval && (ub_log_reader_seek_timestamp(&reader, -1, &index) ||
+                reader.first_row + index != 0))
+        retval = 19;
+
+    /* reading can continue normally after seeking */
+    if (!retval && (ub_log_reader_next_block(&reader) ||
+                reader.first_row != reader.index.entries[1].first_row))
+        retval = 20;
+
+    if (!retval && (ub_log_reader_seek_row(&reader, 1000, &index) != UB_EOF ||
+                ub_log_reader_seek_timestamp(&reader, 3000, &index) != UB_EOF))
+        retval = 21;
+
+    ub_log_reader_destroy(&reader);
+    return retval;
+}
+
+TEST_CASE(seek) {
+    static char buffer[32768];
+    FILE* f;
+    int retval;
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    retval = write_indexed_log(f, UB_CODEC_RAW, UB_DATATYPE_U32);
+    if (!retval) {
+        rewind(f);
+        retval = seek_indexed_log(f);
+    }
+    fclose(f);
+    if (retval)
+        return retval;
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    retval = write_indexed_log(f, UB_CODEC_AUTO, UB_DATATYPE_U32);
+    if (!retval) {
+        rewind(f);
+        retval = seek_indexed_log(f);
+    }
+    fclose(f);
+    if (retval)
+        return 100 + retval;
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    retval = write_indexed_log(f, UB_CODEC_RAW, UB_DATATYPE_STRING);
+    if (!retval) {
+        rewind(f);
+        retval = seek_indexed_log(f);
+    }
+    fclose(f);
+    if (retval)
+        return 200 + retval;
+
+    return 0;
+}
+
+/* State of fetch_indexed_log() */
+typedef struct {
+    const ub_block_index_t* index;
+    const uint64_t* offsets;
+    size_t count;
+    size_t* seen;
+} fetch_state_t;
+
+static ub_error_t check_fetched_block(const ub_scan_block_t* block,
+        void* user_data) {
+    fetch_state_t* state = (fetch_state_t*)user_data;
+    const ub_block_index_entry_t* entry;
+    int64_t time;
+    size_t i;
+
+    if (block->range >= state->count ||
+            block->offset != state->offsets[block->range])
+        return UB_FAILURE;
+
+    /* the offsets are passed in reverse order */
+    entry = &state->index->entries[state->count - 1 - block->range];
+    if (block->num_rows != entry->num_rows)
+        return UB_FAILURE;
+
+    /* the timestamp of a row is three times its row number */
+    for (i = 0; i < block->num_rows && block->row_length > 0; i++) {
+        if (ub_byteorder_decode_int64(block->columns[1].type,
+                    block->byte_order, block->rows + i * block->row_length +
+                    block->offsets[1], &time) ||
+                (uint64_t)time != (entry->first_row + i) * 3)
+            return UB_FAILURE;
+    }
+
+    state->seen[block->range]++;
+    return UB_SUCCESS;
+}
+
+/* Fetches every block of an indexed log at once, in reverse order */
+static int fetch_indexed_log(FILE* f) {
+    ub_log_reader_t reader;
+    fetch_state_t state;
+    uint64_t* offsets;
+    size_t i, *seen;
+    long position;
+    int retval = 0;
+
+    if (ub_log_reader_init(&reader, f))
+        return 10;
+    if (ub_log_reader_load_index(&reader))
+        return 11;
+
+    state.index = &reader.index;
+    state.count = reader.index.num_entries;
+    offsets = calloc(state.count, sizeof(uint64_t));
+    seen = calloc(state.count, sizeof(size_t));
+    state.offsets = offsets;
+    state.seen = seen;
+
+    for (i = 0; i < state.count; i++)
+        offsets[i] = reader.index.entries[state.count - 1 - i].offset;
+
+    position = ftell(f);
+    if (ub_log_reader_fetch_blocks(&reader, offsets, state.count,
+                check_fetched_block, &state))
+        retval = 12;
+    for (i = 0; i < state.count && !retval; i++) {
+        if (seen[i] != 1)
+            retval = 13;
+    }
+
+    /* fetching does not move the reader */
+    if (!retval && ftell(f) != position)
+        retval = 14;
+
+    /* an offset that is not the start of a log entry block */
+    offsets[0] = 0;
+    if (!retval && ub_log_reader_fetch_blocks(&reader, offsets, state.count,
+                check_fetched_block, &state) != UB_EPARSE)
+        retval = 15;
+
+    /* an offset past the end of the file */
+    offsets[0] = 1 << 30;
+    if (!retval && ub_log_reader_fetch_blocks(&reader, offsets, 1,
+                check_fetched_block, &state) != UB_EPARSE)
+        retval = 16;
+
+    free(offsets);
+    free(seen);
+    ub_log_reader_destroy(&reader);
+    return retval;
+}
+
+TEST_CASE(fetch_blocks) {
+    ub_log_reader_t reader;
+    static char buffer[1024];
+    ub_codec_t codecs[] = { UB_CODEC_RAW, UB_CODEC_AUTO };
+    uint64_t offset = 0;
+    size_t i;
+    FILE* f;
+    int retval = 0;
+
+    for (i = 0; i < 2 && !retval; i++) {
+        f = tmpfile();
+        retval = write_indexed_log(f, codecs[i], UB_DATATYPE_U32);
+        if (!retval) {
+            rewind(f);
+            retval = fetch_indexed_log(f);
+        }
+        fclose(f);
+        if (retval)
+            retval += i * 100;
+    }
+    if (retval)
+        return retval;
+
+    /* blocks longer than the first read */
+    f = tmpfile();
+    retval = write_indexed_log_with_block_length(f, UB_CODEC_RAW,
+            UB_DATATYPE_U32, 20000);
+    if (!retval) {
+        rewind(f);
+        retval = fetch_indexed_log(f);
+    }
+    fclose(f);
+    if (retval)
+        return 200 + retval;
+
+    /* streams without a file descriptor are not supported */
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    retval = write_log(f, UB_CODEC_RAW);
+    rewind(f);
+    if (!retval && ub_log_reader_init(&reader, f))
+        retval = 301;
+    if (!retval) {
+        if (ub_log_reader_fetch_blocks(&reader, &offset, 1,
+                    check_fetched_block, 0) != UB_EUNSUPPORTED)
+            retval = 302;
+        ub_log_reader_destroy(&reader);
+    }
+    fclose(f);
+
+    return retval;
+}
+
+/* Reads all the rows of an indexed log with the given access pattern */
+static int read_with_access_pattern(FILE* f, ub_access_pattern_t pattern) {
+    ub_log_reader_t reader;
+    ub_error_t retval;
+    uint64_t num_rows = 0;
+
+    rewind(f);
+    if (ub_log_reader_init(&reader, f))
+        return 1;
+
+    if (ub_log_reader_set_access_pattern(&reader, pattern))
+        retval = 2;
+    else if (reader.access_pattern != pattern)
+        retval = 3;
+    else {
+        while ((retval = ub_log_reader_next_block(&reader)) == UB_SUCCESS)
+            num_rows += reader.num_rows;
+        retval = retval == UB_EOF && num_rows == 1000 ? 0 : 4;
+    }
+
+    ub_log_reader_destroy(&reader);
+    return retval;
+}
+
+TEST_CASE(access_pattern) {
+    static char buffer[32768];
+    ub_log_reader_t reader;
+    size_t index;
+    FILE* f;
+    int retval = 0;
+
+    f = tmpfile();
+    if (write_indexed_log(f, UB_CODEC_RAW, UB_DATATYPE_U32)) {
+        fclose(f);
+        return 1;
+    }
+
+    if (read_with_access_pattern(f, UB_ACCESS_SEQUENTIAL))
+        retval = 2;
+    else if (read_with_access_pattern(f, UB_ACCESS_ONCE))
+        retval = 3;
+    else if (read_with_access_pattern(f, UB_ACCESS_NORMAL))
+        retval = 4;
+
+    /* index-driven access prefetches the selected blocks */
+    rewind(f);
+    if (!retval && ub_log_reader_init(&reader, f))
+        retval = 5;
+    if (!retval) {
+        if (ub_log_reader_set_access_pattern(&reader, UB_ACCESS_RANDOM) ||
+                ub_log_reader_set_access_pattern(&reader, 42) != UB_EINVAL)
+            retval = 6;
+        else if (ub_log_reader_prefetch_rows(&reader, 0, 10) != UB_EINVAL)
+            retval = 7;
+        else if (ub_log_reader_load_index(&reader) ||
+                ub_log_reader_prefetch_rows(&reader, 300, 400) ||
+                ub_log_reader_prefetch_rows(&reader, 900, UINT64_MAX) ||
+                ub_log_reader_prefetch_rows(&reader, 0, 0))
+            retval = 8;
+        else if (ub_log_reader_prefetch_rows(&reader, 1000, 1) != UB_EOF)
+            retval = 9;
+        else if (ub_log_reader_seek_row(&reader, 567, &index) ||
+                reader.first_row + index != 567)
+            retval = 10;
+        ub_log_reader_destroy(&reader);
+    }
+    fclose(f);
+    if (retval)
+        return retval;
+
+    /* hints need a file descriptor */
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    retval = write_indexed_log(f, UB_CODEC_RAW, UB_DATATYPE_U32);
+    rewind(f);
+    if (!retval && ub_log_reader_init(&reader, f))
+        retval = 20;
+    if (!retval) {
+        if (ub_log_reader_set_access_pattern(&reader,
+                    UB_ACCESS_SEQUENTIAL) != UB_EUNSUPPORTED ||
+                reader.access_pattern != UB_ACCESS_NORMAL)
+            retval = 21;
+        ub_log_reader_destroy(&reader);
+    }
+    fclose(f);
+
+    return retval;
+}
+
+static int write_log_with_zone_maps(FILE* f, ub_codec_t codec,
+        ub_bool_t bloom_filters) {
+    ub_log_column_t columns[2];
+    ub_log_writer_t writer;
+    uint8_t row[3];
+    uint16_t i;
+    int retval = 0;
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "flag", UB_DATATYPE_BOOLEAN);
+
+    if (ub_log_writer_init(&writer, f, columns, 2, UB_CHKSUM_FLETCHER_16))
+        return 1;
+
+    if (ub_log_writer_set_zone_maps(&writer, 1) ||
+            ub_log_writer_set_codec(&writer, codec, 0) ||
+            ub_log_writer_set_block_length(&writer, 64))
+        retval = 2;
+    if (!retval && bloom_filters && ub_log_writer_add_bloom_filter(&writer, 0))
+        retval = 2;
+
+    for (i = 0; i < 500 && !retval; i++) {
+        make_row(row, i, i % 2);
+        if (ub_log_writer_write_row(&writer, row, 3))
+            retval = 3;
+    }
+
+    if (!retval && (ub_log_writer_close(&writer) ||
+                ub_log_writer_set_zone_maps(&writer, 0) != UB_EINVAL))
+        retval = 4;
+
+    ub_log_writer_destroy(&writer);
+    ub_log_column_destroy_array(columns, 2);
+
+    return retval;
+}
+
+/* Reads the rows with counters in [lower; upper] with the help of filters
+ * and checks that the row numbers stay correct when blocks are skipped */
+static int read_filtered_log(FILE* f, uint16_t lower, uint16_t upper,
+        size_t* num_blocks) {
+    ub_log_reader_t reader;
+    ub_error_t retval;
+    uint8_t row[3];
+    size_t i, num_matches = 0;
+    uint64_t row_number;
+    ub_bool_t flag = 1;
+
+    if (ub_log_reader_init(&reader, f))
+        return 10;
+
+    if (ub_log_reader_add_filter(&reader, 0, UB_FILTER_GE, &lower) ||
+            ub_log_reader_add_filter(&reader, 0, UB_FILTER_LE, &upper))
+        return 11;
+    if (ub_log_reader_add_filter(&reader, 2, UB_FILTER_EQ, &flag) != UB_EINVAL)
+        return 12;
+
+    *num_blocks = 0;
+    while ((retval = ub_log_reader_next_block(&reader)) == UB_SUCCESS) {
+        (*num_blocks)++;
+        for (i = 0; i < reader.num_rows; i++) {
+            row_number = reader.first_row + i;
+            make_row(row, row_number, row_number % 2);
+            if (memcmp(ub_log_reader_get_row(&reader, i), row, 3))
+                return 13;
+            if (row_number >= lower && row_number <= upper)
+                num_matches++;
+        }
+    }
+
+    if (retval != UB_EOF)
+        return 14;
+    if (num_matches != (size_t)(upper - lower + 1))
+        return 15;
+
+    ub_log_reader_destroy(&reader);
+    return 0;
+}
+
+TEST_CASE(filter) {
+    static char buffer[8192];
+    size_t num_blocks;
+    FILE* f;
+    int retval;
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    retval = write_log_with_zone_maps(f, UB_CODEC_RAW, 0);
+    if (!retval) {
+        /* filters that match everything do not skip anything */
+        rewind(f);
+        retval = read_filtered_log(f, 0, 499, &num_blocks);
+        if (!retval && num_blocks != 24)
+            retval = 20;
+    }
+    if (!retval) {
+        /* 21 rows fit into a block, so 3 out of 24 blocks have to be read */
+        rewind(f);
+        retval = read_filtered_log(f, 200, 240, &num_blocks);
+        if (!retval && num_blocks != 3)
+            retval = 20;
+    }
+    fclose(f);
+    if (retval)
+        return retval;
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    retval = write_log_with_zone_maps(f, UB_CODEC_AUTO, 0);
+    if (!retval) {
+        rewind(f);
+        retval = read_filtered_log(f, 450, 499, &num_blocks);
+        if (!retval && num_blocks > 4)
+            retval = 20;
+    }
+    fclose(f);
+    if (retval)
+        return 100 + retval;
+
+    /* blocks are skipped together with their Bloom filters */
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    retval = write_log_with_zone_maps(f, UB_CODEC_RAW, 1);
+    if (!retval) {
+        rewind(f);
+        retval = read_filtered_log(f, 200, 240, &num_blocks);
+        if (!retval && num_blocks != 3)
+            retval = 20;
+    }
+    fclose(f);
+    if (retval)
+        return 200 + retval;
+
+    return 0;
+}
+
+static int write_log_with_bloom_filters(FILE* f) {
+    ub_log_column_t columns[2];
+    ub_log_writer_t writer;
+    uint8_t row[32];
+    size_t length;
+    uint16_t i;
+    int retval = 0;
+
+    ub_log_column_init(&columns[0], "device", UB_DATATYPE_STRING);
+    ub_log_column_init(&columns[1], "counter", UB_DATATYPE_U16);
+
+    if (ub_log_writer_init(&writer, f, columns, 2, UB_CHKSUM_FLETCHER_16))
+        return 1;
+
+    if (ub_log_writer_add_bloom_filter(&writer, 0) ||
+            ub_log_writer_add_bloom_filter(&writer, 0) ||
+            ub_log_writer_add_bloom_filter(&writer, 2) != UB_EINVAL ||
+            ub_log_writer_set_block_length(&writer, 200))
+        retval = 2;
+
+    for (i = 0; i < 500 && !retval; i++) {
+        length = sprintf((char*)row, "device-%d", i / 25) + 1;
+        row[length++] = i >> 8;
+        row[length++] = i & 0xFF;
+        if (ub_log_writer_write_row(&writer, row, length))
+            retval = 3;
+    }
+
+    if (!retval && ub_log_writer_close(&writer))
+        retval = 4;
+
+    ub_log_writer_destroy(&writer);
+    ub_log_column_destroy_array(columns, 2);
+
+    return retval;
+}
+
+TEST_CASE(bloom_filter) {
+    static char buffer[16384];
+    ub_log_reader_t reader;
+    ub_error_t err;
+    const uint8_t* row;
+    size_t i, length, num_blocks = 0, num_matches = 0;
+    FILE* f;
+    int retval;
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    retval = write_log_with_bloom_filters(f);
+    if (!retval) {
+        rewind(f);
+        if (ub_log_reader_init(&reader, f))
+            retval = 10;
+    }
+
+    if (!retval && (ub_log_reader_add_key(&reader, 0, "device-7", 8) ||
+                ub_log_reader_add_key(&reader, 2, "device-7", 8) != UB_EINVAL))
+        retval = 11;
+
+    while (!retval && (err = ub_log_reader_next_block(&reader)) == UB_SUCCESS) {
+        num_blocks++;
+        row = reader.rows;
+        for (i = 0; i < reader.num_rows; i++, row += length + 2) {
+            length = strlen((const char*)row) + 1;
+            if (((row[length] << 8) | row[length + 1]) != reader.first_row + i)
+                retval = 12;
+            if (!strcmp((const char*)row, "device-7"))
+                num_matches++;
+        }
+    }
+
+    /* rows 175-199 span two or three blocks of 18 rows */
+    if (!retval && (err != UB_EOF || num_matches != 25 || num_blocks > 5))
+        retval = 13;
+
+    if (!retval || retval > 10)
+        ub_log_reader_destroy(&reader);
+    fclose(f);
+
+    return retval;
+}
+
+static int write_log_with_sync_blocks(FILE* f, uint64_t sync_interval,
+        size_t* length) {
+    ub_log_column_t columns[2];
+    ub_log_writer_t writer;
+    uint8_t row[3];
+    uint16_t i;
+    int retval = 0;
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "flag", UB_DATATYPE_BOOLEAN);
+
+    if (ub_log_writer_init(&writer, f, columns, 2, UB_CHKSUM_FLETCHER_16))
+        return 1;
+    if (ub_log_writer_set_sync_interval(&writer, sync_interval) ||
+            ub_log_writer_set_block_length(&writer, 64))
+        retval = 2;
+
+    for (i = 0; i < 1000 && !retval; i++) {
+        make_row(row, i, i % 2);
+        if (ub_log_writer_write_row(&writer, row, 3))
+            retval = 3;
+    }
+
+    if (!retval && ub_log_writer_close(&writer))
+        retval = 4;
+    if (!retval && ub_log_writer_set_sync_interval(&writer, 0) != UB_EINVAL)
+        retval = 5;
+
+    fflush(f);
+    *length = ftell(f);
+
+    ub_log_writer_destroy(&writer);
+    ub_log_column_destroy_array(columns, 2);
+
+    return retval;
+}
+
+/* Seeks to the first sync block after the given offset and checks that the
+ * rows found there and in the next few blocks have the right row numbers */
+static int seek_sync(ub_log_reader_t* reader, uint64_t offset) {
+    uint8_t row[3];
+    uint64_t start, next;
+    size_t i;
+    ub_error_t retval;
+
+    retval = ub_log_reader_seek_sync(reader, offset);
+    if (retval == UB_EOF)
+        return 1;
+    if (retval != UB_SUCCESS)
+        return 2;
+
+    /* sync blocks are written at most one block past the interval */
+    if (reader->block_offset < offset || reader->block_offset - offset > 600)
+        return 3;
+
+    start = next = reader->first_row;
+    do {
+        if (reader->first_row != next || reader->num_rows == 0)
+            return 4;
+        for (i = 0; i < reader->num_rows; i++, next++) {
+            make_row(row, next, next % 2);
+            if (memcmp(ub_log_reader_get_row(reader, i), row, 3))
+                return 5;
+        }
+    } while (next < start + 100 &&
+            (retval = ub_log_reader_next_block(reader)) == UB_SUCCESS);
+
+    return retval == UB_SUCCESS || retval == UB_EOF ? 0 : 6;
+}
+
+TEST_CASE(sync) {
+    static char buffer[16384];
+    ub_log_reader_t reader;
+    size_t length;
+    uint64_t offset;
+    FILE* f;
+    int retval;
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    retval = write_log_with_sync_blocks(f, 500, &length);
+    rewind(f);
+    if (!retval && ub_log_reader_init(&reader, f))
+        retval = 10;
+
+    for (offset = 0; offset < length && !retval; offset += 37) {
+        retval = seek_sync(&reader, offset);
+
+        /* there are no sync blocks in the last interval only */
+        if (retval == 1 && length - offset < 600) {
+            retval = 0;
+            break;
+        }
+        if (retval)
+            retval += 10;
+    }
+
+    /* the columns are reloaded if the sync block refers to another log
+     * header block */
+    if (!retval) {
+        reader.header_offset = 1;
+        if (seek_sync(&reader, 0))
+            retval = 20;
+        else if (reader.header_offset == 1 || reader.num_columns != 2)
+            retval = 21;
+        ub_log_reader_destroy(&reader);
+    }
+    fclose(f);
+    if (retval)
+        return retval;
+
+    /* logs without sync blocks cannot be resynchronized on */
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    retval = write_log_with_sync_blocks(f, 0, &length);
+    rewind(f);
+    if (!retval && ub_log_reader_init(&reader, f))
+        retval = 30;
+    if (!retval) {
+        if (ub_log_reader_seek_sync(&reader, 0) != UB_EOF)
+            retval = 31;
+        ub_log_reader_destroy(&reader);
+    }
+    fclose(f);
+
+    return retval;
+}
+
+TEST_CASE(read_variable_length_rows) {
+    char buffer[256];
+    FILE* f;
+    ub_log_column_t columns[2];
+    ub_log_writer_t writer;
+    ub_log_reader_t reader;
+
+    ub_log_column_init(&columns[0], "id", UB_DATATYPE_U8);
+    ub_log_column_init(&columns[1], "message", UB_DATATYPE_STRING);
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    ub_log_writer_init(&writer, f, columns, 2, UB_CHKSUM_NONE);
+    ub_log_writer_write_row(&writer, "\x01" "foo", 5);
+    ub_log_writer_write_row(&writer, "\x02" "", 2);
+    ub_log_writer_write_row(&writer, "\x03" "barbaz", 8);
+    ub_log_writer_close(&writer);
+    ub_log_writer_destroy(&writer);
+    ub_log_column_destroy_array(columns, 2);
+
+    rewind(f);
+    if (ub_log_reader_init(&reader, f))
+        return 1;
+    if (reader.row_length != 0)
+        return 2;
+    if (ub_log_reader_next_block(&reader))
+        return 3;
+    if (reader.num_rows != 3 || reader.rows_length != 15)
+        return 4;
+    if (ub_log_reader_get_row(&reader, 0) != 0)
+        return 5;
+    if (ub_log_reader_read_column(&reader, 0, buffer) != UB_EUNSUPPORTED)
+        return 7;
+    if (ub_log_reader_next_block(&reader) != UB_EOF)
+        return 6;
+
+    ub_log_reader_destroy(&reader);
+    fclose(f);
+
+    return 0;
+}
+
+TEST_CASE(not_a_log) {
+    char buffer[64];
+    FILE* f;
+    ub_log_reader_t reader;
+
+    memset(buffer, 0, sizeof(buffer));
+    f = fmemopen(buffer, sizeof(buffer), "r");
+    if (ub_log_reader_init(&reader, f) != UB_EPARSE)
+        return 1;
+    fclose(f);
+
+    /* a file without a log header block is not a log either */
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    ub_write_header(f, 1, UB_CHKSUM_NONE);
+    ub_write_comment_block(f, "hello", UB_CHKSUM_NONE);
+    rewind(f);
+    if (ub_log_reader_init(&reader, f) != UB_EPARSE)
+        return 2;
+    fclose(f);
+
+    return 0;
+}
+
+START_OF_TESTS;
+RUN_TEST_CASE(read_rows);
+RUN_TEST_CASE(read_encoded_rows);
+RUN_TEST_CASE(read_column);
+RUN_TEST_CASE(little_endian);
+RUN_TEST_CASE(aligned_rows);
+RUN_TEST_CASE(seek);
+RUN_TEST_CASE(fetch_blocks);
+RUN_TEST_CASE(access_pattern);
+RUN_TEST_CASE(filter);
+RUN_TEST_CASE(bloom_filter);
+RUN_TEST_CASE(sync);
+RUN_TEST_CASE(read_variable_length_rows);
+RUN_TEST_CASE(not_a_log);
+NO_MORE_TEST_CASES;
@@ -0,0 +1,286 @@
+#include <cstring>
+#include <type_traits>
+
+#include <unibinlog/log_reader.hpp>
+#include <unibinlog/log_writer.hpp>
+#include "fmemopen.h"
+#include "common.c"
+
+using namespace unibinlog;
+
+typedef log_writer<std::uint16_t, double, std::int32_t> test_writer;
+typedef test_writer::schema_type test_schema;
+
+static_assert(std::tuple_size<row_view<test_schema>>::value == 3,
+        "wrong tuple size");
+static_assert(std::is_same<std::tuple_element_t<1, row_view<test_schema>>,
+        double>::value, "wrong tuple element");
+
+static_assert(aligned_schema<std::uint16_t, double, std::int32_t>::offsets[1] == 8,
+        "wrong aligned offset");
+static_assert(aligned_schema<std::uint16_t, double, std::int32_t>::row_length == 24,
+        "wrong aligned row length");
+
+static void write_log(FILE* f, ub_codec_t codec,
+        ub_byte_order_t order = UB_BIG_ENDIAN, bool aligned = false,
+        bool indexed = false, bool zone_maps = false) {
+    test_writer writer(f, { "counter", "value", "delta" });
+    writer.set_block_length(100);
+    writer.set_codec(codec);
+    writer.set_byte_order(order);
+    writer.set_aligned(aligned);
+    writer.set_zone_maps(zone_maps);
+    if (indexed) {
+        writer.set_index(true);
+        writer.set_timestamp_column(0);
+    }
+    for (std::uint16_t i = 0; i < 100; i++) {
+        writer.write(i, i * 0.5, -i);
+    }
+    writer.close();
+}
+
+template <typename Schema = test_schema>
+static int read_log(FILE* f) {
+    log_reader reader(f);
+    std::uint16_t i = 0;
+
+    if (reader.columns().size() != 3 ||
+            std::strcmp(reader.columns()[1].name, "value"))
+        return 1;
+
+    for (auto row : reader.rows<Schema>()) {
+        if (row.template get<0>() != i || row.template get<1>() != i * 0.5)
+            return 2;
+
+        auto [counter, value, delta] = row;
+        if (counter != i || value != i * 0.5 || delta != -i)
+            return 3;
+
+        i++;
+    }
+
+    if (i != 100)
+        return 4;
+
+    return 0;
+}
+
+TEST_CASE(rows) {
+    char buffer[4096];
+    FILE* f = fmemopen(buffer, sizeof(buffer), "w+");
+    int retval;
+
+    write_log(f, UB_CODEC_RAW);
+    rewind(f);
+    retval = read_log(f);
+
+    fclose(f);
+    return retval;
+}
+
+TEST_CASE(encoded_rows) {
+    char buffer[4096];
+    FILE* f = fmemopen(buffer, sizeof(buffer), "w+");
+    int retval;
+
+    write_log(f, UB_CODEC_AUTO);
+    rewind(f);
+    retval = read_log(f);
+
+    fclose(f);
+    return retval;
+}
+
+TEST_CASE(little_endian_rows) {
+    char buffer[4096];
+    FILE* f = fmemopen(buffer, sizeof(buffer), "w+");
+    int retval;
+
+    write_log(f, UB_CODEC_RAW, UB_LITTLE_ENDIAN);
+    rewind(f);
+    retval = read_log(f);
+
+    fclose(f);
+    return retval;
+}
+
+TEST_CASE(aligned_rows) {
+    char buffer[4096];
+    FILE* f = fmemopen(buffer, sizeof(buffer), "w+");
+    int retval;
+
+    write_log(f, UB_CODEC_RAW, UB_LITTLE_ENDIAN, true);
+    rewind(f);
+    retval = read_log<test_writer::aligned_schema_type>(f);
+
+    /* the packed schema must not match an aligned log */
+    if (!retval) {
+        rewind(f);
+        try {
+            log_reader reader(f);
+            reader.rows<test_schema>();
+            retval = 5;
+        } catch (const error& ex) {
+            retval = ex.code() == UB_EINVAL ? 0 : 6;
+        }
+    }
+
+    fclose(f);
+    return retval;
+}
+
+TEST_CASE(seek) {
+    char buffer[4096];
+    FILE* f = fmemopen(buffer, sizeof(buffer), "w+");
+    int retval = 0;
+
+    write_log(f, UB_CODEC_RAW, UB_BIG_ENDIAN, false, true);
+    rewind(f);
+
+    log_reader reader(f);
+    if (!reader.load_index()) {
+        retval = 1;
+    } else {
+        std::size_t index = reader.seek_row(57);
+        std::uint16_t expected = 57;
+        for (auto row : reader.rows<test_schema>(index)) {
+            if (row.get<0>() != expected++) {
+                retval = 2;
+                break;
+            }
+        }
+        if (!retval && expected != 100) {
+            retval = 3;
+        }
+
+        index = reader.seek_timestamp(80);
+        if (!retval && (*reader.rows<test_schema>(index).begin()).get<0>() != 80) {
+            retval = 4;
+        }
+    }
+
+    fclose(f);
+    return retval;
+}
+
+TEST_CASE(filter) {
+    char buffer[8192];
+    FILE* f = fmemopen(buffer, sizeof(buffer), "w+");
+    std::size_t num_rows = 0;
+    int retval = 0;
+
+    write_log(f, UB_CODEC_RAW, UB_BIG_ENDIAN, false, false, true);
+    rewind(f);
+
+    log_reader reader(f);
+    reader.add_filter<std::uint16_t>(0, UB_FILTER_GE, 90);
+    for (auto row : reader.rows<test_schema>()) {
+        (void)row;
+        num_rows++;
+    }
+
+    /* only the last blocks are read */
+    if (num_rows < 10 || num_rows >= 20) {
+        retval = 1;
+    }
+
+    /* the constant must have the type of the column, otherwise the filter
+     * would read the wrong number of bytes */
+    try {
+        reader.add_filter(0, UB_FILTER_GE, 90);
+        retval = 2;
+    } catch (const error& ex) {
+        if (ex.code() != UB_EINVAL) {
+            retval = 3;
+        }
+    }
+    try {
+        reader.add_filter(1, UB_FILTER_GE, 0.5f);
+        retval = 4;
+    } catch (const error& ex) {
+        if (ex.code() != UB_EINVAL) {
+            retval = 5;
+        }
+    }
+
+    fclose(f);
+    return retval;
+}
+
+TEST_CASE(bloom_filter) {
+    char buffer[8192];
+    FILE* f = fmemopen(buffer, sizeof(buffer), "w+");
+    std::size_t num_rows = 0, num_matches = 0;
+    int retval = 0;
+
+    {
+        test_writer writer(f, { "counter", "value", "delta" });
+        writer.set_block_length(100);
+        writer.add_bloom_filter(0);
+        for (std::uint16_t i = 0; i < 100; i++) {
+            writer.write(i, i * 0.5, -i);
+        }
+        writer.close();
+    }
+    rewind(f);
+
+    log_reader reader(f);
+    reader.add_key<std::uint16_t>(0, 42);
+    reader.add_key<std::uint16_t>(0, 77);
+    for (auto row : reader.rows<test_schema>()) {
+        if (row.get<0>() == 42 || row.get<0>() == 77) {
+            num_matches++;
+        }
+        num_rows++;
+    }
+
+    /* only the blocks holding the two keys are read, apart from false
+     * positives */
+    if (num_matches != 2 || num_rows > 28) {
+        retval = 1;
+    }
+
+    /* a key of the wrong width would hash the wrong bytes and miss blocks */
+    try {
+        reader.add_key(0, 42);
+        retval = 2;
+    } catch (const error& ex) {
+        if (ex.code() != UB_EINVAL) {
+            retval = 3;
+        }
+    }
+
+    fclose(f);
+    return retval;
+}
+
+TEST_CASE(schema_mismatch) {
+    char buffer[4096];
+    FILE* f = fmemopen(buffer, sizeof(buffer), "w+");
+    int retval = 1;
+
+    write_log(f, UB_CODEC_RAW);
+    rewind(f);
+
+    try {
+        log_reader reader(f);
+        reader.rows<schema<std::uint16_t, float, std::int32_t>>();
+    } catch (const error& ex) {
+        retval = ex.code() == UB_EINVAL ? 0 : 2;
+    }
+
+    fclose(f);
+    return retval;
+}
+
+START_OF_TESTS;
+RUN_TEST_CASE(rows);
+RUN_TEST_CASE(encoded_rows);
+RUN_TEST_CASE(little_endian_rows);
+RUN_TEST_CASE(aligned_rows);
+RUN_TEST_CASE(seek);
+RUN_TEST_CASE(filter);
+RUN_TEST_CASE(bloom_filter);
+RUN_TEST_CASE(schema_mismatch);
+NO_MORE_TEST_CASES;
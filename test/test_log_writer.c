@@ -0,0 +1,704 @@
+#include <string.h>
+#include <unistd.h>
+
+#include <unibinlog/log_reader.h>
+#include <unibinlog/log_writer.h>
+#include <unibinlog/lowlevel.h>
+#include "fmemopen.h"
+#include "common.c"
+
+static void make_row(uint8_t* row, uint16_t counter, uint8_t flag) {
+    row[0] = counter >> 8;
+    row[1] = counter & 0xFF;
+    row[2] = flag;
+}
+
+TEST_CASE(write_rows) {
+    char buffer[256];
+    FILE* f;
+    ub_log_column_t columns[2];
+    ub_log_writer_t writer;
+    ub_buffer_t payload;
+    ub_block_type_t block_type;
+    uint8_t row[3];
+    uint16_t i;
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "flag", UB_DATATYPE_BOOLEAN);
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    if (ub_log_writer_init(&writer, f, columns, 2, UB_CHKSUM_SUM))
+        return 1;
+
+    /* two rows per block */
+    if (ub_log_writer_set_block_length(&writer, 7))
+        return 2;
+
+    for (i = 0; i < 5; i++) {
+        make_row(row, i, i % 2);
+        if (ub_log_writer_write_row(&writer, row, 3))
+            return 3;
+    }
+
+    /* rows of the wrong length must be rejected */
+    if (ub_log_writer_write_row(&writer, row, 2) != UB_EINVAL)
+        return 4;
+
+    /* settings cannot be changed while there are pending rows */
+    if (ub_log_writer_set_block_length(&writer, 100) != UB_EINVAL)
+        return 5;
+
+    if (ub_log_writer_close(&writer))
+        return 6;
+    ub_log_writer_destroy(&writer);
+
+    /* read back the file */
+    rewind(f);
+    ub_buffer_init(&payload, 0);
+    if (ub_read_header(f, 0, 0))
+        return 7;
+    if (ub_read_block(f, &block_type, &payload, UB_CHKSUM_SUM) ||
+            block_type != UB_BLOCK_LOG_HEADER)
+        return 8;
+    for (i = 0; i < 3; i++) {
+        if (ub_read_block(f, &block_type, &payload, UB_CHKSUM_SUM) ||
+                block_type != UB_BLOCK_LOG_ENTRY)
+            return 9;
+        if (ub_buffer_size(&payload) != (i < 2 ? 6 : 3))
+            return 10;
+        make_row(row, 2*i, 0);
+        if (memcmp(UB_BUFFER(payload), row, 3))
+            return 11;
+    }
+
+    ub_buffer_destroy(&payload);
+    fclose(f);
+    ub_log_column_destroy_array(columns, 2);
+
+    return 0;
+}
+
+TEST_CASE(write_encoded_rows) {
+    char buffer[256];
+    FILE* f;
+    ub_log_column_t columns[2];
+    ub_log_writer_t writer;
+    ub_buffer_t payload, rows;
+    ub_block_type_t block_type;
+    uint8_t row[3];
+    size_t num_rows;
+    uint16_t i;
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "flag", UB_DATATYPE_BOOLEAN);
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    ub_log_writer_init(&writer, f, columns, 2, UB_CHKSUM_FLETCHER_16);
+    if (ub_log_writer_set_codec(&writer, UB_MAX_CODEC, 0) != UB_EINVAL)
+        return 1;
+    if (ub_log_writer_set_codec(&writer, UB_CODEC_AUTO, 8))
+        return 2;
+
+    for (i = 0; i < 20; i++) {
+        make_row(row, 1000 + i, 1);
+        if (ub_log_writer_write_row(&writer, row, 3))
+            return 3;
+    }
+
+    if (ub_log_writer_close(&writer))
+        return 4;
+    ub_log_writer_destroy(&writer);
+
+    /* read back the file */
+    rewind(f);
+    ub_buffer_init(&payload, 0);
+    ub_buffer_init(&rows, 0);
+    ub_read_header(f, 0, 0);
+    ub_read_block(f, &block_type, &payload, UB_CHKSUM_FLETCHER_16);
+    if (ub_read_block(f, &block_type, &payload, UB_CHKSUM_FLETCHER_16) ||
+            block_type != UB_BLOCK_ENCODED_LOG_ENTRY)
+        return 5;
+
+    /* 2 bytes for the row count, 3+2+19 bytes for the delta-encoded counter,
+     * 3+2 bytes for the run-length encoded flag */
+    if (ub_buffer_size(&payload) != 2 + 24 + 5)
+        return 6;
+
+    if (ub_codec_decode_log_entries(columns, 2, UB_BUFFER(payload),
+                ub_buffer_size(&payload), &rows, &num_rows))
+        return 7;
+    if (num_rows != 20)
+        return 8;
+    for (i = 0; i < 20; i++) {
+        make_row(row, 1000 + i, 1);
+        if (memcmp(UB_BUFFER(rows) + 3*i, row, 3))
+            return 9;
+    }
+
+    if (ub_read_block(f, &block_type, &payload, UB_CHKSUM_FLETCHER_16) != UB_EOF)
+        return 10;
+
+    ub_buffer_destroy(&rows);
+    ub_buffer_destroy(&payload);
+    fclose(f);
+    ub_log_column_destroy_array(columns, 2);
+
+    return 0;
+}
+
+TEST_CASE(variable_length_rows) {
+    char buffer[256];
+    FILE* f;
+    ub_log_column_t column;
+    ub_log_writer_t writer;
+
+    ub_log_column_init(&column, "message", UB_DATATYPE_STRING);
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    ub_log_writer_init(&writer, f, &column, 1, UB_CHKSUM_NONE);
+    if (ub_log_writer_set_codec(&writer, UB_CODEC_AUTO, 0) != UB_EUNSUPPORTED)
+        return 1;
+    if (ub_log_writer_write_row(&writer, "spam", 5))
+        return 2;
+    if (ub_log_writer_write_row(&writer, "eggs", 5))
+        return 3;
+    if (ub_log_writer_close(&writer))
+        return 4;
+    ub_log_writer_destroy(&writer);
+    fclose(f);
+
+    /* header (8 bytes), log header block (3+1+10 bytes), then the entries */
+    if (memcmp(buffer + 22, "\x03\x00\x0Aspam\0eggs\0", 13))
+        return 5;
+
+    ub_log_column_destroy(&column);
+
+    return 0;
+}
+
+static int write_column_log(char* buffer, size_t size, int by_columns) {
+    static uint16_t counters[1000];
+    static double values[1000];
+    static ub_bool_t flags[1000];
+    const void* columns_values[3] = { counters, values, flags };
+    ub_log_column_t columns[3];
+    ub_log_writer_t writer;
+    ub_buffer_t row;
+    ub_buffer_writer_t row_writer;
+    FILE* f;
+    size_t i;
+
+    for (i = 0; i < 1000; i++) {
+        counters[i] = i * 3;
+        values[i] = i / 8.0;
+        flags[i] = i % 3 == 0;
+    }
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "value", UB_DATATYPE_DOUBLE);
+    ub_log_column_init(&columns[2], "flag", UB_DATATYPE_BOOLEAN);
+
+    f = fmemopen(buffer, size, "w+");
+    ub_log_writer_init(&writer, f, columns, 3, UB_CHKSUM_FLETCHER_16);
+
+    if (by_columns) {
+        /* split into two calls to test appending to a partial block */
+        if (ub_log_writer_write_columns(&writer, columns_values, 10))
+            return 1;
+        columns_values[0] = counters + 10;
+        columns_values[1] = values + 10;
+        columns_values[2] = flags + 10;
+        if (ub_log_writer_write_columns(&writer, columns_values, 990))
+            return 2;
+    } else {
+        ub_buffer_init(&row, 11);
+        for (i = 0; i < 1000; i++) {
+            ub_buffer_writer_init(&row_writer, &row, 0, 0);
+            ub_buffer_writer_write_u16(&row_writer, counters[i]);
+            ub_buffer_writer_write_double(&row_writer, values[i]);
+            ub_buffer_writer_write_u8(&row_writer, flags[i]);
+            ub_buffer_writer_destroy(&row_writer);
+            if (ub_log_writer_write_row(&writer, UB_BUFFER(row), 11))
+                return 3;
+        }
+        ub_buffer_destroy(&row);
+    }
+
+    ub_log_writer_close(&writer);
+    ub_log_writer_destroy(&writer);
+    fclose(f);
+    ub_log_column_destroy_array(columns, 3);
+
+    return 0;
+}
+
+TEST_CASE(write_columns) {
+    static char buffer[16384], expected[16384];
+    ub_log_column_t column;
+    ub_log_writer_t writer;
+    const void* values[1] = { "abc" };
+    int retval;
+
+    memset(buffer, 0, sizeof(buffer));
+    memset(expected, 0, sizeof(expected));
+
+    if ((retval = write_column_log(buffer, sizeof(buffer), 1)))
+        return retval;
+    if ((retval = write_column_log(expected, sizeof(expected), 0)))
+        return 10 + retval;
+    if (memcmp(buffer, expected, sizeof(buffer)))
+        return 20;
+
+    /* variable-length columns are not supported */
+    ub_log_column_init(&column, "message", UB_DATATYPE_STRING);
+    ub_log_writer_init(&writer, 0, &column, 1, UB_CHKSUM_NONE);
+    if (ub_log_writer_write_columns(&writer, values, 1) != UB_EUNSUPPORTED)
+        return 21;
+    ub_log_writer_destroy(&writer);
+    ub_log_column_destroy(&column);
+
+    return 0;
+}
+
+/* Number of rows in the logs of the append tests; the log is longer than
+ * the window read from the end of the file */
+#define NUM_APPEND_ROWS 120000
+
+static int write_counter_rows(ub_log_writer_t* writer, size_t first,
+        size_t num_rows) {
+    uint8_t row[3];
+    size_t i;
+
+    for (i = first; i < first + num_rows; i++) {
+        make_row(row, i, i % 2);
+        if (ub_log_writer_write_row(writer, row, 3))
+            return 1;
+    }
+
+    return 0;
+}
+
+/* Writes a log that ends with a torn block; the rows of the last block
+ * are not flushed. Returns the number of intact rows */
+static int write_torn_log(FILE* f, ub_log_column_t* columns,
+        uint64_t sync_interval, uint64_t* num_rows) {
+    ub_log_writer_t writer;
+    int retval = 0;
+
+    if (ub_log_writer_init(&writer, f, columns, 2, UB_CHKSUM_FLETCHER_16))
+        return 1;
+
+    if (ub_log_writer_set_block_length(&writer, 200) ||
+            ub_log_writer_set_sync_interval(&writer, sync_interval) ||
+            write_counter_rows(&writer, 0, NUM_APPEND_ROWS))
+        retval = 2;
+
+    *num_rows = writer.num_rows_written;
+    ub_log_writer_destroy(&writer);
+
+    /* a log entry block whose payload was not written completely */
+    if (!retval && fwrite("\x03\x00\xc8\x00\x01\x00", 1, 6, f) != 6)
+        retval = 3;
+
+    return retval;
+}
+
+/* Checks that the log holds the given number of consecutive rows */
+static int check_counter_log(FILE* f, uint64_t num_rows) {
+    ub_log_reader_t reader;
+    ub_error_t retval;
+    uint8_t row[3];
+    uint64_t n = 0;
+    size_t i;
+
+    rewind(f);
+    if (ub_log_reader_init(&reader, f))
+        return 10;
+
+    while ((retval = ub_log_reader_next_block(&reader)) == UB_SUCCESS) {
+        for (i = 0; i < reader.num_rows; i++, n++) {
+            make_row(row, n, n % 2);
+            if (reader.first_row + i != n ||
+                    memcmp(ub_log_reader_get_row(&reader, i), row, 3))
+                break;
+        }
+        if (i < reader.num_rows)
+            break;
+    }
+
+    ub_log_reader_destroy(&reader);
+
+    if (retval != UB_EOF)
+        return 11;
+    return n == num_rows ? 0 : 12;
+}
+
+static int append_to_torn_log(uint64_t sync_interval) {
+    ub_log_column_t columns[2];
+    ub_log_writer_t writer;
+    uint64_t num_rows;
+    FILE* f;
+    int retval;
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "flag", UB_DATATYPE_BOOLEAN);
+
+    f = tmpfile();
+    if (f == 0)
+        return 1;
+
+    retval = write_torn_log(f, columns, sync_interval, &num_rows);
+
+    if (!retval && ub_log_writer_init_append(&writer, f, columns, 2))
+        retval = 2;
+    if (!retval) {
+        /* without sync blocks, the rows before the window are not counted
+         * and the row numbers of new sync blocks would be wrong */
+        if (writer.chksum_type != UB_CHKSUM_FLETCHER_16 ||
+                writer.rows_unknown != (sync_interval == 0) ||
+                writer.num_rows_written != (sync_interval ? num_rows : 0))
+            retval = 3;
+        else if (!sync_interval && ub_log_writer_set_sync_interval(&writer,
+                    4096) != UB_EUNSUPPORTED)
+            retval = 5;
+        else if (ub_log_writer_set_sync_interval(&writer, sync_interval) ||
+                ub_log_writer_set_block_length(&writer, 200) ||
+                write_counter_rows(&writer, num_rows, 1000) ||
+                ub_log_writer_close(&writer))
+            retval = 4;
+        ub_log_writer_destroy(&writer);
+    }
+
+    if (!retval)
+        retval = check_counter_log(f, num_rows + 1000);
+
+    fclose(f);
+    ub_log_column_destroy_array(columns, 2);
+
+    return retval;
+}
+
+TEST_CASE(append_with_sync_blocks) {
+    return append_to_torn_log(4096);
+}
+
+TEST_CASE(append_without_sync_blocks) {
+    return append_to_torn_log(0);
+}
+
+/* Damages a block the given number of bytes before the end of a log; the
+ * intact blocks after it must not be cut off when appending to the log */
+static int append_to_corrupted_log(uint64_t sync_interval, size_t num_rows,
+        long distance, ub_error_t expected) {
+    ub_log_column_t columns[2];
+    ub_log_writer_t writer;
+    long size;
+    int byte, retval = 0;
+    FILE* f;
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "flag", UB_DATATYPE_BOOLEAN);
+
+    f = tmpfile();
+    if (f == 0)
+        return 1;
+
+    if (ub_log_writer_init(&writer, f, columns, 2, UB_CHKSUM_FLETCHER_16))
+        return 2;
+    if (ub_log_writer_set_block_length(&writer, 200) ||
+            ub_log_writer_set_sync_interval(&writer, sync_interval) ||
+            write_counter_rows(&writer, 0, num_rows) ||
+            ub_log_writer_close(&writer))
+        retval = 3;
+    ub_log_writer_destroy(&writer);
+
+    size = ftell(f);
+    if (!retval && (fseek(f, size - distance, SEEK_SET) ||
+                (byte = fgetc(f)) == EOF ||
+                fseek(f, size - distance, SEEK_SET) ||
+                fputc(byte ^ 1, f) == EOF || fflush(f)))
+        retval = 4;
+
+    if (!retval && ub_log_writer_init_append(&writer, f, columns, 2) !=
+            expected)
+        retval = 5;
+    if (!retval && expected == UB_SUCCESS)
+        ub_log_writer_destroy(&writer);
+    if (!retval && (fseek(f, 0, SEEK_END) || ftell(f) != size))
+        retval = 6;
+
+    fclose(f);
+    ub_log_column_destroy_array(columns, 2);
+
+    return retval;
+}
+
+TEST_CASE(append_to_corrupted_log) {
+    int retval;
+
+    /* the whole log is walked */
+    retval = append_to_corrupted_log(4096, 20000, 10000, UB_EPARSE);
+    if (retval)
+        return 10 + retval;
+
+    /* the log is walked from the last sync block, which comes after the
+     * damaged block or before it */
+    retval = append_to_corrupted_log(4096, NUM_APPEND_ROWS, 10000,
+            UB_SUCCESS);
+    if (retval)
+        return 20 + retval;
+    retval = append_to_corrupted_log(4096, NUM_APPEND_ROWS, 600, UB_EPARSE);
+    if (retval)
+        return 30 + retval;
+
+    return 0;
+}
+
+TEST_CASE(append_to_indexed_log) {
+    ub_log_column_t columns[2];
+    ub_log_writer_t writer;
+    ub_log_reader_t reader;
+    size_t index;
+    FILE* f;
+    int retval = 0;
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "flag", UB_DATATYPE_BOOLEAN);
+
+    f = tmpfile();
+    if (f == 0)
+        return 1;
+
+    if (ub_log_writer_init(&writer, f, columns, 2, UB_CHKSUM_FLETCHER_16))
+        return 2;
+    if (ub_log_writer_set_index(&writer, 1) ||
+            ub_log_writer_set_timestamp_column(&writer, 0) ||
+            ub_log_writer_set_block_length(&writer, 200) ||
+            write_counter_rows(&writer, 0, 1000) ||
+            ub_log_writer_close(&writer))
+        retval = 3;
+    ub_log_writer_destroy(&writer);
+
+    /* the index is read back and written again with the new blocks */
+    if (!retval && ub_log_writer_init_append(&writer, f, columns, 2))
+        retval = 4;
+    if (!retval) {
+        if (!writer.indexed || writer.num_rows_written != 1000 ||
+                writer.index.timestamp_column != 0)
+            retval = 5;
+        else if (ub_log_writer_set_byte_order(&writer,
+                    UB_LITTLE_ENDIAN) != UB_EINVAL ||
+                ub_log_writer_set_timestamp_column(&writer,
+                    UB_BLOCK_INDEX_NO_TIMESTAMP) != UB_EINVAL)
+            retval = 6;
+        else if (write_counter_rows(&writer, 1000, 500) ||
+                ub_log_writer_close(&writer))
+            retval = 7;
+        ub_log_writer_destroy(&writer);
+    }
+
+    if (!retval)
+        retval = check_counter_log(f, 1500);
+
+    rewind(f);
+    if (!retval && ub_log_reader_init(&reader, f))
+        retval = 8;
+    if (!retval) {
+        if (ub_log_reader_load_index(&reader) ||
+                ub_block_index_get_num_rows(&reader.index) != 1500 ||
+                ub_log_reader_seek_row(&reader, 1234, &index) ||
+                reader.first_row + index != 1234)
+            retval = 9;
+        ub_log_reader_destroy(&reader);
+    }
+
+    fclose(f);
+    ub_log_column_destroy_array(columns, 2);
+
+    return retval;
+}
+
+TEST_CASE(append_mismatch) {
+    ub_log_column_t columns[2];
+    ub_log_writer_t writer;
+    char buffer[64];
+    FILE* f;
+    int retval = 0;
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "flag", UB_DATATYPE_BOOLEAN);
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    if (ub_log_writer_init(&writer, f, columns, 2, UB_CHKSUM_NONE) ||
+            ub_log_writer_close(&writer))
+        retval = 1;
+    ub_log_writer_destroy(&writer);
+
+    /* the columns must match the ones in the file */
+    ub_log_column_set_name(&columns[1], "other");
+    if (!retval && ub_log_writer_init_append(&writer, f, columns, 2) !=
+            UB_EINVAL)
+        retval = 2;
+    if (!retval && ub_log_writer_init_append(&writer, f, columns, 1) !=
+            UB_EINVAL)
+        retval = 3;
+    fclose(f);
+
+    /* not a log */
+    memset(buffer, 0, sizeof(buffer));
+    f = fmemopen(buffer, sizeof(buffer), "r+");
+    if (!retval && ub_log_writer_init_append(&writer, f, columns, 2) !=
+            UB_EPARSE)
+        retval = 4;
+    fclose(f);
+
+    ub_log_column_destroy_array(columns, 2);
+
+    return retval;
+}
+
+TEST_CASE(durability) {
+    ub_log_column_t columns[2];
+    ub_log_writer_t writer;
+    size_t i;
+    FILE* f;
+    int retval = 0;
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "flag", UB_DATATYPE_BOOLEAN);
+
+    f = tmpfile();
+    if (f == 0)
+        return 1;
+
+    if (ub_log_writer_init(&writer, f, columns, 2, UB_CHKSUM_FLETCHER_16))
+        return 2;
+
+    if (ub_log_writer_set_durability(&writer, UB_DURABILITY_BLOCK_COUNT, 0) !=
+            UB_EINVAL ||
+            ub_log_writer_set_durability(&writer, UB_DURABILITY_INTERVAL, 0) !=
+            UB_EINVAL ||
+            ub_log_writer_set_durability(&writer, (ub_durability_t)42, 1) !=
+            UB_EINVAL)
+        retval = 3;
+
+    /* 10 rows per block; a sync every 4 blocks */
+    if (!retval && (ub_log_writer_set_block_length(&writer, 30) ||
+                ub_log_writer_set_durability(&writer,
+                    UB_DURABILITY_BLOCK_COUNT, 4)))
+        retval = 4;
+    for (i = 0; i < 20 && !retval; i++) {
+        if (write_counter_rows(&writer, i * 10, 10) ||
+                ub_log_writer_flush(&writer))
+            retval = 5;
+        else if (writer.unsynced_blocks != (i + 1) % 4)
+            retval = 6;
+    }
+
+    /* an explicit sync is always done */
+    if (!retval && (write_counter_rows(&writer, 200, 10) ||
+                ub_log_writer_sync(&writer) || writer.unsynced_blocks != 0))
+        retval = 7;
+
+    if (!retval && (ub_log_writer_set_durability(&writer,
+                    UB_DURABILITY_BLOCK, 0) ||
+                write_counter_rows(&writer, 210, 10) ||
+                ub_log_writer_flush(&writer) || writer.unsynced_blocks != 0))
+        retval = 8;
+
+    /* an interval that never expires during the test */
+    if (!retval && (ub_log_writer_set_durability(&writer,
+                    UB_DURABILITY_INTERVAL, 3600000) ||
+                write_counter_rows(&writer, 220, 30) ||
+                ub_log_writer_flush(&writer) || writer.unsynced_blocks != 3))
+        retval = 9;
+
+    if (!retval && (ub_log_writer_close(&writer) ||
+                writer.unsynced_blocks != 0))
+        retval = 10;
+    ub_log_writer_destroy(&writer);
+
+    if (!retval)
+        retval = check_counter_log(f, 250);
+
+    fclose(f);
+    ub_log_column_destroy_array(columns, 2);
+
+    return retval;
+}
+
+TEST_CASE(durability_interval) {
+#ifdef HAVE_PTHREAD
+    ub_log_column_t columns[2];
+    ub_log_writer_t writers[2];
+    char buffer[256];
+    int retval = 0;
+    FILE *f, *g;
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "flag", UB_DATATYPE_BOOLEAN);
+
+    /* memory streams cannot be synced */
+    g = fmemopen(buffer, sizeof(buffer), "w");
+    if (g == 0 || ub_log_writer_init(&writers[0], g, columns, 2,
+                UB_CHKSUM_NONE))
+        return 1;
+    if (ub_log_writer_set_durability(&writers[0], UB_DURABILITY_INTERVAL,
+                1) != UB_EUNSUPPORTED ||
+            ub_log_writer_sync(&writers[0]) != UB_EUNSUPPORTED)
+        retval = 2;
+    ub_log_writer_destroy(&writers[0]);
+    fclose(g);
+
+    /* /dev/null cannot be synced either, but only the sync thread finds
+     * out, and the writers of the file share the thread */
+    f = fopen("/dev/null", "wb");
+    if (f == 0) {
+        ub_log_column_destroy_array(columns, 2);
+        return retval;
+    }
+    if (ub_log_writer_init(&writers[0], f, columns, 2, UB_CHKSUM_NONE) ||
+            ub_log_writer_init(&writers[1], f, columns, 2, UB_CHKSUM_NONE))
+        return 3;
+
+    if (!retval && (ub_log_writer_set_durability(&writers[0],
+                    UB_DURABILITY_INTERVAL, 3600000) ||
+                ub_log_writer_set_durability(&writers[1],
+                    UB_DURABILITY_INTERVAL, 1) ||
+                writers[0].sync_thread == 0 ||
+                writers[0].sync_thread != writers[1].sync_thread))
+        retval = 4;
+    if (!retval && (write_counter_rows(&writers[0], 0, 10) ||
+                ub_log_writer_flush(&writers[0])))
+        retval = 5;
+
+    /* the error is reported even though no block is written any more */
+    usleep(100000);
+    if (!retval && (ub_log_writer_flush(&writers[0]) != UB_EWRITE ||
+                ub_log_writer_flush(&writers[1]) != UB_EWRITE))
+        retval = 6;
+
+    ub_log_writer_destroy(&writers[0]);
+    ub_log_writer_destroy(&writers[1]);
+    fclose(f);
+    ub_log_column_destroy_array(columns, 2);
+
+    return retval;
+#else
+    return 0;
+#endif
+}
+
+START_OF_TESTS;
+RUN_TEST_CASE(write_rows);
+RUN_TEST_CASE(write_encoded_rows);
+RUN_TEST_CASE(variable_length_rows);
+RUN_TEST_CASE(write_columns);
+RUN_TEST_CASE(append_with_sync_blocks);
+RUN_TEST_CASE(append_without_sync_blocks);
+RUN_TEST_CASE(append_to_corrupted_log);
+RUN_TEST_CASE(append_to_indexed_log);
+RUN_TEST_CASE(append_mismatch);
+RUN_TEST_CASE(durability);
+RUN_TEST_CASE(durability_interval);
+NO_MORE_TEST_CASES;
@@ -0,0 +1,127 @@
+#include <cstring>
+
+#include <unibinlog/log_writer.hpp>
+#include <unibinlog/lowlevel.h>
+#include "fmemopen.h"
+#include "common.c"
+
+using namespace unibinlog;
+
+typedef log_writer<std::uint16_t, float, bool, std::int64_t> test_writer;
+
+static_assert(test_writer::num_columns == 4, "wrong number of columns");
+static_assert(test_writer::row_length == 15, "wrong row length");
+static_assert(test_writer::offsets[3] == 7, "wrong column offset");
+static_assert(test_writer::types[1] == UB_DATATYPE_FLOAT, "wrong column type");
+
+TEST_CASE(encode) {
+    std::uint8_t row[test_writer::row_length];
+    const std::uint8_t expected[] = {
+        0x12, 0x34,                                      /* 0x1234 */
+        0x3F, 0xC0, 0x00, 0x00,                          /* 1.5f */
+        0x01,                                            /* true */
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE   /* -2 */
+    };
+
+    test_writer::encode(row, 0x1234, 1.5f, true, -2);
+    if (std::memcmp(row, expected, sizeof(expected)))
+        return 1;
+
+    return 0;
+}
+
+TEST_CASE(write) {
+    char buffer[128], expected[128];
+    ub_log_column_t columns[2];
+    ub_log_writer_t c_writer;
+    std::uint8_t row[6];
+    FILE* f;
+
+    std::memset(buffer, 0, sizeof(buffer));
+    std::memset(expected, 0, sizeof(expected));
+
+    /* write the file with the typed writer */
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    {
+        log_writer<std::uint16_t, std::int32_t> writer(f, { "x", "y" });
+        writer.write(1, -1);
+        writer.write(2, 65536);
+        writer.close();
+
+        log_writer<std::uint16_t, std::int32_t> moved(std::move(writer));
+    }
+    fclose(f);
+
+    /* write the same file with the C API */
+    ub_log_column_init(&columns[0], "x", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "y", UB_DATATYPE_S32);
+    f = fmemopen(expected, sizeof(expected), "w+");
+    ub_log_writer_init(&c_writer, f, columns, 2, UB_CHKSUM_FLETCHER_16);
+    std::memcpy(row, "\x00\x01\xFF\xFF\xFF\xFF", 6);
+    ub_log_writer_write_row(&c_writer, row, 6);
+    std::memcpy(row, "\x00\x02\x00\x01\x00\x00", 6);
+    ub_log_writer_write_row(&c_writer, row, 6);
+    ub_log_writer_close(&c_writer);
+    ub_log_writer_destroy(&c_writer);
+    fclose(f);
+    ub_log_column_destroy_array(columns, 2);
+
+    if (std::memcmp(buffer, expected, sizeof(buffer)))
+        return 1;
+
+    return 0;
+}
+
+TEST_CASE(write_columns) {
+    char buffer[256], expected[256];
+    const std::uint16_t xs[] = { 1, 2, 3 };
+    const double ys[] = { 0.5, -1.0, 2.25 };
+    FILE* f;
+
+    std::memset(buffer, 0, sizeof(buffer));
+    std::memset(expected, 0, sizeof(expected));
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    {
+        log_writer<std::uint16_t, double> writer(f, { "x", "y" });
+        writer.write_columns(3, xs, ys);
+    }
+    fclose(f);
+
+    f = fmemopen(expected, sizeof(expected), "w+");
+    {
+        log_writer<std::uint16_t, double> writer(f, { "x", "y" });
+        for (int i = 0; i < 3; i++) {
+            writer.write(xs[i], ys[i]);
+        }
+    }
+    fclose(f);
+
+    if (std::memcmp(buffer, expected, sizeof(buffer)))
+        return 1;
+
+    return 0;
+}
+
+TEST_CASE(errors) {
+    char buffer[128];
+    FILE* f = fmemopen(buffer, sizeof(buffer), "w+");
+    int retval = 1;
+
+    try {
+        log_writer<double> writer(f, { "value" });
+        writer.set_block_length(100000);
+    } catch (const error& ex) {
+        retval = ex.code() == UB_EINVAL ? 0 : 2;
+    }
+
+    fclose(f);
+    return retval;
+}
+
+START_OF_TESTS;
+RUN_TEST_CASE(encode);
+RUN_TEST_CASE(write);
+RUN_TEST_CASE(write_columns);
+RUN_TEST_CASE(errors);
+NO_MORE_TEST_CASES;
@@ -126,6 +126,40 @@ TEST_CASE(write_comment_block) {
     return 0;
 }
 
+TEST_CASE(write_padding_block) {
+    char buffer[64];
+    size_t start;
+    long pos;
+    FILE* f;
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+
+    /* no padding is needed if the next payload is aligned already */
+    ub_write_byte_array(f, "\0\0\0\0\0", 5);
+    if (ub_write_padding_block(f, 8, UB_CHKSUM_FLETCHER_16) || ftell(f) != 5)
+        return 1;
+
+    for (start = 6; start < 13; start++) {
+        fseek(f, start, SEEK_SET);
+        if (ub_write_padding_block(f, 8, UB_CHKSUM_FLETCHER_16))
+            return 2;
+
+        fflush(f);
+        pos = ftell(f);
+        if ((pos + 3) % 8 != 0)
+            return 3;
+        if (buffer[start] != UB_BLOCK_PADDING ||
+                pos - start != buffer[start + 2] + 5)
+            return 4;
+    }
+
+    if (ub_write_padding_block(f, 0, UB_CHKSUM_NONE) != UB_EINVAL)
+        return 5;
+
+    fclose(f);
+    return 0;
+}
+
 TEST_CASE(write_log_header_block) {
     char buffer[48];
     ub_buffer_t view;
@@ -153,10 +187,138 @@ TEST_CASE(write_log_header_block) {
     return 0;
 }
 
+TEST_CASE(find_sync_block) {
+    char buffer[128];
+    size_t offset, length;
+    uint64_t schema_id, row;
+    FILE* f;
+
+    /* junk that looks like the start of a sync block comes first */
+    memset(buffer, 0, sizeof(buffer));
+    memcpy(buffer, "\x0d\x00\x20UBSYNC", 9);
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    fseek(f, 21, SEEK_SET);
+    if (ub_write_sync_block(f, 0x1234, 0x0102030405060708ULL,
+                UB_CHKSUM_FLETCHER_16))
+        return 1;
+    fflush(f);
+    length = ftell(f);
+    fclose(f);
+
+    if (length != 21 + 3 + UB_SYNC_BLOCK_LENGTH + 2 ||
+            buffer[21] != UB_BLOCK_SYNC)
+        return 2;
+
+    if (ub_find_sync_block(buffer, length, UB_CHKSUM_FLETCHER_16, &offset,
+                &schema_id, &row) || offset != 21 || schema_id != 0x1234 ||
+            row != 0x0102030405060708ULL)
+        return 3;
+
+    /* truncated and corrupted blocks are not found */
+    if (ub_find_sync_block(buffer, length - 1, UB_CHKSUM_FLETCHER_16,
+                &offset, 0, 0) != UB_EOF)
+        return 4;
+    buffer[length - 1] ^= 1;
+    if (ub_find_sync_block(buffer, length, UB_CHKSUM_FLETCHER_16, &offset,
+                0, 0) != UB_EOF)
+        return 5;
+
+    return 0;
+}
+
+TEST_CASE(read_header) {
+    char buffer[32];
+    uint8_t version, flags;
+    ub_chksum_type_t chksum_type;
+    FILE* f;
+
+    f = fmemopen(buffer, 32, "w+");
+    ub_write_header(f, 42, UB_CHKSUM_FLETCHER_16);
+    rewind(f);
+    if (ub_read_header(f, &version, &chksum_type))
+        return 1;
+    if (version != 42 || chksum_type != UB_CHKSUM_FLETCHER_16)
+        return 2;
+    fclose(f);
+
+    /* Header flags share the byte of the checksum type */
+    f = fmemopen(buffer, 32, "w+");
+    if (ub_write_header_with_flags(f, 1, UB_CHKSUM_SUM, 0x01) != UB_EINVAL)
+        return 4;
+    ub_write_header_with_flags(f, 1, UB_CHKSUM_SUM, UB_HEADER_FLAG_LITTLE_ENDIAN);
+    rewind(f);
+    if (ub_read_header_with_flags(f, &version, &chksum_type, &flags))
+        return 5;
+    if (chksum_type != UB_CHKSUM_SUM || flags != UB_HEADER_FLAG_LITTLE_ENDIAN)
+        return 6;
+    rewind(f);
+    if (ub_read_header(f, &version, &chksum_type) || chksum_type != UB_CHKSUM_SUM)
+        return 7;
+    fclose(f);
+
+    /* Not a unibin file */
+    f = fmemopen(buffer, 32, "w+");
+    fputs("UNIBAN\x01\x01", f);
+    rewind(f);
+    if (ub_read_header(f, &version, &chksum_type) != UB_EPARSE)
+        return 3;
+    fclose(f);
+
+    return 0;
+}
+
+TEST_CASE(read_block) {
+    char buffer[64];
+    const char* payload = "Spanish Inquisition";
+    ub_buffer_t buf;
+    ub_block_type_t block_type;
+    FILE* f;
+
+    ub_buffer_init(&buf, 0);
+
+    f = fmemopen(buffer, 64, "w+");
+    ub_write_comment_block(f, payload, UB_CHKSUM_FLETCHER_16);
+    ub_write_comment_block(f, payload, UB_CHKSUM_FLETCHER_16);
+    rewind(f);
+    if (ub_read_block(f, &block_type, &buf, UB_CHKSUM_FLETCHER_16))
+        return 1;
+    if (block_type != UB_BLOCK_COMMENT || ub_buffer_size(&buf) != 19)
+        return 2;
+    if (memcmp(UB_BUFFER(buf), payload, 19))
+        return 3;
+    fclose(f);
+
+    /* Corrupted checksum */
+    buffer[30] ^= 0x20;
+    f = fmemopen(buffer, 64, "r");
+    if (ub_read_block(f, &block_type, &buf, UB_CHKSUM_FLETCHER_16))
+        return 4;
+    if (ub_read_block(f, &block_type, &buf, UB_CHKSUM_FLETCHER_16) != UB_EPARSE)
+        return 5;
+    fclose(f);
+
+    /* Truncated block */
+    f = fmemopen(buffer, 30, "r");
+    if (ub_read_block(f, &block_type, &buf, UB_CHKSUM_FLETCHER_16))
+        return 6;
+    if (ub_read_block(f, &block_type, &buf, UB_CHKSUM_FLETCHER_16) != UB_EREAD)
+        return 7;
+    fclose(f);
+
+    ub_buffer_destroy(&buf);
+
+    return 0;
+}
+
 START_OF_TESTS;
 RUN_TEST_CASE(write_byte_array);
 RUN_TEST_CASE(write_header);
 RUN_TEST_CASE(write_block);
 RUN_TEST_CASE(write_comment_block);
+RUN_TEST_CASE(write_padding_block);
 RUN_TEST_CASE(write_log_header_block);
+RUN_TEST_CASE(find_sync_block);
+RUN_TEST_CASE(read_header);
+RUN_TEST_CASE(read_block);
 NO_MORE_TEST_CASES;
@@ -0,0 +1,209 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <unibinlog/log_reader.h>
+#include <unibinlog/log_writer.h>
+#include <unibinlog/memory.h>
+#include "fmemopen.h"
+#include "common.c"
+
+/* State of the counting allocator */
+typedef struct {
+    size_t allocations;
+    size_t live;
+} counter_t;
+
+static void* counting_malloc(size_t size, void* context) {
+    counter_t* counter = (counter_t*)context;
+
+    counter->allocations++;
+    counter->live++;
+    return malloc(size);
+}
+
+static void* counting_calloc(size_t count, size_t size, void* context) {
+    counter_t* counter = (counter_t*)context;
+
+    counter->allocations++;
+    counter->live++;
+    return calloc(count, size);
+}
+
+static void* counting_realloc(void* ptr, size_t size, void* context) {
+    counter_t* counter = (counter_t*)context;
+
+    if (ptr == 0) {
+        counter->allocations++;
+        counter->live++;
+    }
+    return realloc(ptr, size);
+}
+
+static void counting_free(void* ptr, void* context) {
+    counter_t* counter = (counter_t*)context;
+
+    if (ptr != 0)
+        counter->live--;
+    free(ptr);
+}
+
+/* Writes a short log and reads it back */
+static int write_and_read_log(void) {
+    static char buffer[4096];
+    ub_log_column_t columns[2];
+    ub_log_writer_t writer;
+    ub_log_reader_t reader;
+    size_t num_rows = 0;
+    uint8_t row[3] = { 1, 2, 1 };
+    int i, retval = 0;
+    FILE* f;
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "flag", UB_DATATYPE_BOOLEAN);
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    if (ub_log_writer_init(&writer, f, columns, 2, UB_CHKSUM_FLETCHER_16))
+        retval = 1;
+    for (i = 0; i < 100 && !retval; i++) {
+        if (ub_log_writer_write_row(&writer, row, 3))
+            retval = 2;
+    }
+    if (!retval && ub_log_writer_close(&writer))
+        retval = 3;
+    ub_log_writer_destroy(&writer);
+    ub_log_column_destroy_array(columns, 2);
+
+    rewind(f);
+    if (!retval && ub_log_reader_init(&reader, f))
+        retval = 4;
+    if (!retval) {
+        while (ub_log_reader_next_block(&reader) == UB_SUCCESS)
+            num_rows += reader.num_rows;
+        if (num_rows != 100 || strcmp(reader.columns[0].name, "counter"))
+            retval = 5;
+        ub_log_reader_destroy(&reader);
+    }
+    fclose(f);
+
+    return retval;
+}
+
+TEST_CASE(counting_allocator) {
+    counter_t counter = { 0, 0 };
+    ub_allocator_t allocator;
+    int retval;
+
+    allocator.malloc = counting_malloc;
+    allocator.calloc = counting_calloc;
+    allocator.realloc = counting_realloc;
+    allocator.free = counting_free;
+    allocator.context = &counter;
+
+    if (ub_memory_set_allocator(&allocator))
+        return 1;
+    if (ub_memory_get_allocator()->context != &counter)
+        return 2;
+
+    /* every allocation of the library goes through the allocator and is
+     * given back */
+    retval = write_and_read_log();
+    ub_memory_set_allocator(0);
+
+    if (retval)
+        return 10 + retval;
+    if (counter.allocations == 0 || counter.live != 0)
+        return 3;
+    if (ub_memory_get_allocator()->context != 0)
+        return 4;
+
+    return 0;
+}
+
+TEST_CASE(allocator_without_calloc) {
+    counter_t counter = { 0, 0 };
+    ub_allocator_t allocator;
+    uint8_t* bytes;
+    char* copy;
+    size_t i;
+    int retval = 0;
+
+    allocator.malloc = counting_malloc;
+    allocator.calloc = 0;
+    allocator.realloc = counting_realloc;
+    allocator.free = 0;
+    allocator.context = &counter;
+
+    /* free is required */
+    if (ub_memory_set_allocator(&allocator) != UB_EINVAL)
+        return 1;
+
+    allocator.free = counting_free;
+    if (ub_memory_set_allocator(&allocator))
+        return 2;
+
+    /* calloc falls back to malloc and zeroes the memory itself */
+    bytes = ub_calloc(uint8_t, 1000);
+    for (i = 0; bytes != 0 && i < 1000; i++) {
+        if (bytes[i] != 0)
+            retval = 3;
+    }
+    if (bytes == 0)
+        retval = 4;
+    ub_free_unless_null(bytes);
+
+    copy = ub_memory_strdup("counter");
+    if (copy == 0 || strcmp(copy, "counter"))
+        retval = 5;
+    ub_free_unless_null(copy);
+
+    /* the size of the array overflows */
+    if (!retval && ub_calloc(uint32_t, SIZE_MAX) != 0)
+        retval = 6;
+
+    ub_memory_set_allocator(0);
+
+    if (!retval && (counter.allocations != 2 || counter.live != 0))
+        retval = 7;
+
+    return retval;
+}
+
+TEST_CASE(aligned_alloc) {
+    counter_t counter = { 0, 0 };
+    ub_allocator_t allocator;
+    void* ptrs[4];
+    size_t alignments[4] = { 1, 64, 512, 4096 };
+    size_t i;
+    int retval = 0;
+
+    allocator.malloc = counting_malloc;
+    allocator.calloc = counting_calloc;
+    allocator.realloc = counting_realloc;
+    allocator.free = counting_free;
+    allocator.context = &counter;
+    ub_memory_set_allocator(&allocator);
+
+    for (i = 0; i < 4; i++) {
+        ptrs[i] = ub_memory_aligned_alloc(alignments[i], 1000);
+        if (ptrs[i] == 0 || (uintptr_t)ptrs[i] % alignments[i] != 0)
+            retval = 1;
+        else
+            memset(ptrs[i], 0xAB, 1000);
+    }
+    for (i = 0; i < 4; i++)
+        ub_memory_aligned_free(ptrs[i]);
+    ub_memory_aligned_free(0);
+
+    ub_memory_set_allocator(0);
+
+    if (!retval && (counter.allocations != 4 || counter.live != 0))
+        retval = 2;
+
+    return retval;
+}
+
+START_OF_TESTS;
+RUN_TEST_CASE(counting_allocator);
+RUN_TEST_CASE(allocator_without_calloc);
+RUN_TEST_CASE(aligned_alloc);
+NO_MORE_TEST_CASES;
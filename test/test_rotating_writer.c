@@ -0,0 +1,313 @@
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <unibinlog/log_reader.h>
+#include <unibinlog/rotating_writer.h>
+#include "fmemopen.h"
+#include "common.c"
+
+#define NUM_ROWS 3000
+
+static void make_row(uint8_t* row, uint16_t counter, uint8_t flag) {
+    row[0] = counter >> 8;
+    row[1] = counter & 0xFF;
+    row[2] = flag;
+}
+
+static ub_error_t setup_writer(ub_log_writer_t* writer, void* user_data) {
+    size_t* num_calls = (size_t*)user_data;
+
+    (*num_calls)++;
+    return ub_log_writer_set_block_length(writer, 150);
+}
+
+/* Reads the rows of the file with the given index, which must continue
+ * the rows read so far, and removes the file. Returns -1 if the file does
+ * not exist */
+static int read_file(const char* dir, uint64_t index, uint64_t* num_rows,
+        long* length) {
+    ub_log_reader_t reader;
+    ub_error_t retval;
+    char path[256];
+    uint8_t row[3];
+    size_t i;
+    FILE* f;
+
+    sprintf(path, "%s/log-%06lu.ubl", dir, (unsigned long)index);
+    f = fopen(path, "rb");
+    if (f == 0)
+        return -1;
+
+    fseek(f, 0, SEEK_END);
+    *length = ftell(f);
+    rewind(f);
+
+    if (ub_log_reader_init(&reader, f)) {
+        fclose(f);
+        return 1;
+    }
+
+    while ((retval = ub_log_reader_next_block(&reader)) == UB_SUCCESS) {
+        for (i = 0; i < reader.num_rows; i++, (*num_rows)++) {
+            make_row(row, *num_rows, *num_rows % 2);
+            if (memcmp(ub_log_reader_get_row(&reader, i), row, 3))
+                retval = UB_EPARSE;
+        }
+        if (retval != UB_SUCCESS)
+            break;
+    }
+
+    ub_log_reader_destroy(&reader);
+    fclose(f);
+    remove(path);
+
+    return retval == UB_EOF ? 0 : 2;
+}
+
+TEST_CASE(rotate_by_size) {
+    char dir[] = "/tmp/unibinlog-rotation-XXXXXX";
+    char prefix[64];
+    ub_log_column_t columns[2];
+    ub_rotating_writer_t writer;
+    uint8_t row[3];
+    uint64_t index, num_rows = 0;
+    size_t i, num_calls = 0;
+    long length;
+    int retval = 0;
+
+    if (mkdtemp(dir) == 0)
+        return 1;
+    sprintf(prefix, "%s/log-", dir);
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "flag", UB_DATATYPE_BOOLEAN);
+
+    if (ub_rotating_writer_init(&writer, prefix, ".ubl", 7, columns, 2,
+                UB_CHKSUM_FLETCHER_16))
+        return 2;
+    ub_rotating_writer_set_limits(&writer, 1024, 0);
+    ub_rotating_writer_set_setup_func(&writer, setup_writer, &num_calls);
+
+    for (i = 0; i < NUM_ROWS && !retval; i++) {
+        make_row(row, i, i % 2);
+        if (ub_rotating_writer_write_row(&writer, row, 3))
+            retval = 3;
+    }
+
+    /* a rotation on demand */
+    if (!retval && (ub_rotating_writer_rotate(&writer) || writer.index < 10))
+        retval = 4;
+    if (!retval && ub_rotating_writer_close(&writer))
+        retval = 5;
+    if (!retval && num_calls != writer.index - 6)
+        retval = 6;
+
+    /* the rows continue from one file to the next, and the files are
+     * at most one block longer than the limit */
+    for (index = 7; !retval && index < writer.index; index++) {
+        retval = read_file(dir, index, &num_rows, &length);
+        if (retval)
+            retval = 10 + retval;
+        else if (length > 1024 + 150 + 5)
+            retval = 13;
+    }
+    if (!retval && num_rows != NUM_ROWS)
+        retval = 14;
+
+    /* the last file is empty, and the prepared next one is removed */
+    if (!retval && (read_file(dir, writer.index, &num_rows, &length) ||
+                num_rows != NUM_ROWS))
+        retval = 15;
+    if (!retval && read_file(dir, writer.index + 1, &num_rows, &length) != -1)
+        retval = 16;
+
+    ub_rotating_writer_destroy(&writer);
+    ub_log_column_destroy_array(columns, 2);
+    rmdir(dir);
+
+    return retval;
+}
+
+TEST_CASE(rotate_by_time) {
+    char dir[] = "/tmp/unibinlog-rotation-XXXXXX";
+    char prefix[64];
+    ub_log_column_t columns[2];
+    ub_rotating_writer_t writer;
+    uint8_t row[3];
+    uint64_t index, first, num_rows = 0;
+    size_t i;
+    long length;
+    int retval = 0;
+
+    if (mkdtemp(dir) == 0)
+        return 1;
+    sprintf(prefix, "%s/log-", dir);
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "flag", UB_DATATYPE_BOOLEAN);
+
+    if (ub_rotating_writer_init(&writer, prefix, ".ubl", 0, columns, 2,
+                UB_CHKSUM_FLETCHER_16))
+        return 2;
+    ub_rotating_writer_set_limits(&writer, 0, 1);
+
+    /* at most two blocks per file, as the files are at least a millisecond
+     * old when the next block is written */
+    for (i = 0; i < 20 && !retval; i++) {
+        make_row(row, i, i % 2);
+        if (ub_rotating_writer_write_row(&writer, row, 3) ||
+                ub_rotating_writer_flush(&writer))
+            retval = 3;
+        usleep(2000);
+    }
+    if (!retval && (ub_rotating_writer_close(&writer) || writer.index < 19))
+        retval = 4;
+
+    for (index = 0; !retval && index <= writer.index; index++) {
+        first = num_rows;
+        retval = read_file(dir, index, &num_rows, &length);
+        if (retval)
+            retval = 10 + retval;
+        else if (num_rows - first > 2)
+            retval = 13;
+    }
+    if (!retval && num_rows != 20)
+        retval = 14;
+
+    ub_rotating_writer_destroy(&writer);
+    ub_log_column_destroy_array(columns, 2);
+    rmdir(dir);
+
+    return retval;
+}
+
+TEST_CASE(close_error) {
+    char dir[] = "/tmp/unibinlog-rotation-XXXXXX";
+    char prefix[64], path[256];
+    ub_log_column_t columns[2];
+    ub_rotating_writer_t writer;
+    uint8_t row[3];
+    uint64_t index;
+    int fd, retval = 0;
+
+    if (mkdtemp(dir) == 0)
+        return 1;
+    sprintf(prefix, "%s/log-", dir);
+
+    if (access("/dev/full", W_OK)) {
+        rmdir(dir);
+        return 0;
+    }
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "flag", UB_DATATYPE_BOOLEAN);
+
+    if (ub_rotating_writer_init(&writer, prefix, ".ubl", 0, columns, 2,
+                UB_CHKSUM_FLETCHER_16))
+        return 2;
+
+    make_row(row, 0, 0);
+    if (ub_rotating_writer_write_row(&writer, row, 3) ||
+            ub_rotating_writer_rotate(&writer))
+        retval = 3;
+
+    /* the second file cannot be flushed when it is closed */
+    if (!retval) {
+        fd = open("/dev/full", O_WRONLY);
+        if (fd < 0 || dup2(fd, fileno(writer.file)) < 0)
+            retval = 6;
+        if (fd >= 0)
+            close(fd);
+    }
+
+    if (!retval && (ub_rotating_writer_write_row(&writer, row, 3) ||
+                ub_rotating_writer_rotate(&writer)))
+        retval = 3;
+
+    /* the second file is closed while the third one is written; its error
+     * is reported even though the fourth file is started */
+    if (!retval && (ub_rotating_writer_rotate(&writer) != UB_EWRITE ||
+                writer.index != 3 || writer.file == 0))
+        retval = 4;
+    if (!retval && ub_rotating_writer_close(&writer))
+        retval = 5;
+
+    ub_rotating_writer_destroy(&writer);
+    ub_log_column_destroy_array(columns, 2);
+
+    for (index = 0; index <= 4; index++) {
+        sprintf(path, "%s/log-%06lu.ubl", dir, (unsigned long)index);
+        remove(path);
+    }
+    rmdir(dir);
+
+    return retval;
+}
+
+TEST_CASE(existing_file) {
+    char dir[] = "/tmp/unibinlog-rotation-XXXXXX";
+    char prefix[64], path[256], contents[8];
+    ub_log_column_t columns[2];
+    ub_rotating_writer_t writer;
+    uint8_t row[3];
+    uint64_t index;
+    int retval = 0;
+    FILE* f;
+
+    if (mkdtemp(dir) == 0)
+        return 1;
+    sprintf(prefix, "%s/log-", dir);
+
+    /* the second file belongs to someone else */
+    sprintf(path, "%s000001.ubl", prefix);
+    f = fopen(path, "w");
+    if (f == 0 || fputs("keep", f) == EOF || fclose(f))
+        return 2;
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "flag", UB_DATATYPE_BOOLEAN);
+
+    if (ub_rotating_writer_init(&writer, prefix, ".ubl", 0, columns, 2,
+                UB_CHKSUM_FLETCHER_16))
+        return 3;
+
+    make_row(row, 0, 0);
+    if (ub_rotating_writer_write_row(&writer, row, 3))
+        retval = 4;
+    if (!retval && (ub_rotating_writer_rotate(&writer) != UB_EWRITE ||
+                writer.file != 0))
+        retval = 5;
+    if (!retval && ub_rotating_writer_write_row(&writer, row, 3) != UB_EWRITE)
+        retval = 6;
+    if (!retval && ub_rotating_writer_close(&writer))
+        retval = 7;
+
+    ub_rotating_writer_destroy(&writer);
+    ub_log_column_destroy_array(columns, 2);
+
+    /* the existing file is neither truncated nor removed */
+    memset(contents, 0, sizeof(contents));
+    f = fopen(path, "r");
+    if (f == 0 || fread(contents, 1, sizeof(contents), f) != 4 ||
+            strcmp(contents, "keep"))
+        retval = retval ? retval : 8;
+    if (f != 0)
+        fclose(f);
+
+    for (index = 0; index <= 2; index++) {
+        sprintf(path, "%s/log-%06lu.ubl", dir, (unsigned long)index);
+        remove(path);
+    }
+    rmdir(dir);
+
+    return retval;
+}
+
+START_OF_TESTS;
+RUN_TEST_CASE(rotate_by_size);
+RUN_TEST_CASE(rotate_by_time);
+RUN_TEST_CASE(close_error);
+RUN_TEST_CASE(existing_file);
+NO_MORE_TEST_CASES;
@@ -0,0 +1,245 @@
+#include <string.h>
+
+#include <unibinlog/log_writer.h>
+#include <unibinlog/lowlevel.h>
+#include <unibinlog/scanner.h>
+#include "fmemopen.h"
+#include "common.c"
+
+#define NUM_ROWS 2000
+
+/* Summary of the rows of a range: the rows must come in order */
+typedef struct {
+    size_t num_rows;
+    uint64_t sum;
+    long first;
+    long last;
+    int ordered;
+} summary_t;
+
+/* Writes rows with a U16 and a BOOLEAN column: (i, i % 3 == 0) and
+ * returns the length of the log. Sync blocks are written every
+ * sync_interval bytes if it is not zero */
+static size_t write_log(char* buffer, size_t size, ub_chksum_type_t chksum_type,
+        ub_codec_t codec, uint64_t sync_interval) {
+    ub_log_column_t columns[2];
+    ub_log_writer_t writer;
+    uint8_t row[3];
+    size_t i, length = 0;
+    FILE* f;
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "flag", UB_DATATYPE_BOOLEAN);
+
+    f = fmemopen(buffer, size, "w");
+    if (ub_log_writer_init(&writer, f, columns, 2, chksum_type) == UB_SUCCESS) {
+        if (ub_log_writer_set_codec(&writer, codec, 0) == UB_SUCCESS &&
+                ub_log_writer_set_block_length(&writer, 96) == UB_SUCCESS &&
+                ub_log_writer_set_sync_interval(&writer, sync_interval) ==
+                UB_SUCCESS) {
+            for (i = 0; i < NUM_ROWS; i++) {
+                row[0] = i >> 8;
+                row[1] = i & 0xFF;
+                row[2] = i % 3 == 0;
+                if (ub_log_writer_write_row(&writer, row, 3))
+                    break;
+            }
+            if (i == NUM_ROWS && ub_log_writer_close(&writer) == UB_SUCCESS) {
+                fflush(f);
+                length = ftell(f);
+            }
+        }
+        ub_log_writer_destroy(&writer);
+    }
+
+    fclose(f);
+    ub_log_column_destroy_array(columns, 2);
+
+    return length;
+}
+
+static ub_error_t summarize_block(const ub_scan_block_t* block, void* state) {
+    summary_t* summary = (summary_t*)state;
+    const uint8_t* row;
+    size_t i;
+    long counter;
+
+    if (block->row_length != 3)
+        return UB_EINVAL;
+
+    for (i = 0, row = block->rows; i < block->num_rows; i++, row += 3) {
+        counter = (row[0] << 8) | row[1];
+        if (row[2] != (counter % 3 == 0))
+            return UB_EPARSE;
+        if (summary->num_rows > 0 && counter != summary->last + 1)
+            summary->ordered = 0;
+        if (summary->num_rows == 0)
+            summary->first = counter;
+        summary->last = counter;
+        summary->sum += counter;
+        summary->num_rows++;
+    }
+
+    return UB_SUCCESS;
+}
+
+static ub_error_t merge_summaries(void* state, const void* other) {
+    summary_t* summary = (summary_t*)state;
+    const summary_t* next = (const summary_t*)other;
+
+    if (next->num_rows == 0)
+        return UB_SUCCESS;
+
+    if (!next->ordered || (summary->num_rows > 0 &&
+                next->first != summary->last + 1))
+        summary->ordered = 0;
+    if (summary->num_rows == 0)
+        summary->first = next->first;
+    summary->last = next->last;
+    summary->sum += next->sum;
+    summary->num_rows += next->num_rows;
+
+    return UB_SUCCESS;
+}
+
+static int scan_log(const char* buffer, size_t length, size_t num_threads,
+        size_t num_ranges) {
+    static summary_t states[64];
+    ub_scanner_t scanner;
+    size_t i;
+    int retval = 0;
+
+    for (i = 0; i < num_ranges; i++) {
+        memset(&states[i], 0, sizeof(summary_t));
+        states[i].ordered = 1;
+    }
+
+    if (ub_scanner_init(&scanner, buffer, length))
+        return 1;
+
+    if (ub_scanner_set_num_threads(&scanner, num_threads))
+        retval = 2;
+    else if (ub_scanner_run(&scanner, num_ranges, summarize_block, states,
+                sizeof(summary_t), merge_summaries))
+        retval = 3;
+    else if (states[0].num_rows != NUM_ROWS || !states[0].ordered ||
+            states[0].first != 0 ||
+            states[0].sum != (uint64_t)NUM_ROWS * (NUM_ROWS - 1) / 2)
+        retval = 4;
+
+    ub_scanner_destroy(&scanner);
+    return retval;
+}
+
+static int scan_log_in_ranges(ub_chksum_type_t chksum_type, ub_codec_t codec,
+        uint64_t sync_interval) {
+    static char buffer[32768];
+    const size_t num_ranges[] = { 1, 2, 7, 64 };
+    const size_t num_threads[] = { 1, 4 };
+    size_t i, j, length;
+    int retval;
+
+    length = write_log(buffer, sizeof(buffer), chksum_type, codec,
+            sync_interval);
+    if (length == 0)
+        return 1;
+
+    for (i = 0; i < sizeof(num_ranges) / sizeof(num_ranges[0]); i++) {
+        for (j = 0; j < sizeof(num_threads) / sizeof(num_threads[0]); j++) {
+            retval = scan_log(buffer, length, num_threads[j], num_ranges[i]);
+            if (retval)
+                return 10 * (i + 1) + retval;
+        }
+    }
+
+    return 0;
+}
+
+TEST_CASE(scan) {
+    return scan_log_in_ranges(UB_CHKSUM_FLETCHER_16, UB_CODEC_RAW, 0);
+}
+
+TEST_CASE(scan_encoded) {
+    return scan_log_in_ranges(UB_CHKSUM_FLETCHER_16, UB_CODEC_AUTO, 0);
+}
+
+TEST_CASE(scan_without_checksums) {
+    return scan_log_in_ranges(UB_CHKSUM_NONE, UB_CODEC_RAW, 0);
+}
+
+TEST_CASE(scan_with_sync_blocks) {
+    int retval;
+
+    retval = scan_log_in_ranges(UB_CHKSUM_FLETCHER_16, UB_CODEC_RAW, 300);
+    if (!retval)
+        retval = scan_log_in_ranges(UB_CHKSUM_NONE, UB_CODEC_AUTO, 1000);
+
+    return retval;
+}
+
+TEST_CASE(find_block) {
+    static char buffer[32768];
+    ub_scanner_t scanner;
+    ub_block_type_t block_type;
+    const uint8_t* payload;
+    size_t length, size, pos, next, offset, found;
+    int retval = 0;
+
+    size = write_log(buffer, sizeof(buffer), UB_CHKSUM_FLETCHER_16,
+            UB_CODEC_RAW, 0);
+    if (size == 0)
+        return 1;
+    if (ub_scanner_init(&scanner, buffer, size))
+        return 2;
+
+    /* every offset of a block must resynchronize on the next block */
+    for (pos = scanner.start; pos < size && !retval; pos = next) {
+        if (ub_parse_block(buffer + pos, size - pos, &block_type, &payload,
+                    &length, scanner.chksum_type)) {
+            retval = 3;
+            break;
+        }
+        next = pos + 3 + length + ub_chksum_size(scanner.chksum_type);
+
+        for (offset = pos + 1; offset <= next && next < size; offset++) {
+            if (ub_scanner_find_block(&scanner, offset, &found) ||
+                    found != next) {
+                retval = 4;
+                break;
+            }
+        }
+
+        /* there is nothing to find in the last block */
+        if (next == size && pos + 1 < size &&
+                ub_scanner_find_block(&scanner, pos + 1, &found) != UB_EOF)
+            retval = 5;
+    }
+
+    if (!retval && ub_scanner_find_block(&scanner, size, &found) != UB_EOF)
+        retval = 6;
+
+    ub_scanner_destroy(&scanner);
+    return retval;
+}
+
+TEST_CASE(not_a_log) {
+    ub_scanner_t scanner;
+    char buffer[64];
+
+    memset(buffer, 0, sizeof(buffer));
+    if (ub_scanner_init(&scanner, buffer, sizeof(buffer)) != UB_EPARSE)
+        return 1;
+    if (ub_scanner_init(&scanner, buffer, 0) != UB_EPARSE)
+        return 2;
+
+    return 0;
+}
+
+START_OF_TESTS;
+RUN_TEST_CASE(scan);
+RUN_TEST_CASE(scan_encoded);
+RUN_TEST_CASE(scan_without_checksums);
+RUN_TEST_CASE(scan_with_sync_blocks);
+RUN_TEST_CASE(find_block);
+RUN_TEST_CASE(not_a_log);
+NO_MORE_TEST_CASES;
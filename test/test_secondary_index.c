@@ -0,0 +1,300 @@
+#include <string.h>
+
+#include <unibinlog/log_writer.h>
+#include <unibinlog/secondary_index.h>
+#include "fmemopen.h"
+#include "common.c"
+
+#define NUM_ROWS 300
+
+static int32_t get_value(size_t i) {
+    return (int32_t)((i * 37) % 200) - 100;
+}
+
+static void store_be(uint8_t* bytes, size_t width, uint64_t value) {
+    while (width > 0) {
+        width--;
+        bytes[width] = value & 0xFF;
+        value >>= 8;
+    }
+}
+
+/* Writes rows with a STRING, an S32 and a DOUBLE column:
+ * ("device-<i / 25>", get_value(i), get_value(i) / 8.0) */
+static int write_log(FILE* f) {
+    ub_log_column_t columns[3];
+    ub_log_writer_t writer;
+    union { double d; uint64_t u; } ratio;
+    uint8_t row[32];
+    size_t i, length;
+    int retval = 0;
+
+    ub_log_column_init(&columns[0], "device", UB_DATATYPE_STRING);
+    ub_log_column_init(&columns[1], "value", UB_DATATYPE_S32);
+    ub_log_column_init(&columns[2], "ratio", UB_DATATYPE_DOUBLE);
+
+    if (ub_log_writer_init(&writer, f, columns, 3, UB_CHKSUM_FLETCHER_16) ||
+            ub_log_writer_set_block_length(&writer, 200))
+        retval = 1;
+
+    for (i = 0; i < NUM_ROWS && !retval; i++) {
+        length = sprintf((char*)row, "device-%d", (int)(i / 25)) + 1;
+        store_be(row + length, 4, (uint32_t)get_value(i));
+        ratio.d = get_value(i) / 8.0;
+        store_be(row + length + 4, 8, ratio.u);
+        if (ub_log_writer_write_row(&writer, row, length + 12))
+            retval = 2;
+    }
+
+    if (!retval && ub_log_writer_close(&writer))
+        retval = 3;
+
+    ub_log_writer_destroy(&writer);
+    ub_log_column_destroy_array(columns, 3);
+
+    return retval;
+}
+
+/* Builds an index of the given column of the log in the given file */
+static int build_index(ub_secondary_index_t* index, FILE* f, size_t column) {
+    ub_log_reader_t reader;
+    int retval = 0;
+
+    rewind(f);
+    if (ub_log_reader_init(&reader, f))
+        return 10;
+
+    if (ub_secondary_index_build(index, &reader, column))
+        retval = 11;
+    else if (index->num_entries != NUM_ROWS || index->type !=
+            reader.columns[column].type ||
+            strcmp(index->column_name, reader.columns[column].name))
+        retval = 12;
+
+    ub_log_reader_destroy(&reader);
+    return retval;
+}
+
+/* Seeks to each entry in the given range and checks that the row number of
+ * the row is consistent with the device name found there */
+static int check_entries(const ub_secondary_index_t* index, FILE* f,
+        size_t begin, size_t end) {
+    ub_log_reader_t reader;
+    const ub_secondary_index_entry_t* entry;
+    const uint8_t* row;
+    char device[32];
+    size_t i, j;
+    int retval = 0;
+
+    rewind(f);
+    if (ub_log_reader_init(&reader, f))
+        return 20;
+
+    for (i = begin; i < end && !retval; i++) {
+        entry = &index->entries[i];
+        if (ub_log_reader_seek_entry(&reader, entry)) {
+            retval = 21;
+            break;
+        }
+
+        row = reader.rows;
+        for (j = 0; j < entry->index; j++)
+            row += strlen((const char*)row) + 13;
+
+        sprintf(device, "device-%d", (int)(entry->row / 25));
+        if (reader.first_row + entry->index != entry->row ||
+                strcmp((const char*)row, device))
+            retval = 22;
+    }
+
+    ub_log_reader_destroy(&reader);
+    return retval;
+}
+
+TEST_CASE(find_integers) {
+    static char buffer[16384];
+    ub_secondary_index_t index;
+    int32_t lower = -10, upper = 10;
+    size_t i, begin, end, expected = 0;
+    FILE* f;
+    int retval;
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    ub_secondary_index_init(&index);
+
+    retval = write_log(f);
+    if (!retval)
+        retval = build_index(&index, f, 1);
+
+    for (i = 0; i < NUM_ROWS; i++) {
+        if (get_value(i) >= lower && get_value(i) <= upper)
+            expected++;
+    }
+
+    if (!retval && ub_secondary_index_find(&index, &lower, 0, &upper, 0,
+                &begin, &end))
+        retval = 1;
+    if (!retval && end - begin != expected)
+        retval = 2;
+    if (!retval)
+        retval = check_entries(&index, f, begin, end);
+
+    /* equality lookups and open ranges */
+    lower = 100;
+    if (!retval && (ub_secondary_index_find(&index, &lower, 0, &lower, 0,
+                    &begin, &end) || end != begin))
+        retval = 3;
+    lower = -100;
+    if (!retval && (ub_secondary_index_find(&index, &lower, 0, &lower, 0,
+                    &begin, &end) || begin != 0 || end - begin != 2 ||
+                index.entries[0].row > index.entries[1].row))
+        retval = 4;
+    upper = -1;
+    for (i = 0, expected = 0; i < NUM_ROWS; i++) {
+        if (get_value(i) <= upper)
+            expected++;
+    }
+    if (!retval && (ub_secondary_index_find(&index, 0, 0, &upper, 0,
+                    &begin, &end) || begin != 0 || end != expected))
+        retval = 5;
+
+    ub_secondary_index_destroy(&index);
+    fclose(f);
+
+    return retval;
+}
+
+TEST_CASE(find_doubles) {
+    static char buffer[16384];
+    ub_secondary_index_t index;
+    double lower = -1.5, upper = 0.25;
+    size_t i, begin, end, expected = 0;
+    FILE* f;
+    int retval;
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    ub_secondary_index_init(&index);
+
+    retval = write_log(f);
+    if (!retval)
+        retval = build_index(&index, f, 2);
+
+    for (i = 0; i < NUM_ROWS; i++) {
+        if (get_value(i) / 8.0 >= lower && get_value(i) / 8.0 <= upper)
+            expected++;
+    }
+
+    if (!retval && (ub_secondary_index_find(&index, &lower, 0, &upper, 0,
+                    &begin, &end) || end - begin != expected))
+        retval = 1;
+    if (!retval)
+        retval = check_entries(&index, f, begin, end);
+
+    ub_secondary_index_destroy(&index);
+    fclose(f);
+
+    return retval;
+}
+
+TEST_CASE(find_strings) {
+    static char buffer[16384];
+    ub_secondary_index_t index;
+    size_t i, begin, end;
+    FILE* f;
+    int retval;
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    ub_secondary_index_init(&index);
+
+    retval = write_log(f);
+    if (!retval)
+        retval = build_index(&index, f, 0);
+
+    if (!retval && (ub_secondary_index_find(&index, "device-7", 8,
+                    "device-7", 8, &begin, &end) || end - begin != 25))
+        retval = 1;
+    for (i = begin; i < end && !retval; i++) {
+        if (index.entries[i].row != 175 + i - begin)
+            retval = 2;
+    }
+    if (!retval)
+        retval = check_entries(&index, f, begin, end);
+
+    /* "device-1" is a prefix of "device-10" and "device-11" */
+    if (!retval && (ub_secondary_index_find(&index, "device-1", 8,
+                    "device-1", 8, &begin, &end) || end - begin != 25))
+        retval = 3;
+    if (!retval && (ub_secondary_index_find(&index, "device-1", 8,
+                    "device-2", 8, &begin, &end) || end - begin != 100))
+        retval = 4;
+
+    ub_secondary_index_destroy(&index);
+    fclose(f);
+
+    return retval;
+}
+
+TEST_CASE(write_and_read) {
+    static char buffer[16384];
+    static char sidecar[16384];
+    ub_secondary_index_t index, loaded;
+    const ub_secondary_index_entry_t* a;
+    const ub_secondary_index_entry_t* b;
+    size_t i;
+    FILE* f;
+    FILE* g;
+    int retval;
+
+    f = fmemopen(buffer, sizeof(buffer), "w+");
+    g = fmemopen(sidecar, sizeof(sidecar), "w+");
+    ub_secondary_index_init(&index);
+    ub_secondary_index_init(&loaded);
+
+    retval = write_log(f);
+    if (!retval)
+        retval = build_index(&index, f, 0);
+
+    if (!retval && ub_secondary_index_write(&index, g, UB_CHKSUM_FLETCHER_16))
+        retval = 1;
+
+    rewind(g);
+    if (!retval && ub_secondary_index_read(&loaded, g))
+        retval = 2;
+
+    if (!retval && (loaded.column != 0 || loaded.type != UB_DATATYPE_STRING ||
+                strcmp(loaded.column_name, "device") ||
+                loaded.log_length != index.log_length ||
+                loaded.num_entries != index.num_entries))
+        retval = 3;
+
+    for (i = 0; i < loaded.num_entries && !retval; i++) {
+        a = &index.entries[i];
+        b = &loaded.entries[i];
+        if (a->key_length != b->key_length ||
+                memcmp(a->key, b->key, a->key_length) ||
+                a->offset != b->offset || a->row != b->row ||
+                a->index != b->index)
+            retval = 4;
+    }
+
+    /* a log is not a sidecar file */
+    rewind(f);
+    if (!retval && ub_secondary_index_read(&loaded, f) != UB_EPARSE)
+        retval = 5;
+    if (!retval && loaded.num_entries != 0)
+        retval = 6;
+
+    ub_secondary_index_destroy(&loaded);
+    ub_secondary_index_destroy(&index);
+    fclose(g);
+    fclose(f);
+
+    return retval;
+}
+
+START_OF_TESTS;
+RUN_TEST_CASE(find_integers);
+RUN_TEST_CASE(find_doubles);
+RUN_TEST_CASE(find_strings);
+RUN_TEST_CASE(write_and_read);
+NO_MORE_TEST_CASES;
@@ -0,0 +1,208 @@
+#include <string.h>
+#include <sys/time.h>
+
+#include <unibinlog/struct_decoder.h>
+#include "common.c"
+
+typedef struct {
+    double value;
+    int32_t counter;
+    uint8_t flag;
+    const char* label;
+    struct timeval time;
+} sample_t;
+
+TEST_CASE(validate) {
+    ub_log_column_t columns[2];
+    ub_struct_field_t fields[2] = {
+        UB_STRUCT_FIELD(sample_t, value, UB_DATATYPE_DOUBLE),
+        UB_STRUCT_FIELD(sample_t, counter, UB_DATATYPE_S32)
+    };
+    int retval = 0;
+
+    ub_log_column_init(&columns[0], "a", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "b", UB_DATATYPE_FLOAT);
+
+    /* integers may be widened into doubles, floats cannot be truncated */
+    if (ub_struct_decoder_validate(columns, 1, fields))
+        retval = 1;
+    else if (ub_struct_decoder_validate(columns, 2, fields) != UB_EINVAL)
+        retval = 2;
+
+    /* unknown fields are skipped */
+    fields[1].type = UB_DATATYPE_UNKNOWN;
+    if (!retval && ub_struct_decoder_validate(columns, 2, fields))
+        retval = 3;
+
+    /* strings can be decoded only as strings */
+    ub_log_column_set_type(&columns[1], UB_DATATYPE_STRING);
+    fields[1].type = UB_DATATYPE_U8;
+    if (!retval && ub_struct_decoder_validate(columns, 2, fields) != UB_EINVAL)
+        retval = 4;
+
+    ub_log_column_destroy_array(columns, 2);
+    return retval;
+}
+
+TEST_CASE(decode) {
+    ub_log_column_t columns[5];
+    ub_struct_field_t fields[5] = {
+        UB_STRUCT_FIELD(sample_t, counter, UB_DATATYPE_S32),
+        UB_STRUCT_FIELD(sample_t, value, UB_DATATYPE_DOUBLE),
+        UB_STRUCT_FIELD_SKIP,
+        UB_STRUCT_FIELD(sample_t, label, UB_DATATYPE_STRING),
+        UB_STRUCT_FIELD(sample_t, time, UB_DATATYPE_TIMEVAL)
+    };
+    const uint8_t rows[] = {
+        /* row 1 */
+        0xFF, 0xFE,                                      /* -2 */
+        0xC0, 0x20, 0x00, 0x00,                          /* -2.5f */
+        0x07,                                            /* skipped */
+        'f', 'o', 'o', 0,                                /* "foo" */
+        0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x20,  /* 16s 32us */
+        /* row 2 */
+        0x00, 0x05,                                      /* 5 */
+        0x3F, 0x80, 0x00, 0x00,                          /* 1.0f */
+        0x08,                                            /* skipped */
+        0,                                               /* "" */
+        0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02   /* 1s 2us */
+    };
+    sample_t samples[3];
+    size_t num_samples;
+    int retval = 0;
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_S16);
+    ub_log_column_init(&columns[1], "value", UB_DATATYPE_FLOAT);
+    ub_log_column_init(&columns[2], "ignored", UB_DATATYPE_U8);
+    ub_log_column_init(&columns[3], "label", UB_DATATYPE_STRING);
+    ub_log_column_init(&columns[4], "time", UB_DATATYPE_TIMEVAL);
+
+    memset(samples, 0, sizeof(samples));
+    if (ub_struct_decode_log_entries(columns, 5, fields, rows, sizeof(rows),
+                UB_BIG_ENDIAN, 0, samples, sizeof(sample_t), 3, &num_samples))
+        retval = 1;
+    else if (num_samples != 2)
+        retval = 2;
+    else if (samples[0].counter != -2 || samples[0].value != -2.5 ||
+            samples[1].counter != 5 || samples[1].value != 1.0)
+        retval = 3;
+    else if (strcmp(samples[0].label, "foo") || strcmp(samples[1].label, ""))
+        retval = 4;
+    else if (samples[0].time.tv_sec != 16 || samples[1].time.tv_usec != 2)
+        retval = 5;
+    else if (samples[0].flag != 0 || samples[2].counter != 0)
+        retval = 6;
+
+    /* too short arrays and truncated rows must be detected */
+    if (!retval && (ub_struct_decode_log_entries(columns, 5, fields, rows,
+                    sizeof(rows), UB_BIG_ENDIAN, 0, samples, sizeof(sample_t),
+                    1, &num_samples) != UB_ETOOLONG || num_samples != 1))
+        retval = 7;
+    if (!retval && ub_struct_decode_log_entries(columns, 5, fields, rows,
+                sizeof(rows) - 1, UB_BIG_ENDIAN, 0, samples, sizeof(sample_t),
+                3, &num_samples) != UB_EPARSE)
+        retval = 8;
+
+    ub_log_column_destroy_array(columns, 5);
+    return retval;
+}
+
+TEST_CASE(conversions) {
+    ub_log_column_t columns[3];
+    ub_struct_field_t fields[3] = {
+        UB_STRUCT_FIELD(sample_t, flag, UB_DATATYPE_BOOLEAN),
+        UB_STRUCT_FIELD(sample_t, value, UB_DATATYPE_DOUBLE),
+        UB_STRUCT_FIELD(sample_t, counter, UB_DATATYPE_S32)
+    };
+    const uint8_t rows[] = {
+        0x00, 0x00, 0x01, 0x00,                          /* 256 */
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFD,  /* -3 */
+        0xFF                                             /* 255 */
+    };
+    const uint8_t le_rows[] = {
+        0x00, 0x01, 0x00, 0x00,                          /* 256 */
+        0xFD, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,  /* -3 */
+        0x07                                             /* 7 */
+    };
+    sample_t sample;
+    int retval = 0;
+
+    ub_log_column_init(&columns[0], "flag", UB_DATATYPE_U32);
+    ub_log_column_init(&columns[1], "value", UB_DATATYPE_S64);
+    ub_log_column_init(&columns[2], "counter", UB_DATATYPE_U8);
+
+    if (ub_struct_decode_log_entries(columns, 3, fields, rows, sizeof(rows),
+                UB_BIG_ENDIAN, 0, &sample, sizeof(sample), 1, 0))
+        retval = 1;
+    else if (sample.flag != 1 || sample.value != -3 || sample.counter != 255)
+        retval = 2;
+    else if (ub_struct_decode_log_entries(columns, 3, fields, le_rows,
+                sizeof(le_rows), UB_LITTLE_ENDIAN, 0, &sample, sizeof(sample),
+                1, 0))
+        retval = 3;
+    else if (sample.flag != 1 || sample.value != -3 || sample.counter != 7)
+        retval = 4;
+
+    ub_log_column_destroy_array(columns, 3);
+    return retval;
+}
+
+TEST_CASE(aligned) {
+    ub_log_column_t columns[3];
+    ub_struct_field_t fields[3] = {
+        UB_STRUCT_FIELD(sample_t, flag, UB_DATATYPE_U8),
+        UB_STRUCT_FIELD(sample_t, value, UB_DATATYPE_DOUBLE),
+        UB_STRUCT_FIELD(sample_t, counter, UB_DATATYPE_S32)
+    };
+    const uint8_t rows[] = {
+        /* row 1 */
+        0x01, 0, 0, 0, 0, 0, 0, 0,                       /* 1, padding */
+        0x40, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  /* 3.0 */
+        0xFF, 0xFE, 0, 0, 0, 0, 0, 0,                    /* -2, padding */
+        /* row 2 */
+        0x02, 0, 0, 0, 0, 0, 0, 0,                       /* 2, padding */
+        0xC0, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  /* -4.0 */
+        0x00, 0x07, 0, 0, 0, 0, 0, 0                     /* 7, padding */
+    };
+    sample_t samples[2];
+    size_t num_samples;
+    int retval = 0;
+
+    ub_log_column_init(&columns[0], "flag", UB_DATATYPE_U8);
+    ub_log_column_init(&columns[1], "value", UB_DATATYPE_DOUBLE);
+    ub_log_column_init(&columns[2], "counter", UB_DATATYPE_S16);
+
+    if (ub_struct_decode_log_entries(columns, 3, fields, rows, sizeof(rows),
+                UB_BIG_ENDIAN, 1, samples, sizeof(sample_t), 2,
+                &num_samples))
+        retval = 1;
+    else if (num_samples != 2 || samples[0].flag != 1 ||
+            samples[0].value != 3.0 || samples[0].counter != -2 ||
+            samples[1].flag != 2 || samples[1].value != -4.0 ||
+            samples[1].counter != 7)
+        retval = 2;
+
+    /* the rows are walked with their padding */
+    if (!retval && ub_struct_decode_log_entries(columns, 3, fields, rows,
+                sizeof(rows) - 1, UB_BIG_ENDIAN, 1, samples,
+                sizeof(sample_t), 2, &num_samples) != UB_EPARSE)
+        retval = 3;
+
+    /* variable-length rows cannot be aligned */
+    ub_log_column_set_type(&columns[2], UB_DATATYPE_STRING);
+    fields[2] = (ub_struct_field_t)UB_STRUCT_FIELD_SKIP;
+    if (!retval && ub_struct_decode_log_entries(columns, 3, fields, rows,
+                sizeof(rows), UB_BIG_ENDIAN, 1, samples, sizeof(sample_t), 2,
+                &num_samples) != UB_EUNSUPPORTED)
+        retval = 4;
+
+    ub_log_column_destroy_array(columns, 3);
+    return retval;
+}
+
+START_OF_TESTS;
+RUN_TEST_CASE(validate);
+RUN_TEST_CASE(decode);
+RUN_TEST_CASE(conversions);
+RUN_TEST_CASE(aligned);
+NO_MORE_TEST_CASES;
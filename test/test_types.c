@@ -95,7 +95,57 @@ TEST_CASE(get_info) {
 	return 0;
 }
 
+TEST_CASE(get_value_length) {
+	/* fixed-length types */
+	if (ub_datatype_get_value_length(UB_DATATYPE_U32, "\0\0\0\1", 4) != 4)
+		return 1;
+	if (ub_datatype_get_value_length(UB_DATATYPE_U32, "\0\0\0", 3) != 0)
+		return 2;
+	if (ub_datatype_get_value_length(UB_DATATYPE_UNKNOWN, "\0", 1) != 0)
+		return 3;
+
+	/* strings include their terminating zero */
+	if (ub_datatype_get_value_length(UB_DATATYPE_STRING, "foo\0bar", 7) != 4)
+		return 4;
+	if (ub_datatype_get_value_length(UB_DATATYPE_STRING, "foo", 3) != 0)
+		return 5;
+
+	/* blobs include their length prefix */
+	if (ub_datatype_get_value_length(UB_DATATYPE_SHORT_BLOB, "\2ab", 3) != 3)
+		return 6;
+	if (ub_datatype_get_value_length(UB_DATATYPE_SHORT_BLOB, "\3ab", 3) != 0)
+		return 7;
+	if (ub_datatype_get_value_length(UB_DATATYPE_BLOB, "\0\1a", 3) != 3)
+		return 8;
+
+	return 0;
+}
+
+TEST_CASE(get_alignment) {
+	if (ub_datatype_get_alignment(UB_DATATYPE_BOOLEAN) != 1)
+		return 1;
+	if (ub_datatype_get_alignment(UB_DATATYPE_S16) != 2)
+		return 2;
+	if (ub_datatype_get_alignment(UB_DATATYPE_FLOAT) != 4)
+		return 3;
+	if (ub_datatype_get_alignment(UB_DATATYPE_U64) != 8)
+		return 4;
+
+	/* a timeval consists of two 32-bit integers */
+	if (ub_datatype_get_alignment(UB_DATATYPE_TIMEVAL) != 4)
+		return 5;
+
+	if (ub_datatype_get_alignment(UB_DATATYPE_STRING) != 0 ||
+			ub_datatype_get_alignment(UB_DATATYPE_UNKNOWN) != 0 ||
+			ub_datatype_get_alignment(UB_MAX_DATATYPE) != 0)
+		return 6;
+
+	return 0;
+}
+
 START_OF_TESTS;
 RUN_TEST_CASE(get_info);
+RUN_TEST_CASE(get_value_length);
+RUN_TEST_CASE(get_alignment);
 NO_MORE_TEST_CASES;
 
@@ -0,0 +1,190 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <unibinlog/log_writer.h>
+#include <unibinlog/uring_file.h>
+#include "common.c"
+
+#define NUM_ROWS 20000
+#define MAX_LENGTH 262144
+
+/* Writes a log with an index into the given stream, syncing the io_uring
+ * file through the writer if it is given */
+static ub_error_t write_log(FILE* f, ub_uring_file_t* file) {
+    ub_log_column_t columns[2];
+    ub_log_writer_t writer;
+    ub_error_t retval;
+    uint8_t row[3];
+    size_t i;
+
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "flag", UB_DATATYPE_BOOLEAN);
+
+    retval = ub_log_writer_init(&writer, f, columns, 2, UB_CHKSUM_FLETCHER_16);
+    if (retval == UB_SUCCESS) {
+        retval = ub_log_writer_set_block_length(&writer, 300);
+        if (retval == UB_SUCCESS)
+            retval = ub_log_writer_set_index(&writer, 1);
+        if (retval == UB_SUCCESS)
+            retval = ub_log_writer_set_sync_interval(&writer, 4096);
+
+        /* the stream has no file descriptor to sync */
+        if (retval == UB_SUCCESS && file &&
+                ub_log_writer_sync(&writer) != UB_EUNSUPPORTED)
+            retval = UB_FAILURE;
+        if (retval == UB_SUCCESS && file)
+            retval = ub_uring_file_attach(file, &writer);
+        if (retval == UB_SUCCESS && file)
+            retval = ub_log_writer_set_durability(&writer,
+                    UB_DURABILITY_BLOCK_COUNT, 8);
+
+        for (i = 0; i < NUM_ROWS && retval == UB_SUCCESS; i++) {
+            row[0] = i >> 8;
+            row[1] = i & 0xFF;
+            row[2] = i % 2;
+            retval = ub_log_writer_write_row(&writer, row, 3);
+        }
+
+        if (retval == UB_SUCCESS)
+            retval = ub_log_writer_close(&writer);
+        ub_log_writer_destroy(&writer);
+    }
+
+    ub_log_column_destroy_array(columns, 2);
+    return retval;
+}
+
+/* Reads the file with the given path into the buffer and removes it */
+static size_t read_file(const char* path, uint8_t* buffer, size_t size) {
+    size_t length;
+    FILE* f;
+
+    f = fopen(path, "rb");
+    if (f == 0)
+        return 0;
+
+    length = fread(buffer, 1, size, f);
+    fclose(f);
+    remove(path);
+
+    return length;
+}
+
+/* Writes the log through an io_uring file and compares it to the log
+ * written by plain stdio */
+static int write_through_uring(size_t buffer_size, size_t num_buffers,
+        ub_bool_t async) {
+    static uint8_t expected[MAX_LENGTH], actual[MAX_LENGTH];
+    char path[] = "/tmp/unibinlog-uring-XXXXXX";
+    ub_uring_file_t file;
+    size_t expected_length, actual_length;
+    int fd, retval = 0;
+    FILE* f;
+
+    f = tmpfile();
+    if (f == 0 || write_log(f, 0))
+        return 1;
+    fflush(f);
+    rewind(f);
+    expected_length = fread(expected, 1, MAX_LENGTH, f);
+    fclose(f);
+
+    fd = mkstemp(path);
+    if (fd < 0)
+        return 2;
+
+    if (ub_uring_file_init(&file, fd, buffer_size, num_buffers, async)) {
+        close(fd);
+        remove(path);
+        return 3;
+    }
+
+    if (!async && file.async)
+        retval = 4;
+    else if (write_log(file.file, &file))
+        retval = 5;
+    else if (ub_uring_file_sync(&file))
+        retval = 6;
+    else if (ub_uring_file_close(&file))
+        retval = 7;
+    ub_uring_file_destroy(&file);
+
+    actual_length = read_file(path, actual, MAX_LENGTH);
+    if (!retval && (actual_length != expected_length ||
+                memcmp(actual, expected, expected_length)))
+        retval = 8;
+
+    return retval;
+}
+
+TEST_CASE(write_async) {
+    int retval;
+
+    retval = write_through_uring(4096, 4, 1);
+    if (!retval)
+        retval = write_through_uring(1000, 2, 1);
+    if (!retval)
+        retval = write_through_uring(100000, 8, 1);
+
+    return retval;
+}
+
+TEST_CASE(write_sync) {
+    return write_through_uring(1000, 3, 0);
+}
+
+TEST_CASE(seek) {
+    char path[] = "/tmp/unibinlog-uring-XXXXXX";
+    uint8_t contents[16];
+    ub_uring_file_t file;
+    int fd, retval = 0;
+
+    fd = mkstemp(path);
+    if (fd < 0)
+        return 1;
+
+    if (ub_uring_file_init(&file, fd, 4, 2, 1)) {
+        close(fd);
+        remove(path);
+        return 2;
+    }
+
+    /* ftell() does not wait for the writes; seeking back rewrites */
+    if (fputs("abcdefghij", file.file) < 0 || ftell(file.file) != 10)
+        retval = 3;
+    else if (fseek(file.file, 2, SEEK_SET) || fputs("XY", file.file) < 0 ||
+            ftell(file.file) != 4)
+        retval = 4;
+    else if (fseek(file.file, 0, SEEK_END) || ftell(file.file) != 10 ||
+            fputs("k", file.file) < 0)
+        retval = 5;
+    else if (ub_uring_file_close(&file))
+        retval = 6;
+    ub_uring_file_destroy(&file);
+
+    if (!retval && (read_file(path, contents, sizeof(contents)) != 11 ||
+                memcmp(contents, "abXYefghijk", 11)))
+        retval = 7;
+    remove(path);
+
+    return retval;
+}
+
+TEST_CASE(invalid_arguments) {
+    ub_uring_file_t file;
+
+    if (ub_uring_file_init(&file, 0, 0, 4, 1) != UB_EINVAL)
+        return 1;
+    if (ub_uring_file_init(&file, 0, 4096, 1, 1) != UB_EINVAL)
+        return 2;
+
+    return 0;
+}
+
+START_OF_TESTS;
+RUN_TEST_CASE(write_async);
+RUN_TEST_CASE(write_sync);
+RUN_TEST_CASE(seek);
+RUN_TEST_CASE(invalid_arguments);
+NO_MORE_TEST_CASES;
@@ -0,0 +1,187 @@
+#include <string.h>
+
+#include <unibinlog/zone_map.h>
+#include "common.c"
+
+static const uint8_t nan_bits[] = { 0x7F, 0xF8, 0, 0, 0, 0, 0, 0 };
+static const uint8_t half_bits[] = { 0x3F, 0xE0, 0, 0, 0, 0, 0, 0 };
+static const uint8_t two_bits[] = { 0x40, 0x00, 0, 0, 0, 0, 0, 0 };
+
+/* Builds three rows with a U16, an S16, a DOUBLE and a STRING column:
+ * (3, -5, 0.5, "a"), (7, 2, NaN, ""), (5, -1, 2.0, "bc") */
+static size_t make_rows(uint8_t* rows) {
+    const uint16_t counters[] = { 3, 7, 5 };
+    const int16_t deltas[] = { -5, 2, -1 };
+    const uint8_t* values[] = { half_bits, nan_bits, two_bits };
+    const char* names[] = { "a", "", "bc" };
+    uint8_t* p = rows;
+    size_t i;
+
+    for (i = 0; i < 3; i++) {
+        *p++ = counters[i] >> 8;
+        *p++ = counters[i] & 0xFF;
+        *p++ = (uint16_t)deltas[i] >> 8;
+        *p++ = (uint16_t)deltas[i] & 0xFF;
+        memcpy(p, values[i], 8);
+        p += 8;
+        strcpy((char*)p, names[i]);
+        p += strlen(names[i]) + 1;
+    }
+
+    return p - rows;
+}
+
+static void make_columns(ub_log_column_t* columns) {
+    ub_log_column_init(&columns[0], "counter", UB_DATATYPE_U16);
+    ub_log_column_init(&columns[1], "delta", UB_DATATYPE_S16);
+    ub_log_column_init(&columns[2], "value", UB_DATATYPE_DOUBLE);
+    ub_log_column_init(&columns[3], "name", UB_DATATYPE_STRING);
+}
+
+TEST_CASE(compute) {
+    ub_log_column_t columns[4];
+    ub_zone_map_t map;
+    uint8_t rows[64];
+    size_t length;
+    int retval = 0;
+
+    make_columns(columns);
+    length = make_rows(rows);
+    ub_zone_map_init(&map);
+
+    if (ub_zone_map_compute(&map, columns, 4, 0, UB_BIG_ENDIAN, rows, length))
+        retval = 1;
+    else if (map.num_rows != 3 || map.num_entries != 3)
+        retval = 2;
+    else if (map.entries[0].column != 0 || map.entries[0].min.u != 3 ||
+            map.entries[0].max.u != 7 || map.entries[0].num_nans != 0)
+        retval = 3;
+    else if (map.entries[1].column != 1 || map.entries[1].min.s != -5 ||
+            map.entries[1].max.s != 2)
+        retval = 4;
+    else if (map.entries[2].column != 2 || map.entries[2].min.f != 0.5 ||
+            map.entries[2].max.f != 2.0 || map.entries[2].num_nans != 1)
+        retval = 5;
+    else if (ub_zone_map_compute(&map, columns, 4, 0, UB_BIG_ENDIAN, rows,
+                length - 1) != UB_EINVAL)
+        retval = 6;
+
+    ub_zone_map_destroy(&map);
+    ub_log_column_destroy_array(columns, 4);
+    return retval;
+}
+
+TEST_CASE(encode_and_decode) {
+    ub_log_column_t columns[4];
+    ub_zone_map_t map, decoded;
+    ub_buffer_t payload;
+    uint8_t rows[64];
+    size_t length;
+    int retval = 0;
+
+    make_columns(columns);
+    length = make_rows(rows);
+    ub_zone_map_init(&map);
+    ub_zone_map_init(&decoded);
+    ub_buffer_init(&payload, 0);
+
+    if (ub_zone_map_compute(&map, columns, 4, 0, UB_BIG_ENDIAN, rows, length))
+        retval = 1;
+    else if (ub_zone_map_encode(&map, &payload))
+        retval = 2;
+    else if (ub_buffer_size(&payload) != 3 + 3 * UB_ZONE_MAP_ENTRY_LENGTH)
+        retval = 3;
+    else if (ub_zone_map_decode(&decoded, UB_BUFFER(payload),
+                ub_buffer_size(&payload)))
+        retval = 4;
+    else if (decoded.num_rows != 3 || decoded.num_entries != 3 ||
+            memcmp(decoded.entries, map.entries,
+                3 * sizeof(ub_zone_map_entry_t)))
+        retval = 5;
+    else if (ub_zone_map_decode(&decoded, UB_BUFFER(payload),
+                ub_buffer_size(&payload) - 1) != UB_EPARSE)
+        retval = 6;
+
+    ub_buffer_destroy(&payload);
+    ub_zone_map_destroy(&decoded);
+    ub_zone_map_destroy(&map);
+    ub_log_column_destroy_array(columns, 4);
+    return retval;
+}
+
+static int may_match(const ub_zone_map_t* map, const ub_log_column_t* columns,
+        size_t column, ub_filter_op_t op, const void* value) {
+    ub_filter_t filter;
+
+    if (ub_filter_init(&filter, column, columns[column].type, op, value))
+        return -1;
+
+    return ub_zone_map_may_match(map, columns, 4, &filter, 1);
+}
+
+TEST_CASE(may_match) {
+    ub_log_column_t columns[4];
+    ub_filter_t filters[2];
+    ub_zone_map_t map;
+    uint8_t rows[64];
+    uint16_t u16;
+    int16_t s16;
+    double value;
+    int retval = 0;
+
+    make_columns(columns);
+    ub_zone_map_init(&map);
+    ub_zone_map_compute(&map, columns, 4, 0, UB_BIG_ENDIAN, rows,
+            make_rows(rows));
+
+    /* counter is in [3; 7] */
+    u16 = 3;
+    if (may_match(&map, columns, 0, UB_FILTER_LT, &u16) != 0 ||
+            may_match(&map, columns, 0, UB_FILTER_LE, &u16) != 1 ||
+            may_match(&map, columns, 0, UB_FILTER_EQ, &u16) != 1)
+        retval = 1;
+    u16 = 8;
+    if (!retval && (may_match(&map, columns, 0, UB_FILTER_GE, &u16) != 0 ||
+                may_match(&map, columns, 0, UB_FILTER_NE, &u16) != 1 ||
+                may_match(&map, columns, 0, UB_FILTER_EQ, &u16) != 0))
+        retval = 2;
+
+    /* delta is in [-5; 2], compared as a signed value */
+    s16 = -6;
+    if (!retval && (may_match(&map, columns, 1, UB_FILTER_LT, &s16) != 0 ||
+                may_match(&map, columns, 1, UB_FILTER_GT, &s16) != 1))
+        retval = 3;
+
+    /* value is in [0.5; 2] with a NaN */
+    value = 2.5;
+    if (!retval && (may_match(&map, columns, 2, UB_FILTER_GT, &value) != 0 ||
+                may_match(&map, columns, 2, UB_FILTER_LT, &value) != 1))
+        retval = 4;
+
+    /* filters are combined with AND */
+    u16 = 5;
+    value = 0.25;
+    ub_filter_init(&filters[0], 0, UB_DATATYPE_U16, UB_FILTER_EQ, &u16);
+    ub_filter_init(&filters[1], 2, UB_DATATYPE_DOUBLE, UB_FILTER_LE, &value);
+    if (!retval && (ub_zone_map_may_match(&map, columns, 4, filters, 1) != 1 ||
+                ub_zone_map_may_match(&map, columns, 4, filters, 2) != 0))
+        retval = 5;
+
+    /* only numeric columns can be filtered */
+    if (!retval && ub_filter_init(&filters[0], 3, UB_DATATYPE_STRING,
+                UB_FILTER_EQ, "a") != UB_EUNSUPPORTED)
+        retval = 6;
+    if (!retval && ub_filter_init(&filters[0], 0, UB_DATATYPE_U16,
+                UB_MAX_FILTER_OP, &u16) != UB_EINVAL)
+        retval = 7;
+
+    ub_zone_map_destroy(&map);
+    ub_log_column_destroy_array(columns, 4);
+    return retval;
+}
+
+START_OF_TESTS;
+RUN_TEST_CASE(compute);
+RUN_TEST_CASE(encode_and_decode);
+RUN_TEST_CASE(may_match);
+NO_MORE_TEST_CASES;
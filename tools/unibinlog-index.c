@@ -0,0 +1,116 @@
+/* vim:set ts=4 sw=4 sts=4 et: */
+
+/**
+ * Builds a secondary index sidecar file for a column of an existing
+ * \c unibin log file.
+ *
+ * Usage: unibinlog-index LOGFILE COLUMN [INDEXFILE]
+ *
+ * COLUMN is the name or the index of the column to index. The index is
+ * written into INDEXFILE, or into LOGFILE.idx if it is not given.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unibinlog/log_reader.h>
+#include <unibinlog/memory.h>
+#include <unibinlog/secondary_index.h>
+
+static int find_column(const ub_log_reader_t* reader, const char* spec,
+        size_t* column) {
+    char* end;
+    size_t i;
+
+    for (i = 0; i < reader->num_columns; i++) {
+        if (!strcmp(reader->columns[i].name, spec)) {
+            *column = i;
+            return 1;
+        }
+    }
+
+    *column = strtoul(spec, &end, 10);
+    return *spec != 0 && *end == 0 && *column < reader->num_columns;
+}
+
+int main(int argc, char* argv[]) {
+    ub_secondary_index_t index;
+    ub_log_reader_t reader;
+    ub_error_t retval;
+    char* index_path = 0;
+    size_t column;
+    FILE* log;
+    FILE* out;
+
+    if (argc < 3 || argc > 4) {
+        fprintf(stderr, "Usage: %s LOGFILE COLUMN [INDEXFILE]\n", argv[0]);
+        return 1;
+    }
+
+    log = fopen(argv[1], "rb");
+    if (log == 0) {
+        perror(argv[1]);
+        return 2;
+    }
+
+    retval = ub_log_reader_init(&reader, log);
+    if (retval != UB_SUCCESS) {
+        fprintf(stderr, "%s: %s\n", argv[1], ub_error_to_string(retval));
+        fclose(log);
+        return 2;
+    }
+
+    if (!find_column(&reader, argv[2], &column)) {
+        fprintf(stderr, "%s: no such column: %s\n", argv[1], argv[2]);
+        ub_log_reader_destroy(&reader);
+        fclose(log);
+        return 1;
+    }
+
+    ub_secondary_index_init(&index);
+    retval = ub_secondary_index_build(&index, &reader, column);
+    ub_log_reader_destroy(&reader);
+    fclose(log);
+
+    if (retval != UB_SUCCESS) {
+        fprintf(stderr, "%s: %s\n", argv[1], ub_error_to_string(retval));
+        ub_secondary_index_destroy(&index);
+        return 2;
+    }
+
+    if (argc > 3) {
+        out = fopen(argv[3], "wb");
+    } else {
+        index_path = ub_calloc(char, strlen(argv[1]) + 5);
+        if (index_path == 0) {
+            ub_secondary_index_destroy(&index);
+            return 2;
+        }
+        sprintf(index_path, "%s.idx", argv[1]);
+        out = fopen(index_path, "wb");
+    }
+
+    if (out == 0) {
+        perror(argc > 3 ? argv[3] : index_path);
+        retval = UB_EWRITE;
+    } else {
+        retval = ub_secondary_index_write(&index, out, UB_CHKSUM_FLETCHER_16);
+        if (fclose(out) && retval == UB_SUCCESS)
+            retval = UB_EWRITE;
+        if (retval != UB_SUCCESS) {
+            fprintf(stderr, "%s: %s\n", argc > 3 ? argv[3] : index_path,
+                    ub_error_to_string(retval));
+        }
+    }
+
+    if (retval == UB_SUCCESS) {
+        printf("Indexed %lu rows of column %s.\n",
+                (unsigned long)index.num_entries, index.column_name);
+    }
+
+    ub_free_unless_null(index_path);
+    ub_secondary_index_destroy(&index);
+
+    return retval == UB_SUCCESS ? 0 : 2;
+}